@@ -0,0 +1,54 @@
+#pragma once
+
+/*
+ * Tiny helpers shared by the benchmarks. Each benchmark is a standalone
+ * executable which prints its timings to stdout, build them with
+ * -DSIMULANT_BUILD_BENCHMARKS=ON and a Release build type.
+ */
+
+#include <chrono>
+#include <cstdio>
+#include <functional>
+#include <string>
+
+#include <simulant/simulant.h>
+
+namespace benchmark {
+
+#ifdef _arch_dreamcast
+typedef smlt::KOSWindow BenchmarkWindow;
+#else
+typedef smlt::SDL2Window BenchmarkWindow;
+#endif
+
+/* Creates a hidden window without an application, the same way the tests do */
+inline BenchmarkWindow::ptr create_window() {
+#ifdef _arch_dreamcast
+    auto window = smlt::KOSWindow::create(nullptr, 640, 480, 32, false, true);
+#else
+    auto window = smlt::SDL2Window::create(nullptr, 640, 480, 0, false, true);
+#endif
+    window->_init();
+    window->set_logging_level(smlt::LOG_LEVEL_NONE);
+    return window;
+}
+
+/* Runs func iterations times, and prints the mean time per iteration */
+inline double run(const std::string& name, uint32_t iterations, std::function<void ()> func) {
+    // Warm up caches and any lazily allocated storage
+    func();
+
+    auto start = std::chrono::high_resolution_clock::now();
+    for(uint32_t i = 0; i < iterations; ++i) {
+        func();
+    }
+    auto end = std::chrono::high_resolution_clock::now();
+
+    double ms = std::chrono::duration<double, std::milli>(end - start).count() / double(iterations);
+    printf("%-60s %10.3f ms\n", name.c_str(), ms);
+    fflush(stdout);
+
+    return ms;
+}
+
+}
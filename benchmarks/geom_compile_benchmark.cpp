@@ -0,0 +1,93 @@
+/*
+ * Times compiling a large generated level mesh into a Geom's octree, on a single
+ * thread and across the window's worker pool.
+ *
+ * The mesh is a bumpy grid split into strips with different materials, which is
+ * roughly what a big terrain or city level looks like to the culler.
+ */
+
+#include <cmath>
+#include <string>
+
+#include "benchmark.h"
+#include "simulant/nodes/geoms/octree_culler.h"
+#include "simulant/generic/threading/worker_pool.h"
+
+using namespace smlt;
+
+namespace {
+
+const uint32_t GRID_SIZE = 1000;
+const uint32_t MATERIAL_COUNT = 4;
+
+MeshPtr generate_level(Stage* stage) {
+    auto mesh = stage->assets->new_mesh(VertexSpecification::DEFAULT).fetch();
+
+    for(uint32_t z = 0; z <= GRID_SIZE; ++z) {
+        for(uint32_t x = 0; x <= GRID_SIZE; ++x) {
+            float height = std::sin(float(x) * 0.1f) * std::cos(float(z) * 0.1f) * 5.0f;
+
+            mesh->vertex_data->position(float(x), height, -float(z));
+            mesh->vertex_data->normal(0, 1, 0);
+            mesh->vertex_data->tex_coord0(float(x) / GRID_SIZE, float(z) / GRID_SIZE);
+            mesh->vertex_data->diffuse(Colour::WHITE);
+            mesh->vertex_data->move_next();
+        }
+    }
+
+    mesh->vertex_data->done();
+
+    const uint32_t rows_per_material = GRID_SIZE / MATERIAL_COUNT;
+
+    for(uint32_t m = 0; m < MATERIAL_COUNT; ++m) {
+        auto material = stage->assets->new_material_from_file(Material::BuiltIns::DIFFUSE_ONLY);
+        auto submesh = mesh->new_submesh_with_material(
+            "strip" + std::to_string(m), material, MESH_ARRANGEMENT_TRIANGLES, INDEX_TYPE_32_BIT
+        );
+
+        for(uint32_t z = m * rows_per_material; z < (m + 1) * rows_per_material; ++z) {
+            for(uint32_t x = 0; x < GRID_SIZE; ++x) {
+                uint32_t i = z * (GRID_SIZE + 1) + x;
+
+                submesh->index_data->index(i);
+                submesh->index_data->index(i + 1);
+                submesh->index_data->index(i + GRID_SIZE + 1);
+
+                submesh->index_data->index(i + 1);
+                submesh->index_data->index(i + GRID_SIZE + 2);
+                submesh->index_data->index(i + GRID_SIZE + 1);
+            }
+        }
+
+        submesh->index_data->done();
+    }
+
+    return mesh;
+}
+
+}
+
+int main(int argc, char* argv[]) {
+    auto window = benchmark::create_window();
+    auto stage = window->new_stage();
+
+    auto mesh = generate_level(stage);
+    printf("Triangles: %u\n", GRID_SIZE * GRID_SIZE * 2);
+
+    WorkerPool serial_workers(0);
+
+    benchmark::run("OctreeCuller::compile (1 thread)", 3, [&]() {
+        OctreeCuller culler(nullptr, mesh);
+        culler.set_compile_workers(&serial_workers);
+        culler.compile();
+    });
+
+    auto name = "OctreeCuller::compile (" + std::to_string(window->workers->thread_count()) + " threads)";
+    benchmark::run(name, 3, [&]() {
+        OctreeCuller culler(nullptr, mesh);
+        culler.set_compile_workers(window->workers.get());
+        culler.compile();
+    });
+
+    return 0;
+}
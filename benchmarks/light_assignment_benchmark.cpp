@@ -0,0 +1,104 @@
+/*
+ * Compares testing every light against every node (what run_pipeline used to do)
+ * against building a LightGrid and only testing the candidates it returns.
+ *
+ * This only needs bounding boxes so no window is created, the grid timings
+ * include rebuilding the grid as that happens once per camera each frame.
+ */
+
+#include <vector>
+
+#include "benchmark.h"
+#include "simulant/partitioners/impl/light_grid.h"
+
+using namespace smlt;
+
+namespace {
+
+const uint32_t NODE_COUNT = 5000;
+const float WORLD_SIZE = 512.0f;
+
+Vec3 random_position(RandomGenerator& random) {
+    return Vec3(
+        random.float_in_range(-WORLD_SIZE, WORLD_SIZE),
+        random.float_in_range(-WORLD_SIZE / 8, WORLD_SIZE / 8),
+        random.float_in_range(-WORLD_SIZE, WORLD_SIZE)
+    );
+}
+
+void benchmark_light_count(RandomGenerator& random, const std::vector<AABB>& nodes, uint32_t light_count) {
+    std::vector<AABB> lights;
+    float total_dimension = 0.0f;
+    for(uint32_t i = 0; i < light_count; ++i) {
+        lights.push_back(AABB(random_position(random), random.float_in_range(4.0f, 32.0f)));
+        total_dimension += lights.back().max_dimension();
+    }
+
+    uint64_t brute_force_hits = 0;
+    auto prefix = std::to_string(light_count) + " lights: ";
+
+    benchmark::run(prefix + "every light per node", 10, [&]() {
+        brute_force_hits = 0;
+        for(auto& node: nodes) {
+            for(auto& light: lights) {
+                if(light.intersects_aabb(node)) {
+                    ++brute_force_hits;
+                }
+            }
+        }
+    });
+
+    LightGrid grid;
+    std::vector<uint32_t> candidates;
+    uint64_t grid_hits = 0;
+    uint64_t candidate_count = 0;
+
+    benchmark::run(prefix + "light grid", 10, [&]() {
+        grid_hits = 0;
+        candidate_count = 0;
+
+        grid.reset(LightGrid::cell_size_for_dimension(total_dimension / float(light_count)));
+        for(uint32_t i = 0; i < light_count; ++i) {
+            grid.insert(i, lights[i]);
+        }
+        grid.finalize();
+
+        for(auto& node: nodes) {
+            candidates.clear();
+            grid.candidates_for_box(node, candidates);
+            candidate_count += candidates.size();
+
+            for(auto i: candidates) {
+                if(lights[i].intersects_aabb(node)) {
+                    ++grid_hits;
+                }
+            }
+        }
+    });
+
+    printf(
+        "    hits: %llu vs %llu, tests per node: %u vs %.2f\n",
+        (unsigned long long) brute_force_hits,
+        (unsigned long long) grid_hits,
+        light_count,
+        double(candidate_count) / double(nodes.size())
+    );
+}
+
+}
+
+int main(int argc, char* argv[]) {
+    // Seeded, so every run places the same nodes and lights
+    RandomGenerator random(1);
+
+    std::vector<AABB> nodes;
+    for(uint32_t i = 0; i < NODE_COUNT; ++i) {
+        nodes.push_back(AABB(random_position(random), random.float_in_range(0.5f, 4.0f)));
+    }
+
+    for(uint32_t light_count = 8; light_count <= 1024; light_count *= 2) {
+        benchmark_light_count(random, nodes, light_count);
+    }
+
+    return 0;
+}
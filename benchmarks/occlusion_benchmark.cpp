@@ -0,0 +1,88 @@
+/*
+ * Times filling the OcclusionBuffer from a city-like grid of building occluders,
+ * and testing a few thousand boxes against it, at a few buffer sizes.
+ *
+ * This doesn't need a window, the occlusion buffer runs entirely on the CPU.
+ */
+
+#include <string>
+#include <vector>
+
+#include "benchmark.h"
+#include "simulant/occlusion_buffer.h"
+
+using namespace smlt;
+
+namespace {
+
+const uint32_t BUILDINGS_PER_SIDE = 16;
+const uint32_t BOX_COUNT = 5000;
+
+/* The four walls of a box-shaped building, as a triangle list */
+void add_building(std::vector<Vec3>& triangles, const Vec3& min, const Vec3& max) {
+    Vec3 corners[] = {
+        Vec3(min.x, min.y, min.z), Vec3(max.x, min.y, min.z),
+        Vec3(max.x, min.y, max.z), Vec3(min.x, min.y, max.z)
+    };
+
+    for(uint32_t i = 0; i < 4; ++i) {
+        auto a = corners[i];
+        auto b = corners[(i + 1) % 4];
+        auto c = Vec3(b.x, max.y, b.z);
+        auto d = Vec3(a.x, max.y, a.z);
+
+        triangles.push_back(a); triangles.push_back(b); triangles.push_back(c);
+        triangles.push_back(a); triangles.push_back(c); triangles.push_back(d);
+    }
+}
+
+}
+
+int main(int argc, char* argv[]) {
+    // Seeded, so every run measures the same city
+    RandomGenerator random(1);
+
+    std::vector<Vec3> triangles;
+    for(uint32_t z = 0; z < BUILDINGS_PER_SIDE; ++z) {
+        for(uint32_t x = 0; x < BUILDINGS_PER_SIDE; ++x) {
+            Vec3 min(float(x) * 20.0f - 160.0f, 0, -float(z) * 20.0f - 10.0f);
+            Vec3 max = min + Vec3(12.0f, random.float_in_range(10.0f, 40.0f), 12.0f);
+            add_building(triangles, min, max);
+        }
+    }
+
+    std::vector<AABB> boxes;
+    for(uint32_t i = 0; i < BOX_COUNT; ++i) {
+        Vec3 centre(random.float_in_range(-160, 160), random.float_in_range(0, 10), random.float_in_range(-320, -5));
+        boxes.push_back(AABB(centre, random.float_in_range(0.5f, 4.0f)));
+    }
+
+    Mat4 projection = Mat4::as_projection(Degrees(60.0), 16.0 / 9.0, 0.1, 500.0);
+    Mat4 view = Mat4::as_look_at(Vec3(0, 5, 0), Vec3(0, 5, -1), Vec3(0, 1, 0));
+
+    uint32_t sizes[][2] = {{128, 64}, {256, 128}, {512, 256}};
+
+    for(auto& size: sizes) {
+        OcclusionBuffer buffer(size[0], size[1]);
+        buffer.set_view_projection(projection * view);
+
+        auto prefix = "OcclusionBuffer " + std::to_string(size[0]) + "x" + std::to_string(size[1]) + ": ";
+
+        benchmark::run(prefix + "rasterize occluders", 100, [&]() {
+            buffer.clear();
+            buffer.rasterize_triangles(&triangles[0], triangles.size());
+        });
+
+        uint32_t occluded = 0;
+        benchmark::run(prefix + "test boxes", 100, [&]() {
+            occluded = 0;
+            for(auto& box: boxes) {
+                occluded += buffer.is_occluded(box);
+            }
+        });
+
+        printf("    occluded: %u / %u\n", occluded, BOX_COUNT);
+    }
+
+    return 0;
+}
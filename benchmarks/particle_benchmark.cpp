@@ -0,0 +1,76 @@
+/*
+ * Times the per-frame particle update (integration, removing expired particles and a
+ * SizeManipulator) for a big particle system. The array-of-structs loop the update
+ * used to be is timed alongside it for comparison.
+ *
+ * This doesn't need a window, the particle pool is plain CPU work.
+ */
+
+#include <algorithm>
+#include <vector>
+
+#include "benchmark.h"
+#include "simulant/nodes/particles/particle_pool.h"
+#include "simulant/nodes/particles/manipulators/size_manipulator.h"
+
+using namespace smlt;
+using namespace smlt::particles;
+
+namespace {
+
+const uint32_t PARTICLE_COUNT = 10000;
+const float DT = 1.0f / 60.0f;
+
+Particle random_particle(RandomGenerator& random) {
+    Particle particle;
+    particle.position = Vec3(random.float_in_range(-10, 10), random.float_in_range(-10, 10), random.float_in_range(-10, 10));
+    particle.velocity = Vec3(random.float_in_range(-1, 1), random.float_in_range(0, 5), random.float_in_range(-1, 1));
+    particle.dimensions = Vec2(1, 1);
+    particle.ttl = random.float_in_range(0.5f, 5.0f);
+    particle.colour = Colour::WHITE;
+    return particle;
+}
+
+}
+
+int main(int argc, char* argv[]) {
+    // Seeded, so every run spawns the same particles
+    RandomGenerator random(1);
+
+    SizeManipulator manipulator;
+    manipulator.set_property("rate", 0.5f);
+
+    std::vector<Particle> aos;
+    benchmark::run("Array of structs update (10000 particles)", 1000, [&]() {
+        while(aos.size() < PARTICLE_COUNT) {
+            aos.push_back(random_particle(random));
+        }
+
+        for(auto& particle: aos) {
+            particle.position += particle.velocity * DT;
+            particle.ttl -= DT;
+        }
+
+        aos.erase(
+            std::remove_if(aos.begin(), aos.end(), [](const Particle& p) -> bool { return p.ttl <= 0.0f; }),
+            aos.end()
+        );
+
+        manipulator.manipulate(aos, DT);
+    });
+
+    ParticlePool pool;
+    pool.set_capacity(PARTICLE_COUNT);
+
+    benchmark::run("ParticlePool update (10000 particles)", 1000, [&]() {
+        while(pool.size() < PARTICLE_COUNT) {
+            pool.push_back(random_particle(random));
+        }
+
+        pool.integrate(DT);
+        pool.remove_expired();
+        manipulator.manipulate(pool, DT);
+    });
+
+    return 0;
+}
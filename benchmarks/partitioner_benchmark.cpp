@@ -0,0 +1,103 @@
+/*
+ * Compares the partitioners on scenes where few, some, or all of the actors
+ * move every frame.
+ *
+ * Each frame moves the dynamic actors, applies the staged writes and then asks
+ * the partitioner what the camera can see, which is what a rendered frame does.
+ */
+
+#include <string>
+#include <vector>
+
+#include "benchmark.h"
+
+using namespace smlt;
+
+namespace {
+
+const uint32_t ACTOR_COUNT = 10000;
+const float WORLD_SIZE = 512.0f;
+
+struct SceneConfig {
+    std::string name;
+
+    /* Every nth actor moves each frame */
+    uint32_t dynamic_stride;
+};
+
+void benchmark_partitioner(Window* window, AvailablePartitioner type, const std::string& name, const SceneConfig& scene) {
+    // Same seed for every partitioner, so they all get the same scene
+    RandomGenerator random(1);
+
+    auto stage = window->new_stage(type);
+    auto camera = stage->new_camera();
+    camera->set_perspective_projection(Degrees(60.0), 16.0 / 9.0, 1.0, WORLD_SIZE);
+
+    auto mesh = stage->assets->new_mesh_as_cube(1.0);
+
+    std::vector<ActorPtr> actors;
+    std::vector<Vec3> velocities;
+
+    for(uint32_t i = 0; i < ACTOR_COUNT; ++i) {
+        auto actor = stage->new_actor_with_mesh(mesh);
+        actor->move_to(
+            random.float_in_range(-WORLD_SIZE, WORLD_SIZE),
+            random.float_in_range(-WORLD_SIZE / 8, WORLD_SIZE / 8),
+            random.float_in_range(-WORLD_SIZE, WORLD_SIZE)
+        );
+
+        actors.push_back(actor);
+        velocities.push_back(Vec3(random.float_in_range(-1, 1), 0, random.float_in_range(-1, 1)));
+    }
+
+    stage->partitioner->_apply_writes();
+
+    std::vector<LightID> lights;
+    std::vector<StageNode*> nodes;
+
+    float direction = 1.0f;
+    uint32_t frame = 0;
+
+    auto prefix = name + " (" + scene.name + "): ";
+    benchmark::run(prefix + "frame", 20, [&]() {
+        // Back and forth, so the actors stay in the world
+        if(++frame % 20 == 0) {
+            direction = -direction;
+        }
+
+        for(uint32_t i = 0; i < actors.size(); i += scene.dynamic_stride) {
+            actors[i]->move_by(velocities[i] * direction);
+        }
+
+        stage->partitioner->_apply_writes();
+
+        lights.clear();
+        nodes.clear();
+        stage->partitioner->lights_and_geometry_visible_from(camera->id(), lights, nodes);
+    });
+
+    printf("    visible: %u\n", (uint32_t) nodes.size());
+
+    window->delete_stage(stage->id());
+}
+
+}
+
+int main(int argc, char* argv[]) {
+    auto window = benchmark::create_window();
+
+    SceneConfig scenes[] = {
+        {"static heavy", 50},
+        {"mixed", 3},
+        {"dynamic heavy", 1}
+    };
+
+    for(auto& scene: scenes) {
+        benchmark_partitioner(window.get(), PARTITIONER_FRUSTUM, "Frustum", scene);
+        benchmark_partitioner(window.get(), PARTITIONER_HASH, "SpatialHash", scene);
+        benchmark_partitioner(window.get(), PARTITIONER_FLAT_HASH, "FlatSpatialHash", scene);
+        benchmark_partitioner(window.get(), PARTITIONER_AABB_TREE, "AABBTree", scene);
+    }
+
+    return 0;
+}
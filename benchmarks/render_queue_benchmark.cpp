@@ -0,0 +1,117 @@
+/*
+ * Compares traversing the std::map/std::list batched render queue against the
+ * flat sort key command buffer.
+ *
+ * The visitor does nothing, so this measures the cost of the queue itself
+ * (plus keying and sorting for the sort key backend), not of the GL calls.
+ */
+
+#include <vector>
+
+#include "benchmark.h"
+#include "simulant/renderers/batching/render_queue.h"
+
+using namespace smlt;
+
+namespace {
+
+const uint32_t MATERIAL_COUNT = 16;
+
+class NullVisitor : public batcher::RenderQueueVisitor {
+public:
+    void start_traversal(const batcher::RenderQueue&, uint64_t, Stage*) override {}
+    void end_traversal(const batcher::RenderQueue&, Stage*) override {}
+    void change_render_group(const batcher::RenderGroup*, const batcher::RenderGroup*) override { ++group_changes; }
+    void change_material_pass(const MaterialPass*, const MaterialPass*) override { ++pass_changes; }
+    void apply_lights(const LightPtr*, const uint8_t) override {}
+    void change_light(const Light*, const Light*) override {}
+    void visit(Renderable*, MaterialPass*, batcher::Iteration) override { ++visits; }
+
+    uint64_t group_changes = 0;
+    uint64_t pass_changes = 0;
+    uint64_t visits = 0;
+};
+
+void benchmark_traversal(Window* window, uint32_t renderable_count) {
+    auto stage = window->new_stage();
+
+    std::vector<MeshID> meshes;
+    for(uint32_t i = 0; i < MATERIAL_COUNT; ++i) {
+        auto material = stage->assets->new_material_from_file(Material::BuiltIns::DIFFUSE_ONLY);
+        auto mesh = stage->assets->new_mesh_as_cube(1.0);
+        mesh.fetch()->set_material_id(material);
+        meshes.push_back(mesh);
+    }
+
+    RenderPriority priorities[] = {RENDER_PRIORITY_BACKGROUND, RENDER_PRIORITY_MAIN, RENDER_PRIORITY_FOREGROUND};
+
+    const uint64_t frame_id = 1;
+
+    std::vector<Renderable*> renderables;
+    renderables.reserve(renderable_count);
+
+    for(uint32_t i = 0; i < renderable_count; ++i) {
+        // Interleave materials and priorities so that insertion order is the worst case
+        auto actor = stage->new_actor_with_mesh(meshes[i % MATERIAL_COUNT]);
+        actor->set_render_priority(priorities[(i / MATERIAL_COUNT) % 3]);
+        actor->move_to(float(i % 100), float((i / 100) % 100), -float(i / 10000));
+
+        auto renderable = &actor->subactor(0);
+        renderable->update_last_visible_frame_id(frame_id);
+        renderables.push_back(renderable);
+    }
+
+    batcher::RenderQueue batched(stage, window->renderer.get(), batcher::RENDER_QUEUE_BACKEND_BATCHED);
+    batcher::RenderQueue sorted(stage, window->renderer.get(), batcher::RENDER_QUEUE_BACKEND_SORT_KEYS);
+
+    auto prefix = std::to_string(renderable_count) + " renderables: ";
+    const uint32_t iterations = (renderable_count > 10000) ? 10 : 100;
+
+    benchmark::run(prefix + "insert (batched)", 1, [&]() {
+        batched.clear();
+        for(auto renderable: renderables) {
+            batched.update_renderable(renderable);
+        }
+    });
+
+    benchmark::run(prefix + "insert (sort keys)", 1, [&]() {
+        sorted.clear();
+        for(auto renderable: renderables) {
+            sorted.update_renderable(renderable);
+        }
+    });
+
+    NullVisitor batched_visitor;
+    benchmark::run(prefix + "traverse (batched)", iterations, [&]() {
+        batched.traverse(&batched_visitor, frame_id);
+    });
+
+    NullVisitor sorted_visitor;
+    benchmark::run(prefix + "traverse (sort keys)", iterations, [&]() {
+        sorted.traverse(&sorted_visitor, frame_id, Vec3());
+    });
+
+    // Per traversal, both runs include the same warm up traversal
+    printf(
+        "    group changes: %llu vs %llu, material pass changes: %llu vs %llu\n",
+        (unsigned long long) (batched_visitor.group_changes / (iterations + 1)),
+        (unsigned long long) (sorted_visitor.group_changes / (iterations + 1)),
+        (unsigned long long) (batched_visitor.pass_changes / (iterations + 1)),
+        (unsigned long long) (sorted_visitor.pass_changes / (iterations + 1))
+    );
+
+    batched.clear();
+    sorted.clear();
+    window->delete_stage(stage->id());
+}
+
+}
+
+int main(int argc, char* argv[]) {
+    auto window = benchmark::create_window();
+
+    benchmark_traversal(window.get(), 10000);
+    benchmark_traversal(window.get(), 100000);
+
+    return 0;
+}
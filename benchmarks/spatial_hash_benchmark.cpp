@@ -0,0 +1,109 @@
+/*
+ * Compares the std::map based SpatialHash with the FlatSpatialHash for inserting,
+ * moving and querying entries, from 1k up to 1M entries.
+ *
+ * The boxes are the shapes used in tests/test_spatial_hash.h (small and large cubes,
+ * and flat boxes) scattered so that the density stays the same as the count grows.
+ */
+
+#include <cmath>
+#include <vector>
+#include <memory>
+
+#include "benchmark.h"
+#include "simulant/frustum.h"
+#include "simulant/partitioners/impl/spatial_hash.h"
+#include "simulant/partitioners/impl/flat_spatial_hash.h"
+
+using namespace smlt;
+
+namespace {
+
+AABB random_box(RandomGenerator& random, float world_size) {
+    Vec3 centre(
+        random.float_in_range(-world_size, world_size),
+        random.float_in_range(-world_size, world_size),
+        random.float_in_range(-world_size, world_size)
+    );
+
+    switch(random.int_in_range(0, 3)) {
+        case 0: return AABB(centre, 0.5f);
+        case 1: return AABB(centre, 5.0f);
+        case 2: return AABB(centre, 1.0f);
+    default:
+        // Flat, like a floor tile
+        return AABB(centre, centre + Vec3(1, 1, 0));
+    }
+}
+
+void benchmark_index(const std::string& name, SpatialIndex* index, const std::vector<AABB>& boxes, const Frustum& frustum) {
+    std::vector<SpatialHashEntry> entries(boxes.size());
+
+    auto prefix = std::to_string(boxes.size()) + " entries (" + name + "): ";
+    uint32_t iterations = (boxes.size() >= 100000) ? 1 : 10;
+
+    benchmark::run(prefix + "insert", iterations, [&]() {
+        for(auto& entry: entries) {
+            index->remove_object(&entry);
+        }
+
+        for(uint32_t i = 0; i < boxes.size(); ++i) {
+            index->insert_object_for_box(boxes[i], &entries[i]);
+        }
+    });
+
+    float offset = 0.0f;
+    benchmark::run(prefix + "update (small moves)", iterations, [&]() {
+        offset += 0.25f;
+        for(uint32_t i = 0; i < boxes.size(); ++i) {
+            auto box = boxes[i];
+            index->update_object_for_box(AABB(box.min() + Vec3(offset, 0, 0), box.max() + Vec3(offset, 0, 0)), &entries[i]);
+        }
+    });
+
+    std::size_t visible = 0;
+    benchmark::run(prefix + "frustum query", iterations * 10, [&]() {
+        visible = index->find_objects_within_frustum(frustum).size();
+    });
+
+    printf("    visible: %u\n", (uint32_t) visible);
+
+    for(auto& entry: entries) {
+        index->remove_object(&entry);
+    }
+}
+
+}
+
+int main(int argc, char* argv[]) {
+    Frustum frustum;
+    Mat4 projection = Mat4::as_projection(Degrees(45.0), 16.0 / 9.0, 0.1, 100.0);
+    Mat4 modelview;
+    Mat4 modelview_projection = projection * modelview;
+    frustum.build(&modelview_projection);
+
+    // Seeded, so every run measures the same scenes
+    RandomGenerator random(1);
+
+    for(uint32_t count = 1000; count <= 1000000; count *= 10) {
+        // Keep roughly one entry per 1000 cubic units
+        float world_size = 0.5f * std::cbrt(float(count) * 1000.0f);
+
+        std::vector<AABB> boxes;
+        for(uint32_t i = 0; i < count; ++i) {
+            boxes.push_back(random_box(random, world_size));
+        }
+
+        {
+            std::unique_ptr<SpatialIndex> hash(new SpatialHash());
+            benchmark_index("SpatialHash", hash.get(), boxes, frustum);
+        }
+
+        {
+            std::unique_ptr<SpatialIndex> hash(new FlatSpatialHash());
+            benchmark_index("FlatSpatialHash", hash.get(), boxes, frustum);
+        }
+    }
+
+    return 0;
+}
@@ -0,0 +1,103 @@
+/*
+ * Times filling a million vertices (position, normal, texcoord0 and diffuse) through
+ * VertexData's cursor, through attribute spans and through a typed VertexView. Reading the
+ * positions back is timed the same way.
+ *
+ * This doesn't need a window, VertexData is plain CPU work.
+ */
+
+#include <vector>
+
+#include "benchmark.h"
+#include "simulant/vertex_view.h"
+
+using namespace smlt;
+
+namespace {
+
+const uint32_t VERTEX_COUNT = 1000000;
+
+typedef VertexView<VertexPosition3F, VertexNormal3F, VertexTexCoord0_2F, VertexDiffuse4F> View;
+
+struct SourceAttributes {
+    std::vector<Vec3> positions;
+    std::vector<Vec3> normals;
+    std::vector<Vec2> uvs;
+};
+
+SourceAttributes make_source() {
+    SourceAttributes source;
+    source.positions.reserve(VERTEX_COUNT);
+    source.normals.reserve(VERTEX_COUNT);
+    source.uvs.reserve(VERTEX_COUNT);
+
+    for(uint32_t i = 0; i < VERTEX_COUNT; ++i) {
+        float f = float(i);
+        source.positions.push_back(Vec3(f, f * 0.5f, -f));
+        source.normals.push_back(Vec3(0, 1, 0));
+        source.uvs.push_back(Vec2(f / VERTEX_COUNT, 1.0f - (f / VERTEX_COUNT)));
+    }
+
+    return source;
+}
+
+}
+
+int main(int argc, char* argv[]) {
+    const SourceAttributes source = make_source();
+
+    VertexData data(View::layout::specification());
+
+    benchmark::run("Fill 1M vertices with the cursor", 10, [&]() {
+        data.clear();
+
+        for(uint32_t i = 0; i < VERTEX_COUNT; ++i) {
+            data.position(source.positions[i]);
+            data.normal(source.normals[i]);
+            data.tex_coord0(source.uvs[i]);
+            data.diffuse(Colour::WHITE);
+            data.move_next();
+        }
+
+        data.done();
+    });
+
+    benchmark::run("Fill 1M vertices with attribute spans", 10, [&]() {
+        data.clear();
+        data.resize(VERTEX_COUNT);
+
+        data.attribute_span<Vec3>(VERTEX_ATTRIBUTE_BIT_POSITION).assign(&source.positions[0], VERTEX_COUNT);
+        data.attribute_span<Vec3>(VERTEX_ATTRIBUTE_BIT_NORMAL).assign(&source.normals[0], VERTEX_COUNT);
+        data.attribute_span<Vec2>(VERTEX_ATTRIBUTE_BIT_TEXCOORD0).assign(&source.uvs[0], VERTEX_COUNT);
+        data.attribute_span<Colour>(VERTEX_ATTRIBUTE_BIT_DIFFUSE).fill(Colour::WHITE);
+
+        data.done();
+    });
+
+    benchmark::run("Fill 1M vertices with a VertexView", 10, [&]() {
+        data.clear();
+        data.resize(VERTEX_COUNT);
+
+        View view(data);
+        view.span<VertexPosition3F>().assign(&source.positions[0], VERTEX_COUNT);
+        view.span<VertexNormal3F>().assign(&source.normals[0], VERTEX_COUNT);
+        view.span<VertexTexCoord0_2F>().assign(&source.uvs[0], VERTEX_COUNT);
+        view.span<VertexDiffuse4F>().fill(Colour::WHITE);
+
+        data.done();
+    });
+
+    std::vector<Vec3> out(VERTEX_COUNT);
+
+    benchmark::run("Read 1M positions with position_at", 10, [&]() {
+        for(uint32_t i = 0; i < VERTEX_COUNT; ++i) {
+            out[i] = data.position_at<Vec3>(i);
+        }
+    });
+
+    benchmark::run("Read 1M positions with a VertexView", 10, [&]() {
+        View(data).span<VertexPosition3F>().copy_to(&out[0]);
+    });
+
+    return 0;
+}
@@ -18,6 +18,7 @@
 //
 
 #include <cassert>
+#include <limits>
 #include "frustum.h"
 #include "types.h"
 
@@ -79,6 +80,40 @@ bool Frustum::intersects_aabb(const AABB& aabb) const {
     return true;
 }
 
+FrustumClassification Frustum::classify_aabb(const AABB& box) const {
+    const float epsilon = std::numeric_limits<float>::epsilon();
+
+    auto& min = box.min();
+    auto& max = box.max();
+
+    FrustumClassification result = FRUSTUM_CONTAINS_ALL;
+
+    for(const Plane& plane: planes_) {
+        // The corners furthest in front of, and behind, the plane
+        Vec3 front(
+            (plane.n.x >= 0) ? max.x : min.x,
+            (plane.n.y >= 0) ? max.y : min.y,
+            (plane.n.z >= 0) ? max.z : min.z
+        );
+
+        Vec3 back(
+            (plane.n.x >= 0) ? min.x : max.x,
+            (plane.n.y >= 0) ? min.y : max.y,
+            (plane.n.z >= 0) ? min.z : max.z
+        );
+
+        if(plane.n.dot(front) + plane.d < -epsilon) {
+            return FRUSTUM_CONTAINS_NONE;
+        }
+
+        if(plane.n.dot(back) + plane.d < epsilon) {
+            result = FRUSTUM_CONTAINS_PARTIAL;
+        }
+    }
+
+    return result;
+}
+
 Vec3 Frustum::direction() const {
     Vec3 far = Vec3::find_average(far_corners());
     Vec3 near = Vec3::find_average(near_corners());
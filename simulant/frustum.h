@@ -53,6 +53,10 @@ public:
     bool intersects_aabb(const AABB &box) const;
     bool intersects_cube(const Vec3& centre, float size) const;
 
+    /* Returns whether the box is entirely outside, partially inside or entirely inside the
+     * frustum. Anything that intersects_aabb() accepts is at least FRUSTUM_CONTAINS_PARTIAL */
+    FrustumClassification classify_aabb(const AABB& box) const;
+
     bool initialized() const { return initialized_; }
 
     double near_height() const {
@@ -96,6 +100,17 @@ public:
         return (far_avg - near_avg).length();
     }    
 
+    /* The camera's right and up directions in world space */
+    Vec3 right() const {
+        assert(initialized_);
+        return (near_corners_[FRUSTUM_CORNER_BOTTOM_RIGHT] - near_corners_[FRUSTUM_CORNER_BOTTOM_LEFT]).normalized();
+    }
+
+    Vec3 up() const {
+        assert(initialized_);
+        return (near_corners_[FRUSTUM_CORNER_TOP_LEFT] - near_corners_[FRUSTUM_CORNER_BOTTOM_LEFT]).normalized();
+    }
+
     Plane plane(FrustumPlane p) const {
         return planes_[p];
     }
@@ -0,0 +1,85 @@
+#include <cassert>
+#include <algorithm>
+
+#include "frame_arena.h"
+
+namespace smlt {
+
+FrameArena::FrameArena(std::size_t initial_size):
+    bytes_allocated_(0),
+    allocation_count_(0),
+    heap_allocation_count_(0) {
+
+    blocks_.push_back(std::unique_ptr<Block>(new Block(initial_size)));
+    current_ = blocks_.back().get();
+}
+
+void* FrameArena::allocate(std::size_t size, std::size_t alignment) {
+    assert(alignment && (alignment & (alignment - 1)) == 0);
+
+    // Reserve enough that the start can always be aligned
+    std::size_t required = size + alignment - 1;
+
+    Block* block = current_.load();
+    while(true) {
+        std::size_t offset = block->used.fetch_add(required);
+
+        if(offset + required <= block->size) {
+            uintptr_t address = uintptr_t(block->data.get() + offset);
+            address = (address + alignment - 1) & ~uintptr_t(alignment - 1);
+
+            bytes_allocated_ += size;
+            allocation_count_++;
+
+            return (void*) address;
+        }
+
+        // Block is full (its used count now runs past the end, which is fine)
+        block = add_block(block, required);
+    }
+}
+
+FrameArena::Block* FrameArena::add_block(Block* full, std::size_t required) {
+    std::lock_guard<std::mutex> lock(blocks_lock_);
+
+    // Another thread may have already replaced the full block
+    Block* current = current_.load();
+    if(current != full) {
+        return current;
+    }
+
+    std::size_t size = std::max(blocks_.back()->size * 2, required);
+    blocks_.push_back(std::unique_ptr<Block>(new Block(size)));
+    heap_allocation_count_++;
+
+    current_ = blocks_.back().get();
+    return current_;
+}
+
+std::size_t FrameArena::capacity() const {
+    std::size_t total = 0;
+    for(auto& block: blocks_) {
+        total += block->size;
+    }
+    return total;
+}
+
+void FrameArena::reset() {
+    bytes_allocated_ = 0;
+    allocation_count_ = 0;
+    heap_allocation_count_ = 0;
+
+    if(blocks_.size() > 1) {
+        // Last frame didn't fit, so replace everything with a single block that would have
+        auto total = capacity();
+        blocks_.clear();
+        blocks_.push_back(std::unique_ptr<Block>(new Block(total)));
+        heap_allocation_count_++;
+    } else {
+        blocks_[0]->used = 0;
+    }
+
+    current_ = blocks_.back().get();
+}
+
+}
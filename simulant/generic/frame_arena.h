@@ -0,0 +1,155 @@
+#pragma once
+
+#include <cstdint>
+#include <cstddef>
+#include <new>
+#include <vector>
+#include <memory>
+#include <mutex>
+#include <atomic>
+#include <unordered_set>
+#include <functional>
+
+namespace smlt {
+
+/*
+ * A bump allocator for data which only needs to live until the end of the frame.
+ *
+ * Allocating is a single atomic add (so it's safe to use from the worker pool),
+ * freeing does nothing at all, and everything is released at once by reset() which
+ * the Window calls at the start of each frame. If a frame needs more than one block
+ * then the blocks are merged into one on the next reset, so once the frame loop has
+ * warmed up the arena doesn't touch the heap.
+ *
+ * Anything allocated from the arena must not be used after the next reset().
+ */
+class FrameArena {
+public:
+    const static std::size_t DEFAULT_BLOCK_SIZE = 64 * 1024;
+    const static std::size_t DEFAULT_ALIGNMENT = 16;
+
+    FrameArena(std::size_t initial_size=DEFAULT_BLOCK_SIZE);
+
+    FrameArena(const FrameArena&) = delete;
+    FrameArena& operator=(const FrameArena&) = delete;
+
+    void* allocate(std::size_t size, std::size_t alignment=DEFAULT_ALIGNMENT);
+
+    /* Releases everything allocated since the last reset. Must not be called while
+     * another thread is allocating. */
+    void reset();
+
+    /* Totals since the last reset */
+    std::size_t bytes_allocated() const { return bytes_allocated_; }
+    uint32_t allocation_count() const { return allocation_count_; }
+
+    /* How many blocks had to be taken from the heap since the last reset */
+    uint32_t heap_allocation_count() const { return heap_allocation_count_; }
+
+    std::size_t capacity() const;
+
+private:
+    struct Block {
+        Block(std::size_t size):
+            data(new uint8_t[size]),
+            size(size),
+            used(0) {}
+
+        std::unique_ptr<uint8_t[]> data;
+        std::size_t size;
+        std::atomic<std::size_t> used;
+    };
+
+    Block* add_block(Block* full, std::size_t required);
+
+    std::mutex blocks_lock_;
+    std::vector<std::unique_ptr<Block>> blocks_;
+    std::atomic<Block*> current_;
+
+    std::atomic<std::size_t> bytes_allocated_;
+    std::atomic<uint32_t> allocation_count_;
+    std::atomic<uint32_t> heap_allocation_count_;
+};
+
+
+/*
+ * A standard allocator which takes its memory from a FrameArena. Deallocation is a
+ * no-op, the memory is reclaimed when the arena resets. A default constructed
+ * allocator (with no arena) uses the heap, so containers using it work fine outside
+ * of the frame loop too.
+ */
+template<typename T>
+class FrameAllocator {
+public:
+    typedef T value_type;
+    typedef T* pointer;
+    typedef const T* const_pointer;
+    typedef T& reference;
+    typedef const T& const_reference;
+    typedef std::size_t size_type;
+    typedef std::ptrdiff_t difference_type;
+
+    template<typename U>
+    struct rebind {
+        typedef FrameAllocator<U> other;
+    };
+
+    FrameAllocator(FrameArena* arena=nullptr):
+        arena_(arena) {}
+
+    template<typename U>
+    FrameAllocator(const FrameAllocator<U>& other):
+        arena_(other.arena()) {}
+
+    T* allocate(std::size_t n) {
+        if(arena_) {
+            return static_cast<T*>(arena_->allocate(n * sizeof(T), alignof(T)));
+        }
+
+        return static_cast<T*>(::operator new(n * sizeof(T)));
+    }
+
+    void deallocate(T* p, std::size_t) {
+        if(!arena_) {
+            ::operator delete(p);
+        }
+    }
+
+    template<typename U, typename... Args>
+    void construct(U* p, Args&&... args) {
+        ::new((void*) p) U(std::forward<Args>(args)...);
+    }
+
+    template<typename U>
+    void destroy(U* p) {
+        p->~U();
+    }
+
+    std::size_t max_size() const {
+        return std::size_t(-1) / sizeof(T);
+    }
+
+    FrameArena* arena() const { return arena_; }
+
+private:
+    FrameArena* arena_;
+};
+
+template<typename T, typename U>
+bool operator==(const FrameAllocator<T>& lhs, const FrameAllocator<U>& rhs) {
+    return lhs.arena() == rhs.arena();
+}
+
+template<typename T, typename U>
+bool operator!=(const FrameAllocator<T>& lhs, const FrameAllocator<U>& rhs) {
+    return lhs.arena() != rhs.arena();
+}
+
+/* Containers for per-frame data, construct them with FrameAllocator<T>(arena) */
+template<typename T>
+using FrameVector = std::vector<T, FrameAllocator<T>>;
+
+template<typename T, typename Hash=std::hash<T>>
+using FrameUnorderedSet = std::unordered_set<T, Hash, std::equal_to<T>, FrameAllocator<T>>;
+
+}
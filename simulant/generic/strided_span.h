@@ -0,0 +1,143 @@
+#pragma once
+
+#include <cstdint>
+#include <cstddef>
+#include <cstring>
+#include <cassert>
+#include <iterator>
+
+namespace smlt {
+
+/*
+ * A view of count values of type T which are stride bytes apart in memory, for
+ * example one attribute of every vertex in interleaved vertex data. The span
+ * doesn't own the memory, so it's only valid for as long as the memory is.
+ *
+ * The bulk operations (assign, fill, generate, transform, copy_to) are the fast way
+ * to get data in and out. When the values are tightly packed (stride == sizeof(T))
+ * assign() and copy_to() are a single memcpy.
+ */
+template<typename T>
+class StridedSpan {
+public:
+    class iterator {
+    public:
+        typedef std::forward_iterator_tag iterator_category;
+        typedef T value_type;
+        typedef std::ptrdiff_t difference_type;
+        typedef T* pointer;
+        typedef T& reference;
+
+        iterator(uint8_t* ptr, uint32_t stride):
+            ptr_(ptr), stride_(stride) {}
+
+        T& operator*() const { return *reinterpret_cast<T*>(ptr_); }
+        T* operator->() const { return reinterpret_cast<T*>(ptr_); }
+
+        iterator& operator++() {
+            ptr_ += stride_;
+            return *this;
+        }
+
+        iterator operator++(int) {
+            iterator ret = *this;
+            ptr_ += stride_;
+            return ret;
+        }
+
+        bool operator==(const iterator& rhs) const { return ptr_ == rhs.ptr_; }
+        bool operator!=(const iterator& rhs) const { return ptr_ != rhs.ptr_; }
+
+    private:
+        uint8_t* ptr_;
+        uint32_t stride_;
+    };
+
+    StridedSpan() = default;
+
+    StridedSpan(uint8_t* data, uint32_t stride, uint32_t size):
+        data_(data), stride_(stride), size_(size) {
+
+        assert(stride_ >= sizeof(T));
+    }
+
+    T& operator[](uint32_t i) const {
+        assert(i < size_);
+        return *reinterpret_cast<T*>(data_ + (i * stride_));
+    }
+
+    uint32_t size() const { return size_; }
+    uint32_t stride() const { return stride_; }
+    bool empty() const { return size_ == 0; }
+    bool packed() const { return stride_ == sizeof(T); }
+
+    iterator begin() const { return iterator(data_, stride_); }
+    iterator end() const { return iterator(data_ + (size_ * stride_), stride_); }
+
+    /* The count values starting at first */
+    StridedSpan subspan(uint32_t first, uint32_t count) const {
+        assert(first + count <= size_);
+        return StridedSpan(data_ + (first * stride_), stride_, count);
+    }
+
+    /* Copies count values from the array into the start of the span */
+    void assign(const T* values, uint32_t count) const {
+        assert(count <= size_);
+
+        if(packed()) {
+            std::memcpy(data_, values, count * sizeof(T));
+            return;
+        }
+
+        uint8_t* out = data_;
+        for(uint32_t i = 0; i < count; ++i, out += stride_) {
+            std::memcpy(out, &values[i], sizeof(T));
+        }
+    }
+
+    void fill(const T& value) const {
+        uint8_t* out = data_;
+        for(uint32_t i = 0; i < size_; ++i, out += stride_) {
+            std::memcpy(out, &value, sizeof(T));
+        }
+    }
+
+    /* Sets each value to func(i), where i is its index in the span */
+    template<typename Func>
+    void generate(Func func) const {
+        uint8_t* out = data_;
+        for(uint32_t i = 0; i < size_; ++i, out += stride_) {
+            *reinterpret_cast<T*>(out) = func(i);
+        }
+    }
+
+    /* Replaces each value with func(value) */
+    template<typename Func>
+    void transform(Func func) const {
+        uint8_t* out = data_;
+        for(uint32_t i = 0; i < size_; ++i, out += stride_) {
+            T& value = *reinterpret_cast<T*>(out);
+            value = func(value);
+        }
+    }
+
+    /* Copies every value in the span to out, which must have room for size() of them */
+    void copy_to(T* out) const {
+        if(packed()) {
+            std::memcpy(out, data_, size_ * sizeof(T));
+            return;
+        }
+
+        const uint8_t* in = data_;
+        for(uint32_t i = 0; i < size_; ++i, in += stride_) {
+            std::memcpy(&out[i], in, sizeof(T));
+        }
+    }
+
+private:
+    uint8_t* data_ = nullptr;
+    uint32_t stride_ = sizeof(T);
+    uint32_t size_ = 0;
+};
+
+}
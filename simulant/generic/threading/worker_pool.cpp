@@ -0,0 +1,133 @@
+//
+//   Copyright (c) 2011-2017 Luke Benstead https://simulant-engine.appspot.com
+//
+//     This file is part of Simulant.
+//
+//     Simulant is free software: you can redistribute it and/or modify
+//     it under the terms of the GNU General Public License as published by
+//     the Free Software Foundation, either version 3 of the License, or
+//     (at your option) any later version.
+//
+//     Simulant is distributed in the hope that it will be useful,
+//     but WITHOUT ANY WARRANTY; without even the implied warranty of
+//     MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+//     GNU General Public License for more details.
+//
+//     You should have received a copy of the GNU General Public License
+//     along with Simulant.  If not, see <http://www.gnu.org/licenses/>.
+//
+
+#include <algorithm>
+
+#include "worker_pool.h"
+
+namespace smlt {
+
+uint32_t WorkerPool::default_worker_count() {
+#ifdef _arch_dreamcast
+    return 0;
+#else
+    uint32_t hardware_threads = std::thread::hardware_concurrency();
+    return (hardware_threads > 1) ? hardware_threads - 1 : 0;
+#endif
+}
+
+WorkerPool::WorkerPool(uint32_t worker_count):
+    next_chunk_(0) {
+
+    for(uint32_t i = 0; i < worker_count; ++i) {
+        // Index 0 is the calling thread
+        threads_.push_back(std::thread(&WorkerPool::run_worker, this, i + 1));
+    }
+}
+
+WorkerPool::~WorkerPool() {
+    {
+        std::lock_guard<std::mutex> lock(lock_);
+        shutting_down_ = true;
+    }
+
+    job_ready_.notify_all();
+
+    for(auto& thread: threads_) {
+        thread.join();
+    }
+}
+
+void WorkerPool::parallel_for(uint32_t count, uint32_t chunk_size, ChunkFunction func) {
+    if(!count) {
+        return;
+    }
+
+    chunk_size = std::max(chunk_size, 1u);
+
+    // Don't bother waking anyone if there's only one chunk
+    if(threads_.empty() || count <= chunk_size) {
+        func(0, 0, count);
+        return;
+    }
+
+    std::lock_guard<std::mutex> job_lock(job_lock_);
+
+    {
+        std::lock_guard<std::mutex> lock(lock_);
+        func_ = func;
+        count_ = count;
+        chunk_size_ = chunk_size;
+        next_chunk_ = 0;
+        busy_workers_ = threads_.size();
+        ++generation_;
+    }
+
+    job_ready_.notify_all();
+
+    run_chunks(0);
+
+    std::unique_lock<std::mutex> lock(lock_);
+    job_finished_.wait(lock, [this]() { return busy_workers_ == 0; });
+
+    func_ = ChunkFunction();
+}
+
+void WorkerPool::run_chunks(uint32_t worker) {
+    const uint32_t chunk_count = (count_ + chunk_size_ - 1) / chunk_size_;
+
+    while(true) {
+        uint32_t chunk = next_chunk_++;
+        if(chunk >= chunk_count) {
+            break;
+        }
+
+        uint32_t begin = chunk * chunk_size_;
+        uint32_t end = std::min(begin + chunk_size_, count_);
+        func_(worker, begin, end);
+    }
+}
+
+void WorkerPool::run_worker(uint32_t index) {
+    uint64_t last_generation = 0;
+
+    while(true) {
+        {
+            std::unique_lock<std::mutex> lock(lock_);
+            job_ready_.wait(lock, [&]() { return shutting_down_ || generation_ != last_generation; });
+
+            if(shutting_down_) {
+                return;
+            }
+
+            last_generation = generation_;
+        }
+
+        run_chunks(index);
+
+        {
+            std::lock_guard<std::mutex> lock(lock_);
+            --busy_workers_;
+        }
+
+        job_finished_.notify_one();
+    }
+}
+
+}
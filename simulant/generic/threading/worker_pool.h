@@ -0,0 +1,102 @@
+/* *   Copyright (c) 2011-2017 Luke Benstead https://simulant-engine.appspot.com
+ *
+ *     This file is part of Simulant.
+ *
+ *     Simulant is free software: you can redistribute it and/or modify
+ *     it under the terms of the GNU General Public License as published by
+ *     the Free Software Foundation, either version 3 of the License, or
+ *     (at your option) any later version.
+ *
+ *     Simulant is distributed in the hope that it will be useful,
+ *     but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *     MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *     GNU General Public License for more details.
+ *
+ *     You should have received a copy of the GNU General Public License
+ *     along with Simulant.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#pragma once
+
+#include <cstdint>
+#include <vector>
+#include <thread>
+#include <mutex>
+#include <condition_variable>
+#include <functional>
+#include <atomic>
+
+namespace smlt {
+
+/*
+ * A fixed set of threads for running data-parallel jobs. The calling thread
+ * always takes part in a job, so a pool with no workers just runs everything
+ * inline (which is what happens on platforms without threads).
+ *
+ * Usage:
+ *
+ * pool.parallel_for(items.size(), 64, [&](uint32_t worker, uint32_t begin, uint32_t end) {
+ *     for(auto i = begin; i < end; ++i) {
+ *         process(items[i], scratch[worker]);
+ *     }
+ * });
+ *
+ * Chunks are handed out in no particular order, so anything that needs to be
+ * deterministic should write its results by index and merge them afterwards.
+ */
+class WorkerPool {
+public:
+    typedef std::function<void (uint32_t, uint32_t, uint32_t)> ChunkFunction;
+
+    /* Uses one less worker than the number of hardware threads */
+    static uint32_t default_worker_count();
+
+    WorkerPool(uint32_t worker_count=default_worker_count());
+    ~WorkerPool();
+
+    WorkerPool(const WorkerPool&) = delete;
+    WorkerPool& operator=(const WorkerPool&) = delete;
+
+    uint32_t worker_count() const { return threads_.size(); }
+
+    /* The number of threads that can run a chunk, and so the number of scratch
+     * buffers the caller needs. Worker indexes are always less than this. */
+    uint32_t thread_count() const { return threads_.size() + 1; }
+
+    /*
+     * Splits [0, count) into chunks of chunk_size and calls func(worker, begin, end)
+     * for each of them. Returns once every chunk has finished. Must not be called
+     * from inside a chunk.
+     *
+     * Any thread can call this, but the pool runs one job at a time: a second caller
+     * (e.g. something being loaded in the background) waits for the first job to finish
+     * before its own starts.
+     */
+    void parallel_for(uint32_t count, uint32_t chunk_size, ChunkFunction func);
+
+private:
+    void run_worker(uint32_t index);
+    void run_chunks(uint32_t worker);
+
+    std::vector<std::thread> threads_;
+
+    /* Held by parallel_for for the whole of a job, so that callers on different threads
+     * don't overwrite each other's job state */
+    std::mutex job_lock_;
+
+    std::mutex lock_;
+    std::condition_variable job_ready_;
+    std::condition_variable job_finished_;
+
+    /* Incremented every time a job starts, so that workers know there's something new */
+    uint64_t generation_ = 0;
+    uint32_t busy_workers_ = 0;
+    bool shutting_down_ = false;
+
+    ChunkFunction func_;
+    uint32_t count_ = 0;
+    uint32_t chunk_size_ = 1;
+    std::atomic<uint32_t> next_chunk_;
+};
+
+}
@@ -29,6 +29,7 @@ HardwareBufferManager::HardwareBufferManager(const Renderer* renderer):
 }
 
 HardwareBuffer::ptr HardwareBufferManager::allocate(std::size_t size, HardwareBufferPurpose purpose, ShadowBufferEnableOption shadow_buffer, HardwareBufferUsage usage) {
+    ++allocation_count_;
     return HardwareBuffer::ptr(new HardwareBuffer(do_allocation(size, purpose, shadow_buffer, usage)));
 }
 
@@ -73,8 +74,46 @@ void HardwareBuffer::upload(const uint8_t *data, const std::size_t size) {
     impl_->upload(data, size);
 }
 
+void HardwareBuffer::upload_range(const std::size_t offset, const uint8_t* data, const std::size_t size) {
+    if(is_dead()) {
+        throw std::logic_error("Tried to reuse a dead hardware buffer");
+    }
+
+    if(offset + size > impl_->size) {
+        throw std::out_of_range("Tried to upload outside of a hardware buffer");
+    }
+
+    impl_->upload_range(offset, data, size);
+}
+
 MappedBuffer HardwareBuffer::map_target_for_read() const {
     return impl_->map_target_for_read();
 }
 
+bool HardwareBuffer::has_shadow_buffer() const {
+    return impl_->has_shadow_buffer();
+}
+
+BufferLocation HardwareBuffer::shadow_buffer_location() const {
+    return impl_->shadow_buffer_location();
+}
+
+BufferLocation HardwareBuffer::target_buffer_location() const {
+    return impl_->target_buffer_location();
+}
+
+void HardwareBuffer::update_target_from_shadow_buffer() {
+    impl_->update_target_from_shadow_buffer();
+}
+
+void HardwareBuffer::destroy_shadow_buffer() {
+    impl_->destroy_shadow_buffer();
+}
+
+std::vector<uint8_t> HardwareBuffer::download() const {
+    auto mapped = map_target_for_read();
+    const uint8_t* data = mapped;
+    return (data) ? std::vector<uint8_t>(data, data + size()) : std::vector<uint8_t>();
+}
+
 }
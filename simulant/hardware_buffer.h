@@ -19,6 +19,8 @@
 #pragma once
 
 #include <vector>
+#include <cstdint>
+#include <stdexcept>
 
 #include "generic/managed.h"
 #include "generic/property.h"
@@ -114,6 +116,7 @@ struct HardwareBufferImpl {
     std::size_t capacity = 0; ///< This is the actual amount of allocated memory
     std::size_t size = 0; ///< The size of the buffer, this is for bounds checking and...
     // ... used when rendering
+    std::size_t offset = 0; ///< Where the buffer starts in the renderer's storage, for renderers which share it between buffers
 
     HardwareBufferImpl(HardwareBufferManager* manager):
         manager(manager) {
@@ -132,6 +135,22 @@ struct HardwareBufferImpl {
     virtual MappedBuffer map_target_for_read() const = 0;
 
     virtual void upload(const uint8_t* data, const std::size_t size) = 0;
+    virtual void upload_range(const std::size_t offset, const uint8_t* data, const std::size_t size) = 0;
+
+    /* Returns somewhere to write size bytes, end_write() then makes them the buffer's
+     * contents. By default that's a scratch buffer which is then uploaded, buffers which
+     * keep their data in RAM can hand out their own storage instead */
+    virtual uint8_t* begin_write(const std::size_t size) {
+        write_scratch_.resize(size);
+        return write_scratch_.data();
+    }
+
+    virtual void end_write(const std::size_t size) {
+        upload(write_scratch_.data(), size);
+    }
+
+private:
+    std::vector<uint8_t> write_scratch_;
 };
 
 /* Public-facing API to hardware buffers */
@@ -152,6 +171,25 @@ public:
     void upload(IndexData& index_data);
     void upload(const uint8_t* data, const std::size_t size);
 
+    /* Replaces size bytes of the buffer starting at offset, leaving the rest alone */
+    void upload_range(const std::size_t offset, const uint8_t* data, const std::size_t size);
+
+    /* Calls func with somewhere to write size bytes of new contents to. Unlike upload()
+     * the data doesn't need to be built somewhere else first */
+    template<typename Func>
+    void write(const std::size_t size, Func func) {
+        if(is_dead()) {
+            throw std::logic_error("Tried to reuse a dead hardware buffer");
+        }
+
+        if(size > impl_->size) {
+            throw std::out_of_range("Tried to write too much data to a hardware buffer");
+        }
+
+        func(impl_->begin_write(size));
+        impl_->end_write(size);
+    }
+
     // Download data from the shadow buffer (if there is one) else the target
     // buffer (may be slow!)
     std::vector<uint8_t> download() const;
@@ -174,6 +212,7 @@ public:
     }
 
     std::size_t size() const { return impl_->size; }
+    std::size_t offset() const { return impl_->offset; }
     bool is_dead() const { return is_dead_; }
 
     // Make sure we can't copy hardware buffers, they must be passed around as unique_ptr<HardwareBuffer>
@@ -198,9 +237,20 @@ public:
         HardwareBufferUsage usage = HARDWARE_BUFFER_MODIFY_ONCE_USED_FOR_RENDERING
     );
 
+    /* Called by the window around the rendering of each frame */
+    void begin_frame(uint64_t frame) { do_begin_frame(frame); }
+    void end_frame() { do_end_frame(); }
+
+    /* The number of buffers allocated so far, released or not */
+    uint64_t allocation_count() const { return allocation_count_; }
+
     Property<HardwareBufferManager, const Renderer> renderer = { this, &HardwareBufferManager::renderer_ };
 private:
     const Renderer* renderer_;
+    uint64_t allocation_count_ = 0;
+
+    virtual void do_begin_frame(uint64_t frame) {}
+    virtual void do_end_frame() {}
 
     virtual std::unique_ptr<HardwareBufferImpl> do_allocation(
         std::size_t size,
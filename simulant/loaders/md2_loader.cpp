@@ -20,6 +20,7 @@
 
 #include "md2_loader.h"
 #include "../meshes/mesh.h"
+#include "../meshes/keyframe_lerp.h"
 #include "../resource_manager.h"
 #include "../resource_locator.h"
 #include "../time_keeper.h"
@@ -85,6 +86,13 @@ class MD2MeshFrameData : public MeshFrameData {
      * performance vs memory. Turn the value up to improve performance but use more ram.
      */
 public:
+    /* Only the positions and normals change between frames */
+    static const uint32_t FRAME_ATTRIBUTES = VERTEX_ATTRIBUTE_BIT_POSITION | VERTEX_ATTRIBUTE_BIT_NORMAL;
+
+    MD2MeshFrameData(const VertexSpecification& spec):
+        frame_specification_(spec.subset(FRAME_ATTRIBUTES)),
+        static_specification_(spec.subset(~FRAME_ATTRIBUTES)) {}
+
     /* This is the frame data from an MD2 file, but without the vertices */
     struct FrameTransform {
         Vec3 scale;
@@ -105,18 +113,23 @@ public:
     /* This contains the scale/translate data for each frame */
     std::vector<FrameTransform> frames_;
 
-    struct UnpackedVertex {
-        Vec3 v;
-        Vec3 n;
-    };
-
-    typedef std::vector<UnpackedVertex> UnpackedFrame;
+    /* An unpacked frame is laid out exactly like the interpolated vertex data (see
+     * frame_specification()) so that frames can be blended straight into it */
+    typedef std::vector<float> UnpackedFrame;
 
     /* Cache of recently used frames, trying to balance memory usage with
      * performance */
     std::unordered_map<uint16_t, UnpackedFrame> frame_cache;
     std::unordered_map<uint16_t, uint64_t> frame_usage_times;
 
+    VertexSpecification frame_specification() const override {
+        return frame_specification_;
+    }
+
+    VertexSpecification static_specification() const override {
+        return static_specification_;
+    }
+
     void _expand_verts(uint16_t frame) {
         /* Decompresses a single frame of MD2 data into the frame cache */
 
@@ -150,48 +163,77 @@ public:
             FrameTransform& frame1 = frames_[frame];
             FrameVertex* v1 = &vertices_[vertex_count * frame];
 
-            verts.resize(vertex_count);
+            const uint32_t stride = frame_specification_.stride() / sizeof(float);
+            const uint32_t normal_offset = frame_specification_.normal_offset() / sizeof(float);
+
+            verts.assign(vertex_count * stride, 0.0f);
+            float* out = verts.data();
+
             for(uint16_t i = 0; i < vertex_count; ++i) {
                 float vx1 = float(v1->v[0]) * frame1.scale.x + frame1.translate.x;
                 float vy1 = float(v1->v[1]) * frame1.scale.y + frame1.translate.y;
                 float vz1 = float(v1->v[2]) * frame1.scale.z + frame1.translate.z;
 
-                verts[i].v = Vec3(vx1, vy1, vz1).rotated_by(VERTEX_ROTATION);
-                verts[i].n = ANORMS[v1->normal].rotated_by(VERTEX_ROTATION);
+                auto v = Vec3(vx1, vy1, vz1).rotated_by(VERTEX_ROTATION);
+                auto n = ANORMS[v1->normal].rotated_by(VERTEX_ROTATION);
+
+                out[0] = v.x;
+                out[1] = v.y;
+                out[2] = v.z;
 
+                out[normal_offset + 0] = n.x;
+                out[normal_offset + 1] = n.y;
+                out[normal_offset + 2] = n.z;
+
+                out += stride;
                 v1++;
             }
         }
     }
 
-    void unpack_frame(uint32_t current_frame, uint32_t next_frame, float t, VertexData *out) {
+    void unpack_frame(uint32_t current_frame, uint32_t next_frame, float t, VertexData *out) override {
+        assert(out->specification() == frame_specification_);
+
         _expand_verts(current_frame);
         _expand_verts(next_frame);
 
-        FrameVertex* v1 = &vertices_[vertex_count * current_frame];
-        FrameVertex* v2 = &vertices_[vertex_count * next_frame];
+        out->resize(vertex_count);
+
+        if(vertex_count) {
+            lerp_keyframes(
+                (float*) out->data(),
+                frame_cache[current_frame].data(),
+                frame_cache[next_frame].data(),
+                t,
+                vertex_count * (frame_specification_.stride() / sizeof(float))
+            );
+        }
+
+        out->done();
+    }
+
+    void unpack_static(VertexData* out) override {
+        assert(out->specification() == static_specification_);
 
         out->resize(vertex_count);
         out->move_to_start();
 
+        // Texture coordinates are the same in every frame, so they're taken from the first
+        FrameVertex* v1 = vertices_.data();
         for(uint16_t i = 0; i < vertex_count; ++i) {
-            const auto& v1v = frame_cache[current_frame][i].v;
-            const auto& v2v = frame_cache[next_frame][i].v;
-            const auto& n1 = frame_cache[current_frame][i].n;
-            const auto& n2 = frame_cache[next_frame][i].n;
-
-            out->position(v1v + (v2v - v1v) * t);
             out->tex_coord0(v1->st);
             out->diffuse(smlt::Colour::WHITE);
-            out->normal(n1 + (n2 - n1) * t);
             out->move_next();
 
             ++v1;
-            ++v2;
         }
 
         out->done();
     }
+
+private:
+    VertexSpecification frame_specification_;
+    VertexSpecification static_specification_;
 };
 
 typedef std::shared_ptr<MD2MeshFrameData> MD2MeshFrameDataPtr;
@@ -230,7 +272,7 @@ void MD2Loader::into(Loadable &resource, const LoaderOptions &options) {
 
     std::vector<std::vector<MD2Vertex>> vertices_by_frame;
 
-    MD2MeshFrameDataPtr frame_data = std::make_shared<MD2MeshFrameData>();
+    MD2MeshFrameDataPtr frame_data = std::make_shared<MD2MeshFrameData>(vertex_specification);
 
     /* Load all the vertex data from the frames */
     for(auto i = 0; i < header.num_frames; ++i) {
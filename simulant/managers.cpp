@@ -169,6 +169,8 @@ void StageManager::update(float dt) {
             StageNode* stage_node = static_cast<StageNode*>(node);
             stage_node->update(dt);
         });
+
+        stage_pair.second->update_particle_systems(dt);
     }
 }
 
@@ -0,0 +1,87 @@
+#include <cstring>
+#include <algorithm>
+
+#include "animated_frame_cache.h"
+
+namespace smlt {
+
+AnimatedFrameCache::AnimatedFrameCache(MeshFrameDataPtr frame_data):
+    frame_data_(frame_data) {
+
+}
+
+void AnimatedFrameCache::set_interpolation_steps(uint32_t steps) {
+    if(steps == interpolation_steps_) {
+        return;
+    }
+
+    // Keys mean something different now, frames already handed out stay with their actors
+    interpolation_steps_ = steps;
+    frames_.clear();
+}
+
+AnimatedFramePtr AnimatedFrameCache::frame(uint32_t current_frame, uint32_t next_frame, float t) {
+    Key key;
+    key.current_frame = current_frame;
+    key.next_frame = next_frame;
+
+    if(interpolation_steps_) {
+        t = std::min(std::max(t, 0.0f), 1.0f);
+        key.interpolation = uint32_t(t * float(interpolation_steps_) + 0.5f);
+        t = float(key.interpolation) / float(interpolation_steps_);
+    } else {
+        static_assert(sizeof(float) == sizeof(uint32_t), "Unexpected float size");
+        std::memcpy(&key.interpolation, &t, sizeof(float));
+    }
+
+    auto it = frames_.find(key);
+    if(it != frames_.end()) {
+        return it->second;
+    }
+
+    auto result = take_unused_frame();
+    if(!result) {
+        result = std::make_shared<AnimatedFrame>(frame_data_->frame_specification());
+    }
+
+    frame_data_->unpack_frame(current_frame, next_frame, t, &result->vertices);
+    result->needs_upload = true;
+
+    frames_[key] = result;
+    return result;
+}
+
+AnimatedFramePtr AnimatedFrameCache::static_frame() {
+    if(!static_frame_) {
+        static_frame_ = std::make_shared<AnimatedFrame>(frame_data_->static_specification());
+        frame_data_->unpack_static(&static_frame_->vertices);
+    }
+
+    return static_frame_;
+}
+
+std::size_t AnimatedFrameCache::frame_count() const {
+    return std::count_if(frames_.begin(), frames_.end(), [](const std::pair<const Key, AnimatedFramePtr>& p) {
+        return p.second.use_count() > 1;
+    });
+}
+
+AnimatedFramePtr AnimatedFrameCache::take_unused_frame() {
+    AnimatedFramePtr result;
+
+    for(auto it = frames_.begin(); it != frames_.end();) {
+        if(it->second.use_count() == 1) {
+            if(!result) {
+                result = it->second;
+            }
+
+            it = frames_.erase(it);
+        } else {
+            ++it;
+        }
+    }
+
+    return result;
+}
+
+}
@@ -0,0 +1,85 @@
+#pragma once
+
+#include <cstdint>
+#include <map>
+#include <memory>
+
+#include "mesh.h"
+#include "../vertex_data.h"
+#include "../hardware_buffer.h"
+
+namespace smlt {
+
+/* The vertices for one state of an animated mesh, shared by every actor in that state */
+struct AnimatedFrame {
+    AnimatedFrame(const VertexSpecification& spec):
+        vertices(spec) {}
+
+    VertexData vertices;
+
+    /* Created and uploaded by whichever actor renders the frame first */
+    std::unique_ptr<HardwareBuffer> buffer;
+
+    /* Set when the vertices change. The cache reuses frames for new states, and their
+     * buffer with them, so the buffer can exist and still need uploading */
+    bool needs_upload = true;
+};
+
+typedef std::shared_ptr<AnimatedFrame> AnimatedFramePtr;
+
+/*
+ * Each animated mesh has one of these, so that actors playing the same frames of the same
+ * mesh (a crowd all running, say) unpack and upload those frames once between them rather
+ * than once each. Frames are looked up by (current frame, next frame, interpolation), so the
+ * memory used grows with the number of different animation states rather than the number
+ * of actors.
+ *
+ * A frame nobody is using any more is kept, along with its buffer, and becomes the next new
+ * state anyone asks for. An actor moving through states on its own therefore swaps between
+ * two frames instead of allocating vertices and a buffer every tick.
+ *
+ * Actors rarely land on exactly the same interpolation unless they started together, so
+ * the interpolation can be rounded to one of N steps between frames (see
+ * set_interpolation_steps()). That trades smoothness for sharing.
+ */
+class AnimatedFrameCache {
+public:
+    AnimatedFrameCache(MeshFrameDataPtr frame_data);
+
+    /* 0 (the default) means only identical interpolations are shared */
+    void set_interpolation_steps(uint32_t steps);
+    uint32_t interpolation_steps() const { return interpolation_steps_; }
+
+    /* Returns the shared frame, unpacking it into an unused frame if it isn't cached */
+    AnimatedFramePtr frame(uint32_t current_frame, uint32_t next_frame, float t);
+
+    /* The attributes which are the same in every frame (see MeshFrameData::unpack_static) */
+    AnimatedFramePtr static_frame();
+
+    /* The number of frames which are still in use */
+    std::size_t frame_count() const;
+
+private:
+    struct Key {
+        uint32_t current_frame;
+        uint32_t next_frame;
+        uint32_t interpolation; // The step, or the bits of t when there are no steps
+
+        bool operator<(const Key& rhs) const {
+            if(current_frame != rhs.current_frame) return current_frame < rhs.current_frame;
+            if(next_frame != rhs.next_frame) return next_frame < rhs.next_frame;
+            return interpolation < rhs.interpolation;
+        }
+    };
+
+    /* Removes every frame only the cache holds, returning one of them to be reused */
+    AnimatedFramePtr take_unused_frame();
+
+    MeshFrameDataPtr frame_data_;
+    uint32_t interpolation_steps_ = 0;
+
+    std::map<Key, AnimatedFramePtr> frames_;
+    AnimatedFramePtr static_frame_;
+};
+
+}
@@ -0,0 +1,36 @@
+#if defined(__SSE__)
+#define KEYFRAME_LERP_SSE 1
+#include <xmmintrin.h>
+#elif defined(__ARM_NEON) || defined(__ARM_NEON__)
+#define KEYFRAME_LERP_NEON 1
+#include <arm_neon.h>
+#endif
+
+#include "keyframe_lerp.h"
+
+namespace smlt {
+
+void lerp_keyframes(float* out, const float* a, const float* b, float t, uint32_t count) {
+    uint32_t i = 0;
+
+#if defined(KEYFRAME_LERP_SSE)
+    const __m128 s = _mm_set1_ps(t);
+    for(; i + 4 <= count; i += 4) {
+        __m128 va = _mm_loadu_ps(a + i);
+        __m128 vb = _mm_loadu_ps(b + i);
+        _mm_storeu_ps(out + i, _mm_add_ps(va, _mm_mul_ps(_mm_sub_ps(vb, va), s)));
+    }
+#elif defined(KEYFRAME_LERP_NEON)
+    for(; i + 4 <= count; i += 4) {
+        float32x4_t va = vld1q_f32(a + i);
+        float32x4_t vb = vld1q_f32(b + i);
+        vst1q_f32(out + i, vmlaq_n_f32(va, vsubq_f32(vb, va), t));
+    }
+#endif
+
+    for(; i < count; ++i) {
+        out[i] = a[i] + (b[i] - a[i]) * t;
+    }
+}
+
+}
@@ -0,0 +1,18 @@
+#pragma once
+
+#include <cstdint>
+
+namespace smlt {
+
+/*
+ * out[i] = a[i] + (b[i] - a[i]) * t
+ *
+ * This is the inner loop of vertex morph animation. Keyframes are stored in the same
+ * interleaved layout as the vertex data they're unpacked into, so a whole frame is one
+ * run of floats and can be blended straight into the vertex buffer four floats at a
+ * time (SSE or NEON, where the platform has it). None of the arrays need any particular
+ * alignment.
+ */
+void lerp_keyframes(float* out, const float* a, const float* b, float t, uint32_t count);
+
+}
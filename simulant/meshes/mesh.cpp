@@ -21,6 +21,7 @@
 
 #include "mesh.h"
 #include "adjacency_info.h"
+#include "animated_frame_cache.h"
 
 #include "../window.h"
 #include "../resource_manager.h"
@@ -109,10 +110,20 @@ void Mesh::enable_animation(MeshAnimationType animation_type, uint32_t animation
     animation_type_ = animation_type;
     animation_frames_ = animation_frames;
     animated_frame_data_ = data;
+    animated_frame_cache_ = std::make_shared<AnimatedFrameCache>(data);
+    animated_frame_cache_->set_interpolation_steps(animation_interpolation_steps_);
 
     signal_animation_enabled_(this, animation_type_, animation_frames_);
 }
 
+void Mesh::set_animation_interpolation_steps(uint32_t steps) {
+    animation_interpolation_steps_ = steps;
+
+    if(animated_frame_cache_) {
+        animated_frame_cache_->set_interpolation_steps(steps);
+    }
+}
+
 void Mesh::rebuild_aabb() const {
     AABB& result = aabb_;
 
@@ -477,6 +488,37 @@ void Mesh::transform_vertices(const smlt::Mat4& transform) {
     vertex_data->done();
 }
 
+bool Mesh::quantize(VertexQuantizeOptions options) {
+    if(is_animated()) {
+        return false;
+    }
+
+    if(!options.supported) {
+        Window* window = resource_manager().window;
+        Renderer* renderer = (window) ? window->renderer.get() : nullptr;
+
+        if(renderer) {
+            options.supported = [renderer](VertexAttributeBit attr, VertexAttribute format) -> bool {
+                return renderer->supports_vertex_attribute(attr, format);
+            };
+        } else {
+            // Without a renderer there's no telling what can be drawn, so stick to floats
+            options.supported = [](VertexAttributeBit, VertexAttribute format) -> bool {
+                return vertex_attribute_is_float(format);
+            };
+        }
+    }
+
+    auto spec = quantized_specification(*vertex_data_, options);
+    if(spec == vertex_data_->specification()) {
+        return false;
+    }
+
+    vertex_data_->convert_to(spec);
+    vertex_data_->done();
+    return true;
+}
+
 void Mesh::set_diffuse(const smlt::Colour& colour) {
     vertex_data->move_to_start();
     for(uint32_t i = 0; i < vertex_data->count(); ++i) {
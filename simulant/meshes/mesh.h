@@ -62,11 +62,23 @@ typedef sig::signal<void (Mesh*, MeshAnimationType, uint32_t)> SignalAnimationEn
 class MeshFrameData {
 public:
     virtual ~MeshFrameData() {}
+
+    /*
+     * Animated vertices are split into two streams. unpack_frame() writes the attributes which
+     * change from frame to frame, and unpack_static() writes the rest, which only needs doing
+     * (and uploading) once. The VertexData passed to each must use the matching specification.
+     */
+    virtual VertexSpecification frame_specification() const = 0;
+    virtual VertexSpecification static_specification() const = 0;
+
     virtual void unpack_frame(uint32_t current_frame, uint32_t next_frame, float t, VertexData* out) = 0;
+    virtual void unpack_static(VertexData* out) = 0;
 };
 
 typedef std::shared_ptr<MeshFrameData> MeshFrameDataPtr;
 
+class AnimatedFrameCache;
+
 class Mesh :
     public virtual Boundable,
     public Resource,
@@ -141,6 +153,15 @@ public:
     void normalize(); //Scales the mesh so it has a radius of 1.0
     void transform_vertices(const smlt::Mat4& transform);
 
+    /* Converts the vertex data to the most compact formats that keep it within the options'
+     * tolerances and that the window's renderer can draw. Animated meshes are left alone as
+     * their frames are interpolated as floats. Returns true if anything changed.
+     *
+     * Normals, texture coordinates and colours shrink for most meshes, but positions usually
+     * stay float: snorm16 needs them within [-1, 1] and half floats lose too much away from
+     * the origin. Meshes modelled around the origin at a small scale are the exception */
+    bool quantize(VertexQuantizeOptions options=VertexQuantizeOptions());
+
     // DEPRECATED use each_submesh
     void each(std::function<void (const std::string&, SubMeshPtr)> func) const;
     void each_submesh(std::function<void (const std::string&, SubMeshPtr)> func) const;
@@ -150,6 +171,12 @@ public:
     uint32_t animation_frames() const { return animation_frames_; }
     MeshAnimationType animation_type() const { return animation_type_; }
 
+    /* Actors playing the same frames of this mesh share the interpolated vertices. Rounding
+     * the interpolation between two frames to one of `steps` steps lets many more actors
+     * share them, at the cost of smoothness. 0 (the default) only shares exact matches */
+    void set_animation_interpolation_steps(uint32_t steps);
+    uint32_t animation_interpolation_steps() const { return animation_interpolation_steps_; }
+
     void prepare_buffers(Renderer *renderer);
 
     /* Generates adjacency information for this mesh. This is necessary for stencil shadowing
@@ -179,6 +206,8 @@ private:
     MeshAnimationType animation_type_ = MESH_ANIMATION_TYPE_NONE;
     uint32_t animation_frames_ = 0;
     MeshFrameDataPtr animated_frame_data_;
+    std::shared_ptr<AnimatedFrameCache> animated_frame_cache_;
+    uint32_t animation_interpolation_steps_ = 0;
 
     std::unique_ptr<HardwareBuffer> shared_vertex_buffer_;
     bool shared_vertex_buffer_dirty_ = false;
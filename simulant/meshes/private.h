@@ -10,10 +10,12 @@ namespace smlt {
 template<typename Data, typename Allocator>
 void sync_buffer(HardwareBuffer::ptr* buffer, Data* data, Allocator* allocator, HardwareBufferPurpose purpose) {
     if(!(*buffer) && data->count()) {
+        // Meshes are often changed from other threads, with a shadow buffer those changes
+        // only touch RAM and are uploaded when the renderer next flushes
         (*buffer) = allocator->hardware_buffers->allocate(
             data->data_size(),
             purpose,
-            SHADOW_BUFFER_DISABLED
+            SHADOW_BUFFER_ENABLE_IF_OPTIMAL
         );
     } else {
         // If we have a buffer, then resize it (possibly to zero)
@@ -21,6 +21,7 @@
 
 #include "../stage.h"
 #include "../animation.h"
+#include "../meshes/animated_frame_cache.h"
 #include "../renderers/renderer.h"
 #include "../hardware_buffer.h"
 
@@ -73,6 +74,10 @@ void SubActor::prepare_buffers(Renderer *renderer) {
 }
 
 VertexSpecification SubActor::vertex_attribute_specification() const {
+    if(parent_.has_animated_mesh()) {
+        return parent_.interpolated_frame_->vertices.specification();
+    }
+
     auto* vertex_data = get_vertex_data();
     if(vertex_data) {
         return vertex_data->specification();
@@ -83,12 +88,28 @@ VertexSpecification SubActor::vertex_attribute_specification() const {
 
 HardwareBuffer* SubActor::vertex_attribute_buffer() const {
     if(parent_.has_animated_mesh()) {
-        return parent_.interpolated_vertex_buffer_.get();
+        return parent_.interpolated_frame_->buffer.get();
     }
 
     return submesh_->vertex_buffer();
 }
 
+VertexSpecification SubActor::static_vertex_attribute_specification() const {
+    if(parent_.has_animated_mesh()) {
+        return parent_.static_frame_->vertices.specification();
+    }
+
+    return VertexSpecification();
+}
+
+HardwareBuffer* SubActor::static_vertex_attribute_buffer() const {
+    if(parent_.has_animated_mesh()) {
+        return parent_.static_frame_->buffer.get();
+    }
+
+    return nullptr;
+}
+
 HardwareBuffer* SubActor::index_buffer() const {
     return submesh_->index_buffer();
 }
@@ -129,7 +150,8 @@ void Actor::set_mesh(MeshID mesh) {
     if(!mesh) {
         clear_subactors();
         mesh_.reset();
-        interpolated_vertex_data_.reset();
+        interpolated_frame_.reset();
+        static_frame_.reset();
 
         // FIXME: Delete vertex buffer!
         return;
@@ -154,7 +176,9 @@ void Actor::set_mesh(MeshID mesh) {
     if(mesh_ && mesh_->is_animated()) {
         using namespace std::placeholders;
 
-        interpolated_vertex_data_ = std::make_shared<VertexData>(mesh_->vertex_data->specification());
+        static_frame_ = mesh_->animated_frame_cache_->static_frame();
+        upload_frame(static_frame_.get());
+
         animation_state_ = std::make_shared<KeyFrameAnimationState>(
             mesh_,
             std::bind(&Actor::refresh_animation_state, this, _1, _2, _3)
@@ -197,18 +221,27 @@ void Actor::update(float dt) {
 void Actor::refresh_animation_state(uint32_t current_frame, uint32_t next_frame, float interp) {
     assert(mesh_ && mesh_->is_animated());
 
-    mesh_->animated_frame_data_->unpack_frame(current_frame, next_frame, interp, interpolated_vertex_data_.get());
+    // Another actor may have got here first, in which case there's nothing to do
+    interpolated_frame_ = mesh_->animated_frame_cache_->frame(current_frame, next_frame, interp);
+    upload_frame(interpolated_frame_.get());
+}
 
-    if(!interpolated_vertex_buffer_) {
-        // Create an interpolated vertex hardware buffer if this is an animated mesh
-        interpolated_vertex_buffer_ = stage->window->renderer->hardware_buffers->allocate(
-            interpolated_vertex_data_->data_size(),
+void Actor::upload_frame(AnimatedFrame* frame) {
+    if(!frame->needs_upload) {
+        return;
+    }
+
+    // Frames the cache has reused already have a buffer of the right size
+    if(!frame->buffer) {
+        frame->buffer = stage->window->renderer->hardware_buffers->allocate(
+            frame->vertices.data_size(),
             HARDWARE_BUFFER_VERTEX_ATTRIBUTES,
             SHADOW_BUFFER_DISABLED
         );
     }
 
-    interpolated_vertex_buffer_->upload(*interpolated_vertex_data_);
+    frame->buffer->upload(frame->vertices);
+    frame->needs_upload = false;
 }
 
 
@@ -315,7 +348,9 @@ void Actor::each(std::function<void (uint32_t, SubActor*)> callback) {
 }
 
 RenderableList Actor::_get_renderables(const Frustum &frustum) const {
-    auto ret = RenderableList();
+    auto ret = RenderableList(frame_arena());
+    ret.reserve(subactors_.size());
+
     for(auto& actor: subactors_) {
         ret.push_back(std::const_pointer_cast<SubActor>(actor));
     }
@@ -35,6 +35,7 @@
 namespace smlt {
 
 class KeyFrameAnimationState;
+struct AnimatedFrame;
 class SubActor;
 
 class Actor :
@@ -113,9 +114,10 @@ public:
 
     RenderableList _get_renderables(const Frustum &frustum) const;
 private:
-    // Used for animated meshes
-    std::unique_ptr<HardwareBuffer> interpolated_vertex_buffer_;
-    std::shared_ptr<VertexData> interpolated_vertex_data_;
+    // Used for animated meshes. Both frames are shared with any other actors of the
+    // same mesh (see AnimatedFrameCache), the static one by all of them
+    std::shared_ptr<AnimatedFrame> interpolated_frame_;
+    std::shared_ptr<AnimatedFrame> static_frame_;
 
     std::shared_ptr<Mesh> mesh_;
     std::vector<std::shared_ptr<SubActor> > subactors_;
@@ -137,6 +139,7 @@ private:
     friend class SubActor;
 
     void refresh_animation_state(uint32_t current_frame, uint32_t next_frame, float interp);
+    void upload_frame(AnimatedFrame* frame);
 };
 
 class SubActor :
@@ -184,6 +187,8 @@ public:
 
     VertexSpecification vertex_attribute_specification() const;
     HardwareBuffer* vertex_attribute_buffer() const;
+    VertexSpecification static_vertex_attribute_specification() const;
+    HardwareBuffer* static_vertex_attribute_buffer() const;
     HardwareBuffer* index_buffer() const;
     std::size_t index_element_count() const;
     IndexType index_type() const;
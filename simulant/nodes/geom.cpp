@@ -20,14 +20,18 @@
 #include "geom.h"
 #include "../stage.h"
 #include "geoms/octree_culler.h"
+#include "geoms/geom_culler.h"
+#include "geoms/compiled_geom.h"
+#include "../deps/kazlog/kazlog.h"
 
 namespace smlt {
 
-Geom::Geom(GeomID id, Stage* stage, SoundDriver* sound_driver, MeshID mesh, const Vec3 &position, const Quaternion rotation):
+Geom::Geom(GeomID id, Stage* stage, SoundDriver* sound_driver, MeshID mesh, const Vec3 &position, const Quaternion rotation, const std::string& compiled_path):
     StageNode(stage),
     generic::Identifiable<GeomID>(id),
     Source(stage, sound_driver),
     mesh_id_(mesh),
+    compiled_path_(compiled_path),
     render_priority_(RENDER_PRIORITY_MAIN) {
 
     set_parent(stage);
@@ -35,12 +39,29 @@ Geom::Geom(GeomID id, Stage* stage, SoundDriver* sound_driver, MeshID mesh, cons
 
 bool Geom::init() {
     auto mesh_ptr = stage->assets->mesh(mesh_id_);
-    culler_.reset(new OctreeCuller(this, mesh_ptr));
+
+    std::shared_ptr<CompiledGeomFile> compiled;
+    if(!compiled_path_.empty()) {
+        compiled = CompiledGeomFile::open(compiled_path_);
+
+        if(compiled && !compiled->is_compatible_with(*mesh_ptr)) {
+            L_WARN("Compiled geom doesn't match its mesh, recompiling: " + compiled_path_);
+            compiled.reset();
+        }
+    }
+
+    auto culler = std::make_shared<OctreeCuller>(this, mesh_ptr, compiled);
+    culler_ = culler;
 
     /* FIXME: Transform and recalc */
     aabb_ = mesh_ptr->aabb();
 
     culler_->compile();
+
+    if(!compiled_path_.empty() && !compiled && !culler->save_compiled(compiled_path_)) {
+        L_WARN("Unable to write compiled geom: " + compiled_path_);
+    }
+
     return true;
 }
 
@@ -52,8 +73,12 @@ void Geom::ask_owner_for_destruction() {
     stage->delete_geom(id());
 }
 
-std::vector<std::shared_ptr<Renderable>> Geom::_get_renderables(const Frustum &frustum) const {
-    return culler_->renderables_visible(frustum);
+RenderableList Geom::_get_renderables(const Frustum &frustum) const {
+    return culler_->renderables_visible(frustum, frame_arena());
+}
+
+RenderableList Geom::_get_unoccluded_renderables(const Frustum& frustum, const OcclusionBuffer& occlusion, uint32_t& occluded) const {
+    return culler_->renderables_visible(frustum, frame_arena(), &occlusion, &occluded);
 }
 
 
@@ -49,7 +49,8 @@ class Geom :
     public Source {
 
 public:
-    Geom(GeomID id, Stage* stage, SoundDriver *sound_driver, MeshID mesh, const Vec3& position=Vec3(), const Quaternion rotation=Quaternion());
+    /* If compiled_path is set the compiled culler is loaded from (or saved to) that file */
+    Geom(GeomID id, Stage* stage, SoundDriver *sound_driver, MeshID mesh, const Vec3& position=Vec3(), const Quaternion rotation=Quaternion(), const std::string& compiled_path="");
 
     const AABB& aabb() const;
 
@@ -65,9 +66,11 @@ public:
 
     bool init() override;
 
-    std::vector<std::shared_ptr<Renderable>> _get_renderables(const Frustum& frustum) const;
+    RenderableList _get_renderables(const Frustum& frustum) const;
+    RenderableList _get_unoccluded_renderables(const Frustum& frustum, const OcclusionBuffer& occlusion, uint32_t& occluded) const override;
 private:
     MeshID mesh_id_;
+    std::string compiled_path_;
     RenderPriority render_priority_ = RENDER_PRIORITY_MAIN;
 
     std::shared_ptr<GeomCuller> culler_;
@@ -0,0 +1,332 @@
+#include <cassert>
+#include <cstring>
+#include <fstream>
+#include <limits>
+
+#if !defined(_arch_dreamcast) && (defined(__unix__) || defined(__APPLE__))
+#define COMPILED_GEOM_USE_MMAP 1
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#endif
+
+#include "compiled_geom.h"
+#include "../../meshes/mesh.h"
+
+namespace smlt {
+
+static const char MAGIC[4] = {'S', 'G', 'E', 'O'};
+
+static uint64_t align8(uint64_t offset) {
+    return (offset + 7) & ~uint64_t(7);
+}
+
+void write_vertex_attributes(const VertexSpecification& spec, uint8_t* out) {
+    out[0] = (VertexAttribute) spec.position_attribute;
+    out[1] = (VertexAttribute) spec.normal_attribute;
+    out[2] = (VertexAttribute) spec.texcoord0_attribute;
+    out[3] = (VertexAttribute) spec.texcoord1_attribute;
+    out[4] = (VertexAttribute) spec.texcoord2_attribute;
+    out[5] = (VertexAttribute) spec.texcoord3_attribute;
+    out[6] = (VertexAttribute) spec.texcoord4_attribute;
+    out[7] = (VertexAttribute) spec.texcoord5_attribute;
+    out[8] = (VertexAttribute) spec.texcoord6_attribute;
+    out[9] = (VertexAttribute) spec.texcoord7_attribute;
+    out[10] = (VertexAttribute) spec.diffuse_attribute;
+    out[11] = (VertexAttribute) spec.specular_attribute;
+}
+
+/* 64 bit FNV-1a, taking eight bytes at a time where it can */
+static uint64_t hash_bytes(uint64_t hash, const uint8_t* data, std::size_t size) {
+    const uint64_t PRIME = 1099511628211ull;
+
+    std::size_t i = 0;
+    for(; i + 8 <= size; i += 8) {
+        uint64_t word;
+        memcpy(&word, data + i, sizeof(word));
+        hash = (hash ^ word) * PRIME;
+    }
+
+    for(; i < size; ++i) {
+        hash = (hash ^ data[i]) * PRIME;
+    }
+
+    return hash;
+}
+
+uint64_t compiled_geom_source_hash(const Mesh& mesh) {
+    uint64_t hash = 14695981039346656037ull;
+
+    uint8_t attributes[COMPILED_GEOM_ATTRIBUTE_COUNT];
+    write_vertex_attributes(mesh.vertex_data->specification(), attributes);
+    hash = hash_bytes(hash, attributes, sizeof(attributes));
+
+    hash = hash_bytes(hash, mesh.vertex_data->data(), mesh.vertex_data->data_size());
+
+    mesh.each_submesh([&](const std::string&, SubMesh* submesh) {
+        uint32_t header[2] = {
+            (uint32_t) submesh->arrangement(),
+            (uint32_t) submesh->index_data->index_type()
+        };
+
+        hash = hash_bytes(hash, (const uint8_t*) header, sizeof(header));
+
+        auto& indices = *submesh->index_data;
+        if(indices.data_size()) {
+            hash = hash_bytes(hash, indices.data(), indices.data_size());
+        }
+    });
+
+    return hash;
+}
+
+IndexType compiled_geom_index_type(const Mesh& mesh) {
+    /* Submeshes are merged per material, so large meshes can need bigger indices
+     * than any single submesh did */
+    bool needs_32_bit = mesh.vertex_data->count() >= std::numeric_limits<uint16_t>::max();
+
+    mesh.each_submesh([&](const std::string&, SubMesh* submesh) {
+        needs_32_bit = needs_32_bit || submesh->index_data->index_type() == INDEX_TYPE_32_BIT;
+    });
+
+    return (needs_32_bit) ? INDEX_TYPE_32_BIT : INDEX_TYPE_16_BIT;
+}
+
+std::shared_ptr<CompiledGeomFile> CompiledGeomFile::open(const std::string& path) {
+    std::shared_ptr<CompiledGeomFile> file(new CompiledGeomFile());
+
+#ifdef COMPILED_GEOM_USE_MMAP
+    int fd = ::open(path.c_str(), O_RDONLY);
+    if(fd < 0) {
+        return std::shared_ptr<CompiledGeomFile>();
+    }
+
+    struct stat info;
+    if(fstat(fd, &info) != 0 || info.st_size < (off_t) sizeof(CompiledGeomHeader)) {
+        ::close(fd);
+        return std::shared_ptr<CompiledGeomFile>();
+    }
+
+    void* data = mmap(nullptr, info.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+    ::close(fd); // The mapping keeps the file open
+
+    if(data == MAP_FAILED) {
+        return std::shared_ptr<CompiledGeomFile>();
+    }
+
+    file->data_ = (const uint8_t*) data;
+    file->size_ = info.st_size;
+    file->mapped_ = true;
+#else
+    std::ifstream stream(path, std::ios::binary | std::ios::ate);
+    if(!stream) {
+        return std::shared_ptr<CompiledGeomFile>();
+    }
+
+    std::size_t size = stream.tellg();
+    if(size < sizeof(CompiledGeomHeader)) {
+        return std::shared_ptr<CompiledGeomFile>();
+    }
+
+    file->buffer_.resize((size + 7) / 8);
+    stream.seekg(0);
+    if(!stream.read((char*) &file->buffer_[0], size)) {
+        return std::shared_ptr<CompiledGeomFile>();
+    }
+
+    file->data_ = (const uint8_t*) &file->buffer_[0];
+    file->size_ = size;
+#endif
+
+    file->header_ = (const CompiledGeomHeader*) file->data_;
+
+    if(!file->is_valid()) {
+        return std::shared_ptr<CompiledGeomFile>();
+    }
+
+    return file;
+}
+
+CompiledGeomFile::~CompiledGeomFile() {
+#ifdef COMPILED_GEOM_USE_MMAP
+    if(mapped_) {
+        munmap((void*) data_, size_);
+    }
+#endif
+}
+
+bool CompiledGeomFile::is_valid() const {
+    auto& header = *header_;
+
+    if(memcmp(header.magic, MAGIC, sizeof(MAGIC)) != 0 || header.version != COMPILED_GEOM_VERSION) {
+        return false;
+    }
+
+    /* Make sure everything the header points to is actually in the file, so a truncated
+     * file is just ignored rather than read past the end of */
+    auto fits = [this](uint64_t offset, uint64_t size) -> bool {
+        return offset <= size_ && size <= size_ - offset;
+    };
+
+    if(!fits(header.node_offset, uint64_t(header.node_count) * sizeof(CompiledGeomNode)) ||
+       !fits(header.range_offset, uint64_t(header.range_count) * sizeof(CompiledGeomRange)) ||
+       !fits(header.renderable_offset, uint64_t(header.renderable_count) * sizeof(CompiledGeomRenderable)) ||
+       !fits(header.vertex_data_offset, header.vertex_data_size) ||
+       !fits(header.index_data_offset, header.index_data_size)) {
+        return false;
+    }
+
+    if(header.vertex_data_size != uint64_t(header.vertex_count) * vertex_specification().stride()) {
+        return false;
+    }
+
+    // The culler only ever writes 16 or 32 bit indices
+    if(header.index_type != INDEX_TYPE_16_BIT && header.index_type != INDEX_TYPE_32_BIT) {
+        return false;
+    }
+
+    uint32_t index_size = (header.index_type == INDEX_TYPE_16_BIT) ? 2 : 4;
+
+    for(uint32_t i = 0; i < header.renderable_count; ++i) {
+        auto& renderable = renderables()[i];
+        if(renderable.material_slot >= header.submesh_count ||
+           !fits(renderable.index_offset, uint64_t(renderable.index_count) * index_size)) {
+            return false;
+        }
+    }
+
+    // The culler builds the octree with the same number of levels, so the nodes must line up
+    uint64_t expected_nodes = 0;
+    for(uint32_t level = 0, across = 1; level < header.octree_levels && level < 8; ++level, across *= 2) {
+        expected_nodes += uint64_t(across) * across * across;
+    }
+
+    if(header.octree_levels > 8 || header.node_count != expected_nodes) {
+        return false;
+    }
+
+    for(uint32_t i = 0; i < header.node_count; ++i) {
+        auto& node = nodes()[i];
+        if(uint64_t(node.first_range) + node.range_count > header.range_count) {
+            return false;
+        }
+    }
+
+    for(uint32_t i = 0; i < header.range_count; ++i) {
+        auto& range = ranges()[i];
+        if(range.renderable >= header.renderable_count ||
+           uint64_t(range.start) + range.count > renderables()[range.renderable].index_count) {
+            return false;
+        }
+    }
+
+    return true;
+}
+
+bool CompiledGeomFile::is_compatible_with(const Mesh& mesh) const {
+    uint8_t attributes[COMPILED_GEOM_ATTRIBUTE_COUNT];
+    write_vertex_attributes(mesh.vertex_data->specification(), attributes);
+
+    // The cheap checks first, the hash has to read the whole mesh
+    return (
+        memcmp(attributes, header_->vertex_attributes, sizeof(attributes)) == 0 &&
+        header_->vertex_count == mesh.vertex_data->count() &&
+        header_->submesh_count == mesh.submesh_count() &&
+        header_->index_type == (uint32_t) compiled_geom_index_type(mesh) &&
+        header_->source_hash == compiled_geom_source_hash(mesh)
+    );
+}
+
+VertexSpecification CompiledGeomFile::vertex_specification() const {
+    auto attributes = header_->vertex_attributes;
+
+    VertexSpecification spec;
+    spec.position_attribute = (VertexAttribute) attributes[0];
+    spec.normal_attribute = (VertexAttribute) attributes[1];
+    spec.texcoord0_attribute = (VertexAttribute) attributes[2];
+    spec.texcoord1_attribute = (VertexAttribute) attributes[3];
+    spec.texcoord2_attribute = (VertexAttribute) attributes[4];
+    spec.texcoord3_attribute = (VertexAttribute) attributes[5];
+    spec.texcoord4_attribute = (VertexAttribute) attributes[6];
+    spec.texcoord5_attribute = (VertexAttribute) attributes[7];
+    spec.texcoord6_attribute = (VertexAttribute) attributes[8];
+    spec.texcoord7_attribute = (VertexAttribute) attributes[9];
+    spec.diffuse_attribute = (VertexAttribute) attributes[10];
+    spec.specular_attribute = (VertexAttribute) attributes[11];
+    return spec;
+}
+
+AABB CompiledGeomFile::bounds() const {
+    return AABB(
+        Vec3(header_->bounds_min[0], header_->bounds_min[1], header_->bounds_min[2]),
+        Vec3(header_->bounds_max[0], header_->bounds_max[1], header_->bounds_max[2])
+    );
+}
+
+bool CompiledGeomFile::write(
+    const std::string& path,
+    CompiledGeomHeader header,
+    const std::vector<CompiledGeomNode>& nodes,
+    const std::vector<CompiledGeomRange>& ranges,
+    std::vector<CompiledGeomRenderable> renderables,
+    const uint8_t* vertex_data,
+    const std::vector<std::pair<const uint8_t*, std::size_t>>& index_data) {
+
+    assert(renderables.size() == index_data.size());
+
+    memcpy(header.magic, MAGIC, sizeof(MAGIC));
+    header.version = COMPILED_GEOM_VERSION;
+    header.node_count = nodes.size();
+    header.range_count = ranges.size();
+    header.renderable_count = renderables.size();
+
+    header.node_offset = align8(sizeof(CompiledGeomHeader));
+    header.range_offset = align8(header.node_offset + nodes.size() * sizeof(CompiledGeomNode));
+    header.renderable_offset = align8(header.range_offset + ranges.size() * sizeof(CompiledGeomRange));
+    header.vertex_data_offset = align8(header.renderable_offset + renderables.size() * sizeof(CompiledGeomRenderable));
+    header.index_data_offset = align8(header.vertex_data_offset + header.vertex_data_size);
+
+    uint64_t offset = header.index_data_offset;
+    for(uint32_t i = 0; i < renderables.size(); ++i) {
+        renderables[i].index_offset = offset;
+        offset = align8(offset + index_data[i].second);
+    }
+
+    header.index_data_size = offset - header.index_data_offset;
+
+    std::ofstream stream(path, std::ios::binary | std::ios::trunc);
+    if(!stream) {
+        return false;
+    }
+
+    uint64_t written = 0;
+    auto write_at = [&](uint64_t at, const void* data, std::size_t size) {
+        static const char zeros[8] = {0};
+        assert(at >= written && at - written < 8);
+
+        stream.write(zeros, at - written);
+        if(size) {
+            stream.write((const char*) data, size);
+        }
+
+        written = at + size;
+    };
+
+    write_at(0, &header, sizeof(header));
+    write_at(header.node_offset, nodes.data(), nodes.size() * sizeof(CompiledGeomNode));
+    write_at(header.range_offset, ranges.data(), ranges.size() * sizeof(CompiledGeomRange));
+    write_at(header.renderable_offset, renderables.data(), renderables.size() * sizeof(CompiledGeomRenderable));
+    write_at(header.vertex_data_offset, vertex_data, header.vertex_data_size);
+
+    for(uint32_t i = 0; i < renderables.size(); ++i) {
+        write_at(renderables[i].index_offset, index_data[i].first, index_data[i].second);
+    }
+
+    // Pad out the last renderable's indices, so the file is as long as the header says
+    write_at(header.index_data_offset + header.index_data_size, nullptr, 0);
+
+    return bool(stream);
+}
+
+}
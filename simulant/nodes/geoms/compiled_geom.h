@@ -0,0 +1,149 @@
+#pragma once
+
+#include <cstdint>
+#include <memory>
+#include <string>
+#include <vector>
+
+#include "../../types.h"
+
+/*
+ * A compiled geom file stores the result of OctreeCuller::compile() so that the next
+ * time the same geom is created it can be used as-is, rather than sorting every
+ * triangle of the mesh into the octree again.
+ *
+ * Everything is stored in native byte order, 8 byte aligned, in the layout the culler
+ * and the renderer use at runtime:
+ *
+ *   CompiledGeomHeader
+ *   CompiledGeomNode[node_count]              - one per octree node, in storage order
+ *   CompiledGeomRange[range_count]            - the index ranges the nodes point to
+ *   CompiledGeomRenderable[renderable_count]  - one per material
+ *   vertex data                               - in the header's vertex specification
+ *   index data                                - each renderable's indices in turn
+ *
+ * Files are mapped into memory where the platform allows it, and read in one go where
+ * it doesn't, either way nothing in them is parsed or converted.
+ */
+
+namespace smlt {
+
+const uint32_t COMPILED_GEOM_VERSION = 2;
+
+/* The number of attributes in a VertexSpecification */
+const uint32_t COMPILED_GEOM_ATTRIBUTE_COUNT = 12;
+
+struct CompiledGeomHeader {
+    char magic[4];
+    uint32_t version;
+
+    /* The VertexSpecification's attributes, position first and specular last */
+    uint8_t vertex_attributes[COMPILED_GEOM_ATTRIBUTE_COUNT];
+    uint32_t vertex_count;
+
+    /* What the file was compiled from, to tell if it's still valid for a mesh */
+    uint32_t submesh_count;
+    uint32_t index_type;
+    uint64_t source_hash; // compiled_geom_source_hash() of the mesh
+
+    uint32_t octree_levels;
+    float bounds_min[3];
+    float bounds_max[3];
+
+    uint32_t node_count;
+    uint32_t range_count;
+    uint32_t renderable_count;
+
+    /* Offsets are from the start of the file */
+    uint64_t node_offset;
+    uint64_t range_offset;
+    uint64_t renderable_offset;
+    uint64_t vertex_data_offset;
+    uint64_t vertex_data_size;
+    uint64_t index_data_offset;
+    uint64_t index_data_size;
+};
+
+struct CompiledGeomNode {
+    uint32_t first_range;
+    uint32_t range_count;
+};
+
+struct CompiledGeomRange {
+    uint32_t renderable;
+    uint32_t start;
+    uint32_t count;
+};
+
+struct CompiledGeomRenderable {
+    /* Which of the mesh's submeshes (in order) the material comes from. Materials
+     * aren't stored in the file, they're taken from the mesh the geom is created with */
+    uint32_t material_slot;
+    uint32_t index_count;
+    uint64_t index_offset;
+};
+
+class CompiledGeomFile {
+public:
+    /* Returns null if the file doesn't exist, or isn't a compiled geom of this version */
+    static std::shared_ptr<CompiledGeomFile> open(const std::string& path);
+
+    /* Writes a compiled geom. The offsets and counts in the header are filled in here,
+     * the renderables' index data is written in order. Returns false if the file couldn't be written */
+    static bool write(
+        const std::string& path,
+        CompiledGeomHeader header,
+        const std::vector<CompiledGeomNode>& nodes,
+        const std::vector<CompiledGeomRange>& ranges,
+        std::vector<CompiledGeomRenderable> renderables,
+        const uint8_t* vertex_data,
+        const std::vector<std::pair<const uint8_t*, std::size_t>>& index_data
+    );
+
+    ~CompiledGeomFile();
+
+    CompiledGeomFile(const CompiledGeomFile&) = delete;
+    CompiledGeomFile& operator=(const CompiledGeomFile&) = delete;
+
+    /* Whether this was compiled from the mesh as it is now. The layout, index type and
+     * submesh count are checked, and the hash of the vertices and indices must match */
+    bool is_compatible_with(const Mesh& mesh) const;
+
+    const CompiledGeomHeader& header() const { return *header_; }
+    VertexSpecification vertex_specification() const;
+    AABB bounds() const;
+
+    const CompiledGeomNode* nodes() const { return (const CompiledGeomNode*) (data_ + header_->node_offset); }
+    const CompiledGeomRange* ranges() const { return (const CompiledGeomRange*) (data_ + header_->range_offset); }
+    const CompiledGeomRenderable* renderables() const { return (const CompiledGeomRenderable*) (data_ + header_->renderable_offset); }
+
+    const uint8_t* vertex_data() const { return data_ + header_->vertex_data_offset; }
+    const uint8_t* index_data(const CompiledGeomRenderable& renderable) const { return data_ + renderable.index_offset; }
+
+    /* True if the file is mapped rather than read into memory */
+    bool is_mapped() const { return mapped_; }
+
+private:
+    CompiledGeomFile() = default;
+
+    bool is_valid() const;
+
+    const uint8_t* data_ = nullptr;
+    std::size_t size_ = 0;
+    const CompiledGeomHeader* header_ = nullptr;
+
+    bool mapped_ = false;
+    std::vector<uint64_t> buffer_; // When the file can't be mapped, 8 byte aligned
+};
+
+/* Fills in a header's vertex_attributes from a specification */
+void write_vertex_attributes(const VertexSpecification& spec, uint8_t* out);
+
+/* A hash of everything the culler compiles from: the vertex specification and data, and
+ * each submesh's arrangement and indices in turn */
+uint64_t compiled_geom_source_hash(const Mesh& mesh);
+
+/* The index type the culler merges a mesh's indices into */
+IndexType compiled_geom_index_type(const Mesh& mesh);
+
+}
@@ -32,9 +32,16 @@ void GeomCuller::compile() {
     mesh_.reset();
 }
 
-RenderableList GeomCuller::renderables_visible(const Frustum& frustum) {
-    RenderableList ret;
-    _gather_renderables(frustum, ret);
+RenderableList GeomCuller::renderables_visible(const Frustum& frustum, FrameArena* arena, const OcclusionBuffer* occlusion, uint32_t* occluded) {
+    RenderableList ret(arena);
+
+    uint32_t skipped = 0;
+    _gather_renderables(frustum, occlusion, skipped, ret);
+
+    if(occluded) {
+        *occluded += skipped;
+    }
+
     return ret;
 }
 
@@ -4,11 +4,13 @@
 #include <memory>
 #include <functional>
 #include "../../types.h"
+#include "../../generic/frame_arena.h"
 
 namespace smlt {
 
 class HardwareBuffer;
 class Renderable;
+class OcclusionBuffer;
 
 /*
  * A GeomCuller is a class which compiles a mesh into some kind of internal representation
@@ -19,7 +21,7 @@ class Renderable;
  */
 
 typedef std::shared_ptr<Renderable> RenderablePtr;
-typedef std::vector<RenderablePtr> RenderableList;
+typedef FrameVector<RenderablePtr> RenderableList;
 
 typedef std::function<void (Renderable*)> EachRenderableCallback;
 
@@ -32,7 +34,13 @@ public:
     bool is_compiled() const;
 
     void compile();
-    RenderableList renderables_visible(const Frustum& frustum);
+    /* If arena is null the results are allocated on the heap. If there's an occlusion buffer,
+     * anything hidden by the occluders is left out and the number of parts of the geom that
+     * were left out is added to occluded */
+    RenderableList renderables_visible(
+        const Frustum& frustum, FrameArena* arena=nullptr,
+        const OcclusionBuffer* occlusion=nullptr, uint32_t* occluded=nullptr
+    );
 
     void each_renderable(EachRenderableCallback cb);
 protected:
@@ -44,7 +52,7 @@ private:
 
     virtual void _prepare_buffers(Renderer* renderer) = 0;
     virtual void _compile() = 0;
-    virtual void _gather_renderables(const Frustum& frustum, RenderableList& out) = 0;
+    virtual void _gather_renderables(const Frustum& frustum, const OcclusionBuffer* occlusion, uint32_t& occluded, RenderableList& out) = 0;
     virtual void _all_renderables(RenderableList& out) = 0;
 
     virtual const VertexData* _vertex_data() const = 0;
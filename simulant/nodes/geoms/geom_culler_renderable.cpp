@@ -22,7 +22,7 @@ void GeomCullerRenderable::prepare_buffers(Renderer *renderer) {
 
     if(!index_buffer_) {
         index_buffer_ = renderer->hardware_buffers->allocate(
-            indices_.data_size(),
+            _index_data_size(),
             HARDWARE_BUFFER_VERTEX_ARRAY_INDICES,
             SHADOW_BUFFER_DISABLED
         );
@@ -30,11 +30,54 @@ void GeomCullerRenderable::prepare_buffers(Renderer *renderer) {
 
     if(index_buffer_dirty_) {
         index_buffer_dirty_ = false;
-        if(indices_.data_size() > index_buffer_->size()) {
-            index_buffer_->resize(indices_.data_size());
+        if(_index_data_size() > index_buffer_->size()) {
+            index_buffer_->resize(_index_data_size());
         }
-        index_buffer_->upload(indices_);
+
+        if(external_indices_) {
+            index_buffer_->upload(external_indices_, _index_data_size());
+        } else {
+            index_buffer_->upload(indices_);
+        }
+    }
+}
+
+void GeomCullerRenderable::_set_external_indices(const uint8_t* data, uint32_t count) {
+    external_indices_ = data;
+    external_index_count_ = count;
+    index_buffer_dirty_ = true;
+}
+
+const uint8_t* GeomCullerRenderable::_index_data() const {
+    if(external_indices_) {
+        return external_indices_;
     }
+
+    return (indices_.count()) ? indices_.data() : nullptr;
+}
+
+uint32_t GeomCullerRenderable::_index_count() const {
+    return (external_indices_) ? external_index_count_ : indices_.count();
+}
+
+std::size_t GeomCullerRenderable::_index_data_size() const {
+    return std::size_t(_index_count()) * indices_.stride();
+}
+
+bool GeomCullerRenderable::_set_visible_ranges(const std::vector<IndexRange>& ranges) {
+    if(ranges == visible_ranges_) {
+        return false;
+    }
+
+    visible_ranges_ = ranges;
+    visible_index_count_ = 0;
+
+    for(auto& range: ranges) {
+        assert(range.start + range.count <= _index_count());
+        visible_index_count_ += range.count;
+    }
+
+    return true;
 }
 
 VertexSpecification GeomCullerRenderable::vertex_attribute_specification() const {
@@ -50,7 +93,7 @@ HardwareBuffer *GeomCullerRenderable::index_buffer() const {
 }
 
 std::size_t GeomCullerRenderable::index_element_count() const {
-    return indices_.count();
+    return visible_index_count_;
 }
 
 IndexType GeomCullerRenderable::index_type() const {
@@ -22,11 +22,28 @@ public:
     virtual HardwareBuffer* index_buffer() const;
     virtual std::size_t index_element_count() const;
     virtual IndexType index_type() const;
+    const std::vector<IndexRange>* index_ranges() const { return &visible_ranges_; }
     RenderPriority render_priority() const;
     Mat4 final_transformation() const { return Mat4(); }
     const MaterialID material_id() const { return material_id_; }
     const bool is_visible() const;
+
+    /* Every index for this material, in whatever order the culler laid them out. This
+     * is uploaded once, visibility only changes which ranges of it are drawn */
     IndexData& _indices() { return indices_; }
+
+    /* Draws from indices owned by someone else (like a mapped compiled geom file) instead
+     * of _indices(). The data must outlive the renderable */
+    void _set_external_indices(const uint8_t* data, uint32_t count);
+
+    /* The indices that are uploaded, whichever of the above they came from */
+    const uint8_t* _index_data() const;
+    uint32_t _index_count() const;
+    std::size_t _index_data_size() const;
+
+    /* Sets the ranges of _indices() to draw. Returns false if they're the same as last time */
+    bool _set_visible_ranges(const std::vector<IndexRange>& ranges);
+
     const AABB transformed_aabb() const;
     const AABB& aabb() const;
 
@@ -34,7 +51,12 @@ private:
     std::shared_ptr<HardwareBuffer> index_buffer_;
     GeomCuller* culler_;
     IndexData indices_;
+    const uint8_t* external_indices_ = nullptr;
+    uint32_t external_index_count_ = 0;
     bool index_buffer_dirty_ = true;
+
+    std::vector<IndexRange> visible_ranges_;
+    std::size_t visible_index_count_ = 0;
     std::shared_ptr<Geom> geom_;
     MaterialID material_id_;
 };
@@ -1,5 +1,6 @@
 #pragma once
 
+#include <array>
 #include <cstdint>
 #include "../../math/aabb.h"
 #include "../../frustum.h"
@@ -35,6 +36,7 @@ public:
     };
 
     using TraverseCallback = void(Octree::Node*);
+    using TraverseFilter = bool(const AABB&);
 
     typedef TreeData tree_data_type;
     typedef NodeData node_data_type;
@@ -106,6 +108,20 @@ public:
         return &nodes_[idx];
     }
 
+    uint32_t node_count() const { return nodes_.size(); }
+
+    /* The position of a node in the tree's storage, stable for the lifetime of the tree */
+    uint32_t index_of(const Octree::Node* node) const {
+        assert(node >= &nodes_[0] && node < &nodes_[0] + nodes_.size());
+        return node - &nodes_[0];
+    }
+
+    Octree::Node* node_at(uint32_t index) {
+        assert(index < nodes_.size());
+        return &nodes_[index];
+    }
+
+    /* Like find_destination_for_sphere this only reads the tree, so it can be called from several threads at once */
     Octree::Node* find_destination_for_triangle(const Vec3* vertices) {
         /*
          * Return the node that this triangle should be
@@ -142,22 +158,30 @@ public:
 
     template<typename Callback>
     void traverse_visible(const Frustum& frustum, const Callback& cb) {
+        traverse_visible(frustum, cb, [](const AABB&) -> bool { return true; });
+    }
+
+    /* As above, but the filter is also given the loose bounds of each node in the frustum, and
+     * if it returns false neither that node or anything below it is visited */
+    template<typename Callback, typename Filter>
+    void traverse_visible(const Frustum& frustum, const Callback& cb, const Filter& filter) {
         check_signature<Callback, TraverseCallback>();
+        check_signature<Filter, TraverseFilter>();
 
         if(nodes_.empty()) {
             return;
         }
 
-        _visible_visitor(frustum, cb, nodes_[0]);
+        _visible_visitor(frustum, cb, filter, nodes_[0]);
     }
 
     AABB bounds() const { return bounds_; }
 
 private:
-    template<typename Callback>
-    void _visible_visitor(const Frustum& frustum, const Callback& callback, Octree::Node& node) {
+    template<typename Callback, typename Filter>
+    void _visible_visitor(const Frustum& frustum, const Callback& callback, const Filter& filter, Octree::Node& node) {
         auto bounds = calc_loose_bounds(node);
-        if(frustum.intersects_cube(bounds.centre(), bounds.max_dimension())) {
+        if(frustum.intersects_cube(bounds.centre(), bounds.max_dimension()) && filter(bounds)) {
             callback(&node);
 
             if(!is_leaf(node)) {
@@ -165,7 +189,7 @@ private:
 
                 for(auto child: indexes) {
                     assert(child < nodes_.size());
-                    _visible_visitor(frustum, callback, nodes_[child]);
+                    _visible_visitor(frustum, callback, filter, nodes_[child]);
                 }
             }
         }
@@ -248,19 +272,20 @@ private:
         return level_base + idx;
     }
 
-    static std::vector<uint32_t> child_indexes(Octree::Node& node) {
-        std::vector<uint32_t> indexes;
-        indexes.reserve(8);
+    static std::array<uint32_t, 8> child_indexes(Octree::Node& node) {
+        /* This is called for every visible node, so it mustn't allocate */
+        std::array<uint32_t, 8> indexes;
+        uint32_t i = 0;
 
         for(uint32_t z = 0; z <= 1; ++z) {
             for(uint32_t y = 0; y <= 1; ++y) {
                 for(uint32_t x = 0; x <= 1; ++x) {
-                    indexes.push_back(calc_index(
+                    indexes[i++] = calc_index(
                         node.level + 1,
                         2 * node.grid[0] + x,
                         2 * node.grid[1] + y,
                         2 * node.grid[2] + z
-                    ));
+                    );
                 }
             }
         }
@@ -1,13 +1,19 @@
+#include <cstring>
 #include <functional>
 #include "octree_culler.h"
 #include "loose_octree.h"
+#include "compiled_geom.h"
 
 #include "../../vertex_data.h"
 #include "../../frustum.h"
+#include "../../occlusion_buffer.h"
 #include "../../meshes/mesh.h"
 #include "../geom.h"
 #include "../../renderers/renderer.h"
 #include "../../hardware_buffer.h"
+#include "../../stage.h"
+#include "../../window.h"
+#include "../../generic/threading/worker_pool.h"
 #include "geom_culler_renderable.h"
 
 namespace smlt {
@@ -16,34 +22,69 @@ struct CullerTreeData {
     VertexData* vertices;
 };
 
+struct CullerNodeRange {
+    uint32_t renderable;
+    IndexRange range;
+};
+
 struct CullerNodeData {
-    std::unordered_map<MaterialID, std::vector<uint32_t> > triangles;
+    /* Where this node's triangles are in each renderable's indices */
+    std::vector<CullerNodeRange> ranges;
+};
+
+struct CullerTriangle {
+    uint32_t index[3];
+    uint32_t renderable;
 };
 
+/* Triangles are sorted in fixed-size chunks, so the work (and the result) doesn't
+ * depend on how many threads there are */
+const static uint32_t COMPILE_CHUNK_SIZE = 16384;
+
+const static uint8_t OCTREE_LEVELS = 4;
+
 
 typedef Octree<CullerTreeData, CullerNodeData> CullerOctree;
 
 
 struct _OctreeCullerImpl {
-    std::unordered_map<MaterialID, std::shared_ptr<GeomCullerRenderable>> renderable_map;
+    std::unordered_map<MaterialID, uint32_t> renderable_map;
+    std::vector<std::shared_ptr<GeomCullerRenderable>> renderables;
+
+    /* The visible ranges of each renderable, kept between gathers to avoid allocations */
+    std::vector<std::vector<IndexRange>> visible_ranges;
+
     std::shared_ptr<CullerOctree> octree;
+    uint8_t octree_levels = OCTREE_LEVELS;
+
+    /* The submesh each renderable's material came from, for saving the compiled octree */
+    std::vector<uint32_t> material_slots;
+    uint32_t submesh_count = 0;
+
+    /* compiled_geom_source_hash() of the mesh, taken while it's still around */
+    uint64_t source_hash = 0;
 };
 
-OctreeCuller::OctreeCuller(Geom *geom, const MeshPtr mesh):
+OctreeCuller::OctreeCuller(Geom *geom, const MeshPtr mesh, std::shared_ptr<CompiledGeomFile> compiled):
     GeomCuller(geom, mesh),
     pimpl_(new _OctreeCullerImpl()),
-    vertices_(mesh->vertex_data->specification()) {
+    vertices_(mesh->vertex_data->specification()),
+    compiled_(compiled) {
+
+    pimpl_->submesh_count = mesh->submesh_count();
+
+    if(compiled_) {
+        assert(compiled_->is_compatible_with(*mesh));
+
+        /* Everything comes from the file, there's no need to copy the vertices */
+        index_type_ = (IndexType) compiled_->header().index_type;
+        return;
+    }
 
     /* We have to clone the vertex data as the mesh will be destroyed */
     mesh->vertex_data->clone_into(vertices_);
 
-    /* Find the size of index we need to store all indices */
-    IndexType type = INDEX_TYPE_8_BIT;
-    mesh->each([&](const std::string&, SubMesh* submesh) {
-        if(submesh->index_data->index_type() > type) {
-            type = submesh->index_data->index_type();
-        }
-    });
+    index_type_ = compiled_geom_index_type(*mesh);
 }
 
 const VertexData *OctreeCuller::_vertex_data() const {
@@ -55,16 +96,26 @@ HardwareBuffer *OctreeCuller::_vertex_attribute_buffer() const {
 }
 
 void OctreeCuller::_compile() {
+    if(compiled_) {
+        _load_compiled();
+        return;
+    }
+
+    pimpl_->source_hash = compiled_geom_source_hash(*mesh_);
+
     CullerTreeData data;
     data.vertices = &vertices_;
 
     AABB bounds(*data.vertices);
-    pimpl_->octree.reset(new CullerOctree(bounds, 4, &data));
-
-    Vec3 stash[3];
+    pimpl_->octree.reset(new CullerOctree(bounds, pimpl_->octree_levels, &data));
 
+    auto octree = pimpl_->octree.get();
     auto& renderable_map = pimpl_->renderable_map;
+    auto& renderables = pimpl_->renderables;
+
+    std::vector<CullerTriangle> triangles;
 
+    uint32_t slot = 0;
     mesh_->each([&](const std::string&, SubMesh* submesh) {
         auto material_id = submesh->material_id();
 
@@ -86,71 +137,349 @@ void OctreeCuller::_compile() {
                 index_type_
             );
 
-            renderable_map.insert(std::make_pair(material_id, r));
+            it = renderable_map.insert(std::make_pair(material_id, renderables.size())).first;
+            renderables.push_back(r);
+            pimpl_->material_slots.push_back(slot);
         }
 
+        ++slot;
+
+        auto renderable = it->second;
         submesh->each_triangle([&](uint32_t a, uint32_t b, uint32_t c) {
-            stash[0] = data.vertices->position_at<Vec3>(a);
-            stash[1] = data.vertices->position_at<Vec3>(b);
-            stash[2] = data.vertices->position_at<Vec3>(c);
+            CullerTriangle triangle;
+            triangle.index[0] = a;
+            triangle.index[1] = b;
+            triangle.index[2] = c;
+            triangle.renderable = renderable;
+            triangles.push_back(triangle);
+        });
+    });
 
-            auto node = pimpl_->octree->find_destination_for_triangle(stash);
+    /*
+     * Each material's indices are laid out depth-first, so a node's triangles are followed
+     * by those of its children. traverse_visible() visits in the same order, so a whole
+     * visible subtree ends up as a single range.
+     *
+     * That's a counting sort of the triangles by (node, renderable), keeping the mesh
+     * order within each key. Finding each triangle's node and counting the keys is done
+     * in parallel, a chunk at a time. The chunks' counts are then turned into the
+     * position each chunk writes each key to, so the scatter is parallel too and the
+     * result is exactly what sorting on a single thread would give.
+     */
+
+    // The depth-first position of each node
+    std::vector<uint32_t> node_order(octree->node_count());
+    std::vector<CullerOctree::Node*> nodes_in_order;
+    nodes_in_order.reserve(octree->node_count());
+
+    octree->traverse([&](CullerOctree::Node* node) {
+        node_order[octree->index_of(node)] = nodes_in_order.size();
+        nodes_in_order.push_back(node);
+    });
 
-            auto& indexes = node->data->triangles[material_id];
-            indexes.push_back(a);
-            indexes.push_back(b);
-            indexes.push_back(c);
-        });
+    const uint32_t triangle_count = triangles.size();
+    const uint32_t renderable_count = renderables.size();
+    const uint32_t key_count = nodes_in_order.size() * renderable_count;
+    const uint32_t chunk_count = (triangle_count + COMPILE_CHUNK_SIZE - 1) / COMPILE_CHUNK_SIZE;
+
+    /* Without a pool or a geom (and so a window) to get one from, everything runs here */
+    std::unique_ptr<WorkerPool> inline_workers;
+    auto workers = compile_workers_;
+    if(!workers && geom_) {
+        workers = geom_->stage->window->workers.get();
+    } else if(!workers) {
+        inline_workers.reset(new WorkerPool(0));
+        workers = inline_workers.get();
+    }
+
+    std::vector<uint32_t> keys(triangle_count);
+
+    /* One count per key per chunk, stored by chunk */
+    std::vector<uint32_t> chunk_offsets(chunk_count * key_count, 0);
+
+    workers->parallel_for(triangle_count, COMPILE_CHUNK_SIZE, [&](uint32_t, uint32_t begin, uint32_t end) {
+        uint32_t* counts = &chunk_offsets[(begin / COMPILE_CHUNK_SIZE) * key_count];
+        Vec3 stash[3];
+
+        for(uint32_t i = begin; i < end; ++i) {
+            auto& triangle = triangles[i];
+            stash[0] = data.vertices->position_at<Vec3>(triangle.index[0]);
+            stash[1] = data.vertices->position_at<Vec3>(triangle.index[1]);
+            stash[2] = data.vertices->position_at<Vec3>(triangle.index[2]);
+
+            auto node = octree->find_destination_for_triangle(stash);
+            auto key = node_order[octree->index_of(node)] * renderable_count + triangle.renderable;
+
+            keys[i] = key;
+            ++counts[key];
+        }
     });
+
+    // Where each key starts in the sorted triangles, and where each chunk writes within it
+    std::vector<uint32_t> key_starts(key_count + 1, 0);
+
+    uint32_t position = 0;
+    for(uint32_t key = 0; key < key_count; ++key) {
+        key_starts[key] = position;
+
+        for(uint32_t chunk = 0; chunk < chunk_count; ++chunk) {
+            auto& count = chunk_offsets[chunk * key_count + key];
+            auto offset = position;
+            position += count;
+            count = offset;
+        }
+    }
+
+    key_starts[key_count] = position;
+
+    std::vector<uint32_t> sorted(triangle_count);
+
+    workers->parallel_for(triangle_count, COMPILE_CHUNK_SIZE, [&](uint32_t, uint32_t begin, uint32_t end) {
+        uint32_t* offsets = &chunk_offsets[(begin / COMPILE_CHUNK_SIZE) * key_count];
+
+        for(uint32_t i = begin; i < end; ++i) {
+            sorted[offsets[keys[i]]++] = i;
+        }
+    });
+
+    // Record where each node's triangles ended up in each renderable's indices
+    std::vector<uint32_t> index_counts(renderable_count, 0);
+
+    for(uint32_t key = 0; key < key_count; ++key) {
+        auto count = key_starts[key + 1] - key_starts[key];
+        if(!count) {
+            continue;
+        }
+
+        auto node = nodes_in_order[key / renderable_count];
+        auto renderable = key % renderable_count;
+
+        CullerNodeRange node_range;
+        node_range.renderable = renderable;
+        node_range.range.start = index_counts[renderable];
+        node_range.range.count = count * 3;
+        node->data->ranges.push_back(node_range);
+
+        index_counts[renderable] += count * 3;
+    }
+
+    // Finally, write out each renderable's indices
+    workers->parallel_for(renderable_count, 1, [&](uint32_t, uint32_t begin, uint32_t end) {
+        std::vector<uint32_t> indices;
+
+        for(uint32_t renderable = begin; renderable < end; ++renderable) {
+            indices.clear();
+            indices.reserve(index_counts[renderable]);
+
+            for(uint32_t node = 0; node < nodes_in_order.size(); ++node) {
+                auto key = node * renderable_count + renderable;
+
+                for(uint32_t i = key_starts[key]; i < key_starts[key + 1]; ++i) {
+                    auto& triangle = triangles[sorted[i]];
+                    indices.insert(indices.end(), triangle.index, triangle.index + 3);
+                }
+            }
+
+            if(!indices.empty()) {
+                renderables[renderable]->_indices().index(&indices[0], indices.size());
+            }
+        }
+    });
+
+    // This fires signals, so it happens back on this thread
+    for(auto& renderable: renderables) {
+        renderable->_indices().done();
+    }
+
+    pimpl_->visible_ranges.resize(renderables.size());
 }
 
-void OctreeCuller::_all_renderables(RenderableList& out) {
-    auto& renderable_map = pimpl_->renderable_map;
-    for(auto& p: renderable_map) {
-        out.push_back(p.second);
+void OctreeCuller::_load_compiled() {
+    auto& header = compiled_->header();
+
+    pimpl_->octree_levels = header.octree_levels;
+    pimpl_->octree.reset(new CullerOctree(compiled_->bounds(), header.octree_levels));
+
+    auto octree = pimpl_->octree.get();
+    assert(octree->node_count() == header.node_count);
+
+    /* The file refers to materials by the submesh they came from */
+    std::vector<MaterialID> materials;
+    mesh_->each([&](const std::string&, SubMesh* submesh) {
+        materials.push_back(submesh->material_id());
+    });
+
+    auto& renderables = pimpl_->renderables;
+
+    for(uint32_t i = 0; i < header.renderable_count; ++i) {
+        auto& compiled = compiled_->renderables()[i];
+        auto material_id = materials[compiled.material_slot];
+
+        auto r = std::make_shared<GeomCullerRenderable>(this, material_id, index_type_);
+
+        // The indices are drawn straight from the file
+        r->_set_external_indices(compiled_->index_data(compiled), compiled.index_count);
+
+        pimpl_->renderable_map[material_id] = renderables.size();
+        pimpl_->material_slots.push_back(compiled.material_slot);
+        renderables.push_back(r);
+    }
+
+    auto nodes = compiled_->nodes();
+    auto ranges = compiled_->ranges();
+
+    for(uint32_t i = 0; i < header.node_count; ++i) {
+        auto& node_ranges = octree->node_at(i)->data->ranges;
+        node_ranges.reserve(nodes[i].range_count);
+
+        for(uint32_t j = nodes[i].first_range; j < nodes[i].first_range + nodes[i].range_count; ++j) {
+            CullerNodeRange node_range;
+            node_range.renderable = ranges[j].renderable;
+            node_range.range.start = ranges[j].start;
+            node_range.range.count = ranges[j].count;
+            node_ranges.push_back(node_range);
+        }
     }
+
+    pimpl_->visible_ranges.resize(renderables.size());
 }
 
-void OctreeCuller::_gather_renderables(const Frustum &frustum, std::vector<std::shared_ptr<Renderable> > &out) {    
-    auto& renderable_map = pimpl_->renderable_map;
+bool OctreeCuller::save_compiled(const std::string& path) const {
+    if(!is_compiled()) {
+        return false;
+    }
+
+    auto octree = pimpl_->octree.get();
+    auto& renderables = pimpl_->renderables;
+
+    CompiledGeomHeader header;
+    memset(&header, 0, sizeof(header));
+
+    write_vertex_attributes(vertices_.specification(), header.vertex_attributes);
 
-    /* Reset all the index data before we start gathering */
-    for(auto& p: renderable_map) {
-        p.second->_indices().reset();
+    if(compiled_) {
+        header.vertex_count = compiled_->header().vertex_count;
+        header.vertex_data_size = compiled_->header().vertex_data_size;
+    } else {
+        header.vertex_count = vertices_.count();
+        header.vertex_data_size = vertices_.data_size();
     }
 
-    std::unordered_set<GeomCullerRenderable*> seen;
+    header.submesh_count = pimpl_->submesh_count;
+    header.source_hash = (compiled_) ? compiled_->header().source_hash : pimpl_->source_hash;
+    header.index_type = index_type_;
+    header.octree_levels = pimpl_->octree_levels;
+
+    auto bounds = octree->bounds();
+    header.bounds_min[0] = bounds.min().x;
+    header.bounds_min[1] = bounds.min().y;
+    header.bounds_min[2] = bounds.min().z;
+    header.bounds_max[0] = bounds.max().x;
+    header.bounds_max[1] = bounds.max().y;
+    header.bounds_max[2] = bounds.max().z;
+
+    std::vector<CompiledGeomNode> nodes(octree->node_count());
+    std::vector<CompiledGeomRange> ranges;
+
+    for(uint32_t i = 0; i < nodes.size(); ++i) {
+        nodes[i].first_range = ranges.size();
+
+        for(auto& node_range: octree->node_at(i)->data->ranges) {
+            CompiledGeomRange range;
+            range.renderable = node_range.renderable;
+            range.start = node_range.range.start;
+            range.count = node_range.range.count;
+            ranges.push_back(range);
+        }
+
+        nodes[i].range_count = ranges.size() - nodes[i].first_range;
+    }
+
+    std::vector<CompiledGeomRenderable> compiled_renderables(renderables.size());
+    std::vector<std::pair<const uint8_t*, std::size_t>> index_data;
+
+    for(uint32_t i = 0; i < renderables.size(); ++i) {
+        compiled_renderables[i].material_slot = pimpl_->material_slots[i];
+        compiled_renderables[i].index_count = renderables[i]->_index_count();
+        compiled_renderables[i].index_offset = 0;
+
+        index_data.push_back(std::make_pair(renderables[i]->_index_data(), renderables[i]->_index_data_size()));
+    }
+
+    auto vertex_data = (compiled_) ? compiled_->vertex_data() : vertices_.data();
+
+    return CompiledGeomFile::write(
+        path, header, nodes, ranges, compiled_renderables, vertex_data, index_data
+    );
+}
+
+void OctreeCuller::_all_renderables(RenderableList& out) {
+    for(auto& renderable: pimpl_->renderables) {
+        out.push_back(renderable);
+    }
+}
+
+void OctreeCuller::_gather_renderables(const Frustum &frustum, const OcclusionBuffer* occlusion, uint32_t& occluded, RenderableList &out) {
+    auto& renderables = pimpl_->renderables;
+    auto& visible_ranges = pimpl_->visible_ranges;
+
+    for(auto& ranges: visible_ranges) {
+        ranges.clear();
+    }
 
     auto visitor = [&](CullerOctree::Node* node) {
-        for(auto& p: node->data->triangles) {
-            auto mat_id = p.first;
-            auto it = renderable_map.find(mat_id);
-            GeomCullerRenderable* renderable = it->second.get();
-
-            if(!seen.count(renderable)) {
-                seen.insert(renderable);
-                out.push_back(it->second);
+        for(auto& node_range: node->data->ranges) {
+            auto& ranges = visible_ranges[node_range.renderable];
+
+            // Merge with the previous range if it runs straight into this one
+            if(!ranges.empty() && ranges.back().start + ranges.back().count == node_range.range.start) {
+                ranges.back().count += node_range.range.count;
+            } else {
+                ranges.push_back(node_range.range);
             }
-
-            /* Transfer the indices to the renderable */
-            renderable->_indices().index(&p.second[0], p.second.size());
-            renderable->_indices().done();
         }
     };
 
-    pimpl_->octree->traverse_visible(frustum, visitor);
+    if(occlusion) {
+        // Skip whole subtrees hidden behind the occluders, their loose bounds contain everything below them
+        pimpl_->octree->traverse_visible(frustum, visitor, [&](const AABB& bounds) -> bool {
+            if(occlusion->is_occluded(bounds)) {
+                ++occluded;
+                return false;
+            }
+
+            return true;
+        });
+    } else {
+        pimpl_->octree->traverse_visible(frustum, visitor);
+    }
+
+    for(uint32_t i = 0; i < renderables.size(); ++i) {
+        /* The index data is left alone, the renderers only draw the visible ranges of it */
+        renderables[i]->_set_visible_ranges(visible_ranges[i]);
+
+        if(!visible_ranges[i].empty()) {
+            out.push_back(renderables[i]);
+        }
+    }
 }
 
 void OctreeCuller::_prepare_buffers(Renderer* renderer) {
     if(!vertex_attribute_buffer_ && is_compiled()) {
+        auto size = (compiled_) ? compiled_->header().vertex_data_size : vertices_.data_size();
+
         vertex_attribute_buffer_ = renderer->hardware_buffers->allocate(
-            vertices_.data_size(),
+            size,
             HARDWARE_BUFFER_VERTEX_ATTRIBUTES,
             SHADOW_BUFFER_DISABLED,
             HARDWARE_BUFFER_MODIFY_ONCE_USED_FOR_RENDERING
         );
 
-        vertex_attribute_buffer_->upload(vertices_);
+        if(compiled_) {
+            vertex_attribute_buffer_->upload(compiled_->vertex_data(), size);
+        } else {
+            vertex_attribute_buffer_->upload(vertices_);
+        }
     }
 }
 
@@ -7,21 +7,35 @@
 namespace smlt {
 
 struct _OctreeCullerImpl;
+class WorkerPool;
+class CompiledGeomFile;
 
 class OctreeCuller : public GeomCuller {
 public:
-    OctreeCuller(Geom* geom, const MeshPtr mesh);
+    /* If a compiled geom file is passed (which must be compatible with the mesh), compiling
+     * just uses what's in it, only the mesh's materials are taken from the mesh */
+    OctreeCuller(Geom* geom, const MeshPtr mesh, std::shared_ptr<CompiledGeomFile> compiled=std::shared_ptr<CompiledGeomFile>());
 
     AABB octree_bounds() const;
+
+    /* The pool used to compile the octree, by default the window's. The result is the
+     * same whatever the pool, a pool without workers compiles on the calling thread */
+    void set_compile_workers(WorkerPool* workers) { compile_workers_ = workers; }
+
+    /* Writes the compiled octree to a file that can be passed back in next time. Returns
+     * false if the culler hasn't been compiled, or the file couldn't be written */
+    bool save_compiled(const std::string& path) const;
+
 private:
     const VertexData* _vertex_data() const override;
     HardwareBuffer* _vertex_attribute_buffer() const override;
 
     void _compile() override;
-    void _gather_renderables(const Frustum &frustum, RenderableList &out) override;
+    void _gather_renderables(const Frustum &frustum, const OcclusionBuffer* occlusion, uint32_t& occluded, RenderableList &out) override;
     void _all_renderables(RenderableList& out) override;
 
     void _prepare_buffers(Renderer* renderer);
+    void _load_compiled();
 
     std::shared_ptr<_OctreeCullerImpl> pimpl_;
 
@@ -29,6 +43,10 @@ private:
     IndexType index_type_ = INDEX_TYPE_16_BIT;
 
     std::shared_ptr<HardwareBuffer> vertex_attribute_buffer_;
+
+    WorkerPool* compile_workers_ = nullptr;
+
+    std::shared_ptr<CompiledGeomFile> compiled_;
 };
 
 }
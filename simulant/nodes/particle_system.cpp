@@ -1,3 +1,6 @@
+#include <algorithm>
+#include <limits>
+
 #include "particle_system.h"
 
 #include "particles/emitter.h"
@@ -5,6 +8,8 @@
 #include "../stage.h"
 #include "../types.h"
 #include "../hardware_buffer.h"
+#include "../vertex_view.h"
+#include "../frustum.h"
 
 namespace smlt {
 
@@ -15,26 +20,17 @@ using smlt::particles::PARTICLE_EMITTER_BOX;
 using smlt::particles::PARTICLE_EMITTER_POINT;
 
 
-const static VertexSpecification PS_VERTEX_SPEC(
-        smlt::VERTEX_ATTRIBUTE_3F, // Position
-        smlt::VERTEX_ATTRIBUTE_NONE,
-        smlt::VERTEX_ATTRIBUTE_2F, // Texcoord 0
-        smlt::VERTEX_ATTRIBUTE_NONE,
-        smlt::VERTEX_ATTRIBUTE_NONE,
-        smlt::VERTEX_ATTRIBUTE_NONE,
-        smlt::VERTEX_ATTRIBUTE_NONE,
-        smlt::VERTEX_ATTRIBUTE_NONE,
-        smlt::VERTEX_ATTRIBUTE_NONE,
-        smlt::VERTEX_ATTRIBUTE_NONE,
-        smlt::VERTEX_ATTRIBUTE_4F // Diffuse
-);
+typedef VertexLayout<VertexPosition3F, VertexTexCoord0_2F, VertexDiffuse4F> ParticleVertexLayout;
+
+const static VertexSpecification PS_VERTEX_SPEC = ParticleVertexLayout::specification();
 
 ParticleSystem::ParticleSystem(ParticleSystemID id, Stage* stage, SoundDriver* sound_driver):
     StageNode(stage),
     generic::Identifiable<ParticleSystemID>(id),
     Source(stage, sound_driver),
     vertex_data_(new VertexData(PS_VERTEX_SPEC)),
-    index_data_(new IndexData(INDEX_TYPE_16_BIT)) {
+    index_data_(new IndexData(INDEX_TYPE_16_BIT)),
+    billboard_writer_(PS_VERTEX_SPEC) {
 
     set_quota(INITIAL_QUOTA); // Force hardware buffer initialization
     set_material_id(stage->assets->clone_default_material());
@@ -133,10 +129,12 @@ void ParticleSystem::prepare_buffers(Renderer *renderer) {
     // Only resize the hardware buffers if someone called set_quota()
     if(resize_buffers_) {
         if(!vertex_buffer_) {
+            // Rewritten whenever the system is drawn, so this is streamed
             vertex_buffer_ = renderer->hardware_buffers->allocate(
                 vertex_data_->stride() * quota_ * 4,
                 HARDWARE_BUFFER_VERTEX_ATTRIBUTES,
-                SHADOW_BUFFER_DISABLED
+                SHADOW_BUFFER_DISABLED,
+                HARDWARE_BUFFER_MODIFY_REPEATEDLY_USED_FOR_RENDERING
             );
         } else {
             vertex_buffer_->resize(vertex_data_->stride() * quota_ * 4);
@@ -156,7 +154,12 @@ void ParticleSystem::prepare_buffers(Renderer *renderer) {
     }
 
     if(vertex_buffer_dirty_) {
-        vertex_buffer_->upload(*vertex_data_);
+        // The quads go straight into the buffer rather than through vertex_data_
+        if(billboard_count_) {
+            vertex_buffer_->write(billboard_count_ * 4 * vertex_data_->stride(), [this](uint8_t* out) {
+                billboard_writer_.write(particles_, out);
+            });
+        }
         vertex_buffer_dirty_ = false;
     }
 
@@ -202,32 +205,32 @@ void ParticleSystem::set_quota(std::size_t quota) {
 
     quota_ = quota;
 
-    // Shrink if necessary
-    if(particles_.size() > quota) {
-        particles_.resize(quota);
-        particles_.shrink_to_fit();
-    } else {
-        // Reserve space for all the particles
-        particles_.reserve(quota);
+    // Drops any particles over the new quota
+    particles_.set_capacity(quota);
+    billboard_count_ = std::min<uint32_t>(billboard_count_, quota);
+
+    // Every quad uses the same indices, so they're only built when the quota changes
+    IndexType type = (quota * 4 > std::numeric_limits<uint16_t>::max()) ? INDEX_TYPE_32_BIT : INDEX_TYPE_16_BIT;
+    if(type != index_data_->index_type()) {
+        delete index_data_;
+        index_data_ = new IndexData(type);
     }
 
+    particles::write_quad_indices(*index_data_, quota);
+
     vertex_buffer_dirty_ = index_buffer_dirty_ = true;
 }
 
 void ParticleSystem::update(float dt) {
     update_source(dt); //Update any sounds attached to this particle system
 
-    // Update existing particles, erase any that are dead
-    for(auto& particle: particles_) {
-        particle.position += particle.velocity * dt;
-        particle.ttl -= dt;
-    }
+    // The particles themselves are updated by the stage, see Stage::update_particle_systems()
+}
 
-    // Erase dead particles
-    particles_.erase(
-        std::remove_if(particles_.begin(), particles_.end(), [](const Particle& p) -> bool { return p.ttl <= 0.0f; }),
-        particles_.end()
-    );
+void ParticleSystem::update_particles(float dt) {
+    // Update existing particles, erase any that are dead
+    particles_.integrate(dt);
+    particles_.remove_expired();
 
     // Run any manipulations on the particles, we do this before
     // we add new particles - otherwise they get manipulated before they're
@@ -252,69 +255,28 @@ void ParticleSystem::update(float dt) {
         emitter->do_emit(dt, max_can_emit, particles_);
     }
 
-    if(particles_.empty() && !has_repeating_emitters() && !has_active_emitters()) {
-        // If the particles are gone, and we don't have repeating emitters and all the emitters are inactive
-        // Then destroy the particle system if that's what we've been told to do
-        if(destroy_on_completion()) {
-            ask_owner_for_destruction();
-            // No point doing anything else!
-            return;
-        }
-    }
+    // If the particles are gone, and we don't have repeating emitters and all the emitters are inactive
+    // then we're done
+    finished_ = particles_.empty() && !has_repeating_emitters() && !has_active_emitters();
+}
 
-    const static auto v1n = Vec3(-0.5, -0.5, 0.0);
-    const static auto v2n = Vec3( 0.5, -0.5, 0.0);
-    const static auto v3n = Vec3( 0.5,  0.5, 0.0);
-    const static auto v4n = Vec3(-0.5,  0.5, 0.0);
-
-    vertex_data_->move_to_start();
-    vertex_data_->resize(particles_.size() * 4);
-    for(auto& particle: particles_) {
-        auto scale = Vec3(particle.dimensions.x, particle.dimensions.y, 0);
-        auto v1 = particle.position + (v1n * scale);
-        auto v2 = particle.position + (v2n * scale);
-        auto v3 = particle.position + (v3n * scale);
-        auto v4 = particle.position + (v4n * scale);
-
-        vertex_data_->position(v1);
-        vertex_data_->diffuse(particle.colour);
-        vertex_data_->tex_coord0(0, 0);
-        vertex_data_->move_next();
-
-        vertex_data_->position(v2);
-        vertex_data_->diffuse(particle.colour);
-        vertex_data_->tex_coord0(1, 0);
-        vertex_data_->move_next();
-
-        vertex_data_->position(v3);
-        vertex_data_->diffuse(particle.colour);
-        vertex_data_->tex_coord0(1, 1);
-        vertex_data_->move_next();
-
-        vertex_data_->position(v4);
-        vertex_data_->diffuse(particle.colour);
-        vertex_data_->tex_coord0(0, 1);
-        vertex_data_->move_next();
+bool ParticleSystem::merge_update() {
+    for(auto emitter: emitters_) {
+        emitter->schedule_pending_repeat();
     }
 
-    index_data_->clear();
-
-    for(uint32_t i = 0; i < particles_.size(); ++i) {
-        auto new_start = (i * 4);
-        index_data_->index(new_start + 0);
-        index_data_->index(new_start + 1);
-        index_data_->index(new_start + 2);
+    // Destroy the particle system if that's what we've been told to do
+    return finished_ && destroy_on_completion();
+}
 
-        index_data_->index(new_start + 0);
-        index_data_->index(new_start + 2);
-        index_data_->index(new_start + 3);
+void ParticleSystem::write_billboards(const Frustum& frustum) {
+    if(frustum.initialized()) {
+        billboard_writer_.set_camera_axes(frustum.right(), frustum.up());
     }
 
+    // The quads themselves are written in prepare_buffers()
+    billboard_count_ = particles_.size();
     vertex_buffer_dirty_ = true;
-    vertex_data_->done();
-
-    index_buffer_dirty_ = true;
-    index_data_->done();
 }
 
 void ParticleSystem::set_particle_width(float width) {
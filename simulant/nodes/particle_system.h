@@ -15,6 +15,8 @@
 
 #include "particles/emitter.h"
 #include "particles/manipulator.h"
+#include "particles/particle_pool.h"
+#include "particles/billboard_writer.h"
 
 namespace smlt {
 
@@ -81,6 +83,19 @@ public:
     bool has_repeating_emitters() const;
     bool has_active_emitters() const;
 
+    uint32_t particle_count() const { return particles_.size(); }
+
+    /*
+     * The stage updates its particle systems in two steps. update_particles() runs the
+     * simulation, and only touches this particle system (and any manipulators
+     * attached to it) so the stage runs it for every system in parallel. Anything
+     * with an effect outside the system is recorded instead, and merge_update() then
+     * applies it on the main thread. merge_update() returns true if the system has
+     * finished and should be destroyed.
+     */
+    void update_particles(float dt);
+    bool merge_update();
+
     void prepare_buffers(Renderer* renderer) override;
     HardwareBuffer* vertex_attribute_buffer() const override {
         return vertex_buffer_.get();
@@ -95,7 +110,8 @@ public:
     }
 
     std::size_t index_element_count() const override {
-        return index_data_->count();
+        // The index buffer covers the whole quota, only the written quads are drawn
+        return billboard_count_ * 6;
     }
 
     IndexType index_type() const override {
@@ -122,8 +138,13 @@ public:
     }
 
     RenderableList _get_renderables(const Frustum &frustum) const {
-        auto ret = RenderableList();
-        std::shared_ptr<Renderable> sptr = std::const_pointer_cast<ParticleSystem>(shared_from_this());
+        auto self = std::const_pointer_cast<ParticleSystem>(shared_from_this());
+
+        // The quads face whichever camera is looking, so its axes are picked up here rather than in update()
+        self->write_billboards(frustum);
+
+        auto ret = RenderableList(frame_arena());
+        std::shared_ptr<Renderable> sptr = self;
         ret.push_back(sptr);
         return ret;
     }
@@ -159,14 +180,20 @@ private:
     MaterialPtr material_ref_;
 
     std::vector<particles::EmitterPtr> emitters_;
-    std::vector<particles::Particle> particles_;
+    particles::ParticlePool particles_;
     std::vector<particles::ManipulatorPtr> manipulators_;
 
     void update(float dt) override;
+    bool finished_ = false;
+
+    void write_billboards(const Frustum& frustum);
 
     VertexData* vertex_data_ = nullptr;
     IndexData* index_data_ = nullptr;
 
+    particles::BillboardWriter billboard_writer_;
+    uint32_t billboard_count_ = 0;
+
     bool destroy_on_completion_ = false;
 };
 
@@ -0,0 +1,100 @@
+#include <cassert>
+#include <vector>
+
+#include "billboard_writer.h"
+#include "../../vertex_data.h"
+
+namespace smlt {
+namespace particles {
+
+BillboardWriter::BillboardWriter(const VertexSpecification& spec):
+    stride_(spec.stride()),
+    position_offset_(spec.position_offset()),
+    has_texcoord_(spec.texcoord0_attribute == VERTEX_ATTRIBUTE_2F),
+    texcoord_offset_(spec.texcoord0_offset(false)),
+    has_diffuse_(spec.diffuse_attribute == VERTEX_ATTRIBUTE_4F),
+    diffuse_offset_(spec.diffuse_offset(false)) {
+
+    assert(spec.position_attribute == VERTEX_ATTRIBUTE_3F);
+}
+
+void BillboardWriter::set_camera_axes(const Vec3& right, const Vec3& up) {
+    right_ = right;
+    up_ = up;
+}
+
+void BillboardWriter::write(const ParticlePool& particles, uint8_t* out) const {
+    const float* px = particles.stream(PARTICLE_STREAM_POSITION_X);
+    const float* py = particles.stream(PARTICLE_STREAM_POSITION_Y);
+    const float* pz = particles.stream(PARTICLE_STREAM_POSITION_Z);
+    const float* width = particles.stream(PARTICLE_STREAM_WIDTH);
+    const float* height = particles.stream(PARTICLE_STREAM_HEIGHT);
+    const float* r = particles.stream(PARTICLE_STREAM_COLOUR_R);
+    const float* g = particles.stream(PARTICLE_STREAM_COLOUR_G);
+    const float* b = particles.stream(PARTICLE_STREAM_COLOUR_B);
+    const float* a = particles.stream(PARTICLE_STREAM_COLOUR_A);
+
+    // Which way each corner goes along the right and up axes, and its texture coordinate
+    const static float CORNERS[4][2] = {{-1, -1}, {1, -1}, {1, 1}, {-1, 1}};
+    const static float TEXCOORDS[4][2] = {{0, 0}, {1, 0}, {1, 1}, {0, 1}};
+
+    const uint32_t count = particles.size();
+
+    for(uint32_t i = 0; i < count; ++i) {
+        const float hw = width[i] * 0.5f;
+        const float hh = height[i] * 0.5f;
+
+        const float rx = right_.x * hw, ry = right_.y * hw, rz = right_.z * hw;
+        const float ux = up_.x * hh, uy = up_.y * hh, uz = up_.z * hh;
+
+        uint8_t* vertex = out + (i * 4 * stride_);
+
+        for(uint32_t c = 0; c < 4; ++c, vertex += stride_) {
+            const float sx = CORNERS[c][0], sy = CORNERS[c][1];
+
+            float* position = (float*) (vertex + position_offset_);
+            position[0] = px[i] + rx * sx + ux * sy;
+            position[1] = py[i] + ry * sx + uy * sy;
+            position[2] = pz[i] + rz * sx + uz * sy;
+
+            if(has_texcoord_) {
+                float* texcoord = (float*) (vertex + texcoord_offset_);
+                texcoord[0] = TEXCOORDS[c][0];
+                texcoord[1] = TEXCOORDS[c][1];
+            }
+
+            if(has_diffuse_) {
+                float* diffuse = (float*) (vertex + diffuse_offset_);
+                diffuse[0] = r[i];
+                diffuse[1] = g[i];
+                diffuse[2] = b[i];
+                diffuse[3] = a[i];
+            }
+        }
+    }
+}
+
+void write_quad_indices(IndexData& indices, uint32_t count) {
+    std::vector<uint32_t> quads;
+    quads.reserve(count * 6);
+
+    for(uint32_t i = 0; i < count; ++i) {
+        auto start = i * 4;
+        quads.push_back(start + 0);
+        quads.push_back(start + 1);
+        quads.push_back(start + 2);
+
+        quads.push_back(start + 0);
+        quads.push_back(start + 2);
+        quads.push_back(start + 3);
+    }
+
+    indices.clear();
+    if(!quads.empty()) {
+        indices.index(&quads[0], quads.size());
+    }
+    indices.done();
+}
+
+}
+}
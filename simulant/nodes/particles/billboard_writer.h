@@ -0,0 +1,54 @@
+#pragma once
+
+#include <cstdint>
+
+#include "../../types.h"
+#include "particle_pool.h"
+
+namespace smlt {
+
+class IndexData;
+
+namespace particles {
+
+/*
+ * Turns particles into quads which face the camera. Rather than building them a vertex
+ * and an attribute at a time through VertexData, the quads are written straight to
+ * memory in the vertex specification's layout, in one pass over the particle pool.
+ *
+ * Each particle becomes four vertices: bottom left, bottom right, top right and top
+ * left, which is the order write_quad_indices() expects.
+ */
+class BillboardWriter {
+public:
+    /* The specification needs 3 component positions. 2 component texcoord0 and
+     * 4 component diffuse are filled in if it has them, anything else is left alone */
+    BillboardWriter(const VertexSpecification& spec);
+
+    /* The quads face a camera with these (unit length) right and up directions */
+    void set_camera_axes(const Vec3& right, const Vec3& up);
+
+    /* Writes four vertices for each particle to out, which must have room
+     * for particles.size() * 4 vertices */
+    void write(const ParticlePool& particles, uint8_t* out) const;
+
+private:
+    uint32_t stride_;
+    uint32_t position_offset_;
+
+    bool has_texcoord_;
+    uint32_t texcoord_offset_;
+
+    bool has_diffuse_;
+    uint32_t diffuse_offset_;
+
+    Vec3 right_ = Vec3(1, 0, 0);
+    Vec3 up_ = Vec3(0, 1, 0);
+};
+
+/* Replaces the indices with two triangles for each of count quads. The quads
+ * don't change, so this only needs doing when the number of them does */
+void write_quad_indices(IndexData& indices, uint32_t count);
+
+}
+}
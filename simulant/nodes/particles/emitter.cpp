@@ -21,14 +21,19 @@ void Emitter::update(float dt) {
     if(current_duration_ && time_active_ >= current_duration_) {
         deactivate();
 
-        float repeat_delay = rgen_.float_in_range(repeat_delay_range_.first, repeat_delay_range_.second);
-        if(repeat_delay > 0) {
-            system().stage->window->idle->add_timeout_once(repeat_delay, std::bind(&Emitter::activate, this));
-        }
+        pending_repeat_delay_ = rgen_.float_in_range(repeat_delay_range_.first, repeat_delay_range_.second);
     }
 }
 
-void Emitter::do_emit(float dt, uint32_t max, std::vector<Particle> &particles) {
+void Emitter::schedule_pending_repeat() {
+    if(pending_repeat_delay_ > 0) {
+        system().stage->window->idle->add_timeout_once(pending_repeat_delay_, std::bind(&Emitter::activate, this));
+    }
+
+    pending_repeat_delay_ = 0.0;
+}
+
+void Emitter::do_emit(float dt, uint32_t max, ParticlePool &particles) {
     if(!max) {
         return; //Do nothing
     }
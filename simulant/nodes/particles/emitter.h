@@ -7,6 +7,7 @@
 #include <memory>
 
 #include "particle.h"
+#include "particle_pool.h"
 #include "../../math/vec3.h"
 #include "../../math/degrees.h"
 #include "../../colour.h"
@@ -85,12 +86,16 @@ public:
     void set_duration_range(float min_seconds, float max_seconds);
     std::pair<float, float> duration_range() const;
 
-    void do_emit(float dt, uint32_t max_to_emit, std::vector<Particle>& particles);
+    void do_emit(float dt, uint32_t max_to_emit, ParticlePool& particles);
 
     ParticleSystem& system() { return system_; }
 
+    /* Safe to call off the main thread, so the repeat isn't scheduled here. See schedule_pending_repeat() */
     void update(float dt);
 
+    /* Schedules the re-activation that update() decided on, if any. Main thread only */
+    void schedule_pending_repeat();
+
     void activate();
     void deactivate();
     bool is_active() const { return is_active_; }
@@ -115,6 +120,7 @@ private:
 
     float time_active_ = 0.0;
     float current_duration_ = 0.0;
+    float pending_repeat_delay_ = 0.0;
 
     bool is_active_ = true;
 
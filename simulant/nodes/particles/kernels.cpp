@@ -0,0 +1,113 @@
+#include <algorithm>
+
+#if defined(__SSE__)
+#define PARTICLE_KERNELS_SSE 1
+#include <xmmintrin.h>
+#elif defined(__ARM_NEON) || defined(__ARM_NEON__)
+#define PARTICLE_KERNELS_NEON 1
+#include <arm_neon.h>
+#endif
+
+#include "kernels.h"
+
+namespace smlt {
+namespace particles {
+namespace kernels {
+
+void multiply_add(float* out, const float* in, float scale, uint32_t count) {
+    uint32_t i = 0;
+
+#if defined(PARTICLE_KERNELS_SSE)
+    const __m128 s = _mm_set1_ps(scale);
+    for(; i + 4 <= count; i += 4) {
+        __m128 o = _mm_loadu_ps(out + i);
+        __m128 v = _mm_loadu_ps(in + i);
+        _mm_storeu_ps(out + i, _mm_add_ps(o, _mm_mul_ps(v, s)));
+    }
+#elif defined(PARTICLE_KERNELS_NEON)
+    for(; i + 4 <= count; i += 4) {
+        float32x4_t o = vld1q_f32(out + i);
+        float32x4_t v = vld1q_f32(in + i);
+        vst1q_f32(out + i, vmlaq_n_f32(o, v, scale));
+    }
+#endif
+
+    for(; i < count; ++i) {
+        out[i] += in[i] * scale;
+    }
+}
+
+void add(float* values, float amount, uint32_t count) {
+    uint32_t i = 0;
+
+#if defined(PARTICLE_KERNELS_SSE)
+    const __m128 a = _mm_set1_ps(amount);
+    for(; i + 4 <= count; i += 4) {
+        _mm_storeu_ps(values + i, _mm_add_ps(_mm_loadu_ps(values + i), a));
+    }
+#elif defined(PARTICLE_KERNELS_NEON)
+    const float32x4_t a = vdupq_n_f32(amount);
+    for(; i + 4 <= count; i += 4) {
+        vst1q_f32(values + i, vaddq_f32(vld1q_f32(values + i), a));
+    }
+#endif
+
+    for(; i < count; ++i) {
+        values[i] += amount;
+    }
+}
+
+void scale_clamped(float* values, float factor, float minimum, uint32_t count) {
+    uint32_t i = 0;
+
+#if defined(PARTICLE_KERNELS_SSE)
+    const __m128 f = _mm_set1_ps(factor);
+    const __m128 m = _mm_set1_ps(minimum);
+    for(; i + 4 <= count; i += 4) {
+        _mm_storeu_ps(values + i, _mm_max_ps(m, _mm_mul_ps(_mm_loadu_ps(values + i), f)));
+    }
+#elif defined(PARTICLE_KERNELS_NEON)
+    const float32x4_t m = vdupq_n_f32(minimum);
+    for(; i + 4 <= count; i += 4) {
+        vst1q_f32(values + i, vmaxq_f32(m, vmulq_n_f32(vld1q_f32(values + i), factor)));
+    }
+#endif
+
+    for(; i < count; ++i) {
+        values[i] = std::max(minimum, values[i] * factor);
+    }
+}
+
+uint32_t find_non_positive(const float* values, uint32_t start, uint32_t count) {
+    uint32_t i = start;
+
+#if defined(PARTICLE_KERNELS_SSE)
+    const __m128 zero = _mm_setzero_ps();
+    for(; i + 4 <= count; i += 4) {
+        if(_mm_movemask_ps(_mm_cmple_ps(_mm_loadu_ps(values + i), zero))) {
+            break; // It's in these four, the scalar loop finds which
+        }
+    }
+#elif defined(PARTICLE_KERNELS_NEON)
+    const float32x4_t zero = vdupq_n_f32(0.0f);
+    for(; i + 4 <= count; i += 4) {
+        uint32x4_t mask = vcleq_f32(vld1q_f32(values + i), zero);
+        uint32x2_t half = vorr_u32(vget_low_u32(mask), vget_high_u32(mask));
+        if(vget_lane_u32(vpmax_u32(half, half), 0)) {
+            break;
+        }
+    }
+#endif
+
+    for(; i < count; ++i) {
+        if(values[i] <= 0.0f) {
+            return i;
+        }
+    }
+
+    return count;
+}
+
+}
+}
+}
@@ -0,0 +1,30 @@
+#pragma once
+
+#include <cstdint>
+
+/*
+ * The inner loops of the particle update. Each works on a flat array of floats (one
+ * attribute of every particle, see ParticlePool) and uses SSE or NEON where the
+ * platform has it, four particles at a time, with a scalar loop for the rest. Arrays
+ * don't need any particular alignment.
+ */
+
+namespace smlt {
+namespace particles {
+namespace kernels {
+
+/* out[i] += in[i] * scale */
+void multiply_add(float* out, const float* in, float scale, uint32_t count);
+
+/* values[i] += amount */
+void add(float* values, float amount, uint32_t count);
+
+/* values[i] = max(minimum, values[i] * factor) */
+void scale_clamped(float* values, float factor, float minimum, uint32_t count);
+
+/* The first index from start onwards where values[i] <= 0, or count if there isn't one */
+uint32_t find_non_positive(const float* values, uint32_t start, uint32_t count);
+
+}
+}
+}
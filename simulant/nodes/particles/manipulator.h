@@ -1,8 +1,11 @@
 #pragma once
 
 #include <list>
+#include <memory>
 #include <string>
+#include <vector>
 #include "particle.h"
+#include "particle_pool.h"
 
 
 namespace smlt {
@@ -13,16 +16,41 @@ public:
     Manipulator(const std::string& name):
         name_(name) {}
 
+    virtual ~Manipulator() {}
+
     virtual void set_property(const std::string& name, int32_t value) {}
     virtual void set_property(const std::string& name, float value) {}
 
+    void manipulate(ParticlePool& particles, float dt) {
+        do_manipulate_batch(particles, dt);
+    }
+
     void manipulate(std::vector<Particle>& particles, float dt) {
         do_manipulate(particles, dt);
     }
 
 private:
     std::string name_;
-    virtual void do_manipulate(std::vector<Particle>& particles, float dt) = 0;
+
+    /* Manipulators should work on the pool's streams directly, see kernels.h. By default
+     * the particles are copied out to a vector for do_manipulate() and back again, which
+     * is only worth it for manipulators which can't be written a stream at a time */
+    virtual void do_manipulate_batch(ParticlePool& particles, float dt) {
+        std::vector<Particle> copy;
+        copy.reserve(particles.size());
+        for(uint32_t i = 0; i < particles.size(); ++i) {
+            copy.push_back(particles.at(i));
+        }
+
+        do_manipulate(copy, dt);
+
+        particles.clear();
+        for(auto& particle: copy) {
+            particles.push_back(particle);
+        }
+    }
+
+    virtual void do_manipulate(std::vector<Particle>& particles, float dt) {}
 };
 
 typedef std::shared_ptr<Manipulator> ManipulatorPtr;
@@ -1,6 +1,7 @@
 #pragma once
 
 #include "../manipulator.h"
+#include "../kernels.h"
 
 
 namespace smlt {
@@ -22,6 +23,12 @@ public:
 private:
     float rate_ = 0.1f;
 
+    void do_manipulate_batch(ParticlePool& particles, float dt) {
+        auto rate_diff = 1.0f + (rate_ * dt);
+        kernels::scale_clamped(particles.stream(PARTICLE_STREAM_WIDTH), rate_diff, 0.0f, particles.size());
+        kernels::scale_clamped(particles.stream(PARTICLE_STREAM_HEIGHT), rate_diff, 0.0f, particles.size());
+    }
+
     void do_manipulate(std::vector<Particle>& particles, float dt) {
         auto rate_diff = 1.0f + (rate_ * dt);
         for(auto& particle: particles) {
@@ -0,0 +1,119 @@
+#include <algorithm>
+#include <cassert>
+
+#include "particle_pool.h"
+#include "kernels.h"
+
+namespace smlt {
+namespace particles {
+
+void ParticlePool::set_capacity(uint32_t capacity) {
+    for(auto& stream: streams_) {
+        stream.resize(capacity);
+        stream.shrink_to_fit();
+    }
+
+    capacity_ = capacity;
+    size_ = std::min(size_, capacity);
+}
+
+bool ParticlePool::push_back(const Particle& particle) {
+    if(size_ == capacity_) {
+        return false;
+    }
+
+    set(size_++, particle);
+    return true;
+}
+
+Particle ParticlePool::at(uint32_t i) const {
+    assert(i < size_);
+
+    Particle particle;
+    particle.position = Vec3(
+        streams_[PARTICLE_STREAM_POSITION_X][i],
+        streams_[PARTICLE_STREAM_POSITION_Y][i],
+        streams_[PARTICLE_STREAM_POSITION_Z][i]
+    );
+
+    particle.velocity = Vec3(
+        streams_[PARTICLE_STREAM_VELOCITY_X][i],
+        streams_[PARTICLE_STREAM_VELOCITY_Y][i],
+        streams_[PARTICLE_STREAM_VELOCITY_Z][i]
+    );
+
+    particle.dimensions = Vec2(
+        streams_[PARTICLE_STREAM_WIDTH][i],
+        streams_[PARTICLE_STREAM_HEIGHT][i]
+    );
+
+    particle.ttl = streams_[PARTICLE_STREAM_TTL][i];
+
+    particle.colour = Colour(
+        streams_[PARTICLE_STREAM_COLOUR_R][i],
+        streams_[PARTICLE_STREAM_COLOUR_G][i],
+        streams_[PARTICLE_STREAM_COLOUR_B][i],
+        streams_[PARTICLE_STREAM_COLOUR_A][i]
+    );
+
+    return particle;
+}
+
+void ParticlePool::set(uint32_t i, const Particle& particle) {
+    assert(i < size_);
+
+    streams_[PARTICLE_STREAM_POSITION_X][i] = particle.position.x;
+    streams_[PARTICLE_STREAM_POSITION_Y][i] = particle.position.y;
+    streams_[PARTICLE_STREAM_POSITION_Z][i] = particle.position.z;
+    streams_[PARTICLE_STREAM_VELOCITY_X][i] = particle.velocity.x;
+    streams_[PARTICLE_STREAM_VELOCITY_Y][i] = particle.velocity.y;
+    streams_[PARTICLE_STREAM_VELOCITY_Z][i] = particle.velocity.z;
+    streams_[PARTICLE_STREAM_WIDTH][i] = particle.dimensions.x;
+    streams_[PARTICLE_STREAM_HEIGHT][i] = particle.dimensions.y;
+    streams_[PARTICLE_STREAM_TTL][i] = particle.ttl;
+    streams_[PARTICLE_STREAM_COLOUR_R][i] = particle.colour.r;
+    streams_[PARTICLE_STREAM_COLOUR_G][i] = particle.colour.g;
+    streams_[PARTICLE_STREAM_COLOUR_B][i] = particle.colour.b;
+    streams_[PARTICLE_STREAM_COLOUR_A][i] = particle.colour.a;
+}
+
+void ParticlePool::swap_remove(uint32_t i) {
+    assert(i < size_);
+
+    auto last = --size_;
+    if(i == last) {
+        return;
+    }
+
+    for(auto& stream: streams_) {
+        stream[i] = stream[last];
+    }
+}
+
+void ParticlePool::integrate(float dt) {
+    if(!size_) {
+        return;
+    }
+
+    kernels::multiply_add(stream(PARTICLE_STREAM_POSITION_X), stream(PARTICLE_STREAM_VELOCITY_X), dt, size_);
+    kernels::multiply_add(stream(PARTICLE_STREAM_POSITION_Y), stream(PARTICLE_STREAM_VELOCITY_Y), dt, size_);
+    kernels::multiply_add(stream(PARTICLE_STREAM_POSITION_Z), stream(PARTICLE_STREAM_VELOCITY_Z), dt, size_);
+    kernels::add(stream(PARTICLE_STREAM_TTL), -dt, size_);
+}
+
+void ParticlePool::remove_expired() {
+    if(!size_) {
+        return;
+    }
+
+    const float* ttl = stream(PARTICLE_STREAM_TTL);
+
+    uint32_t i = 0;
+    while((i = kernels::find_non_positive(ttl, i, size_)) < size_) {
+        // The particle moved into i hasn't been checked yet, so look at i again
+        swap_remove(i);
+    }
+}
+
+}
+}
@@ -0,0 +1,75 @@
+#pragma once
+
+#include <cstdint>
+#include <vector>
+
+#include "particle.h"
+
+namespace smlt {
+namespace particles {
+
+enum ParticleStream {
+    PARTICLE_STREAM_POSITION_X,
+    PARTICLE_STREAM_POSITION_Y,
+    PARTICLE_STREAM_POSITION_Z,
+    PARTICLE_STREAM_VELOCITY_X,
+    PARTICLE_STREAM_VELOCITY_Y,
+    PARTICLE_STREAM_VELOCITY_Z,
+    PARTICLE_STREAM_WIDTH,
+    PARTICLE_STREAM_HEIGHT,
+    PARTICLE_STREAM_TTL,
+    PARTICLE_STREAM_COLOUR_R,
+    PARTICLE_STREAM_COLOUR_G,
+    PARTICLE_STREAM_COLOUR_B,
+    PARTICLE_STREAM_COLOUR_A,
+    PARTICLE_STREAM_COUNT
+};
+
+/*
+ * The particles of a ParticleSystem, stored as a structure of arrays: one array of
+ * floats for each attribute (a "stream"), all the same length. That way the update
+ * and the manipulators can run over one attribute of every particle at a time, which
+ * is what the kernels in kernels.h are written for.
+ *
+ * Particles are removed by moving the last one into the gap, so the order of the
+ * particles isn't kept. Storage is only allocated by set_capacity(), so pointers
+ * returned by stream() stay valid until then.
+ */
+class ParticlePool {
+public:
+    uint32_t size() const { return size_; }
+    bool empty() const { return size_ == 0; }
+    uint32_t capacity() const { return capacity_; }
+
+    /* Resizes the storage. Any particles past the new capacity are dropped */
+    void set_capacity(uint32_t capacity);
+
+    void clear() { size_ = 0; }
+
+    /* Returns false (and adds nothing) if the pool is full */
+    bool push_back(const Particle& particle);
+
+    Particle at(uint32_t i) const;
+    void set(uint32_t i, const Particle& particle);
+
+    /* Removes a particle by moving the last particle into its place */
+    void swap_remove(uint32_t i);
+
+    /* Moves every particle along its velocity, and ages it by dt */
+    void integrate(float dt);
+
+    /* Removes every particle which has run out of time to live */
+    void remove_expired();
+
+    float* stream(ParticleStream s) { return (capacity_) ? &streams_[s][0] : nullptr; }
+    const float* stream(ParticleStream s) const { return (capacity_) ? &streams_[s][0] : nullptr; }
+
+private:
+    std::vector<float> streams_[PARTICLE_STREAM_COUNT];
+
+    uint32_t size_ = 0;
+    uint32_t capacity_ = 0;
+};
+
+}
+}
@@ -1,4 +1,5 @@
 #include "../stage.h"
+#include "../window.h"
 #include "camera.h"
 
 namespace smlt {
@@ -23,6 +24,10 @@ void StageNode::cleanup() {
     detach(); // Make sure we're not connected to anything
 }
 
+FrameArena* StageNode::frame_arena() const {
+    return (stage_) ? stage_->window->frame_arena.get() : nullptr;
+}
+
 void StageNode::set_parent(CameraID id) {
     TreeNode::set_parent(stage_->camera(id));
 }
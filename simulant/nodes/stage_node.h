@@ -10,13 +10,17 @@
 #include "../behaviours/behaviour.h"
 #include "../interfaces/has_auto_id.h"
 #include "../generic/data_carrier.h"
+#include "../generic/frame_arena.h"
 #include "../shadows.h"
 
 namespace smlt {
 
+class OcclusionBuffer;
+
 typedef sig::signal<void (AABB)> BoundsUpdatedSignal;
 
-typedef std::vector<std::shared_ptr<Renderable>> RenderableList;
+/* Only lives until the end of the frame, so it's allocated from the Window's FrameArena */
+typedef FrameVector<std::shared_ptr<Renderable>> RenderableList;
 
 class StageNode:
     public TreeNode,
@@ -92,13 +96,25 @@ public:
 
     StageNode* find_child_with_name(const std::string& name);
 
-    /* Return a list of renderables to pass into the render queue */
+    /* Return a list of renderables to pass into the render queue. This is called from the
+     * render sequence's worker threads; it may update this node's own state, as no other
+     * thread visits the node at the same time, but must not touch other nodes */
     virtual RenderableList _get_renderables(const smlt::Frustum& frustum) const = 0;
 
+    /* Like _get_renderables, but leaving out any parts of the node hidden by the occluders,
+     * and adding how many parts were left out to occluded. The node's bounds have already
+     * been tested as a whole, so by default this is the same as _get_renderables */
+    virtual RenderableList _get_unoccluded_renderables(const smlt::Frustum& frustum, const OcclusionBuffer& occlusion, uint32_t& occluded) const {
+        return _get_renderables(frustum);
+    }
+
 protected:
     // Faster than properties, useful for subclasses where a clean API isn't as important
     Stage* get_stage() const { return stage_; }
 
+    /* The arena for building the per-frame results of _get_renderables */
+    FrameArena* frame_arena() const;
+
     void on_transformation_changed() override;
     void on_parent_set(TreeNode* oldp, TreeNode* newp) override;
 
@@ -132,8 +148,8 @@ public:
         StageNode(stage) {}
 
     /* Containers don't directly have renderables, but their children do */
-    std::vector<std::shared_ptr<Renderable>> _get_renderables(const Frustum& frustum) const {
-        return std::vector<std::shared_ptr<Renderable>>();
+    RenderableList _get_renderables(const Frustum& frustum) const {
+        return RenderableList();
     }
 
     virtual ~ContainerNode() {}
@@ -0,0 +1,490 @@
+#include <cassert>
+#include <algorithm>
+#include <cmath>
+
+#if defined(__SSE__)
+#define OCCLUSION_BUFFER_SSE 1
+#include <xmmintrin.h>
+#elif defined(__ARM_NEON) || defined(__ARM_NEON__)
+#define OCCLUSION_BUFFER_NEON 1
+#include <arm_neon.h>
+#endif
+
+#include "occlusion_buffer.h"
+
+namespace smlt {
+
+const uint32_t OcclusionBuffer::TILE_SIZE;
+
+/* Anything this close to (or behind) the camera can't be safely projected */
+static const float MIN_W = 1e-5f;
+
+OcclusionBuffer::OcclusionBuffer(uint32_t width, uint32_t height) {
+    tiles_x_ = std::max(1u, (width + TILE_SIZE - 1) / TILE_SIZE);
+    tiles_y_ = std::max(1u, (height + TILE_SIZE - 1) / TILE_SIZE);
+
+    width_ = tiles_x_ * TILE_SIZE;
+    height_ = tiles_y_ * TILE_SIZE;
+
+    depth_.resize(width_ * height_);
+    tile_max_.resize(tiles_x_ * tiles_y_);
+
+    clear();
+}
+
+void OcclusionBuffer::clear() {
+    std::fill(depth_.begin(), depth_.end(), 1.0f);
+    std::fill(tile_max_.begin(), tile_max_.end(), 1.0f);
+    triangles_rasterized_ = 0;
+}
+
+void OcclusionBuffer::set_view_projection(const Mat4& view_projection) {
+    view_projection_ = view_projection;
+}
+
+bool OcclusionBuffer::project(const Vec3& p, ScreenVertex& out) const {
+    auto& m = view_projection_;
+
+    float w = p.x * m[3] + p.y * m[7] + p.z * m[11] + m[15];
+    if(w < MIN_W) {
+        return false;
+    }
+
+    float inv_w = 1.0f / w;
+    float x = (p.x * m[0] + p.y * m[4] + p.z * m[8] + m[12]) * inv_w;
+    float y = (p.x * m[1] + p.y * m[5] + p.z * m[9] + m[13]) * inv_w;
+    float z = (p.x * m[2] + p.y * m[6] + p.z * m[10] + m[14]) * inv_w;
+
+    // In front of the near plane
+    if(z < -1.0f) {
+        return false;
+    }
+
+    out.x = (x * 0.5f + 0.5f) * float(width_);
+    out.y = (y * 0.5f + 0.5f) * float(height_);
+    out.z = z * 0.5f + 0.5f;
+    return true;
+}
+
+/* Edge functions and depth planes of the polygon being rasterized are both
+ * f(x, y) = a * x + b * y + c in screen space */
+namespace {
+
+struct ScreenPlane {
+    float a;
+    float b;
+    float c;
+
+    float at(float x, float y) const {
+        return a * x + b * y + c;
+    }
+
+    /* The most f changes from a pixel's centre to anywhere else in the pixel */
+    float pixel_extent() const {
+        return 0.5f * (std::abs(a) + std::abs(b));
+    }
+};
+
+}
+
+float OcclusionBuffer::signed_area(const ScreenVertex& a, const ScreenVertex& b, const ScreenVertex& c) {
+    return (b.x - a.x) * (c.y - a.y) - (b.y - a.y) * (c.x - a.x);
+}
+
+#if defined(OCCLUSION_BUFFER_SSE)
+static const __m128 LANE_OFFSETS = _mm_setr_ps(0.0f, 1.0f, 2.0f, 3.0f);
+
+static float horizontal_max(__m128 v) {
+    v = _mm_max_ps(v, _mm_shuffle_ps(v, v, _MM_SHUFFLE(1, 0, 3, 2)));
+    v = _mm_max_ps(v, _mm_shuffle_ps(v, v, _MM_SHUFFLE(2, 3, 0, 1)));
+    return _mm_cvtss_f32(v);
+}
+#elif defined(OCCLUSION_BUFFER_NEON)
+static const float LANE_OFFSETS[4] = {0.0f, 1.0f, 2.0f, 3.0f};
+
+static float horizontal_max(float32x4_t v) {
+    float32x2_t m = vpmax_f32(vget_low_f32(v), vget_high_f32(v));
+    return vget_lane_f32(vpmax_f32(m, m), 0);
+}
+
+static bool any_lane(uint32x4_t v) {
+    uint32x2_t m = vorr_u32(vget_low_u32(v), vget_high_u32(v));
+    return vget_lane_u32(vpmax_u32(m, m), 0) != 0;
+}
+#endif
+
+/* Writes one row of a tile, starting at the pixel centre (x, y). Every edge must be
+ * non-negative for a pixel to be written (they're already offset so that only fully
+ * covered pixels pass), and the depth is the farthest of the planes clamped to max_z.
+ * Returns the farthest depth in the row afterwards */
+static float write_row(float* depths, float x, float y, const ScreenPlane* edges, uint32_t edge_count,
+                       const ScreenPlane* planes, uint32_t plane_count, float max_z) {
+
+    uint32_t i = 0;
+    float row_max = 0.0f;
+
+#if defined(OCCLUSION_BUFFER_SSE)
+    const __m128 zero = _mm_setzero_ps();
+    const __m128 farthest = _mm_set1_ps(max_z);
+    __m128 row_max4 = zero;
+
+    for(; i < OcclusionBuffer::TILE_SIZE; i += 4) {
+        const __m128 px = _mm_add_ps(_mm_set1_ps(x + float(i)), LANE_OFFSETS);
+
+        __m128 inside = _mm_cmpge_ps(_mm_add_ps(_mm_mul_ps(px, _mm_set1_ps(edges[0].a)), _mm_set1_ps(edges[0].b * y + edges[0].c)), zero);
+        for(uint32_t e = 1; e < edge_count; ++e) {
+            __m128 v = _mm_add_ps(_mm_mul_ps(px, _mm_set1_ps(edges[e].a)), _mm_set1_ps(edges[e].b * y + edges[e].c));
+            inside = _mm_and_ps(inside, _mm_cmpge_ps(v, zero));
+        }
+
+        __m128 z = _mm_add_ps(_mm_mul_ps(px, _mm_set1_ps(planes[0].a)), _mm_set1_ps(planes[0].b * y + planes[0].c));
+        for(uint32_t p = 1; p < plane_count; ++p) {
+            z = _mm_max_ps(z, _mm_add_ps(_mm_mul_ps(px, _mm_set1_ps(planes[p].a)), _mm_set1_ps(planes[p].b * y + planes[p].c)));
+        }
+        z = _mm_min_ps(z, farthest);
+
+        __m128 current = _mm_loadu_ps(depths + i);
+        __m128 write = _mm_and_ps(inside, _mm_cmplt_ps(z, current));
+        current = _mm_or_ps(_mm_and_ps(write, z), _mm_andnot_ps(write, current));
+
+        _mm_storeu_ps(depths + i, current);
+        row_max4 = _mm_max_ps(row_max4, current);
+    }
+
+    row_max = horizontal_max(row_max4);
+#elif defined(OCCLUSION_BUFFER_NEON)
+    const float32x4_t zero = vdupq_n_f32(0.0f);
+    const float32x4_t farthest = vdupq_n_f32(max_z);
+    const float32x4_t offsets = vld1q_f32(LANE_OFFSETS);
+    float32x4_t row_max4 = zero;
+
+    for(; i < OcclusionBuffer::TILE_SIZE; i += 4) {
+        const float32x4_t px = vaddq_f32(vdupq_n_f32(x + float(i)), offsets);
+
+        uint32x4_t inside = vcgeq_f32(vmlaq_n_f32(vdupq_n_f32(edges[0].b * y + edges[0].c), px, edges[0].a), zero);
+        for(uint32_t e = 1; e < edge_count; ++e) {
+            float32x4_t v = vmlaq_n_f32(vdupq_n_f32(edges[e].b * y + edges[e].c), px, edges[e].a);
+            inside = vandq_u32(inside, vcgeq_f32(v, zero));
+        }
+
+        float32x4_t z = vmlaq_n_f32(vdupq_n_f32(planes[0].b * y + planes[0].c), px, planes[0].a);
+        for(uint32_t p = 1; p < plane_count; ++p) {
+            z = vmaxq_f32(z, vmlaq_n_f32(vdupq_n_f32(planes[p].b * y + planes[p].c), px, planes[p].a));
+        }
+        z = vminq_f32(z, farthest);
+
+        float32x4_t current = vld1q_f32(depths + i);
+        uint32x4_t write = vandq_u32(inside, vcltq_f32(z, current));
+        current = vbslq_f32(write, z, current);
+
+        vst1q_f32(depths + i, current);
+        row_max4 = vmaxq_f32(row_max4, current);
+    }
+
+    row_max = horizontal_max(row_max4);
+#endif
+
+    for(; i < OcclusionBuffer::TILE_SIZE; ++i) {
+        float px = x + float(i);
+
+        bool inside = true;
+        for(uint32_t e = 0; e < edge_count; ++e) {
+            inside &= (edges[e].at(px, y) >= 0.0f);
+        }
+
+        float z = planes[0].at(px, y);
+        for(uint32_t p = 1; p < plane_count; ++p) {
+            z = std::max(z, planes[p].at(px, y));
+        }
+        z = std::min(z, max_z);
+
+        bool write = inside & (z < depths[i]);
+        depths[i] = (write) ? z : depths[i];
+        row_max = std::max(row_max, depths[i]);
+    }
+
+    return row_max;
+}
+
+/* True if any depth in columns [first, last] of the row is at or behind z */
+static bool any_at_or_behind(const float* depths, uint32_t first, uint32_t last, float z) {
+    uint32_t i;
+
+#if defined(OCCLUSION_BUFFER_SSE)
+    const __m128 zv = _mm_set1_ps(z);
+    const __m128 first4 = _mm_set1_ps(float(first));
+    const __m128 last4 = _mm_set1_ps(float(last));
+
+    // Only the groups of four which overlap the columns
+    for(i = first & ~3u; i <= last; i += 4) {
+        __m128 column = _mm_add_ps(_mm_set1_ps(float(i)), LANE_OFFSETS);
+        __m128 in_range = _mm_and_ps(_mm_cmpge_ps(column, first4), _mm_cmple_ps(column, last4));
+        __m128 behind = _mm_cmpge_ps(_mm_loadu_ps(depths + i), zv);
+
+        if(_mm_movemask_ps(_mm_and_ps(in_range, behind))) {
+            return true;
+        }
+    }
+#elif defined(OCCLUSION_BUFFER_NEON)
+    const float32x4_t zv = vdupq_n_f32(z);
+    const float32x4_t first4 = vdupq_n_f32(float(first));
+    const float32x4_t last4 = vdupq_n_f32(float(last));
+    const float32x4_t offsets = vld1q_f32(LANE_OFFSETS);
+
+    for(i = first & ~3u; i <= last; i += 4) {
+        float32x4_t column = vaddq_f32(vdupq_n_f32(float(i)), offsets);
+        uint32x4_t in_range = vandq_u32(vcgeq_f32(column, first4), vcleq_f32(column, last4));
+        uint32x4_t behind = vcgeq_f32(vld1q_f32(depths + i), zv);
+
+        if(any_lane(vandq_u32(in_range, behind))) {
+            return true;
+        }
+    }
+#else
+    for(i = first; i <= last; ++i) {
+        if(depths[i] >= z) {
+            return true;
+        }
+    }
+#endif
+
+    return false;
+}
+
+void OcclusionBuffer::rasterize_triangle(const Vec3& a, const Vec3& b, const Vec3& c) {
+    ScreenVertex v[3];
+    if(!project(a, v[0]) || !project(b, v[1]) || !project(c, v[2])) {
+        return;
+    }
+
+    if(std::abs(signed_area(v[0], v[1], v[2])) < 1e-6f) {
+        return;
+    }
+
+    triangles_rasterized_ += rasterize_polygon(v, 3);
+}
+
+bool OcclusionBuffer::rasterize_quad(const Vec3* first, const Vec3* second) {
+    // Find the edge of the first triangle which the second shares, in either direction
+    for(uint32_t i = 0; i < 3; ++i) {
+        const Vec3& p = first[i];
+        const Vec3& q = first[(i + 1) % 3];
+
+        for(uint32_t j = 0; j < 3; ++j) {
+            const Vec3& other = second[j];
+            const Vec3& s = second[(j + 1) % 3];
+            const Vec3& t = second[(j + 2) % 3];
+
+            if(!((s == p && t == q) || (s == q && t == p))) {
+                continue;
+            }
+
+            /* The second triangle's other vertex goes between the shared pair, which makes
+             * the fan from vertex 0 the second triangle then the first */
+            ScreenVertex v[4];
+            if(!project(p, v[0]) || !project(other, v[1]) || !project(q, v[2]) || !project(first[(i + 2) % 3], v[3])) {
+                return false;
+            }
+
+            float area0 = signed_area(v[0], v[1], v[2]);
+            float area1 = signed_area(v[0], v[2], v[3]);
+            if(std::abs(area0) < 1e-6f || std::abs(area1) < 1e-6f) {
+                return false;
+            }
+
+            // Facing opposite ways means the triangles fold over each other on screen
+            if((area0 < 0) != (area1 < 0)) {
+                return false;
+            }
+
+            // The other diagonal must split it the same way, or the quad isn't convex
+            float area2 = signed_area(v[1], v[2], v[3]);
+            float area3 = signed_area(v[1], v[3], v[0]);
+            if((area2 < 0) != (area0 < 0) || (area3 < 0) != (area0 < 0)) {
+                return false;
+            }
+
+            triangles_rasterized_ += 2 * rasterize_polygon(v, 4);
+            return true;
+        }
+    }
+
+    return false;
+}
+
+uint32_t OcclusionBuffer::rasterize_polygon(ScreenVertex* v, uint32_t count) {
+    // Occluders can be seen from either side, so make the winding consistent
+    if(signed_area(v[0], v[1], v[2]) < 0) {
+        std::reverse(v + 1, v + count);
+    }
+
+    float min_xf = v[0].x, max_xf = v[0].x, min_yf = v[0].y, max_yf = v[0].y;
+    float min_z = v[0].z, max_z = v[0].z;
+    for(uint32_t i = 1; i < count; ++i) {
+        min_xf = std::min(min_xf, v[i].x);
+        max_xf = std::max(max_xf, v[i].x);
+        min_yf = std::min(min_yf, v[i].y);
+        max_yf = std::max(max_yf, v[i].y);
+        min_z = std::min(min_z, v[i].z);
+        max_z = std::max(max_z, v[i].z);
+    }
+
+    int32_t min_x = std::max(0, (int32_t) std::floor(min_xf));
+    int32_t min_y = std::max(0, (int32_t) std::floor(min_yf));
+    int32_t max_x = std::min((int32_t) width_ - 1, (int32_t) std::ceil(max_xf));
+    int32_t max_y = std::min((int32_t) height_ - 1, (int32_t) std::ceil(max_yf));
+
+    if(min_x > max_x || min_y > max_y) {
+        return 0;
+    }
+
+    /* Each edge is positive on the inside. Moving them in by the most they can change
+     * across a pixel means only pixels the polygon covers completely pass */
+    ScreenPlane edges[4];
+    for(uint32_t i = 0; i < count; ++i) {
+        const ScreenVertex& p = v[i];
+        const ScreenVertex& q = v[(i + 1) % count];
+
+        ScreenPlane& edge = edges[i];
+        edge.a = -(q.y - p.y);
+        edge.b = (q.x - p.x);
+        edge.c = -(edge.a * p.x + edge.b * p.y);
+        edge.c -= edge.pixel_extent();
+    }
+
+    /* Depth is linear in screen space across each triangle. Moving the planes back by the
+     * most they change across a pixel gives the farthest depth the triangle has in it. A
+     * quad's two triangles needn't be coplanar, so each pixel takes the farther of the two,
+     * which is never nearer than whichever triangle is really there */
+    ScreenPlane planes[2];
+    uint32_t plane_count = count - 2;
+    for(uint32_t i = 0; i < plane_count; ++i) {
+        const ScreenVertex& v0 = v[0];
+        const ScreenVertex& v1 = v[i + 1];
+        const ScreenVertex& v2 = v[i + 2];
+
+        float inv_area = 1.0f / signed_area(v0, v1, v2);
+
+        ScreenPlane& plane = planes[i];
+        plane.a = ((v1.z - v0.z) * (v2.y - v0.y) - (v2.z - v0.z) * (v1.y - v0.y)) * inv_area;
+        plane.b = ((v2.z - v0.z) * (v1.x - v0.x) - (v1.z - v0.z) * (v2.x - v0.x)) * inv_area;
+        plane.c = v0.z - plane.a * v0.x - plane.b * v0.y;
+        plane.c += plane.pixel_extent();
+    }
+
+    for(uint32_t ty = min_y / TILE_SIZE; ty <= max_y / TILE_SIZE; ++ty) {
+        for(uint32_t tx = min_x / TILE_SIZE; tx <= max_x / TILE_SIZE; ++tx) {
+            auto tile = tile_index(tx, ty);
+
+            // Everything in the tile is already in front of the polygon
+            if(min_z >= tile_max_[tile]) {
+                continue;
+            }
+
+            float* depths = tile_depths(tile);
+            float tile_max = 0.0f;
+
+            float px = float(tx * TILE_SIZE) + 0.5f;
+            for(uint32_t row = 0; row < TILE_SIZE; ++row) {
+                float py = float(ty * TILE_SIZE + row) + 0.5f;
+
+                tile_max = std::max(
+                    tile_max,
+                    write_row(depths + (row * TILE_SIZE), px, py, edges, count, planes, plane_count, max_z)
+                );
+            }
+
+            tile_max_[tile] = tile_max;
+        }
+    }
+
+    return 1;
+}
+
+void OcclusionBuffer::rasterize_triangles(const Vec3* vertices, std::size_t vertex_count) {
+    std::size_t i = 0;
+    while(i + 2 < vertex_count) {
+        // Pairs of triangles which make up a quad are drawn together, so their shared edge isn't lost
+        if(i + 5 < vertex_count && rasterize_quad(vertices + i, vertices + i + 3)) {
+            i += 6;
+            continue;
+        }
+
+        rasterize_triangle(vertices[i], vertices[i + 1], vertices[i + 2]);
+        i += 3;
+    }
+}
+
+bool OcclusionBuffer::is_occluded(const AABB& box) const {
+    auto& min = box.min();
+    auto& max = box.max();
+
+    float min_x = float(width_), min_y = float(height_), min_z = 1.0f;
+    float max_x = 0.0f, max_y = 0.0f;
+
+    for(uint32_t i = 0; i < 8; ++i) {
+        Vec3 corner(
+            (i & 1) ? max.x : min.x,
+            (i & 2) ? max.y : min.y,
+            (i & 4) ? max.z : min.z
+        );
+
+        ScreenVertex v;
+        if(!project(corner, v)) {
+            // The box reaches the camera, it can't be hidden
+            return false;
+        }
+
+        min_x = std::min(min_x, v.x);
+        min_y = std::min(min_y, v.y);
+        max_x = std::max(max_x, v.x);
+        max_y = std::max(max_y, v.y);
+        min_z = std::min(min_z, v.z);
+    }
+
+    // Off screen, whether it's visible is up to the frustum
+    if(max_x < 0.0f || max_y < 0.0f || min_x >= float(width_) || min_y >= float(height_)) {
+        return false;
+    }
+
+    // Every pixel the box could touch
+    uint32_t x0 = (uint32_t) std::max(0.0f, std::floor(min_x));
+    uint32_t y0 = (uint32_t) std::max(0.0f, std::floor(min_y));
+    uint32_t x1 = (uint32_t) std::min(float(width_ - 1), std::floor(max_x));
+    uint32_t y1 = (uint32_t) std::min(float(height_ - 1), std::floor(max_y));
+
+    for(uint32_t ty = y0 / TILE_SIZE; ty <= y1 / TILE_SIZE; ++ty) {
+        for(uint32_t tx = x0 / TILE_SIZE; tx <= x1 / TILE_SIZE; ++tx) {
+            auto tile = tile_index(tx, ty);
+
+            // Every pixel in this tile is in front of the box
+            if(tile_max_[tile] < min_z) {
+                continue;
+            }
+
+            const float* depths = tile_depths(tile);
+
+            uint32_t row_start = std::max(y0, ty * TILE_SIZE) - ty * TILE_SIZE;
+            uint32_t row_end = std::min(y1, ty * TILE_SIZE + TILE_SIZE - 1) - ty * TILE_SIZE;
+            uint32_t col_start = std::max(x0, tx * TILE_SIZE) - tx * TILE_SIZE;
+            uint32_t col_end = std::min(x1, tx * TILE_SIZE + TILE_SIZE - 1) - tx * TILE_SIZE;
+
+            for(uint32_t row = row_start; row <= row_end; ++row) {
+                if(any_at_or_behind(depths + (row * TILE_SIZE), col_start, col_end, min_z)) {
+                    return false;
+                }
+            }
+        }
+    }
+
+    return true;
+}
+
+float OcclusionBuffer::depth_at(uint32_t x, uint32_t y) const {
+    assert(x < width_ && y < height_);
+
+    auto tile = tile_index(x / TILE_SIZE, y / TILE_SIZE);
+    return tile_depths(tile)[(y % TILE_SIZE) * TILE_SIZE + (x % TILE_SIZE)];
+}
+
+}
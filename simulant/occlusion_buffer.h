@@ -0,0 +1,108 @@
+#pragma once
+
+#include <cstdint>
+#include <vector>
+
+#include "math/vec3.h"
+#include "math/mat4.h"
+#include "math/aabb.h"
+
+/*
+ * A small, CPU-only depth buffer for occlusion culling.
+ *
+ * Each frame the occluders (simple, low-poly stand-ins for walls, buildings and
+ * terrain) are rasterized into the buffer from the camera's point of view, then
+ * bounding boxes are tested against it. Occluders only write the pixels they cover
+ * completely, with the farthest depth they have anywhere in the pixel, and a box is
+ * only occluded if every pixel it touches is in front of the box's nearest point.
+ * So the test is conservative: a box which is reported occluded is definitely hidden.
+ *
+ * The buffer is stored as 8x8 tiles, each tile's pixels contiguous, along with the
+ * farthest depth in each tile. That lets both writes and queries skip whole tiles
+ * at once, and the per-pixel loops work on four pixels at a time with SSE or NEON
+ * where they're available. Nothing here touches the renderer, so it can be used (and
+ * tested) without a window.
+ */
+
+namespace smlt {
+
+class OcclusionBuffer {
+public:
+    const static uint32_t TILE_SIZE = 8;
+
+    /* The size is rounded up to a whole number of tiles */
+    OcclusionBuffer(uint32_t width=256, uint32_t height=128);
+
+    /* Clears the buffer to the far plane, ready for a new frame */
+    void clear();
+
+    /* The combined projection * view matrix of the camera */
+    void set_view_projection(const Mat4& view_projection);
+
+    /* Triangles are in world space. Triangles which cross the near plane are skipped,
+     * so that an occluder can never hide more than it covers */
+    void rasterize_triangle(const Vec3& a, const Vec3& b, const Vec3& c);
+
+    /* A list of triangles, every three vertices is one triangle. A single triangle leaves
+     * the pixels along its edges empty, so consecutive triangles which make a convex quad
+     * on screen are rasterized as one, and the edge they share doesn't leave a gap */
+    void rasterize_triangles(const Vec3* vertices, std::size_t vertex_count);
+
+    /* Returns true if the box is entirely hidden behind what's been rasterized */
+    bool is_occluded(const AABB& box) const;
+
+    /* The depth at a pixel, 0 at the near plane and 1 at the far plane */
+    float depth_at(uint32_t x, uint32_t y) const;
+
+    uint32_t width() const { return width_; }
+    uint32_t height() const { return height_; }
+
+    uint32_t triangles_rasterized() const { return triangles_rasterized_; }
+
+private:
+    struct ScreenVertex {
+        float x;
+        float y;
+        float z;
+    };
+
+    /* Returns false if the point is behind (or too close to) the camera */
+    bool project(const Vec3& p, ScreenVertex& out) const;
+
+    static float signed_area(const ScreenVertex& a, const ScreenVertex& b, const ScreenVertex& c);
+
+    /* Returns false if the two triangles don't make a convex quad, nothing is written then */
+    bool rasterize_quad(const Vec3* first, const Vec3* second);
+
+    /* A convex polygon of 3 or 4 vertices, a quad is the fan from its first vertex.
+     * Returns 0 if it's entirely off screen, otherwise 1 */
+    uint32_t rasterize_polygon(ScreenVertex* vertices, uint32_t count);
+
+    uint32_t tile_index(uint32_t tx, uint32_t ty) const {
+        return ty * tiles_x_ + tx;
+    }
+
+    float* tile_depths(uint32_t tile) {
+        return &depth_[tile * TILE_SIZE * TILE_SIZE];
+    }
+
+    const float* tile_depths(uint32_t tile) const {
+        return &depth_[tile * TILE_SIZE * TILE_SIZE];
+    }
+
+    uint32_t width_;
+    uint32_t height_;
+    uint32_t tiles_x_;
+    uint32_t tiles_y_;
+
+    Mat4 view_projection_;
+
+    std::vector<float> depth_;
+
+    /* The farthest depth of each tile, nothing behind this can be visible in it */
+    std::vector<float> tile_max_;
+
+    uint32_t triangles_rasterized_ = 0;
+};
+
+}
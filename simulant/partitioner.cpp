@@ -1,3 +1,5 @@
+#include <algorithm>
+
 #include "partitioner.h"
 
 namespace smlt {
@@ -93,72 +95,122 @@ void Partitioner::remove_light(LightID obj) {
     stage_write(write);
 }
 
-void Partitioner::_apply_writes() {
-    std::unordered_map<ActorID, std::set<WriteOperation>> seen_actors;
-    std::unordered_map<LightID, std::set<WriteOperation>> seen_lights;
-    std::unordered_map<GeomID, std::set<WriteOperation>> seen_geoms;
-    std::unordered_map<ParticleSystemID, std::set<WriteOperation>> seen_particle_systems;
-
-    std::stack<StagedWrite> filtered;
+uint32_t Partitioner::staged_node_id(const StagedWrite& write) {
+    switch(write.stage_node_type) {
+        case STAGE_NODE_TYPE_ACTOR: return write.actor_id.value();
+        case STAGE_NODE_TYPE_LIGHT: return write.light_id.value();
+        case STAGE_NODE_TYPE_GEOM: return write.geom_id.value();
+        case STAGE_NODE_TYPE_PARTICLE_SYSTEM: return write.particle_system_id.value();
+    default:
+        return 0;
+    }
+}
 
+void Partitioner::_apply_writes() {
     {
+        // Take everything staged so far, new writes go into the (empty) old list
         std::lock_guard<std::mutex> lock(staging_lock_);
+        applying_writes_.swap(staged_writes_);
+    }
+
+    if(applying_writes_.empty()) {
+        return;
+    }
+
+    auto& writes = applying_writes_;
+
+    /* Group the writes by node, keeping them in the order they were made within
+     * each node. The index is part of the key so an unstable sort is fine */
+    write_order_.resize(writes.size());
+    for(uint32_t i = 0; i < writes.size(); ++i) {
+        write_order_[i] = i;
+    }
+
+    std::sort(write_order_.begin(), write_order_.end(), [&](uint32_t lhs, uint32_t rhs) {
+        auto& l = writes[lhs];
+        auto& r = writes[rhs];
+
+        if(l.stage_node_type != r.stage_node_type) {
+            return l.stage_node_type < r.stage_node_type;
+        }
+
+        auto lid = staged_node_id(l);
+        auto rid = staged_node_id(r);
+        return (lid != rid) ? lid < rid : lhs < rhs;
+    });
 
-        /* Filter the list of operations so only the last operation of each
-         * type for each entity is applied. It's a stack so we iterate in most-recent-first
-         * and then push onto another stack (so the newest is at the bottom) then we iterate
-         * the filtered stack so they apply in the right order */
-        while(!staged_writes_.empty()) {
-            auto write = staged_writes_.top();
-            staged_writes_.pop();
-
-            if(write.stage_node_type == STAGE_NODE_TYPE_ACTOR) {
-                if(seen_actors.count(write.actor_id) && seen_actors.at(write.actor_id).count(write.operation)) {
-                    // We've already seen this operation for this actor
-                    continue;
-                } else {
-                    seen_actors[write.actor_id].insert(write.operation);
-                    filtered.push(write);
-                }
-            } else if(write.stage_node_type == STAGE_NODE_TYPE_LIGHT) {
-                if(seen_lights.count(write.light_id) && seen_lights.at(write.light_id).count(write.operation)) {
-                    // We've already seen this operation for this light
-                    continue;
-                } else {
-                    seen_lights[write.light_id].insert(write.operation);
-                    filtered.push(write);
-                }
-            } else if(write.stage_node_type == STAGE_NODE_TYPE_GEOM) {
-                if(seen_geoms.count(write.geom_id) && seen_geoms.at(write.geom_id).count(write.operation)) {
-                    // We've already seen this operation for this geom
-                    continue;
-                } else {
-                    seen_geoms[write.geom_id].insert(write.operation);
-                    filtered.push(write);
-                }
-            } else if(write.stage_node_type == STAGE_NODE_TYPE_PARTICLE_SYSTEM) {
-                if(seen_particle_systems.count(write.particle_system_id) && seen_particle_systems.at(write.particle_system_id).count(write.operation)) {
-                    // We've already seen this operation for this particle system
-                    continue;
-                } else {
-                    seen_particle_systems[write.particle_system_id].insert(write.operation);
-                    filtered.push(write);
-                }
+    /* Coalesce each node's writes. Only the latest update is kept, and an add
+     * followed by a remove cancels out (along with any updates in between). A remove
+     * that comes before an add is for the node that existed before, so it's kept. */
+    pending_nodes_.clear();
+
+    for(uint32_t i = 0; i < write_order_.size();) {
+        auto& first = writes[write_order_[i]];
+        auto node_id = staged_node_id(first);
+
+        PendingNode pending;
+        pending.first_write = write_order_[i];
+
+        for(; i < write_order_.size(); ++i) {
+            auto index = write_order_[i];
+            auto& write = writes[index];
+
+            if(write.stage_node_type != first.stage_node_type || staged_node_id(write) != node_id) {
+                break;
             }
+
+            switch(write.operation) {
+                case WRITE_OPERATION_ADD:
+                    pending.add = index;
+                    pending.update = -1;
+                break;
+                case WRITE_OPERATION_UPDATE:
+                    pending.update = index;
+                break;
+                case WRITE_OPERATION_REMOVE:
+                    if(pending.add >= 0) {
+                        pending.add = -1;
+                    } else {
+                        pending.remove = index;
+                    }
+                    pending.update = -1;
+                break;
+            }
+        }
+
+        if(pending.remove >= 0 || pending.add >= 0 || pending.update >= 0) {
+            pending_nodes_.push_back(pending);
         }
     }
 
-    while(!filtered.empty()) {
-        auto write = filtered.top();
-        filtered.pop();
-        apply_staged_write(write);
+    // Apply nodes in the order they were first written to
+    std::sort(pending_nodes_.begin(), pending_nodes_.end(), [](const PendingNode& lhs, const PendingNode& rhs) {
+        return lhs.first_write < rhs.first_write;
+    });
+
+    for(auto& pending: pending_nodes_) {
+        if(pending.remove >= 0) {
+            apply_staged_write(writes[pending.remove]);
+        }
+
+        if(pending.add >= 0) {
+            apply_staged_write(writes[pending.add]);
+        }
+
+        if(pending.update >= 0) {
+            apply_staged_write(writes[pending.update]);
+        }
     }
+
+    finish_staged_writes();
+
+    writes.clear();
 }
 
 void Partitioner::stage_write(const StagedWrite &op) {
     std::lock_guard<std::mutex> lock(staging_lock_);
 
-    staged_writes_.push(op);
+    staged_writes_.push_back(op);
 }
 
 }
@@ -19,8 +19,8 @@
 #ifndef PARTITIONER_H
 #define PARTITIONER_H
 
-#include <stack>
 #include <memory>
+#include <mutex>
 #include <set>
 #include <vector>
 
@@ -100,11 +100,33 @@ protected:
 
     virtual void apply_staged_write(const StagedWrite& write) = 0;
 
+    /* Called once all of a frame's writes have been applied, for partitioners which
+     * batch up work (e.g. refitting a tree) rather than doing it for every write */
+    virtual void finish_staged_writes() {}
+
 private:
+    /* What's left to do for a single node once its writes have been coalesced,
+     * each is an index into applying_writes_ (or -1) */
+    struct PendingNode {
+        uint32_t first_write = 0;
+        int32_t remove = -1;
+        int32_t add = -1;
+        int32_t update = -1;
+    };
+
+    static uint32_t staged_node_id(const StagedWrite& write);
+
     Stage* stage_;
 
+    /* Writes are appended here (in the order they're made) by any thread, the lock
+     * is only held long enough to push, or to swap the whole list out */
     std::mutex staging_lock_;
-    std::stack<StagedWrite> staged_writes_;
+    std::vector<StagedWrite> staged_writes_;
+
+    /* Only used by _apply_writes, kept around so they don't reallocate every frame */
+    std::vector<StagedWrite> applying_writes_;
+    std::vector<uint32_t> write_order_;
+    std::vector<PendingNode> pending_nodes_;
 };
 
 }
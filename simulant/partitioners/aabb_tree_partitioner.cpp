@@ -0,0 +1,142 @@
+#include "aabb_tree_partitioner.h"
+#include "../stage.h"
+#include "../nodes/actor.h"
+#include "../nodes/light.h"
+#include "../nodes/camera.h"
+#include "../nodes/particle_system.h"
+#include "../nodes/geom.h"
+
+namespace smlt {
+
+AABBTreePartitioner::AABBTreePartitioner(Stage* ss):
+    Partitioner(ss) {
+
+}
+
+template<typename ID>
+void AABBTreePartitioner::insert_entry(std::unordered_map<ID, TreeEntry>& entries, const StagedWrite& write, const ID& id, const AABB& box) {
+    write_lock<shared_mutex> lock(lock_);
+
+    auto& entry = entries[id];
+    if(entry.proxy != AABBTree::NULL_PROXY) {
+        // Already in the tree, just treat this as a move
+        tree_.move_proxy(entry.proxy, box);
+        return;
+    }
+
+    entry.type = write.stage_node_type;
+    entry.actor_id = write.actor_id;
+    entry.light_id = write.light_id;
+    entry.geom_id = write.geom_id;
+    entry.particle_system_id = write.particle_system_id;
+    entry.proxy = tree_.create_proxy(box, &entry);
+}
+
+template<typename ID>
+void AABBTreePartitioner::remove_entry(std::unordered_map<ID, TreeEntry>& entries, const ID& id) {
+    write_lock<shared_mutex> lock(lock_);
+
+    auto it = entries.find(id);
+    if(it != entries.end()) {
+        tree_.destroy_proxy(it->second.proxy);
+        entries.erase(it);
+    }
+}
+
+template<typename ID>
+void AABBTreePartitioner::update_entry(std::unordered_map<ID, TreeEntry>& entries, const ID& id, const AABB& box) {
+    write_lock<shared_mutex> lock(lock_);
+
+    auto it = entries.find(id);
+    if(it != entries.end()) {
+        // Any refitting waits for finish_staged_writes()
+        tree_.move_proxy(it->second.proxy, box);
+    }
+}
+
+void AABBTreePartitioner::apply_staged_write(const StagedWrite &write) {
+    if(write.operation == WRITE_OPERATION_ADD) {
+        if(write.actor_id) {
+            auto actor = stage->actor(write.actor_id);
+            insert_entry(actor_entries_, write, write.actor_id, actor->transformed_aabb());
+        } else if(write.geom_id) {
+            auto geom = stage->geom(write.geom_id);
+            insert_entry(geom_entries_, write, write.geom_id, geom->transformed_aabb());
+        } else if(write.light_id) {
+            auto light = stage->light(write.light_id);
+            if(light->type() == LIGHT_TYPE_DIRECTIONAL) {
+                // Directional lights are always visible, no need to add them to the tree
+                write_lock<shared_mutex> lock(lock_);
+                directional_lights_.insert(write.light_id);
+            } else {
+                insert_entry(light_entries_, write, write.light_id, light->transformed_aabb());
+            }
+        } else if(write.particle_system_id) {
+            auto particle_system = stage->particle_system(write.particle_system_id);
+            insert_entry(particle_system_entries_, write, write.particle_system_id, particle_system->transformed_aabb());
+        }
+    } else if(write.operation == WRITE_OPERATION_REMOVE) {
+        if(write.actor_id) {
+            remove_entry(actor_entries_, write.actor_id);
+        } else if(write.geom_id) {
+            remove_entry(geom_entries_, write.geom_id);
+        } else if(write.light_id) {
+            {
+                write_lock<shared_mutex> lock(lock_);
+                directional_lights_.erase(write.light_id);
+            }
+
+            remove_entry(light_entries_, write.light_id);
+        } else if(write.particle_system_id) {
+            remove_entry(particle_system_entries_, write.particle_system_id);
+        }
+    } else if(write.operation == WRITE_OPERATION_UPDATE) {
+        if(write.stage_node_type == STAGE_NODE_TYPE_ACTOR) {
+            update_entry(actor_entries_, write.actor_id, write.new_bounds);
+        } else if(write.stage_node_type == STAGE_NODE_TYPE_LIGHT) {
+            update_entry(light_entries_, write.light_id, write.new_bounds);
+        } else if(write.stage_node_type == STAGE_NODE_TYPE_PARTICLE_SYSTEM) {
+            update_entry(particle_system_entries_, write.particle_system_id, write.new_bounds);
+        }
+    }
+}
+
+void AABBTreePartitioner::finish_staged_writes() {
+    write_lock<shared_mutex> lock(lock_);
+    tree_.refit();
+}
+
+void AABBTreePartitioner::lights_and_geometry_visible_from(
+        CameraID camera_id, std::vector<LightID> &lights_out,
+        std::vector<StageNode*> &geom_out) {
+
+    read_lock<shared_mutex> lock(lock_);
+
+    auto frustum = stage->camera(camera_id)->frustum();
+
+    tree_.query_frustum(frustum, [&](AABBTree::ProxyID proxy) {
+        auto entry = static_cast<TreeEntry*>(tree_.user_data(proxy));
+
+        switch(entry->type) {
+            case STAGE_NODE_TYPE_ACTOR:
+                geom_out.push_back(entry->actor_id.fetch());
+            break;
+            case STAGE_NODE_TYPE_GEOM:
+                geom_out.push_back(entry->geom_id.fetch());
+            break;
+            case STAGE_NODE_TYPE_PARTICLE_SYSTEM:
+                geom_out.push_back(entry->particle_system_id.fetch());
+            break;
+            case STAGE_NODE_TYPE_LIGHT:
+                lights_out.push_back(entry->light_id);
+            break;
+        default:
+            break;
+        }
+    });
+
+    // Add directional lights to the end
+    lights_out.insert(lights_out.end(), directional_lights_.begin(), directional_lights_.end());
+}
+
+}
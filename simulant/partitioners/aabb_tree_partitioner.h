@@ -0,0 +1,64 @@
+#pragma once
+
+#include <unordered_map>
+#include <unordered_set>
+
+#include "../partitioner.h"
+#include "./impl/aabb_tree.h"
+#include "../generic/threading/shared_mutex.h"
+
+namespace smlt {
+
+/*
+ * A partitioner built on a dynamic AABB tree. Nodes which only move a little are
+ * absorbed by their fattened leaf boxes, and the rest of a frame's updates are
+ * refitted in one batch once all of the staged writes have been applied.
+ */
+class AABBTreePartitioner : public Partitioner {
+public:
+    AABBTreePartitioner(Stage* ss);
+
+    void lights_and_geometry_visible_from(
+        CameraID camera_id,
+        std::vector<LightID> &lights_out,
+        std::vector<StageNode*> &geom_out
+    );
+
+private:
+    struct TreeEntry {
+        StageNodeType type;
+
+        ActorID actor_id;
+        LightID light_id;
+        GeomID geom_id;
+        ParticleSystemID particle_system_id;
+
+        AABBTree::ProxyID proxy = AABBTree::NULL_PROXY;
+    };
+
+    template<typename ID>
+    void insert_entry(std::unordered_map<ID, TreeEntry>& entries, const StagedWrite& write, const ID& id, const AABB& box);
+
+    template<typename ID>
+    void remove_entry(std::unordered_map<ID, TreeEntry>& entries, const ID& id);
+
+    template<typename ID>
+    void update_entry(std::unordered_map<ID, TreeEntry>& entries, const ID& id, const AABB& box);
+
+    void apply_staged_write(const StagedWrite& write);
+    void finish_staged_writes();
+
+    AABBTree tree_;
+
+    /* The tree's user data points at these, elements of an unordered_map don't move */
+    std::unordered_map<ActorID, TreeEntry> actor_entries_;
+    std::unordered_map<LightID, TreeEntry> light_entries_;
+    std::unordered_map<ParticleSystemID, TreeEntry> particle_system_entries_;
+    std::unordered_map<GeomID, TreeEntry> geom_entries_;
+
+    std::unordered_set<LightID> directional_lights_;
+
+    shared_mutex lock_;
+};
+
+}
@@ -0,0 +1,410 @@
+#include <algorithm>
+#include <cmath>
+
+#include "aabb_tree.h"
+
+namespace smlt {
+
+const AABBTree::ProxyID AABBTree::NULL_PROXY;
+const uint32_t AABBTree::NULL_NODE;
+
+static AABB merge(const AABB& a, const AABB& b) {
+    auto& amin = a.min();
+    auto& amax = a.max();
+    auto& bmin = b.min();
+    auto& bmax = b.max();
+
+    return AABB(
+        Vec3(std::min(amin.x, bmin.x), std::min(amin.y, bmin.y), std::min(amin.z, bmin.z)),
+        Vec3(std::max(amax.x, bmax.x), std::max(amax.y, bmax.y), std::max(amax.z, bmax.z))
+    );
+}
+
+static float surface_area(const AABB& box) {
+    float w = box.width();
+    float h = box.height();
+    float d = box.depth();
+    return 2.0f * (w * h + h * d + d * w);
+}
+
+static bool contains(const AABB& outer, const AABB& inner) {
+    auto& omin = outer.min();
+    auto& omax = outer.max();
+    auto& imin = inner.min();
+    auto& imax = inner.max();
+
+    return (
+        omin.x <= imin.x && omin.y <= imin.y && omin.z <= imin.z &&
+        omax.x >= imax.x && omax.y >= imax.y && omax.z >= imax.z
+    );
+}
+
+AABBTree::AABBTree(float margin):
+    margin_(margin) {
+
+}
+
+AABB AABBTree::fatten(const AABB& box) const {
+    Vec3 margin(margin_, margin_, margin_);
+    return AABB(box.min() - margin, box.max() + margin);
+}
+
+uint32_t AABBTree::allocate_node() {
+    if(free_list_ == NULL_NODE) {
+        nodes_.push_back(Node());
+        return nodes_.size() - 1;
+    }
+
+    auto index = free_list_;
+    free_list_ = nodes_[index].parent;
+
+    nodes_[index] = Node();
+    return index;
+}
+
+void AABBTree::free_node(uint32_t node) {
+    nodes_[node].height = -1;
+    nodes_[node].user_data = nullptr;
+    nodes_[node].moved = false;
+    nodes_[node].parent = free_list_;
+    free_list_ = node;
+}
+
+AABBTree::ProxyID AABBTree::create_proxy(const AABB& box, void* user_data) {
+    auto proxy = allocate_node();
+
+    auto& node = nodes_[proxy];
+    node.box = box;
+    node.fat_box = fatten(box);
+    node.user_data = user_data;
+    node.height = 0;
+
+    insert_leaf(proxy);
+    ++proxy_count_;
+
+    return proxy;
+}
+
+void AABBTree::destroy_proxy(ProxyID proxy) {
+    assert(proxy < nodes_.size() && nodes_[proxy].is_leaf());
+
+    remove_leaf(proxy);
+    free_node(proxy);
+    --proxy_count_;
+}
+
+bool AABBTree::move_proxy(ProxyID proxy, const AABB& box) {
+    assert(proxy < nodes_.size() && nodes_[proxy].is_leaf());
+
+    auto& node = nodes_[proxy];
+    node.box = box;
+
+    if(contains(node.fat_box, box)) {
+        return false;
+    }
+
+    if(!node.fat_box.intersects_aabb(box)) {
+        // Moved somewhere else entirely, the leaf probably belongs elsewhere in the tree
+        remove_leaf(proxy);
+        node.fat_box = fatten(box);
+        insert_leaf(proxy);
+        return true;
+    }
+
+    node.fat_box = fatten(box);
+
+    if(!node.moved) {
+        node.moved = true;
+        moved_.push_back(proxy);
+    }
+
+    return true;
+}
+
+void AABBTree::refit() {
+    for(auto leaf: moved_) {
+        auto& node = nodes_[leaf];
+
+        // Removed (or removed and reused) since it moved
+        if(!node.is_leaf() || !node.moved) {
+            continue;
+        }
+
+        node.moved = false;
+
+        for(auto i = node.parent; i != NULL_NODE; i = nodes_[i].parent) {
+            auto& parent = nodes_[i];
+            auto box = merge(nodes_[parent.child1].fat_box, nodes_[parent.child2].fat_box);
+
+            // Anything further up was already updated by another leaf, or doesn't need to be
+            if(box.min() == parent.fat_box.min() && box.max() == parent.fat_box.max()) {
+                break;
+            }
+
+            parent.fat_box = box;
+        }
+    }
+
+    moved_.clear();
+}
+
+void AABBTree::update_from_children(uint32_t index) {
+    auto& node = nodes_[index];
+    auto& child1 = nodes_[node.child1];
+    auto& child2 = nodes_[node.child2];
+
+    node.height = 1 + std::max(child1.height, child2.height);
+    node.fat_box = merge(child1.fat_box, child2.fat_box);
+}
+
+void AABBTree::insert_leaf(uint32_t leaf) {
+    if(root_ == NULL_NODE) {
+        root_ = leaf;
+        nodes_[root_].parent = NULL_NODE;
+        return;
+    }
+
+    /* Walk down to the best sibling. The cost of a new parent is its surface area, plus
+     * the area that every ancestor grows by to fit the leaf (the inheritance cost) */
+    AABB leaf_box = nodes_[leaf].fat_box;
+    uint32_t index = root_;
+
+    while(!nodes_[index].is_leaf()) {
+        auto& node = nodes_[index];
+
+        float area = surface_area(node.fat_box);
+        float combined_area = surface_area(merge(node.fat_box, leaf_box));
+
+        // Making a new parent for this node and the leaf
+        float cost = 2.0f * combined_area;
+
+        // The minimum cost of pushing the leaf further down
+        float inheritance_cost = 2.0f * (combined_area - area);
+
+        auto child_cost = [&](uint32_t child) -> float {
+            auto& c = nodes_[child];
+            float merged = surface_area(merge(c.fat_box, leaf_box));
+            if(c.is_leaf()) {
+                return merged + inheritance_cost;
+            } else {
+                return (merged - surface_area(c.fat_box)) + inheritance_cost;
+            }
+        };
+
+        float cost1 = child_cost(node.child1);
+        float cost2 = child_cost(node.child2);
+
+        if(cost < cost1 && cost < cost2) {
+            break;
+        }
+
+        index = (cost1 < cost2) ? node.child1 : node.child2;
+    }
+
+    uint32_t sibling = index;
+
+    // allocate_node can reallocate nodes_, so no references are held across it
+    uint32_t old_parent = nodes_[sibling].parent;
+    uint32_t new_parent = allocate_node();
+
+    nodes_[new_parent].parent = old_parent;
+    nodes_[new_parent].fat_box = merge(leaf_box, nodes_[sibling].fat_box);
+    nodes_[new_parent].height = nodes_[sibling].height + 1;
+    nodes_[new_parent].child1 = sibling;
+    nodes_[new_parent].child2 = leaf;
+
+    nodes_[sibling].parent = new_parent;
+    nodes_[leaf].parent = new_parent;
+
+    if(old_parent == NULL_NODE) {
+        root_ = new_parent;
+    } else if(nodes_[old_parent].child1 == sibling) {
+        nodes_[old_parent].child1 = new_parent;
+    } else {
+        nodes_[old_parent].child2 = new_parent;
+    }
+
+    // Fix up the boxes and heights on the way back up, rebalancing as we go
+    index = nodes_[leaf].parent;
+    while(index != NULL_NODE) {
+        index = balance(index);
+        update_from_children(index);
+        index = nodes_[index].parent;
+    }
+}
+
+void AABBTree::remove_leaf(uint32_t leaf) {
+    if(leaf == root_) {
+        root_ = NULL_NODE;
+        return;
+    }
+
+    uint32_t parent = nodes_[leaf].parent;
+    uint32_t grand_parent = nodes_[parent].parent;
+    uint32_t sibling = (nodes_[parent].child1 == leaf) ? nodes_[parent].child2 : nodes_[parent].child1;
+
+    if(grand_parent == NULL_NODE) {
+        root_ = sibling;
+        nodes_[sibling].parent = NULL_NODE;
+        free_node(parent);
+        return;
+    }
+
+    // Replace the parent with the sibling
+    if(nodes_[grand_parent].child1 == parent) {
+        nodes_[grand_parent].child1 = sibling;
+    } else {
+        nodes_[grand_parent].child2 = sibling;
+    }
+
+    nodes_[sibling].parent = grand_parent;
+    free_node(parent);
+
+    uint32_t index = grand_parent;
+    while(index != NULL_NODE) {
+        index = balance(index);
+        update_from_children(index);
+        index = nodes_[index].parent;
+    }
+}
+
+uint32_t AABBTree::balance(uint32_t a_index) {
+    /*
+     * If one child of A is more than one level taller than the other, rotate the taller
+     * child (C) up into A's place. A takes the place of C's shorter child, and C's taller
+     * child stays where it is. Returns the node now in A's place.
+     *
+     *       A              C
+     *      / \            / \
+     *     B   C    =>    A   F
+     *        / \        / \
+     *       F   G      B   G
+     */
+
+    auto& a = nodes_[a_index];
+    if(a.is_leaf() || a.height < 2) {
+        return a_index;
+    }
+
+    auto rotate = [this](uint32_t a_index, uint32_t c_index, bool c_is_child1) -> uint32_t {
+        auto& a = nodes_[a_index];
+        auto& c = nodes_[c_index];
+
+        uint32_t f_index = c.child1;
+        uint32_t g_index = c.child2;
+
+        // C takes A's place
+        c.child1 = a_index;
+        c.parent = a.parent;
+        a.parent = c_index;
+
+        if(c.parent == NULL_NODE) {
+            root_ = c_index;
+        } else if(nodes_[c.parent].child1 == a_index) {
+            nodes_[c.parent].child1 = c_index;
+        } else {
+            nodes_[c.parent].child2 = c_index;
+        }
+
+        // The taller of C's children stays with C, the other goes to A
+        if(nodes_[f_index].height < nodes_[g_index].height) {
+            std::swap(f_index, g_index);
+        }
+
+        c.child2 = f_index;
+
+        if(c_is_child1) {
+            a.child1 = g_index;
+        } else {
+            a.child2 = g_index;
+        }
+
+        nodes_[g_index].parent = a_index;
+
+        update_from_children(a_index);
+        update_from_children(c_index);
+
+        return c_index;
+    };
+
+    uint32_t b_index = a.child1;
+    uint32_t c_index = a.child2;
+
+    int32_t difference = nodes_[c_index].height - nodes_[b_index].height;
+
+    if(difference > 1) {
+        return rotate(a_index, c_index, false);
+    } else if(difference < -1) {
+        return rotate(a_index, b_index, true);
+    }
+
+    return a_index;
+}
+
+bool AABBTree::ray_intersects(const Ray& ray, float max_distance, const AABB& box) {
+    float t1 = (box.min().x - ray.start.x) * ray.dir_inv.x;
+    float t2 = (box.max().x - ray.start.x) * ray.dir_inv.x;
+    float t3 = (box.min().y - ray.start.y) * ray.dir_inv.y;
+    float t4 = (box.max().y - ray.start.y) * ray.dir_inv.y;
+    float t5 = (box.min().z - ray.start.z) * ray.dir_inv.z;
+    float t6 = (box.max().z - ray.start.z) * ray.dir_inv.z;
+
+    float tmin = std::max(std::max(std::min(t1, t2), std::min(t3, t4)), std::min(t5, t6));
+    float tmax = std::min(std::min(std::max(t1, t2), std::max(t3, t4)), std::max(t5, t6));
+
+    return tmax >= 0 && tmin <= tmax && tmin <= max_distance;
+}
+
+bool AABBTree::validate() const {
+    if(!moved_.empty()) {
+        return false;
+    }
+
+    if(root_ == NULL_NODE) {
+        return proxy_count_ == 0;
+    }
+
+    if(nodes_[root_].parent != NULL_NODE) {
+        return false;
+    }
+
+    uint32_t leaves = 0;
+    for(auto& node: nodes_) {
+        if(node.is_leaf()) {
+            ++leaves;
+        }
+    }
+
+    return leaves == proxy_count_ && validate_node(root_);
+}
+
+bool AABBTree::validate_node(uint32_t index) const {
+    auto& node = nodes_[index];
+
+    if(node.is_leaf()) {
+        return contains(node.fat_box, node.box);
+    }
+
+    if(node.height < 1) {
+        return false;
+    }
+
+    auto& child1 = nodes_[node.child1];
+    auto& child2 = nodes_[node.child2];
+
+    if(child1.parent != index || child2.parent != index) {
+        return false;
+    }
+
+    if(node.height != 1 + std::max(child1.height, child2.height)) {
+        return false;
+    }
+
+    if(!contains(node.fat_box, child1.fat_box) || !contains(node.fat_box, child2.fat_box)) {
+        return false;
+    }
+
+    return validate_node(node.child1) && validate_node(node.child2);
+}
+
+}
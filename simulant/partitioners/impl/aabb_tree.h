@@ -0,0 +1,229 @@
+#pragma once
+
+#include <cassert>
+#include <cstdint>
+#include <vector>
+
+#include "../../types.h"
+#include "../../frustum.h"
+
+/*
+ * Dynamic AABB tree
+ *
+ * A binary tree of bounding boxes built incrementally, like the broadphase trees used by
+ * physics engines. Each leaf stores a "fat" box (the object's box grown by a margin) so
+ * that objects can move a little without touching the tree at all.
+ *
+ * New leaves are placed next to the sibling which increases the total surface area of
+ * the tree the least, and the tree is kept balanced with rotations as leaves are
+ * inserted and removed.
+ *
+ * Moves which leave the fat box but don't go far are batched: the leaf grows in place
+ * and its ancestors are updated by refit(), which must be called before the next query.
+ * Moves which leave the fat box entirely reinsert the leaf.
+ */
+
+namespace smlt {
+
+class AABBTree {
+public:
+    typedef uint32_t ProxyID;
+    const static ProxyID NULL_PROXY = ~0u;
+
+    AABBTree(float margin=0.5f);
+
+    ProxyID create_proxy(const AABB& box, void* user_data);
+    void destroy_proxy(ProxyID proxy);
+
+    /* Returns true if the leaf had to grow or move */
+    bool move_proxy(ProxyID proxy, const AABB& box);
+
+    /* Updates the ancestors of the leaves that grew since the last refit */
+    void refit();
+
+    void* user_data(ProxyID proxy) const {
+        assert(proxy < nodes_.size() && nodes_[proxy].is_leaf());
+        return nodes_[proxy].user_data;
+    }
+
+    const AABB& box(ProxyID proxy) const {
+        assert(proxy < nodes_.size() && nodes_[proxy].is_leaf());
+        return nodes_[proxy].box;
+    }
+
+    const AABB& fat_box(ProxyID proxy) const {
+        assert(proxy < nodes_.size() && nodes_[proxy].is_leaf());
+        return nodes_[proxy].fat_box;
+    }
+
+    uint32_t proxy_count() const { return proxy_count_; }
+
+    /* 0 for an empty tree, 1 for a single leaf */
+    uint32_t height() const {
+        return (root_ == NULL_NODE) ? 0 : nodes_[root_].height + 1;
+    }
+
+    /* Checks the structure of the tree, for tests */
+    bool validate() const;
+
+    /* Each of these calls callback(proxy) for every proxy whose box touches the query */
+    template<typename Callback>
+    void query_box(const AABB& box, Callback callback) const;
+
+    template<typename Callback>
+    void query_frustum(const Frustum& frustum, Callback callback) const;
+
+    template<typename Callback>
+    void query_ray(const Ray& ray, float max_distance, Callback callback) const;
+
+private:
+    const static uint32_t NULL_NODE = ~0u;
+    const static uint32_t MAX_STACK_SIZE = 256;
+
+    struct Node {
+        AABB fat_box;
+
+        /* The actual bounds, only used by leaves */
+        AABB box;
+        void* user_data = nullptr;
+
+        /* The next free node when the node isn't in use */
+        uint32_t parent = NULL_NODE;
+        uint32_t child1 = NULL_NODE;
+        uint32_t child2 = NULL_NODE;
+
+        /* 0 for leaves, -1 for free nodes */
+        int32_t height = -1;
+
+        /* Waiting for refit() */
+        bool moved = false;
+
+        bool is_leaf() const { return height == 0; }
+    };
+
+    uint32_t allocate_node();
+    void free_node(uint32_t node);
+
+    void insert_leaf(uint32_t leaf);
+    void remove_leaf(uint32_t leaf);
+
+    uint32_t balance(uint32_t node);
+    void update_from_children(uint32_t node);
+
+    AABB fatten(const AABB& box) const;
+
+    bool validate_node(uint32_t node) const;
+
+    static bool ray_intersects(const Ray& ray, float max_distance, const AABB& box);
+
+    std::vector<Node> nodes_;
+    uint32_t root_ = NULL_NODE;
+    uint32_t free_list_ = NULL_NODE;
+    uint32_t proxy_count_ = 0;
+
+    float margin_;
+
+    std::vector<uint32_t> moved_;
+};
+
+template<typename Callback>
+void AABBTree::query_box(const AABB& box, Callback callback) const {
+    assert(moved_.empty() && "refit() must be called before querying");
+
+    if(root_ == NULL_NODE) {
+        return;
+    }
+
+    uint32_t stack[MAX_STACK_SIZE];
+    uint32_t count = 0;
+    stack[count++] = root_;
+
+    while(count) {
+        auto& node = nodes_[stack[--count]];
+        if(!node.fat_box.intersects_aabb(box)) {
+            continue;
+        }
+
+        if(node.is_leaf()) {
+            if(node.box.intersects_aabb(box)) {
+                callback(ProxyID(&node - &nodes_[0]));
+            }
+        } else {
+            assert(count + 2 <= MAX_STACK_SIZE);
+            stack[count++] = node.child1;
+            stack[count++] = node.child2;
+        }
+    }
+}
+
+template<typename Callback>
+void AABBTree::query_frustum(const Frustum& frustum, Callback callback) const {
+    assert(moved_.empty() && "refit() must be called before querying");
+
+    if(root_ == NULL_NODE) {
+        return;
+    }
+
+    /* The top bit marks nodes which are entirely inside the frustum, everything
+     * below them is visible without any more plane tests */
+    const uint32_t INSIDE = 1u << 31;
+
+    uint32_t stack[MAX_STACK_SIZE];
+    uint32_t count = 0;
+    stack[count++] = root_;
+
+    while(count) {
+        auto item = stack[--count];
+        auto& node = nodes_[item & ~INSIDE];
+
+        auto classification = (item & INSIDE) ? FRUSTUM_CONTAINS_ALL : frustum.classify_aabb(node.fat_box);
+
+        if(classification == FRUSTUM_CONTAINS_NONE) {
+            continue;
+        }
+
+        if(node.is_leaf()) {
+            if(classification == FRUSTUM_CONTAINS_ALL || frustum.intersects_aabb(node.box)) {
+                callback(ProxyID(item & ~INSIDE));
+            }
+        } else {
+            uint32_t flag = (classification == FRUSTUM_CONTAINS_ALL) ? INSIDE : 0;
+
+            assert(count + 2 <= MAX_STACK_SIZE);
+            stack[count++] = node.child1 | flag;
+            stack[count++] = node.child2 | flag;
+        }
+    }
+}
+
+template<typename Callback>
+void AABBTree::query_ray(const Ray& ray, float max_distance, Callback callback) const {
+    assert(moved_.empty() && "refit() must be called before querying");
+
+    if(root_ == NULL_NODE) {
+        return;
+    }
+
+    uint32_t stack[MAX_STACK_SIZE];
+    uint32_t count = 0;
+    stack[count++] = root_;
+
+    while(count) {
+        auto& node = nodes_[stack[--count]];
+        if(!ray_intersects(ray, max_distance, node.fat_box)) {
+            continue;
+        }
+
+        if(node.is_leaf()) {
+            if(ray_intersects(ray, max_distance, node.box)) {
+                callback(ProxyID(&node - &nodes_[0]));
+            }
+        } else {
+            assert(count + 2 <= MAX_STACK_SIZE);
+            stack[count++] = node.child1;
+            stack[count++] = node.child2;
+        }
+    }
+}
+
+}
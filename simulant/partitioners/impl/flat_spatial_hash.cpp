@@ -0,0 +1,434 @@
+#include <cmath>
+#include <algorithm>
+
+#include "../../frustum.h"
+#include "flat_spatial_hash.h"
+
+namespace smlt {
+
+/* Cell coordinates are biased into 21 bits for the Morton code */
+static const int32_t MAX_CELL_COORDINATE = (1 << 20) - 1;
+
+static uint64_t split_by_3(uint32_t value) {
+    uint64_t x = value & 0x1FFFFF;
+    x = (x | x << 32) & 0x1F00000000FFFFull;
+    x = (x | x << 16) & 0x1F0000FF0000FFull;
+    x = (x | x << 8) & 0x100F00F00F00F00Full;
+    x = (x | x << 4) & 0x10C30C30C30C30C3ull;
+    x = (x | x << 2) & 0x1249249249249249ull;
+    return x;
+}
+
+static uint32_t home_slot(uint64_t code, uint32_t shift) {
+    // Fibonacci hashing, Morton codes of neighbouring cells are very similar
+    return uint32_t((code * 0x9E3779B97F4A7C15ull) >> shift);
+}
+
+static int32_t cell_coordinate(float value, int32_t cell_size) {
+    int32_t cell = int32_t(std::floor(value / cell_size));
+    return std::max(-MAX_CELL_COORDINATE, std::min(cell, MAX_CELL_COORDINATE));
+}
+
+FlatSpatialHash::FlatSpatialHash() {
+
+}
+
+uint64_t FlatSpatialHash::morton_code(int32_t x, int32_t y, int32_t z) {
+    return (
+        split_by_3(uint32_t(x + MAX_CELL_COORDINATE)) |
+        (split_by_3(uint32_t(y + MAX_CELL_COORDINATE)) << 1) |
+        (split_by_3(uint32_t(z + MAX_CELL_COORDINATE)) << 2)
+    );
+}
+
+uint32_t FlatSpatialHash::level_for_box(const AABB& box) {
+    // Same sizing as SpatialHash::find_cell_size_for_box
+    auto maxd = box.max_dimension();
+    if(maxd < 1.0f) {
+        return 0;
+    }
+
+    uint32_t level = uint32_t(std::ceil(::log2(maxd)));
+    if(float(1u << std::min(level, 31u)) < maxd) {
+        // Rounding in log2, the cells must be at least as big as the box
+        ++level;
+    }
+
+    return (level < MAX_GRID_LEVELS) ? level : OVERSIZED_LEVEL;
+}
+
+FlatSpatialHash::CellRange FlatSpatialHash::cell_range(uint32_t level, const AABB& box) {
+    int32_t cell_size = 1 << level;
+
+    auto& min = box.min();
+    auto& max = box.max();
+
+    CellRange range;
+    range.min[0] = cell_coordinate(min.x, cell_size);
+    range.min[1] = cell_coordinate(min.y, cell_size);
+    range.min[2] = cell_coordinate(min.z, cell_size);
+    range.max[0] = cell_coordinate(max.x, cell_size);
+    range.max[1] = cell_coordinate(max.y, cell_size);
+    range.max[2] = cell_coordinate(max.z, cell_size);
+    return range;
+}
+
+uint32_t FlatSpatialHash::find_slot(const Level& level, uint64_t code) const {
+    if(level.slots.empty()) {
+        return NO_INDEX;
+    }
+
+    uint32_t mask = level.slots.size() - 1;
+    uint32_t i = home_slot(code, level.shift);
+
+    while(true) {
+        auto& slot = level.slots[i];
+        if(slot.code == code) {
+            return i;
+        } else if(slot.code == EMPTY_CODE) {
+            return NO_INDEX;
+        }
+
+        i = (i + 1) & mask;
+    }
+}
+
+uint32_t* FlatSpatialHash::find_or_insert_head(uint32_t level, uint64_t code) {
+    auto& l = levels_[level];
+
+    // Keep the load factor under 3/4
+    if((l.used + 1) * 4 > l.slots.size() * 3) {
+        grow(l);
+    }
+
+    uint32_t mask = l.slots.size() - 1;
+    uint32_t i = home_slot(code, l.shift);
+
+    while(true) {
+        auto& slot = l.slots[i];
+        if(slot.code == code) {
+            return &slot.head;
+        } else if(slot.code == EMPTY_CODE) {
+            slot.code = code;
+            slot.head = NO_INDEX;
+            l.used++;
+            return &slot.head;
+        }
+
+        i = (i + 1) & mask;
+    }
+}
+
+void FlatSpatialHash::grow(Level& level) {
+    std::vector<Slot> old;
+    old.swap(level.slots);
+
+    uint32_t size = std::max<uint32_t>(16, old.size() * 2);
+
+    Slot empty;
+    empty.code = EMPTY_CODE;
+    empty.head = NO_INDEX;
+    level.slots.assign(size, empty);
+
+    level.shift = 64 - uint32_t(::log2(size));
+
+    uint32_t mask = size - 1;
+    for(auto& slot: old) {
+        if(slot.code == EMPTY_CODE) {
+            continue;
+        }
+
+        uint32_t i = home_slot(slot.code, level.shift);
+        while(level.slots[i].code != EMPTY_CODE) {
+            i = (i + 1) & mask;
+        }
+
+        level.slots[i] = slot;
+    }
+}
+
+void FlatSpatialHash::erase_slot(Level& level, uint32_t slot) {
+    /* Backward shift deletion, so lookups never need tombstones. Anything after
+     * the hole that could live in it (or before it) moves back to fill it */
+    uint32_t mask = level.slots.size() - 1;
+    uint32_t i = slot;
+    uint32_t j = slot;
+
+    while(true) {
+        j = (j + 1) & mask;
+        if(level.slots[j].code == EMPTY_CODE) {
+            break;
+        }
+
+        uint32_t k = home_slot(level.slots[j].code, level.shift);
+
+        // Leave it where it is if its home slot is cyclically in (i, j]
+        bool in_range = (i <= j) ? (i < k && k <= j) : (i < k || k <= j);
+        if(in_range) {
+            continue;
+        }
+
+        level.slots[i] = level.slots[j];
+        i = j;
+    }
+
+    level.slots[i].code = EMPTY_CODE;
+    level.slots[i].head = NO_INDEX;
+    level.used--;
+}
+
+uint32_t FlatSpatialHash::new_link() {
+    if(!free_links_.empty()) {
+        auto index = free_links_.back();
+        free_links_.pop_back();
+        return index;
+    }
+
+    links_.push_back(Link());
+    return links_.size() - 1;
+}
+
+void FlatSpatialHash::link_record(uint32_t record_index) {
+    auto& record = records_[record_index];
+
+    if(record.level == OVERSIZED_LEVEL) {
+        record.link_count = 0;
+        oversized_.push_back(record_index);
+        return;
+    }
+
+    auto range = cell_range(record.level, record.box);
+    assert(range.count() <= MAX_CELLS_PER_ENTRY);
+
+    record.link_count = 0;
+    for(int32_t x = range.min[0]; x <= range.max[0]; ++x) {
+        for(int32_t y = range.min[1]; y <= range.max[1]; ++y) {
+            for(int32_t z = range.min[2]; z <= range.max[2]; ++z) {
+                auto code = morton_code(x, y, z);
+                auto link_index = new_link();
+                uint32_t* head = find_or_insert_head(record.level, code);
+
+                auto& link = links_[link_index];
+                link.code = code;
+                link.record = record_index;
+                link.prev = NO_INDEX;
+                link.next = *head;
+
+                if(*head != NO_INDEX) {
+                    links_[*head].prev = link_index;
+                }
+
+                *head = link_index;
+                record.links[record.link_count++] = link_index;
+            }
+        }
+    }
+}
+
+void FlatSpatialHash::unlink_record(uint32_t record_index) {
+    auto& record = records_[record_index];
+
+    if(record.level == OVERSIZED_LEVEL) {
+        auto it = std::find(oversized_.begin(), oversized_.end(), record_index);
+        assert(it != oversized_.end());
+        *it = oversized_.back();
+        oversized_.pop_back();
+        return;
+    }
+
+    auto& level = levels_[record.level];
+
+    for(uint32_t i = 0; i < record.link_count; ++i) {
+        auto link_index = record.links[i];
+        auto& link = links_[link_index];
+
+        if(link.next != NO_INDEX) {
+            links_[link.next].prev = link.prev;
+        }
+
+        if(link.prev != NO_INDEX) {
+            links_[link.prev].next = link.next;
+        } else {
+            // This was the head of the cell's list
+            auto slot = find_slot(level, link.code);
+            assert(slot != NO_INDEX);
+
+            if(link.next == NO_INDEX) {
+                erase_slot(level, slot);
+            } else {
+                level.slots[slot].head = link.next;
+            }
+        }
+
+        free_links_.push_back(link_index);
+    }
+
+    record.link_count = 0;
+}
+
+void FlatSpatialHash::insert_object_for_box(const AABB& box, SpatialHashEntry* object) {
+    if(object->flat_index_ != NO_INDEX) {
+        update_object_for_box(box, object);
+        return;
+    }
+
+    uint32_t index;
+    if(!free_records_.empty()) {
+        index = free_records_.back();
+        free_records_.pop_back();
+    } else {
+        index = records_.size();
+        records_.push_back(Record());
+    }
+
+    auto& record = records_[index];
+    record.object = object;
+    record.box = box;
+    record.level = level_for_box(box);
+
+    link_record(index);
+
+    object->flat_index_ = index;
+    object->set_hash_aabb(box);
+}
+
+void FlatSpatialHash::remove_object(SpatialHashEntry* object) {
+    auto index = object->flat_index_;
+    if(index == NO_INDEX) {
+        return;
+    }
+
+    unlink_record(index);
+
+    records_[index].object = nullptr;
+    free_records_.push_back(index);
+
+    object->flat_index_ = NO_INDEX;
+}
+
+void FlatSpatialHash::update_object_for_box(const AABB& new_box, SpatialHashEntry* object) {
+    auto index = object->flat_index_;
+    if(index == NO_INDEX) {
+        insert_object_for_box(new_box, object);
+        return;
+    }
+
+    auto& record = records_[index];
+    auto level = level_for_box(new_box);
+
+    object->set_hash_aabb(new_box);
+
+    /* Most moves stay within the same cells, in which case only the bounds change */
+    if(level == record.level && level != OVERSIZED_LEVEL) {
+        auto old_range = cell_range(level, record.box);
+        auto new_range = cell_range(level, new_box);
+
+        if(std::equal(old_range.min, old_range.min + 3, new_range.min) &&
+           std::equal(old_range.max, old_range.max + 3, new_range.max)) {
+            record.box = new_box;
+            return;
+        }
+    }
+
+    unlink_record(index);
+    record.box = new_box;
+    record.level = level;
+    link_record(index);
+}
+
+template<typename Callback>
+void FlatSpatialHash::each_candidate(const AABB& box, Callback callback) const {
+    for(uint32_t l = 0; l < MAX_GRID_LEVELS; ++l) {
+        auto& level = levels_[l];
+        if(!level.used) {
+            continue;
+        }
+
+        auto range = cell_range(l, box);
+
+        if(range.count() <= level.used) {
+            for(int32_t x = range.min[0]; x <= range.max[0]; ++x) {
+                for(int32_t y = range.min[1]; y <= range.max[1]; ++y) {
+                    for(int32_t z = range.min[2]; z <= range.max[2]; ++z) {
+                        auto slot = find_slot(level, morton_code(x, y, z));
+                        if(slot == NO_INDEX) {
+                            continue;
+                        }
+
+                        for(auto i = level.slots[slot].head; i != NO_INDEX; i = links_[i].next) {
+                            callback(links_[i].record);
+                        }
+                    }
+                }
+            }
+        } else {
+            // The box covers more cells than are occupied, so just visit everything
+            for(auto& slot: level.slots) {
+                if(slot.code == EMPTY_CODE) {
+                    continue;
+                }
+
+                for(auto i = slot.head; i != NO_INDEX; i = links_[i].next) {
+                    callback(links_[i].record);
+                }
+            }
+        }
+    }
+
+    for(auto index: oversized_) {
+        callback(index);
+    }
+}
+
+HGSHResultList FlatSpatialHash::find_objects_within_box(const AABB& box, FrameArena* arena) {
+    FrameAllocator<SpatialHashEntry*> allocator(arena);
+    HGSHResultList objects(allocator);
+
+    // Objects spanning several cells are visited more than once, the set takes care of that
+    each_candidate(box, [&](uint32_t index) {
+        auto& record = records_[index];
+        if(record.box.intersects_aabb(box)) {
+            objects.insert(record.object);
+        }
+    });
+
+    return objects;
+}
+
+HGSHResultList FlatSpatialHash::find_objects_within_frustum(const Frustum& frustum, FrameArena* arena) {
+    generate_boxes_for_frustum(frustum, frustum_boxes_);
+
+    FrameAllocator<SpatialHashEntry*> allocator(arena);
+    HGSHResultList results(allocator);
+
+    if(++query_stamp_ == 0) {
+        // Wrapped around, clear the old stamps so nothing is skipped by mistake
+        for(auto& record: records_) {
+            if(record.object) {
+                record.object->query_stamp_ = 0;
+            }
+        }
+
+        query_stamp_ = 1;
+    }
+
+    for(auto& box: frustum_boxes_) {
+        each_candidate(box, [&](uint32_t index) {
+            auto& record = records_[index];
+            if(record.object->query_stamp_ == query_stamp_) {
+                return;
+            }
+
+            // Tested against the frustum rather than the box, so one visit is enough
+            record.object->query_stamp_ = query_stamp_;
+
+            if(frustum.intersects_aabb(record.box)) {
+                results.insert(record.object);
+            }
+        });
+    }
+
+    return results;
+}
+
+}
@@ -0,0 +1,116 @@
+#pragma once
+
+#include <cstdint>
+#include <vector>
+
+#include "spatial_hash.h"
+
+/*
+ * Flat hierarchical grid
+ *
+ * An alternative to the SpatialHash with the same interface. There's one grid per
+ * power-of-two cell size (like the levels of the SpatialHash) but each grid is an
+ * open-addressed hash table keyed by the Morton code of the cell, rather than a
+ * std::map of 16-level keys. Each cell holds an intrusive linked list of links into
+ * a flat array of entries, so inserting, moving and removing objects doesn't touch
+ * the heap once the arrays have grown.
+ *
+ * An object goes in the level whose cells are at least as big as the object, so it
+ * always overlaps at most 8 cells.
+ */
+
+namespace smlt {
+
+class FlatSpatialHash : public SpatialIndex {
+public:
+    FlatSpatialHash();
+
+    void insert_object_for_box(const AABB& box, SpatialHashEntry* object) override;
+    void remove_object(SpatialHashEntry* object) override;
+
+    void update_object_for_box(const AABB& new_box, SpatialHashEntry* object) override;
+
+    HGSHResultList find_objects_within_box(const AABB& box, FrameArena* arena=nullptr) override;
+    HGSHResultList find_objects_within_frustum(const Frustum& frustum, FrameArena* arena=nullptr) override;
+
+    uint32_t entry_count() const { return records_.size() - free_records_.size(); }
+
+    /* Packs the cell coordinates into a 63-bit Morton code */
+    static uint64_t morton_code(int32_t x, int32_t y, int32_t z);
+
+private:
+    const static uint32_t NO_INDEX = ~0u;
+    const static uint64_t EMPTY_CODE = ~0ull;
+    const static uint32_t MAX_CELLS_PER_ENTRY = 8;
+
+    /* Objects too big for the largest level are kept in a list which every query checks */
+    const static uint32_t OVERSIZED_LEVEL = MAX_GRID_LEVELS;
+
+    struct Link {
+        uint64_t code;
+        uint32_t record;
+        uint32_t prev;
+        uint32_t next;
+    };
+
+    struct Record {
+        SpatialHashEntry* object = nullptr;
+        AABB box;
+        uint32_t level = 0;
+        uint32_t link_count = 0;
+        uint32_t links[MAX_CELLS_PER_ENTRY];
+    };
+
+    struct Slot {
+        uint64_t code;
+        uint32_t head;
+    };
+
+    struct Level {
+        std::vector<Slot> slots;
+        uint32_t used = 0;
+        uint32_t shift = 64;
+    };
+
+    struct CellRange {
+        int32_t min[3];
+        int32_t max[3];
+
+        uint64_t count() const {
+            return uint64_t(max[0] - min[0] + 1) * uint64_t(max[1] - min[1] + 1) * uint64_t(max[2] - min[2] + 1);
+        }
+    };
+
+    static uint32_t level_for_box(const AABB& box);
+    static CellRange cell_range(uint32_t level, const AABB& box);
+
+    uint32_t find_slot(const Level& level, uint64_t code) const;
+    uint32_t* find_or_insert_head(uint32_t level, uint64_t code);
+    void erase_slot(Level& level, uint32_t slot);
+    void grow(Level& level);
+
+    void link_record(uint32_t record_index);
+    void unlink_record(uint32_t record_index);
+
+    uint32_t new_link();
+
+    template<typename Callback>
+    void each_candidate(const AABB& box, Callback callback) const;
+
+    Level levels_[MAX_GRID_LEVELS];
+
+    std::vector<Record> records_;
+    std::vector<uint32_t> free_records_;
+
+    std::vector<Link> links_;
+    std::vector<uint32_t> free_links_;
+
+    std::vector<uint32_t> oversized_;
+
+    uint32_t query_stamp_ = 0;
+
+    /* Reused by every frustum query so they don't allocate */
+    std::vector<AABB> frustum_boxes_;
+};
+
+}
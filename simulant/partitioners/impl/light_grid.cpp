@@ -0,0 +1,107 @@
+
+#include <cmath>
+#include <algorithm>
+
+#include "light_grid.h"
+
+namespace smlt {
+
+int32_t LightGrid::cell_size_for_dimension(float dimension) {
+    // Same sizing as SpatialHash::find_cell_size_for_box, capped to the top grid level
+    if(dimension < 1.0f) {
+        return 1;
+    }
+
+    uint32_t power = std::min(uint32_t(std::ceil(::log2(dimension))), MAX_GRID_LEVELS - 1);
+    return 1 << power;
+}
+
+void LightGrid::reset(int32_t cell_size) {
+    assert(cell_size > 0);
+
+    cell_size_ = cell_size;
+    light_count_ = 0;
+
+    // Keep the capacity, this is done every frame
+    entries_.clear();
+    oversized_.clear();
+}
+
+uint64_t LightGrid::pack(const Hash& hash) {
+    return (uint64_t(uint16_t(hash.x)) << 32) | (uint64_t(uint16_t(hash.y)) << 16) | uint64_t(uint16_t(hash.z));
+}
+
+uint64_t LightGrid::cell_count(const Hash& min, const Hash& max) const {
+    return uint64_t(max.x - min.x + 1) * uint64_t(max.y - min.y + 1) * uint64_t(max.z - min.z + 1);
+}
+
+void LightGrid::insert(uint32_t light_index, const AABB& bounds) {
+    light_count_ = std::max(light_count_, light_index + 1);
+
+    auto& min = bounds.min();
+    auto& max = bounds.max();
+
+    auto lo = make_hash(cell_size_, min.x, min.y, min.z);
+    auto hi = make_hash(cell_size_, max.x, max.y, max.z);
+
+    if(cell_count(lo, hi) > MAX_CELLS_PER_BOX) {
+        oversized_.push_back(light_index);
+        return;
+    }
+
+    for(int32_t x = lo.x; x <= hi.x; ++x) {
+        for(int32_t y = lo.y; y <= hi.y; ++y) {
+            for(int32_t z = lo.z; z <= hi.z; ++z) {
+                CellEntry entry;
+                entry.cell = pack(Hash(x, y, z));
+                entry.light_index = light_index;
+                entries_.push_back(entry);
+            }
+        }
+    }
+}
+
+void LightGrid::finalize() {
+    std::sort(entries_.begin(), entries_.end());
+}
+
+void LightGrid::candidates_for_box(const AABB& box, std::vector<uint32_t>& out) const {
+    auto start = out.size();
+
+    auto& min = box.min();
+    auto& max = box.max();
+
+    auto lo = make_hash(cell_size_, min.x, min.y, min.z);
+    auto hi = make_hash(cell_size_, max.x, max.y, max.z);
+
+    if(cell_count(lo, hi) > MAX_CELLS_PER_BOX) {
+        // Cheaper to let the caller test everything
+        for(uint32_t i = 0; i < light_count_; ++i) {
+            out.push_back(i);
+        }
+        return;
+    }
+
+    out.insert(out.end(), oversized_.begin(), oversized_.end());
+
+    for(int32_t x = lo.x; x <= hi.x; ++x) {
+        for(int32_t y = lo.y; y <= hi.y; ++y) {
+            for(int32_t z = lo.z; z <= hi.z; ++z) {
+                CellEntry search;
+                search.cell = pack(Hash(x, y, z));
+                search.light_index = 0;
+
+                auto it = std::lower_bound(entries_.begin(), entries_.end(), search);
+                for(; it != entries_.end() && it->cell == search.cell; ++it) {
+                    out.push_back(it->light_index);
+                }
+            }
+        }
+    }
+
+    // A light spanning several cells will have been found more than once
+    std::sort(out.begin() + start, out.end());
+    out.erase(std::unique(out.begin() + start, out.end()), out.end());
+}
+
+}
@@ -0,0 +1,69 @@
+#pragma once
+
+#include <cstdint>
+#include <vector>
+
+#include "../../types.h"
+#include "spatial_hash.h"
+
+/*
+ * A uniform world-space grid of lights, rebuilt once per camera each frame.
+ *
+ * Rather than testing every visible light against every visible node, lights
+ * are bucketed into the cells (using the same make_hash as the SpatialHash)
+ * which their bounds overlap. A node then only needs to test the lights found
+ * in the cells that its own bounds overlap. The results are conservative, callers
+ * are still expected to run their exact intersection test on the candidates.
+ *
+ * The grid works on light indexes and bounds only, so it doesn't need a stage.
+ */
+
+namespace smlt {
+
+class LightGrid {
+public:
+    /* Lights or query boxes which overlap more cells than this are treated as
+     * overlapping everything, rather than walking a huge number of cells */
+    const static uint32_t MAX_CELLS_PER_BOX = 64;
+
+    /* Returns a power-of-two cell size that suits lights of the given size */
+    static int32_t cell_size_for_dimension(float dimension);
+
+    /* Empties the grid, ready for inserting the lights for a new frame */
+    void reset(int32_t cell_size);
+
+    void insert(uint32_t light_index, const AABB& bounds);
+
+    /* Must be called after inserting the lights and before querying */
+    void finalize();
+
+    /* Appends the (sorted, unique) indexes of the lights which might affect the box */
+    void candidates_for_box(const AABB& box, std::vector<uint32_t>& out) const;
+
+    int32_t cell_size() const { return cell_size_; }
+    uint32_t light_count() const { return light_count_; }
+
+private:
+    struct CellEntry {
+        uint64_t cell;
+        uint32_t light_index;
+
+        bool operator<(const CellEntry& rhs) const {
+            return cell < rhs.cell || (cell == rhs.cell && light_index < rhs.light_index);
+        }
+    };
+
+    static uint64_t pack(const Hash& hash);
+    uint64_t cell_count(const Hash& min, const Hash& max) const;
+
+    int32_t cell_size_ = 1;
+    uint32_t light_count_ = 0;
+
+    /* Sorted by cell, so each cell is a contiguous range */
+    std::vector<CellEntry> entries_;
+
+    /* Lights which cover too many cells to be worth bucketing */
+    std::vector<uint32_t> oversized_;
+};
+
+}
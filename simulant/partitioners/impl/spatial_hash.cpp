@@ -1,4 +1,6 @@
+#include <algorithm>
 #include <cmath>
+#include <iterator>
 #include "../../frustum.h"
 #include "spatial_hash.h"
 #include "../../utils/endian.h"
@@ -131,30 +133,115 @@ void generate_boxes_for_frustum(const Frustum& frustum, std::vector<AABB>& resul
     }
 }
 
-HGSHEntryList SpatialHash::find_objects_within_frustum(const Frustum &frustum) {
-    static std::vector<AABB> boxes; // Static to avoid repeated allocations
+static AABB cell_box(uint32_t level, const Hash& hash) {
+    float cell_size = float(1 << (MAX_GRID_LEVELS - 1 - level));
 
-    generate_boxes_for_frustum(frustum, boxes);
+    Vec3 min(hash.x * cell_size, hash.y * cell_size, hash.z * cell_size);
+    return AABB(min, min + Vec3(cell_size, cell_size, cell_size));
+}
+
+static bool same_hash(const Hash& lhs, const Hash& rhs) {
+    return lhs.x == rhs.x && lhs.y == rhs.y && lhs.z == rhs.z;
+}
+
+/* Returns a key which sorts after every descendant of key's cell at level,
+ * but before anything outside it */
+static Key subtree_end(const Key& key, uint32_t level) {
+    Key end;
+    // Every byte 0xFF, so unused levels compare after anything in the subtree
+    std::fill(std::begin(end.hash_path), std::end(end.hash_path), Hash(-1, -1, -1));
+    memcpy(end.hash_path, key.hash_path, sizeof(Hash) * (level + 1));
+    end.ancestors = MAX_GRID_LEVELS - 1;
+    return end;
+}
+
+uint32_t SpatialHash::next_query_stamp() {
+    if(++query_stamp_ == 0) {
+        // Wrapped around, clear the old stamps so nothing is skipped by mistake
+        for(auto& pair: index_) {
+            for(auto entry: pair.second) {
+                entry->query_stamp_ = 0;
+            }
+        }
+
+        query_stamp_ = 1;
+    }
+
+    return query_stamp_;
+}
+
+HGSHResultList SpatialHash::find_objects_within_frustum(const Frustum &frustum, FrameArena* arena) {
+    /*
+     * Walks the index in key order, which is depth-first through the cell tree. Each
+     * cell on the path to a key is classified against the frustum once. Cells
+     * entirely outside are skipped along with everything below them, and cells
+     * entirely inside accept everything below them without any more plane tests.
+     */
 
-    HGSHEntryList results;
+    FrameAllocator<SpatialHashEntry*> allocator(arena);
+    HGSHResultList results(allocator);
 
-    for(auto& box: boxes) {
-        for(auto& result: find_objects_within_box(box)) {
-            if(frustum.intersects_aabb(result->hash_aabb())) {
-                results.insert(result);
+    auto stamp = next_query_stamp();
+
+    // The cells on the current path, and their classifications, valid up to depth
+    Hash path[MAX_GRID_LEVELS];
+    FrustumClassification classifications[MAX_GRID_LEVELS];
+    int32_t depth = -1;
+
+    auto it = index_.begin();
+    while(it != index_.end()) {
+        const Key& key = it->first;
+        const int32_t key_level = key.ancestors;
+
+        // Find how much of the current path this key shares
+        int32_t shared = -1;
+        while(shared < depth && shared < key_level && same_hash(path[shared + 1], key.hash_path[shared + 1])) {
+            ++shared;
+        }
+
+        auto classification = (shared >= 0) ? classifications[shared] : FRUSTUM_CONTAINS_PARTIAL;
+
+        int32_t level = shared;
+        while(level < key_level && classification == FRUSTUM_CONTAINS_PARTIAL) {
+            ++level;
+            path[level] = key.hash_path[level];
+            classification = frustum.classify_aabb(cell_box(level, path[level]));
+            classifications[level] = classification;
+        }
+
+        depth = level;
+
+        if(classification == FRUSTUM_CONTAINS_NONE) {
+            it = index_.upper_bound(subtree_end(key, level));
+            continue;
+        }
+
+        for(auto entry: it->second) {
+            if(entry->query_stamp_ == stamp) {
+                continue;
+            }
+
+            // If the entry isn't visible from this cell it's not visible from any of them
+            entry->query_stamp_ = stamp;
+
+            if(classification == FRUSTUM_CONTAINS_ALL || frustum.intersects_aabb(entry->hash_aabb())) {
+                results.insert(entry);
             }
         }
+
+        ++it;
     }
 
     return results;
 }
 
-HGSHEntryList SpatialHash::find_objects_within_box(const AABB &box) {
-    HGSHEntryList objects;
+HGSHResultList SpatialHash::find_objects_within_box(const AABB &box, FrameArena* arena) {
+    FrameAllocator<SpatialHashEntry*> allocator(arena);
+    HGSHResultList objects(allocator);
 
     auto cell_size = find_cell_size_for_box(box);
 
-    auto gather_objects = [](Index& index, const Key& key, HGSHEntryList& objects) {
+    auto gather_objects = [](Index& index, const Key& key, HGSHResultList& objects) {
         auto it = index.lower_bound(key);
         if(it == index.end()) {
             return;
@@ -178,7 +265,8 @@ HGSHEntryList SpatialHash::find_objects_within_box(const AABB &box) {
         }
     };
 
-    KeyList seen;
+    FrameAllocator<Key> key_allocator(arena);
+    FrameUnorderedSet<Key> seen(key_allocator);
 
     for(auto& corner: box.corners()) {
         auto key = make_key(
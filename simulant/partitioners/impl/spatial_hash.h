@@ -6,6 +6,7 @@
 #include <ostream>
 #include <unordered_set>
 #include "../../interfaces.h"
+#include "../../generic/frame_arena.h"
 
 /*
  * Hierarchical Grid Spatial Hash implementation
@@ -111,34 +112,69 @@ public:
 
     const AABB& hash_aabb() const { return hash_aabb_; }
 private:
+    friend class SpatialHash;
+    friend class FlatSpatialHash;
+
     KeyList keys_;
     AABB hash_aabb_;
+
+    /* The last frustum query that visited this entry, entries live in up to 8 cells
+     * and this stops them being tested (and emitted) more than once per query */
+    uint32_t query_stamp_ = 0;
+
+    /* Slot in the FlatSpatialHash entry array, unused by SpatialHash */
+    uint32_t flat_index_ = ~0u;
 };
 
 typedef std::unordered_set<SpatialHashEntry*> HGSHEntryList;
 
-class SpatialHash {
+/* Query results, these are allocated from the arena (if one is passed) so they must
+ * not be kept beyond the end of the frame */
+typedef FrameUnorderedSet<SpatialHashEntry*> HGSHResultList;
+
+/*
+ * The interface shared by the SpatialHash and the FlatSpatialHash, so the
+ * SpatialHashPartitioner can use either
+ */
+class SpatialIndex {
+public:
+    virtual ~SpatialIndex() {}
+
+    virtual void insert_object_for_box(const AABB& box, SpatialHashEntry* object) = 0;
+    virtual void remove_object(SpatialHashEntry* object) = 0;
+
+    virtual void update_object_for_box(const AABB& new_box, SpatialHashEntry* object) = 0;
+
+    virtual HGSHResultList find_objects_within_box(const AABB& box, FrameArena* arena=nullptr) = 0;
+    virtual HGSHResultList find_objects_within_frustum(const Frustum& frustum, FrameArena* arena=nullptr) = 0;
+};
+
+class SpatialHash : public SpatialIndex {
 public:
     SpatialHash();
 
-    void insert_object_for_box(const AABB& box, SpatialHashEntry* object);
-    void remove_object(SpatialHashEntry* object);
+    void insert_object_for_box(const AABB& box, SpatialHashEntry* object) override;
+    void remove_object(SpatialHashEntry* object) override;
 
-    void update_object_for_box(const AABB& new_box, SpatialHashEntry* object);
+    void update_object_for_box(const AABB& new_box, SpatialHashEntry* object) override;
 
-    HGSHEntryList find_objects_within_box(const AABB& box);
-    HGSHEntryList find_objects_within_frustum(const Frustum& frustum);
+    HGSHResultList find_objects_within_box(const AABB& box, FrameArena* arena=nullptr) override;
+    HGSHResultList find_objects_within_frustum(const Frustum& frustum, FrameArena* arena=nullptr) override;
 
     friend std::ostream &operator<<(std::ostream &os, const SpatialHash &hash);
 
 private:
     void erase_object_from_key(Key key, SpatialHashEntry* object);
 
+    uint32_t next_query_stamp();
+
     int32_t find_cell_size_for_box(const AABB& box) const;
     void insert_object_for_key(Key key, SpatialHashEntry* entry);
 
     typedef std::map<Key, std::unordered_set<SpatialHashEntry*>> Index;
     Index index_;
+
+    uint32_t query_stamp_ = 0;
 };
 
 std::ostream &operator<<(std::ostream &os, const SpatialHash &hash);
@@ -1,4 +1,5 @@
 #include "spatial_hash.h"
+#include "impl/flat_spatial_hash.h"
 #include "../nodes/actor.h"
 #include "../nodes/light.h"
 #include "../nodes/camera.h"
@@ -8,10 +9,14 @@
 
 namespace smlt {
 
-SpatialHashPartitioner::SpatialHashPartitioner(smlt::Stage *ss):
+SpatialHashPartitioner::SpatialHashPartitioner(smlt::Stage *ss, AvailablePartitioner type):
     Partitioner(ss) {
 
-    hash_ = new SpatialHash();
+    if(type == PARTITIONER_FLAT_HASH) {
+        hash_ = new FlatSpatialHash();
+    } else {
+        hash_ = new SpatialHash();
+    }
 }
 
 SpatialHashPartitioner::~SpatialHashPartitioner() {
@@ -162,7 +167,7 @@ void SpatialHashPartitioner::lights_and_geometry_visible_from(
     read_lock<shared_mutex> lock(lock_);
 
     auto frustum = stage->camera(camera_id)->frustum();
-    auto entries = hash_->find_objects_within_frustum(frustum);
+    auto entries = hash_->find_objects_within_frustum(frustum, stage->window->frame_arena.get());
 
     for(auto& entry: entries) {
         auto pentry = static_cast<PartitionerEntry*>(entry);
@@ -45,7 +45,9 @@ struct PartitionerEntry : public SpatialHashEntry {
 
 class SpatialHashPartitioner : public Partitioner {
 public:
-    SpatialHashPartitioner(Stage* ss);
+    /* type is PARTITIONER_HASH or PARTITIONER_FLAT_HASH, which picks between the
+     * SpatialHash and the FlatSpatialHash */
+    SpatialHashPartitioner(Stage* ss, AvailablePartitioner type=PARTITIONER_HASH);
     ~SpatialHashPartitioner();
 
     void lights_and_geometry_visible_from(
@@ -73,7 +75,7 @@ private:
 
     void apply_staged_write(const StagedWrite& write);
 
-    SpatialHash* hash_ = nullptr;
+    SpatialIndex* hash_ = nullptr;
 
     typedef std::shared_ptr<PartitionerEntry> PartitionerEntryPtr;
 
@@ -18,10 +18,14 @@
 //
 
 
+#include <vector>
+
 #include "sphere.h"
 #include "../../types.h"
 #include "../../resource_manager.h"
 #include "../../meshes/mesh.h"
+#include "../../vertex_data.h"
+#include "../../vertex_formats.h"
 
 namespace smlt {
 namespace procedural {
@@ -52,58 +56,85 @@ void generate_uv(const Vec3& pos, float& u, float& v) {
     }
 }
 
+static Vec4 to_vec4(const Vec2& value) { return Vec4(value.x, value.y, 0, 0); }
+static Vec4 to_vec4(const Vec3& value) { return Vec4(value, 0); }
+static Vec4 to_vec4(const Colour& value) { return Vec4(value.r, value.g, value.b, value.a); }
+
+/* Fills the attribute if the vertex data has it. Floats of the generator's size are assigned in one
+ * go, any other format is packed a vertex at a time */
+template<typename T>
+static void fill_attribute(VertexData* data, VertexAttributeBit attr, uint32_t first, const std::vector<T>& values) {
+    VertexAttribute type = data->specification().attribute(attr);
+    if(type == VERTEX_ATTRIBUTE_NONE || values.empty()) {
+        return;
+    }
+
+    if(vertex_attribute_is_float(type) && vertex_attribute_size(type) == sizeof(T)) {
+        data->attribute_span<T>(attr).subspan(first, values.size()).assign(&values[0], values.size());
+        return;
+    }
+
+    const uint32_t stride = data->stride();
+    uint8_t* out = data->data() + (first * stride) + data->specification().offset(attr);
+    for(auto& value: values) {
+        pack_vertex_attribute(type, to_vec4(value), out);
+        out += stride;
+    }
+}
+
 void sphere(MeshPtr mesh, float diameter, int32_t slices, int32_t stacks) {
     float theta, phi;
     float u, v;
-    Vec3 pos, n;
 
     const float radius = diameter / 2.0;
 
+    const uint32_t count = ((stacks - 2) * slices) + 2;
+
+    std::vector<Vec3> positions, normals;
+    std::vector<Vec2> uvs;
+
+    positions.reserve(count);
+    normals.reserve(count);
+    uvs.reserve(count);
+
+    auto add_vertex = [&](const Vec3& pos) {
+        generate_uv(pos, u, v);
+
+        positions.push_back(pos);
+        normals.push_back(pos.normalized());
+        uvs.push_back(Vec2(u, v));
+    };
+
     for(int32_t current_stack = 1; current_stack < stacks - 1; ++current_stack) {
         for(int32_t current_slice = 0; current_slice < slices; ++current_slice) {
             theta = float(current_stack) / (stacks - 1) * PI;
             phi = float(current_slice) / (slices - 1) * PI * 2.0;
 
-            pos = Vec3(
+            add_vertex(Vec3(
                sinf(theta) * cosf(phi) * radius,
                cosf(theta) * radius,
                -sinf(theta) * sinf(phi) * radius
-            );
-
-            n = pos.normalized();
-
-            generate_uv(pos, u, v);
-
-            mesh->vertex_data->position(pos);
-            mesh->vertex_data->tex_coord0(u, v);
-            mesh->vertex_data->tex_coord1(u, v);
-            mesh->vertex_data->normal(n);
-            mesh->vertex_data->diffuse(smlt::Colour::WHITE);
-            mesh->vertex_data->move_next();
+            ));
         }
     }
-    pos = Vec3(0, 1 * radius, 0);
-    n = pos.normalized();
-    generate_uv(pos, u, v);
 
-    mesh->vertex_data->position(pos);
-    mesh->vertex_data->tex_coord0(u, v);
-    mesh->vertex_data->tex_coord1(u, v);
-    mesh->vertex_data->diffuse(smlt::Colour::WHITE);
-    mesh->vertex_data->move_next();
+    add_vertex(Vec3(0, 1 * radius, 0));
+    add_vertex(Vec3(0, -1 * radius, 0));
 
-    pos = Vec3(0, -1 * radius, 0);
-    n = pos.normalized();
+    // Write each attribute in one go, rather than a vertex at a time through the cursor
+    auto vertex_data = mesh->vertex_data.get();
+    auto first = vertex_data->count();
+    vertex_data->resize(first + count);
 
-    generate_uv(pos, u, v);
+    fill_attribute(vertex_data, VERTEX_ATTRIBUTE_BIT_POSITION, first, positions);
+    fill_attribute(vertex_data, VERTEX_ATTRIBUTE_BIT_NORMAL, first, normals);
+    fill_attribute(vertex_data, VERTEX_ATTRIBUTE_BIT_TEXCOORD0, first, uvs);
+    fill_attribute(vertex_data, VERTEX_ATTRIBUTE_BIT_TEXCOORD1, first, uvs);
 
-    mesh->vertex_data->position(pos);
-    mesh->vertex_data->tex_coord0(u, v);
-    mesh->vertex_data->tex_coord1(u, v);
-    mesh->vertex_data->diffuse(smlt::Colour::WHITE);
-    mesh->vertex_data->move_next();
+    fill_attribute(vertex_data, VERTEX_ATTRIBUTE_BIT_DIFFUSE, first, std::vector<Colour>(count, smlt::Colour::WHITE));
 
-    mesh->vertex_data->done();
+    vertex_data->move_to_end();
+    vertex_data->done();
 
     SubMesh* sm = mesh->new_submesh(
         "sphere",
@@ -86,6 +86,17 @@ RenderSequence::RenderSequence(Window *window):
     render_options.texture_enabled = true;
     render_options.backface_culling_enabled = true;
     render_options.point_size = 1;
+
+    /* Drop the render queues for a stage when it goes, they hold onto its materials */
+    stage_removed_connection_ = window_->signal_stage_removed().connect([this](StageID stage_id) {
+        for(auto it = render_queues_.begin(); it != render_queues_.end();) {
+            if(it->first.first == stage_id) {
+                it = render_queues_.erase(it);
+            } else {
+                ++it;
+            }
+        }
+    });
 }
 
 void RenderSequence::activate_pipelines(const std::vector<PipelineID>& pipelines) {
@@ -183,19 +194,182 @@ PipelinePtr RenderSequence::new_pipeline(StageID stage, CameraID camera, const V
 
 void RenderSequence::set_renderer(Renderer* renderer) {
     renderer_ = renderer;
+
+    /* Render groups are renderer specific, so everything needs rebatching */
+    render_queues_.clear();
+}
+
+void RenderSequence::set_render_queue_backend(batcher::RenderQueueBackend backend) {
+    if(backend == render_queue_backend_) {
+        return;
+    }
+
+    render_queue_backend_ = backend;
+    render_queues_.clear();
 }
 
 void RenderSequence::run() {
     targets_rendered_this_frame_.clear();
+    render_queues_used_.clear();
 
     int actors_rendered = 0;
     for(Pipeline::ptr pipeline: ordered_pipelines_) {
         run_pipeline(pipeline, actors_rendered);
     }
 
+    /* Destroy the queues for any stage/camera pairs that weren't rendered */
+    for(auto it = render_queues_.begin(); it != render_queues_.end();) {
+        if(!render_queues_used_.count(it->first)) {
+            it = render_queues_.erase(it);
+        } else {
+            ++it;
+        }
+    }
+
     window->stats->set_subactors_rendered(actors_rendered);
 }
 
+batcher::RenderQueue* RenderSequence::render_queue_for(Stage* stage, CameraID camera_id) {
+    auto key = std::make_pair(stage->id(), camera_id);
+
+    render_queues_used_.insert(key);
+
+    auto it = render_queues_.find(key);
+    if(it == render_queues_.end()) {
+        auto queue = std::make_shared<batcher::RenderQueue>(stage, renderer_, render_queue_backend_);
+        it = render_queues_.insert(std::make_pair(key, queue)).first;
+    }
+
+    return it->second.get();
+}
+
+
+static AABB light_bounds(const LightPtr& light) {
+    // Must match the intersection tests in gather_visible_node
+    if(light->type() == LIGHT_TYPE_SPOT_LIGHT) {
+        return light->transformed_aabb();
+    } else {
+        return AABB(light->absolute_position(), light->range() * 4);
+    }
+}
+
+void RenderSequence::build_light_grid(const FrameVector<LightPtr>& lights_visible) {
+    directional_lights_.clear();
+    local_lights_.clear();
+    local_light_bounds_.clear();
+
+    float total_dimension = 0.0f;
+
+    for(auto& light: lights_visible) {
+        if(light->type() == LIGHT_TYPE_DIRECTIONAL) {
+            directional_lights_.push_back(light);
+        } else {
+            local_lights_.push_back(light);
+            local_light_bounds_.push_back(light_bounds(light));
+            total_dimension += local_light_bounds_.back().max_dimension();
+        }
+    }
+
+    // Size the cells so that the average light only overlaps a few of them
+    float average_dimension = (local_lights_.empty()) ? 1.0f : total_dimension / local_lights_.size();
+    light_grid_.reset(LightGrid::cell_size_for_dimension(average_dimension));
+
+    for(uint32_t i = 0; i < local_lights_.size(); ++i) {
+        light_grid_.insert(i, local_light_bounds_[i]);
+    }
+
+    light_grid_.finalize();
+}
+
+void RenderSequence::gather_visible_node(StageNode* node, const Frustum& frustum, const OcclusionBuffer* occlusion, VisibilityScratch& scratch, VisibleNode& out) {
+    out.lights.clear();
+    out.renderables.clear();
+
+    if(!node->is_visible()) {
+        return;
+    }
+
+    if(occlusion && occlusion->is_occluded(node->transformed_aabb())) {
+        ++scratch.nodes_occluded;
+        return;
+    }
+
+    auto& candidates = scratch.lights;
+    candidates.clear();
+
+    auto& light_indexes = scratch.light_indexes;
+    light_indexes.clear();
+
+    auto candidates_capacity = candidates.capacity();
+    auto light_indexes_capacity = light_indexes.capacity();
+
+    auto bounds = node->transformed_aabb();
+    auto centre = node->centre();
+
+    /* Directional lights affect everything, and always sort first */
+    for(auto& light: directional_lights_) {
+        candidates.push_back(std::make_pair(-1.0f, light));
+    }
+
+    /* Only test the lights which share a grid cell with the node */
+    light_grid_.candidates_for_box(bounds, light_indexes);
+
+    for(auto i: light_indexes) {
+        auto& light = local_lights_[i];
+
+        // Filter by whether or not the renderable bounds intersects the light bounds
+        bool affects = false;
+        if(light->type() == LIGHT_TYPE_SPOT_LIGHT) {
+            affects = bounds.intersects_aabb(light->transformed_aabb());
+        } else {
+            affects = bounds.intersects_sphere(light->absolute_position(), light->range() * 2);
+        }
+
+        if(!affects) {
+            continue;
+        }
+
+        /* FIXME: Sorting by the centre point is problematic. A renderable is made up
+         * of many polygons, by choosing the light closest to the center you may find that
+         * that polygons far away from the center aren't affected by lights when they should be.
+         * This needs more thought, probably. */
+        float distance = (centre - light->position()).length_squared();
+        candidates.push_back(std::make_pair(distance, light));
+    }
+
+    // Only the nearest MAX_LIGHTS_PER_RENDERABLE need to be in order
+    std::partial_sort(
+        candidates.begin(),
+        candidates.begin() + std::min(MAX_LIGHTS_PER_RENDERABLE, (uint32_t) candidates.size()),
+        candidates.end(),
+        [](const std::pair<float, LightPtr>& lhs, const std::pair<float, LightPtr>& rhs) {
+            return lhs.first < rhs.first;
+        }
+    );
+
+    for(auto& candidate: candidates) {
+        if(!out.lights.push_back(candidate.second)) {
+            break;
+        }
+    }
+
+    // The scratch space is kept between frames, so this should settle to zero
+    scratch.allocations += (candidates.capacity() != candidates_capacity);
+    scratch.allocations += (light_indexes.capacity() != light_indexes_capacity);
+
+    auto renderables = (occlusion) ?
+        node->_get_unoccluded_renderables(frustum, *occlusion, scratch.geom_nodes_occluded) :
+        node->_get_renderables(frustum);
+
+    for(auto& renderable: renderables) {
+        if(!renderable->index_element_count()) {
+            // Don't render things with no indices
+            continue;
+        }
+
+        out.renderables.push_back(renderable);
+    }
+}
 
 uint64_t generate_frame_id() {
     static uint64_t frame_id = 0;
@@ -276,70 +450,103 @@ void RenderSequence::run_pipeline(Pipeline::ptr pipeline_stage, int &actors_rend
     // Gather the lights and geometry visible to the camera
     stage->partitioner->lights_and_geometry_visible_from(camera_id, light_ids, nodes_visible);
 
-    // Get the actual lights from the IDs
-    auto lights_visible = map<decltype(light_ids), std::vector<LightPtr>>(
-        light_ids, [&](const LightID& light_id) -> LightPtr { return stage->light(light_id); }
-    );
+    // Get the actual lights from the IDs, this list is only needed until the end of the frame
+    FrameAllocator<LightPtr> allocator(window->frame_arena.get());
+    FrameVector<LightPtr> lights_visible(allocator);
+    lights_visible.reserve(light_ids.size());
+
+    for(auto& light_id: light_ids) {
+        lights_visible.push_back(stage->light(light_id));
+    }
 
     profiler.checkpoint("gather");
 
-    batcher::RenderQueue render_queue(stage, this->window->renderer.get());
+    auto render_queue = render_queue_for(stage, camera_id);
 
-    uint32_t renderables_rendered = 0;
-    // Mark the visible objects as visible
-    for(auto& node: nodes_visible) {
-        if(!node->is_visible()) {
-            continue;
+    // Rebatch anything whose material changed since the last frame
+    render_queue->apply_material_changes();
+
+    /*
+     * Working out which lights affect each visible node, and gathering its renderables,
+     * is independent per node so it's spread across the worker pool. Each node's results
+     * go into its own slot, and are merged into the render queue below in node order so
+     * that the queue sees the same sequence of updates regardless of thread timing.
+     */
+    auto& frustum = camera->frustum();
+    auto workers = window->workers.get();
+
+    if(visible_nodes_.size() < nodes_visible.size()) {
+        visible_nodes_.resize(nodes_visible.size());
+    }
+
+    if(visibility_scratch_.size() < workers->thread_count()) {
+        visibility_scratch_.resize(workers->thread_count());
+    }
+
+    build_light_grid(lights_visible);
+
+    /* Rasterize the occluders, so that anything behind them can be dropped before
+     * it reaches the render queue */
+    const OcclusionBuffer* occlusion = nullptr;
+    if(stage->has_occluders()) {
+        auto& triangles = stage->occluder_triangles();
+
+        occlusion_buffer_.clear();
+        occlusion_buffer_.set_view_projection(camera->projection_matrix() * camera->view_matrix());
+        occlusion_buffer_.rasterize_triangles(&triangles[0], triangles.size());
+        occlusion = &occlusion_buffer_;
+    }
+
+    profiler.checkpoint("occluders");
+
+    workers->parallel_for(nodes_visible.size(), VISIBILITY_CHUNK_SIZE, [&](uint32_t worker, uint32_t begin, uint32_t end) {
+        auto& scratch = visibility_scratch_[worker];
+
+        for(uint32_t i = begin; i < end; ++i) {
+            gather_visible_node(nodes_visible[i], frustum, occlusion, scratch, visible_nodes_[i]);
         }
+    });
 
-        auto renderable_lights = filter(lights_visible, [=](const LightPtr& light) -> bool {
-            // Filter by whether or not the renderable bounds intersects the light bounds
-            if(light->type() == LIGHT_TYPE_DIRECTIONAL) {
-                return true;
-            } else if(light->type() == LIGHT_TYPE_SPOT_LIGHT) {
-                return node->transformed_aabb().intersects_aabb(light->transformed_aabb());
-            } else {
-                return node->transformed_aabb().intersects_sphere(light->absolute_position(), light->range() * 2);
-            }
-        });
-
-        std::partial_sort(
-            renderable_lights.begin(),
-            renderable_lights.begin() + std::min(MAX_LIGHTS_PER_RENDERABLE, (uint32_t) renderable_lights.size()),
-            renderable_lights.end(),
-            [=](LightPtr lhs, LightPtr rhs) {
-                /* FIXME: Sorting by the centre point is problematic. A renderable is made up
-                 * of many polygons, by choosing the light closest to the center you may find that
-                 * that polygons far away from the center aren't affected by lights when they should be.
-                 * This needs more thought, probably. */
-                if(lhs->type() == LIGHT_TYPE_DIRECTIONAL && rhs->type() != LIGHT_TYPE_DIRECTIONAL) {
-                    return true;
-                } else if(rhs->type() == LIGHT_TYPE_DIRECTIONAL && lhs->type() != LIGHT_TYPE_DIRECTIONAL) {
-                    return false;
-                }
-
-                float lhs_dist = (node->centre() - lhs->position()).length_squared();
-                float rhs_dist = (node->centre() - rhs->position()).length_squared();
-                return lhs_dist < rhs_dist;
-            }
-        );
+    profiler.checkpoint("lights");
 
-        for(auto& renderable: node->_get_renderables(camera->frustum())) {
-            if(!renderable->index_element_count()) {
-                // Don't render things with no indices
-                continue;
-            }
+    uint32_t nodes_occluded = 0;
+    uint32_t geom_nodes_occluded = 0;
+
+    for(auto& scratch: visibility_scratch_) {
+        window->stats->increment_light_list_allocations(scratch.allocations);
+        scratch.allocations = 0;
+
+        nodes_occluded += scratch.nodes_occluded;
+        geom_nodes_occluded += scratch.geom_nodes_occluded;
+        scratch.nodes_occluded = 0;
+        scratch.geom_nodes_occluded = 0;
+    }
 
+    window->stats->set_occlusion_culled(nodes_occluded, geom_nodes_occluded);
+
+    uint32_t renderables_rendered = 0;
+    for(uint32_t i = 0; i < nodes_visible.size(); ++i) {
+        auto& visible = visible_nodes_[i];
+
+        for(auto& renderable: visible.renderables) {
+            // Mark the visible objects as visible
             renderable->update_last_visible_frame_id(frame_id);
-            renderable->set_affected_by_lights(renderable_lights);
+            renderable->set_affected_by_lights(visible.lights);
 
-            render_queue.insert_renderable(renderable.get());
+            // Only rebatches if the material or priority changed since last time
+            render_queue->update_renderable(renderable.get());
 
             ++renderables_rendered;
         }
+
+        // Don't hold on to renderables (which might be destroyed) until the next frame
+        visible.renderables.clear();
     }
 
-    profiler.checkpoint("lights");
+    // Drop any batches emptied by renderables changing material or priority
+    render_queue->clean_empty_batches();
+
+    profiler.checkpoint("merge");
 
     window->stats->set_geometry_visible(renderables_rendered);
 
@@ -348,7 +555,7 @@ void RenderSequence::run_pipeline(Pipeline::ptr pipeline_stage, int &actors_rend
     auto visitor = renderer_->get_render_queue_visitor(camera);
 
     // Render the visible objects
-    render_queue.traverse(visitor.get(), frame_id);
+    render_queue->traverse(visitor.get(), frame_id, camera->absolute_position());
 
     profiler.checkpoint("traversal");
 
@@ -22,6 +22,8 @@
 #include <vector>
 #include <memory>
 #include <list>
+#include <map>
+#include <set>
 
 #include "generic/managed.h"
 #include "generic/manager.h"
@@ -31,6 +33,9 @@
 #include "types.h"
 #include "viewport.h"
 #include "partitioner.h"
+#include "partitioners/impl/light_grid.h"
+#include "occlusion_buffer.h"
+#include "renderers/batching/renderable.h"
 
 namespace smlt {
 
@@ -100,6 +105,7 @@ class RenderSequence:
 public:
     RenderSequence(Window* window);
     ~RenderSequence() {
+        stage_removed_connection_.disconnect();
         delete_all_pipelines();
     }
 
@@ -122,6 +128,10 @@ public:
     //void set_batcher(Batcher::ptr batcher);
     void set_renderer(Renderer *renderer);
 
+    /* Switches how render queues store and sort renderables, existing queues are rebuilt */
+    void set_render_queue_backend(batcher::RenderQueueBackend backend);
+    batcher::RenderQueueBackend render_queue_backend() const { return render_queue_backend_; }
+
     void run();
 
     sig::signal<void (Pipeline&)>& signal_pipeline_started() { return signal_pipeline_started_; }
@@ -146,6 +156,69 @@ private:
     friend class Pipeline;
 
     std::set<RenderTarget*> targets_rendered_this_frame_;
+
+    /*
+     * Render queues persist between frames, one for each stage/camera pair being
+     * rendered. Renderables are only rebatched when their material or priority
+     * change. Queues which weren't used by an active pipeline during a run are
+     * destroyed at the end of it.
+     */
+    typedef std::pair<StageID, CameraID> RenderQueueKey;
+    std::map<RenderQueueKey, std::shared_ptr<batcher::RenderQueue>> render_queues_;
+    std::set<RenderQueueKey> render_queues_used_;
+    batcher::RenderQueueBackend render_queue_backend_ = batcher::RENDER_QUEUE_BACKEND_BATCHED;
+
+    batcher::RenderQueue* render_queue_for(Stage* stage, CameraID camera_id);
+
+    sig::connection stage_removed_connection_;
+
+    /*
+     * The results of the visibility stage for a single visible node. Slots are
+     * reused each frame so that their vectors keep their capacity.
+     */
+    struct VisibleNode {
+        LightList lights;
+        std::vector<std::shared_ptr<Renderable>> renderables;
+    };
+
+    /* One per worker pool thread, for filtering and sorting the lights of a node */
+    struct VisibilityScratch {
+        std::vector<uint32_t> light_indexes;
+        std::vector<std::pair<float, LightPtr>> lights;
+
+        /* How many times the vectors above had to grow, reported in the stats */
+        uint32_t allocations = 0;
+
+        /* Nodes, and parts of geoms, that were hidden by the occluders */
+        uint32_t nodes_occluded = 0;
+        uint32_t geom_nodes_occluded = 0;
+    };
+
+    const static uint32_t VISIBILITY_CHUNK_SIZE = 64;
+
+    std::vector<VisibleNode> visible_nodes_;
+    std::vector<VisibilityScratch> visibility_scratch_;
+
+    /*
+     * The visible lights are bucketed into a grid once per pipeline, so each node
+     * only tests the lights near it rather than every visible light.
+     */
+    LightGrid light_grid_;
+    std::vector<LightPtr> directional_lights_;
+    std::vector<LightPtr> local_lights_;
+    std::vector<AABB> local_light_bounds_;
+
+    void build_light_grid(const FrameVector<LightPtr>& lights_visible);
+
+    /* Filled from the stage's occluders once per pipeline, only if the stage has any */
+    OcclusionBuffer occlusion_buffer_;
+
+    /* Called from worker threads. The light grid and the occlusion buffer are only read.
+     * The partitioner lists each node once, so a node is only ever visited by one thread
+     * per pipeline and its _get_renderables may update the node's own state (particle
+     * systems write their billboards there), but nothing shared between nodes.
+     * occlusion is null if occlusion culling is off for this pipeline */
+    void gather_visible_node(StageNode* node, const Frustum& frustum, const OcclusionBuffer* occlusion, VisibilityScratch& scratch, VisibleNode& out);
 };
 
 }
@@ -0,0 +1,219 @@
+//
+//   Copyright (c) 2011-2017 Luke Benstead https://simulant-engine.appspot.com
+//
+//     This file is part of Simulant.
+//
+//     Simulant is free software: you can redistribute it and/or modify
+//     it under the terms of the GNU General Public License as published by
+//     the Free Software Foundation, either version 3 of the License, or
+//     (at your option) any later version.
+//
+//     Simulant is distributed in the hope that it will be useful,
+//     but WITHOUT ANY WARRANTY; without even the implied warranty of
+//     MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+//     GNU General Public License for more details.
+//
+//     You should have received a copy of the GNU General Public License
+//     along with Simulant.  If not, see <http://www.gnu.org/licenses/>.
+//
+
+#include <cstring>
+#include <algorithm>
+
+#include "render_command_buffer.h"
+#include "renderable.h"
+
+namespace smlt {
+namespace batcher {
+
+void radix_sort(RenderCommand* commands, RenderCommand* scratch, std::size_t count) {
+    if(count < 2) {
+        return;
+    }
+
+    // Build the histograms for all 8 bytes in a single pass
+    uint32_t histograms[8][256];
+    memset(histograms, 0, sizeof(histograms));
+
+    for(std::size_t i = 0; i < count; ++i) {
+        uint64_t key = commands[i].key;
+        for(uint32_t b = 0; b < 8; ++b) {
+            histograms[b][(key >> (b * 8)) & 0xFF]++;
+        }
+    }
+
+    RenderCommand* src = commands;
+    RenderCommand* dst = scratch;
+
+    for(uint32_t b = 0; b < 8; ++b) {
+        uint32_t* histogram = histograms[b];
+
+        // If every key has the same value for this byte, there's nothing to do
+        if(histogram[(src[0].key >> (b * 8)) & 0xFF] == count) {
+            continue;
+        }
+
+        uint32_t offsets[256];
+        uint32_t total = 0;
+        for(uint32_t i = 0; i < 256; ++i) {
+            offsets[i] = total;
+            total += histogram[i];
+        }
+
+        for(std::size_t i = 0; i < count; ++i) {
+            auto digit = (src[i].key >> (b * 8)) & 0xFF;
+            dst[offsets[digit]++] = src[i];
+        }
+
+        std::swap(src, dst);
+    }
+
+    // Odd number of scatters, the result is in the scratch buffer
+    if(src != commands) {
+        std::copy(src, src + count, commands);
+    }
+}
+
+void RenderCommandBuffer::add(Renderable* renderable, Pass pass, const RenderGroup& group) {
+    assert(pass < MAX_MATERIAL_PASSES);
+
+    RenderCommand command;
+    command.key = 0;
+    command.renderable = renderable;
+    command.group = acquire_group(pass, group);
+    command.pass = pass;
+
+    commands_by_member_[renderable].push_back(commands_.size());
+    commands_.push_back(command);
+}
+
+void RenderCommandBuffer::remove(BatchMember* member) {
+    auto it = commands_by_member_.find(member);
+    if(it == commands_by_member_.end()) {
+        return;
+    }
+
+    /* Remove from the back, so that swapping the last command into the hole
+     * never moves a command that we're about to remove */
+    auto indexes = it->second;
+    commands_by_member_.erase(it);
+
+    std::sort(indexes.begin(), indexes.end(), std::greater<uint32_t>());
+
+    for(auto index: indexes) {
+        release_group(commands_[index].group);
+
+        uint32_t last = commands_.size() - 1;
+        if(index != last) {
+            commands_[index] = commands_[last];
+
+            // Point the moved command's owner at its new index
+            auto& moved = commands_by_member_.at(commands_[index].renderable);
+            std::replace(moved.begin(), moved.end(), last, index);
+        }
+
+        commands_.pop_back();
+    }
+}
+
+void RenderCommandBuffer::clear() {
+    groups_.clear();
+    free_groups_.clear();
+    group_lookup_.clear();
+    group_ranks_dirty_ = false;
+
+    commands_.clear();
+    commands_by_member_.clear();
+    sorted_.clear();
+}
+
+const std::vector<RenderCommand>& RenderCommandBuffer::build(uint64_t frame_id, const Vec3& camera_position) {
+    if(group_ranks_dirty_) {
+        update_group_ranks();
+    }
+
+    sorted_.clear();
+
+    for(auto& command: commands_) {
+        auto renderable = command.renderable;
+        if(!renderable->is_visible_in_frame(frame_id)) {
+            continue;
+        }
+
+        /* Positive IEEE floats sort the same as their bit patterns, so the top
+         * bits of the squared distance make a decent depth key without needing to
+         * know the far plane */
+        float distance = (renderable->centre() - camera_position).length_squared();
+        uint32_t depth_bits;
+        memcpy(&depth_bits, &distance, sizeof(float));
+
+        uint64_t key = uint64_t(command.pass) << SORT_KEY_PASS_SHIFT;
+        key |= (uint64_t(groups_[command.group].rank) & SORT_KEY_GROUP_MASK) << SORT_KEY_GROUP_SHIFT;
+        key |= (uint64_t(renderable->material_id().value()) & SORT_KEY_MATERIAL_MASK) << SORT_KEY_MATERIAL_SHIFT;
+        key |= (uint64_t(depth_bits >> 7) & SORT_KEY_DEPTH_MASK);
+
+        sorted_.push_back(command);
+        sorted_.back().key = key;
+    }
+
+    scratch_.resize(sorted_.size());
+    radix_sort(sorted_.data(), scratch_.data(), sorted_.size());
+
+    return sorted_;
+}
+
+uint32_t RenderCommandBuffer::acquire_group(Pass pass, const RenderGroup& group) {
+    if(group_lookup_.size() <= pass) {
+        group_lookup_.resize(pass + 1);
+    }
+
+    auto& lookup = group_lookup_[pass];
+    auto it = lookup.find(group);
+    if(it != lookup.end()) {
+        groups_[it->second].refcount++;
+        return it->second;
+    }
+
+    uint32_t index;
+    if(!free_groups_.empty()) {
+        index = free_groups_.back();
+        free_groups_.pop_back();
+        groups_[index] = GroupEntry(pass, group);
+    } else {
+        index = groups_.size();
+        groups_.push_back(GroupEntry(pass, group));
+    }
+
+    groups_[index].refcount = 1;
+    lookup.insert(std::make_pair(group, index));
+    group_ranks_dirty_ = true;
+
+    return index;
+}
+
+void RenderCommandBuffer::release_group(uint32_t index) {
+    auto& entry = groups_[index];
+
+    assert(entry.refcount);
+    if(--entry.refcount == 0) {
+        group_lookup_[entry.pass].erase(entry.group);
+        free_groups_.push_back(index);
+
+        // Removing a group doesn't change the relative order of the others
+    }
+}
+
+void RenderCommandBuffer::update_group_ranks() {
+    for(auto& lookup: group_lookup_) {
+        uint32_t rank = 0;
+        for(auto& p: lookup) {
+            assert(rank <= SORT_KEY_GROUP_MASK);
+            groups_[p.second].rank = rank++;
+        }
+    }
+
+    group_ranks_dirty_ = false;
+}
+
+}
+}
@@ -0,0 +1,124 @@
+/* *   Copyright (c) 2011-2017 Luke Benstead https://simulant-engine.appspot.com
+ *
+ *     This file is part of Simulant.
+ *
+ *     Simulant is free software: you can redistribute it and/or modify
+ *     it under the terms of the GNU General Public License as published by
+ *     the Free Software Foundation, either version 3 of the License, or
+ *     (at your option) any later version.
+ *
+ *     Simulant is distributed in the hope that it will be useful,
+ *     but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *     MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *     GNU General Public License for more details.
+ *
+ *     You should have received a copy of the GNU General Public License
+ *     along with Simulant.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#pragma once
+
+#include <cstdint>
+#include <vector>
+#include <map>
+#include <unordered_map>
+
+#include "../../types.h"
+#include "render_queue.h"
+
+namespace smlt {
+namespace batcher {
+
+/*
+ * The sort key is laid out so that an ascending sort gives the same order
+ * as iterating the std::map batches pass by pass:
+ *
+ *  63..61  material pass number
+ *  60..40  render group rank (priority first, then whatever the renderer's
+ *          RenderGroupImpl::lt orders by, e.g. shader then textures on GL2)
+ *  39..24  material
+ *  23..0   depth (the top bits of the squared distance to the camera, so
+ *          renderables sharing state are drawn front-to-back)
+ */
+const uint32_t SORT_KEY_PASS_SHIFT = 61;
+const uint32_t SORT_KEY_GROUP_SHIFT = 40;
+const uint32_t SORT_KEY_MATERIAL_SHIFT = 24;
+
+const uint64_t SORT_KEY_GROUP_MASK = (1ull << 21) - 1;
+const uint64_t SORT_KEY_MATERIAL_MASK = (1ull << 16) - 1;
+const uint64_t SORT_KEY_DEPTH_MASK = (1ull << 24) - 1;
+
+struct RenderCommand {
+    uint64_t key;
+    Renderable* renderable;
+    uint32_t group;
+    Pass pass;
+};
+
+/*
+ * Sorts the commands on their key. This is a stable LSD radix sort, 8 bits
+ * at a time, which skips any byte which is the same across all the keys
+ * (which is most of them, for most scenes). scratch must be able to hold count
+ * commands.
+ */
+void radix_sort(RenderCommand* commands, RenderCommand* scratch, std::size_t count);
+
+/*
+ * A flat alternative to the map-of-lists batching in RenderQueue. Each
+ * (renderable, material pass) pair is stored as a single command, and
+ * each frame the visible ones are copied out, keyed, radix sorted and then
+ * walked linearly.
+ */
+class RenderCommandBuffer {
+public:
+    void add(Renderable* renderable, Pass pass, const RenderGroup& group);
+    void remove(BatchMember* member);
+    void clear();
+
+    bool contains(BatchMember* member) const {
+        return commands_by_member_.count(member) > 0;
+    }
+
+    /* Builds the sorted list of commands for the renderables visible in the frame */
+    const std::vector<RenderCommand>& build(uint64_t frame_id, const Vec3& camera_position);
+
+    const RenderGroup& group(uint32_t index) const {
+        return groups_[index].group;
+    }
+
+    std::size_t command_count() const { return commands_.size(); }
+    std::size_t group_count() const { return groups_.size() - free_groups_.size(); }
+
+private:
+    struct GroupEntry {
+        GroupEntry(Pass pass, const RenderGroup& group):
+            pass(pass), group(group) {}
+
+        Pass pass;
+        RenderGroup group;
+        uint32_t refcount = 0;
+        uint32_t rank = 0;
+    };
+
+    uint32_t acquire_group(Pass pass, const RenderGroup& group);
+    void release_group(uint32_t index);
+    void update_group_ranks();
+
+    std::vector<GroupEntry> groups_;
+    std::vector<uint32_t> free_groups_;
+
+    /* The map ordering is what gives each group its rank in the sort key */
+    std::vector<std::map<RenderGroup, uint32_t>> group_lookup_;
+    bool group_ranks_dirty_ = false;
+
+    /* Every command in the queue, visible or not, in no particular order */
+    std::vector<RenderCommand> commands_;
+    std::unordered_map<BatchMember*, std::vector<uint32_t>> commands_by_member_;
+
+    /* Rebuilt every frame, kept around to avoid reallocating */
+    std::vector<RenderCommand> sorted_;
+    std::vector<RenderCommand> scratch_;
+};
+
+}
+}
@@ -17,6 +17,7 @@
 //     along with Simulant.  If not, see <http://www.gnu.org/licenses/>.
 //
 
+#include <algorithm>
 
 #include "../../stage.h"
 #include "../../material.h"
@@ -26,19 +27,75 @@
 #include "../../nodes/geoms/geom_culler.h"
 
 #include "render_queue.h"
+#include "render_command_buffer.h"
 #include "../../partitioner.h"
 
 namespace smlt {
 namespace batcher {
 
 
-RenderQueue::RenderQueue(Stage* stage, RenderGroupFactory* render_group_factory):
+RenderQueue::RenderQueue(Stage* stage, RenderGroupFactory* render_group_factory, RenderQueueBackend backend):
     stage_(stage),
-    render_group_factory_(render_group_factory) {
+    render_group_factory_(render_group_factory),
+    backend_(backend),
+    material_watcher_(this) {
 
+    if(backend_ == RENDER_QUEUE_BACKEND_SORT_KEYS) {
+        command_buffer_.reset(new RenderCommandBuffer());
+    }
+}
+
+RenderQueue::~RenderQueue() {
+    std::lock_guard<std::mutex> lock(queue_lock_);
+    do_clear();
 }
 
 void RenderQueue::insert_renderable(Renderable* renderable) {
+    std::lock_guard<std::mutex> lock(queue_lock_);
+
+    if(renderable->membership(this)) {
+        do_remove_member(renderable);
+    }
+
+    do_insert_renderable(renderable);
+}
+
+void RenderQueue::remove_renderable(Renderable* renderable) {
+    std::lock_guard<std::mutex> lock(queue_lock_);
+    do_remove_member(renderable);
+}
+
+void RenderQueue::update_renderable(Renderable* renderable) {
+    std::lock_guard<std::mutex> lock(queue_lock_);
+
+    auto membership = renderable->membership(this);
+    if(membership) {
+        if(membership->material_id == renderable->material_id() &&
+           membership->priority == renderable->render_priority()) {
+            // Nothing changed, it's already in the right batches
+            return;
+        }
+
+        do_remove_member(renderable);
+    }
+
+    do_insert_renderable(renderable);
+}
+
+void RenderQueue::apply_material_changes() {
+    std::lock_guard<std::mutex> lock(queue_lock_);
+
+    for(auto member: material_watcher_.take_changed_renderables()) {
+        /* The member is only a Renderable, we just store it by base class so that
+         * it can be forgotten from the BatchMember destructor */
+        auto renderable = static_cast<Renderable*>(member);
+
+        do_remove_member(member);
+        do_insert_renderable(renderable);
+    }
+}
+
+void RenderQueue::do_insert_renderable(Renderable* renderable) {
     /*
      * Adds a renderable to the correct render groups. This goes through the
      * material passes on the renderable, calculates the render group for each one
@@ -59,20 +116,71 @@ void RenderQueue::insert_renderable(Renderable* renderable) {
         assert(i < MAX_MATERIAL_PASSES);
         assert(i < material->pass_count());
 
+        if(command_buffer_) {
+            command_buffer_->add(renderable, i, group);
+            return;
+        }
+
         if(batches_.size() <= i) {
             batches_.push_back(BatchMap());
         }
 
-        if(!batches_[i].count(group)) {
-            batches_[i].insert(std::make_pair(group, std::make_shared<Batch>()));
+        auto it = batches_[i].find(group);
+        if(it == batches_[i].end()) {
+            it = batches_[i].insert(std::make_pair(group, std::make_shared<Batch>(this))).first;
         }
 
-        batches_[i][group]->add_renderable(renderable);
+        it->second->add_renderable(renderable);
     });
+
+    BatchMember::QueueMembership membership;
+    membership.queue = this;
+    membership.material_id = material_id;
+    membership.priority = renderable->render_priority();
+    renderable->memberships_.push_back(membership);
+
+    members_.insert(renderable);
+    material_watcher_.watch(material, renderable);
 }
 
-void RenderQueue::clean_empty_batches() {    
+void RenderQueue::do_remove_member(BatchMember* member) {
+    if(command_buffer_) {
+        command_buffer_->remove(member);
+    }
+
+    /* Take a copy, removing from the batch alters the member's batch list */
+    for(auto batch: member->batches()) {
+        if(batch->queue() == this) {
+            batch->remove_member(member);
+            has_empty_batches_ = true;
+        }
+    }
+
+    auto& memberships = member->memberships_;
+    for(auto it = memberships.begin(); it != memberships.end(); ++it) {
+        if(it->queue == this) {
+            material_watcher_.unwatch(it->material_id, member);
+            memberships.erase(it);
+            break;
+        }
+    }
+
+    members_.erase(member);
+}
+
+void RenderQueue::forget_member(BatchMember* member) {
     std::lock_guard<std::mutex> lock(queue_lock_);
+    do_remove_member(member);
+}
+
+void RenderQueue::clean_empty_batches() {
+    std::lock_guard<std::mutex> lock(queue_lock_);
+
+    if(!has_empty_batches_) {
+        return;
+    }
+
+    has_empty_batches_ = false;
 
     for(auto& pass: batches_) {
         auto group = pass.begin();
@@ -98,16 +206,96 @@ void RenderQueue::clean_empty_batches() {
 
 void RenderQueue::clear() {
     std::lock_guard<std::mutex> lock(queue_lock_);
+    do_clear();
+}
+
+void RenderQueue::do_clear() {
+    /* Copy, as removing alters the member list */
+    auto members = members_;
+    for(auto member: members) {
+        do_remove_member(member);
+    }
+
     batches_.clear();
+    has_empty_batches_ = false;
+
+    if(command_buffer_) {
+        command_buffer_->clear();
+    }
 }
 
-void RenderQueue::traverse(RenderQueueVisitor* visitor, uint64_t frame_id) const {
+uint32_t RenderQueue::command_count() const {
     std::lock_guard<std::mutex> lock(queue_lock_);
+    return (command_buffer_) ? command_buffer_->command_count() : 0;
+}
 
-    Pass pass = 0;
+static void visit_renderable(RenderQueueVisitor* visitor, Stage* stage, Renderable* renderable, Pass pass,
+    MaterialID& material_id, MaterialPass::ptr& material_pass, IterationType& pass_iteration_type) {
+
+    /* As the pass number is constant for the entire batch, a material_pass
+     * will only change if and when a material changes
+     */
+    auto& this_mat_id = renderable->material_id();
+    if(this_mat_id != material_id) {
+        auto last_pass = material_pass;
+
+        material_id = this_mat_id;
+        material_pass = stage->assets->material(material_id)->pass(pass);
+        pass_iteration_type = material_pass->iteration();
+
+        visitor->change_material_pass(last_pass.get(), material_pass.get());
+    }
+
+    uint32_t iterations = 1;
+
+    // Get any lights which are visible and affecting the renderable this frame
+    auto& lights = renderable->lights_affecting_this_frame();
+
+    if(pass_iteration_type == ITERATE_N) {
+        iterations = material_pass->max_iterations();
+    } else if(pass_iteration_type == ITERATE_ONCE_PER_LIGHT) {
+        iterations = lights.size();
+    }
+
+    Light* light = nullptr;
+    for(Iteration i = 0; i < iterations; ++i) {
+        Light* next = nullptr;
+
+        // Pass down the light if necessary, otherwise just pass nullptr
+        if(i < lights.size()) {
+            next = lights[i];
+        } else {
+            next = nullptr;
+        }
+
+        if(pass_iteration_type == ITERATE_ONCE_PER_LIGHT && (i== 0 || light != next)) {
+            visitor->change_light(light, next);
+        } else if(pass_iteration_type == ITERATE_N || pass_iteration_type == ITERATE_ONCE) {
+            visitor->apply_lights(lights.data(), lights.size());
+        }
+
+        light = next;
+        visitor->visit(renderable, material_pass.get(), i);
+    }
+}
+
+void RenderQueue::traverse(RenderQueueVisitor* visitor, uint64_t frame_id, const Vec3& camera_position) const {
+    std::lock_guard<std::mutex> lock(queue_lock_);
 
     visitor->start_traversal(*this, frame_id, stage_);
 
+    if(command_buffer_) {
+        traverse_commands(visitor, frame_id, camera_position);
+    } else {
+        traverse_batches(visitor, frame_id);
+    }
+
+    visitor->end_traversal(*this, stage_);
+}
+
+void RenderQueue::traverse_batches(RenderQueueVisitor* visitor, uint64_t frame_id) const {
+    Pass pass = 0;
+
     for(auto& batches: batches_) {
         IterationType pass_iteration_type;
         MaterialID material_id;
@@ -133,60 +321,55 @@ void RenderQueue::traverse(RenderQueueVisitor* visitor, uint64_t frame_id) const
                     render_group_changed_ = true;
                 }
 
+                visit_renderable(
+                    visitor, stage_, renderable, pass,
+                    material_id, material_pass, pass_iteration_type
+                );
 
-                /* As the pass number is constant for the entire batch, a material_pass
-                 * will only change if and when a material changes
-                 */
-                auto& this_mat_id = renderable->material_id();
-                if(this_mat_id != material_id) {
-                    auto last_pass = material_pass;
+                last_group = current_group;
+            });
+        }
+        ++pass;
+    }
+}
 
-                    material_id = this_mat_id;
-                    material_pass = stage_->assets->material(material_id)->pass(pass);
-                    pass_iteration_type = material_pass->iteration();
+void RenderQueue::traverse_commands(RenderQueueVisitor* visitor, uint64_t frame_id, const Vec3& camera_position) const {
+    /* Only visible commands are returned, sorted so that walking them in order gives
+     * the same state changes as walking the batches */
+    auto& commands = command_buffer_->build(frame_id, camera_position);
 
-                    visitor->change_material_pass(last_pass.get(), material_pass.get());
-                }
+    IterationType pass_iteration_type;
+    MaterialID material_id;
+    MaterialPass::ptr material_pass;
 
-                uint32_t iterations = 1;
+    const RenderGroup* last_group = nullptr;
+    uint32_t last_group_index = 0;
+    Pass pass = 0;
 
-                // Get any lights which are visible and affecting the renderable this frame
-                std::vector<LightPtr> lights = renderable->lights_affecting_this_frame();
+    for(std::size_t i = 0; i < commands.size(); ++i) {
+        auto& command = commands[i];
 
-                if(pass_iteration_type == ITERATE_N) {
-                    iterations = material_pass->max_iterations();
-                } else if(pass_iteration_type == ITERATE_ONCE_PER_LIGHT) {
-                    iterations = lights.size();
-                }
+        if(i == 0 || command.pass != pass) {
+            // Match the batched traversal, which starts each pass from scratch
+            pass = command.pass;
+            material_id = MaterialID();
+            material_pass.reset();
+            last_group = nullptr;
+        }
 
-                Light* light = nullptr;
-                for(Iteration i = 0; i < iterations; ++i) {
-                    Light* next = nullptr;
-
-                    // Pass down the light if necessary, otherwise just pass nullptr
-                    if(!lights.empty()) {
-                        next = lights[i];
-                    } else {
-                        next = nullptr;
-                    }
-
-                    if(pass_iteration_type == ITERATE_ONCE_PER_LIGHT && (i== 0 || light != next)) {
-                        visitor->change_light(light, next);
-                    } else if(pass_iteration_type == ITERATE_N || pass_iteration_type == ITERATE_ONCE) {
-                        visitor->apply_lights(&lights[0], (uint8_t) lights.size());
-                    }
-
-                    light = next;
-                    visitor->visit(renderable, material_pass.get(), i);
-                }
+        if(!last_group || command.group != last_group_index) {
+            const RenderGroup* current_group = &command_buffer_->group(command.group);
+            visitor->change_render_group(last_group, current_group);
 
-                last_group = current_group;
-            });
+            last_group = current_group;
+            last_group_index = command.group;
         }
-        ++pass;
-    }
 
-    visitor->end_traversal(*this, stage_);
+        visit_renderable(
+            visitor, stage_, command.renderable, pass,
+            material_id, material_pass, pass_iteration_type
+        );
+    }
 }
 
 void Batch::add_renderable(Renderable* renderable) {
@@ -195,27 +378,125 @@ void Batch::add_renderable(Renderable* renderable) {
     write_lock<shared_mutex> lock(batch_lock_);
 
     renderable->join_batch(this);
-    renderables_.push_back(renderable);
+    renderables_.push_back(Entry{renderable, renderable});
 }
 
 void Batch::remove_renderable(Renderable *renderable) {
     write_lock<shared_mutex> lock(batch_lock_);
 
-    auto it = std::find(renderables_.begin(), renderables_.end(), renderable);
+    auto it = std::find_if(renderables_.begin(), renderables_.end(), [renderable](const Entry& entry) {
+        return entry.renderable == renderable;
+    });
+
     if(it != renderables_.end()) {
         renderables_.erase(it);
     }
     renderable->leave_batch(this);
 }
 
+void Batch::remove_member(BatchMember* member) {
+    write_lock<shared_mutex> lock(batch_lock_);
+
+    /* This can be called from ~BatchMember, when the Renderable part of the object
+     * is already gone, so only the recorded member pointers are compared */
+    auto it = std::find_if(renderables_.begin(), renderables_.end(), [member](const Entry& entry) {
+        return entry.member == member;
+    });
+
+    if(it != renderables_.end()) {
+        renderables_.erase(it);
+    }
+
+    member->leave_batch(this);
+}
+
 void Batch::each(std::function<void (uint32_t, Renderable *)> func) const {
     read_lock<shared_mutex> lock(batch_lock_);
 
     uint32_t i = 0;
-    for(auto& renderable: renderables_) {
-        func(i++, renderable);
+    for(auto& entry: renderables_) {
+        func(i++, entry.renderable);
+    }
+}
+
+BatchMember::~BatchMember() {
+    /* Copy, leaving a queue alters the membership list */
+    auto memberships = memberships_;
+    for(auto& membership: memberships) {
+        membership.queue->forget_member(this);
+    }
+}
+
+BatchMember::QueueMembership* BatchMember::membership(RenderQueue* queue) {
+    for(auto& membership: memberships_) {
+        if(membership.queue == queue) {
+            return &membership;
+        }
+    }
+
+    return nullptr;
+}
+
+MaterialChangeWatcher::~MaterialChangeWatcher() {
+    for(auto& p: material_update_conections_) {
+        p.second.disconnect();
+    }
+}
+
+void MaterialChangeWatcher::watch(MaterialPtr material, BatchMember* renderable) {
+    std::lock_guard<std::mutex> lock(lock_);
+
+    auto material_id = material->id();
+
+    renderables_by_material_[material_id].insert(renderable);
+
+    if(!material_update_conections_.count(material_id)) {
+        materials_[material_id] = material;
+        material_update_conections_[material_id] = material->signal_material_changed().connect(
+            std::bind(&MaterialChangeWatcher::on_material_changed, this, std::placeholders::_1)
+        );
+    }
+}
+
+void MaterialChangeWatcher::unwatch(MaterialID material_id, BatchMember* renderable) {
+    std::lock_guard<std::mutex> lock(lock_);
+
+    auto it = renderables_by_material_.find(material_id);
+    if(it == renderables_by_material_.end()) {
+        return;
+    }
+
+    it->second.erase(renderable);
+
+    if(it->second.empty()) {
+        renderables_by_material_.erase(it);
+
+        material_update_conections_[material_id].disconnect();
+        material_update_conections_.erase(material_id);
+        materials_.erase(material_id);
+        changed_materials_.erase(material_id);
     }
 }
 
+std::set<BatchMember*> MaterialChangeWatcher::take_changed_renderables() {
+    std::lock_guard<std::mutex> lock(lock_);
+
+    std::set<BatchMember*> result;
+    for(auto& material_id: changed_materials_) {
+        auto it = renderables_by_material_.find(material_id);
+        if(it != renderables_by_material_.end()) {
+            result.insert(it->second.begin(), it->second.end());
+        }
+    }
+
+    changed_materials_.clear();
+    return result;
+}
+
+void MaterialChangeWatcher::on_material_changed(MaterialID material) {
+    std::lock_guard<std::mutex> lock(lock_);
+    changed_materials_.insert(material);
+}
+
 }
 }
@@ -21,6 +21,10 @@
 #include <list>
 #include <set>
 #include <map>
+#include <unordered_map>
+#include <unordered_set>
+#include <mutex>
+#include <memory>
 
 #include "../../types.h"
 #include "../../generic/threading/shared_mutex.h"
@@ -35,10 +39,12 @@ class Light;
 namespace batcher {
 
 class Batch;
+class RenderQueue;
 
 class BatchMember {
 public:
-    virtual ~BatchMember() {}
+    /* Leaves any persistent render queues this member is still part of */
+    virtual ~BatchMember();
 
     void join_batch(Batch* batch) {
         batches_.insert(batch);
@@ -51,11 +57,30 @@ public:
     std::set<Batch*> batches() const { return batches_; }
 
 private:
+    friend class RenderQueue;
+
+    /*
+     * The state a member had when it was inserted into a render queue. If
+     * the material or priority no longer match then the member needs
+     * moving to a different batch.
+     */
+    struct QueueMembership {
+        RenderQueue* queue;
+        MaterialID material_id;
+        RenderPriority priority;
+    };
+
+    QueueMembership* membership(RenderQueue* queue);
+
     std::set<Batch*> batches_;
+    std::vector<QueueMembership> memberships_;
 };
 
 class Batch {
 public:
+    Batch(RenderQueue* queue):
+        queue_(queue) {}
+
     void add_renderable(Renderable* renderable);
     void remove_renderable(Renderable* renderable);
 
@@ -63,8 +88,22 @@ public:
 
     uint32_t renderable_count() const { return renderables_.size(); }
 
+    RenderQueue* queue() const { return queue_; }
+
 private:
-    std::list<Renderable*> renderables_;
+    friend class RenderQueue;
+
+    void remove_member(BatchMember* member);
+
+    /* The BatchMember pointer is taken when the renderable is added, so remove_member()
+     * can find it from ~BatchMember without converting the half-destroyed object */
+    struct Entry {
+        Renderable* renderable;
+        BatchMember* member;
+    };
+
+    RenderQueue* queue_ = nullptr;
+    std::list<Entry> renderables_;
     mutable shared_mutex batch_lock_;
 };
 
@@ -172,8 +211,13 @@ public:
     MaterialChangeWatcher(RenderQueue* queue):
         queue_(queue) {}
 
-    void watch(MaterialID material_id, Renderable* renderable);
-    void unwatch(Renderable* renderable);
+    ~MaterialChangeWatcher();
+
+    void watch(MaterialPtr material, BatchMember* renderable);
+    void unwatch(MaterialID material_id, BatchMember* renderable);
+
+    /* Returns the renderables using a material which changed since the last call */
+    std::set<BatchMember*> take_changed_renderables();
 
 private:
     RenderQueue* queue_;
@@ -181,29 +225,81 @@ private:
     /*
      * We store a list of all the renderables that need to be reinserted if a material changes
      */
-    std::unordered_map<MaterialID, std::set<Renderable*>> renderables_by_material_;
+    std::unordered_map<MaterialID, std::set<BatchMember*>> renderables_by_material_;
 
     /*
      * We store connections to material update signals, when all renderables are removed
-     * for a particular material, we disconnect the signal
+     * for a particular material, we disconnect the signal. The material is held so that
+     * it outlives the connection.
      */
     std::unordered_map<MaterialID, sig::connection> material_update_conections_;
+    std::unordered_map<MaterialID, MaterialPtr> materials_;
+
+    /*
+     * Material changes can happen on any thread (and while the material's pass lock is
+     * held) so we just record them here and rebatch on the next call to
+     * RenderQueue::apply_material_changes()
+     */
+    std::set<MaterialID> changed_materials_;
+
+    std::mutex lock_;
 
     void on_material_changed(MaterialID material);
 };
 
 
+enum RenderQueueBackend {
+    /* Renderables are kept in a std::map of render groups to lists of renderables */
+    RENDER_QUEUE_BACKEND_BATCHED,
+
+    /* Renderables are stored as flat commands which are radix sorted on a 64 bit key each frame */
+    RENDER_QUEUE_BACKEND_SORT_KEYS
+};
+
+class RenderCommandBuffer;
+
 class RenderQueue {
 public:
     typedef std::function<void (bool, const RenderGroup*, Renderable*, MaterialPass*, Light*, Iteration)> TraverseCallback;
 
-    RenderQueue(Stage* stage, RenderGroupFactory* render_group_factory);
+    RenderQueue(Stage* stage, RenderGroupFactory* render_group_factory, RenderQueueBackend backend=RENDER_QUEUE_BACKEND_BATCHED);
+    ~RenderQueue();
+
+    RenderQueueBackend backend() const { return backend_; }
 
     void insert_renderable(Renderable* renderable); // IMPORTANT, must update RenderGroups if they exist already
+    void remove_renderable(Renderable* renderable);
+
+    /*
+     * Inserts the renderable if it isn't in the queue yet, or moves it to the right
+     * batches if its material or render priority changed since it was inserted. Otherwise
+     * this does nothing, so it's cheap to call every frame on a persistent queue.
+     */
+    void update_renderable(Renderable* renderable);
+
+    /* Rebatches any renderables whose material was changed since the last call */
+    void apply_material_changes();
+
+    /* Removes any batches which were emptied by removing renderables */
+    void clean_empty_batches();
+
     void clear();
 
-    void traverse(RenderQueueVisitor* callback, uint64_t frame_id) const;
+    uint32_t renderable_count() const {
+        std::lock_guard<std::mutex> lock(queue_lock_);
+        return members_.size();
+    }
+
+    /*
+     * Visits everything which is visible in the frame. camera_position is only used by
+     * the sort key backend, which orders renderables sharing the same state front-to-back
+     */
+    void traverse(RenderQueueVisitor* callback, uint64_t frame_id, const Vec3& camera_position=Vec3()) const;
+
+    /* The number of (renderable, material pass) commands, only used by the sort key backend */
+    uint32_t command_count() const;
 
+    /* These are only populated by the batched backend */
     uint32_t pass_count() const { return batches_.size(); }
     uint32_t group_count(Pass pass_number) const {
         if(pass_number >= batches_.size()) {
@@ -230,11 +326,32 @@ private:
 
     Stage* stage_ = nullptr;
     RenderGroupFactory* render_group_factory_ = nullptr;
+    RenderQueueBackend backend_;
     BatchPasses batches_;
 
-    void clean_empty_batches();
+    /* Only used by the sort key backend. This is sorted during traversal */
+    std::unique_ptr<RenderCommandBuffer> command_buffer_;
+
+    /* Everything that was inserted, so we can detach them when the queue is destroyed */
+    std::unordered_set<BatchMember*> members_;
+
+    MaterialChangeWatcher material_watcher_;
+
+    bool has_empty_batches_ = false;
+
+    /* These must be called with the queue_lock_ held */
+    void do_insert_renderable(Renderable* renderable);
+    void do_remove_member(BatchMember* member);
+    void do_clear();
+
+    void traverse_batches(RenderQueueVisitor* visitor, uint64_t frame_id) const;
+    void traverse_commands(RenderQueueVisitor* visitor, uint64_t frame_id, const Vec3& camera_position) const;
+
+    void forget_member(BatchMember* member);
 
     mutable std::mutex queue_lock_;
+
+    friend class BatchMember;
 };
 
 }
@@ -19,6 +19,8 @@
 #pragma once
 
 #include <memory>
+#include <vector>
+#include <algorithm>
 #include "../../generic/property.h"
 #include "../../types.h"
 #include "../../interfaces.h"
@@ -56,6 +58,58 @@ private:
 };
 
 
+/*
+ * The lights affecting a renderable in a frame. This is rewritten for every visible
+ * renderable every frame, so it has a fixed capacity and never touches the heap.
+ */
+class LightList {
+public:
+    /* Copies the first MAX_LIGHTS_PER_RENDERABLE lights, the rest are ignored */
+    void assign(const LightPtr* lights, std::size_t count) {
+        count_ = (uint8_t) std::min(count, (std::size_t) MAX_LIGHTS_PER_RENDERABLE);
+        std::copy(lights, lights + count_, lights_);
+    }
+
+    void clear() { count_ = 0; }
+
+    bool push_back(const LightPtr& light) {
+        if(count_ == MAX_LIGHTS_PER_RENDERABLE) {
+            return false;
+        }
+
+        lights_[count_++] = light;
+        return true;
+    }
+
+    const LightPtr* data() const { return lights_; }
+    const LightPtr* begin() const { return lights_; }
+    const LightPtr* end() const { return lights_ + count_; }
+
+    const LightPtr& operator[](uint8_t i) const {
+        assert(i < count_);
+        return lights_[i];
+    }
+
+    uint8_t size() const { return count_; }
+    bool empty() const { return count_ == 0; }
+
+private:
+    LightPtr lights_[MAX_LIGHTS_PER_RENDERABLE];
+    uint8_t count_ = 0;
+};
+
+
+/* A run of indices, counted in indices rather than bytes */
+struct IndexRange {
+    uint32_t start = 0;
+    uint32_t count = 0;
+
+    bool operator==(const IndexRange& rhs) const {
+        return start == rhs.start && count == rhs.count;
+    }
+};
+
+
 class Renderable:
     public batcher::BatchMember,
     public virtual BoundableEntity {
@@ -70,10 +124,24 @@ public:
     virtual VertexSpecification vertex_attribute_specification() const = 0;
     virtual HardwareBuffer* vertex_attribute_buffer() const = 0;
 
+    /* Renderables can keep some of their vertex attributes in a second buffer, which
+     * is how animated meshes avoid re-uploading the attributes that don't change between
+     * frames. An attribute is read from whichever of the two specifications has it.
+     * The default (nullptr) keeps everything in vertex_attribute_buffer() */
+    virtual VertexSpecification static_vertex_attribute_specification() const { return VertexSpecification(); }
+    virtual HardwareBuffer* static_vertex_attribute_buffer() const { return nullptr; }
+
     virtual HardwareBuffer* index_buffer() const = 0;
     virtual std::size_t index_element_count() const = 0; ///< The number of indexes that should be rendered
     virtual IndexType index_type() const = 0; ///< The size of the index (e.g. 8bit, 16 bit)
 
+    /* Renderables which only want parts of their index buffer drawn return those ranges
+     * here, in the order they should be drawn. Every range uses the same vertex and index
+     * buffers, so the renderers draw them back to back without rebinding anything.
+     * The default (nullptr) draws the first index_element_count() indices, and when there
+     * are ranges index_element_count() should be the total of their counts. */
+    virtual const std::vector<IndexRange>* index_ranges() const { return nullptr; }
+
     virtual RenderPriority render_priority() const = 0;
     virtual Mat4 final_transformation() const = 0;
 
@@ -88,19 +156,44 @@ public:
         return frame_id == last_visible_frame_id_;
     }
 
-    void set_affected_by_lights(std::vector<LightPtr> lights) {
+    void set_affected_by_lights(const LightList& lights) {
         lights_affecting_this_frame_ = lights;
     }
 
-    std::vector<LightPtr> lights_affecting_this_frame() const {
+    void set_affected_by_lights(const std::vector<LightPtr>& lights) {
+        lights_affecting_this_frame_.assign(lights.data(), lights.size());
+    }
+
+    const LightList& lights_affecting_this_frame() const {
         return lights_affecting_this_frame_;
     }
 
 private:
     uint64_t last_visible_frame_id_ = 0;
-    std::vector<LightPtr> lights_affecting_this_frame_;
+    LightList lights_affecting_this_frame_;
 };
 
 typedef std::shared_ptr<Renderable> RenderablePtr;
 
+/* Calls func(start, count) for every run of indices that should be drawn for the
+ * renderable. Renderers (and anything mimicking them) should go through this rather
+ * than index_element_count() so that index ranges are respected */
+template<typename Func>
+void each_index_range(const Renderable* renderable, Func func) {
+    auto ranges = renderable->index_ranges();
+    if(!ranges) {
+        auto count = renderable->index_element_count();
+        if(count) {
+            func(0u, (uint32_t) count);
+        }
+        return;
+    }
+
+    for(auto& range: *ranges) {
+        if(range.count) {
+            func(range.start, range.count);
+        }
+    }
+}
+
 }
@@ -9,6 +9,7 @@
 #include "../../hardware_buffer.h"
 
 #include <vector>
+#include <algorithm>
 #include <cstdint>
 
 namespace smlt {
@@ -33,6 +34,11 @@ struct GL1HardwareBufferImpl : public HardwareBufferImpl {
         target->assign(data, data + (size * sizeof(uint8_t)));
     }
 
+    void upload_range(const std::size_t offset, const uint8_t* data, const std::size_t size) override {
+        std::vector<uint8_t>* target = (has_shadow_buffer()) ? &shadow_buffer_ : &target_buffer_;
+        std::copy(data, data + size, target->begin() + offset);
+    }
+
     bool has_shadow_buffer() const override { return has_shadow_buffer_; }
     BufferLocation shadow_buffer_location() const override { return BUFFER_LOCATION_RAM; }
     BufferLocation target_buffer_location() const override { return BUFFER_LOCATION_RAM; }
@@ -456,6 +456,43 @@ static GLenum convert_index_type(IndexType type) {
     }
 }
 
+static uint32_t index_type_size(IndexType type) {
+    switch(type) {
+    case INDEX_TYPE_8_BIT: return sizeof(GLubyte);
+    case INDEX_TYPE_16_BIT: return sizeof(GLushort);
+    case INDEX_TYPE_32_BIT: return sizeof(GLuint);
+    default:
+        assert(0 && "Invalid index type");
+        return sizeof(GLushort);
+    }
+}
+
+/* The only compact formats GL1XRenderer::supports_vertex_attribute() allows are unorm8
+ * colours and snorm16 normals, the client array functions normalize both. Meshes are
+ * quantized against that check, so anything else reaching here is a bug */
+static GLenum gl_attribute_type(const GL1XRenderer* renderer, VertexAttributeBit bit, VertexAttribute attr) {
+    if(attr == VERTEX_ATTRIBUTE_NONE) {
+        // The array is disabled, the type is never read
+        return GL_FLOAT;
+    }
+
+    if(!renderer->supports_vertex_attribute(bit, attr)) {
+        assert(0 && "Vertex attribute format isn't supported by the GL1 renderer");
+    }
+
+    switch(attr) {
+    case VERTEX_ATTRIBUTE_4UN8: return GL_UNSIGNED_BYTE;
+    case VERTEX_ATTRIBUTE_3SN16: return GL_SHORT;
+    default:
+        return GL_FLOAT;
+    }
+}
+
+static GLint gl_attribute_size(VertexAttribute attr) {
+    auto components = vertex_attribute_components(attr);
+    return (components) ? components : 4;
+}
+
 void GL1RenderQueueVisitor::do_visit(Renderable* renderable, MaterialPass* material_pass, batcher::Iteration iteration) {
     if(queue_if_blended(renderable, material_pass, iteration)) {
         // If this was a transparent object, and we were queuing then do nothing else for now
@@ -489,46 +526,70 @@ void GL1RenderQueueVisitor::do_visit(Renderable* renderable, MaterialPass* mater
     auto vertex_data = renderable->vertex_attribute_buffer()->map_target_for_read();
     auto index_data = renderable->index_buffer()->map_target_for_read();
 
-    (spec.has_positions()) ? enable_vertex_arrays() : disable_vertex_arrays();
-    (spec.has_diffuse()) ? enable_colour_arrays() : disable_colour_arrays();
-    (spec.has_normals()) ? enable_normal_arrays() : disable_normal_arrays();
+    /* Some renderables (animated actors) keep the attributes which never change in a
+     * second buffer, anything that isn't in the first is read from there */
+    auto static_buffer = renderable->static_vertex_attribute_buffer();
+    auto static_spec = (static_buffer) ? renderable->static_vertex_attribute_specification() : VertexSpecification();
+
+    std::unique_ptr<MappedBuffer> static_data;
+    if(static_buffer) {
+        static_data.reset(new MappedBuffer(static_buffer->map_target_for_read()));
+    }
+
+    auto pick = [&](bool in_vertex_data) -> const VertexSpecification& {
+        return (in_vertex_data || !static_data) ? spec : static_spec;
+    };
+
+    auto base = [&](const VertexSpecification& which) -> const uint8_t* {
+        return (&which == &spec) ? (const uint8_t*) vertex_data : (const uint8_t*) *static_data;
+    };
+
+    const VertexSpecification& position_spec = pick(spec.has_positions());
+    const VertexSpecification& diffuse_spec = pick(spec.has_diffuse());
+    const VertexSpecification& normal_spec = pick(spec.has_normals());
+
+    (position_spec.has_positions()) ? enable_vertex_arrays() : disable_vertex_arrays();
+    (diffuse_spec.has_diffuse()) ? enable_colour_arrays() : disable_colour_arrays();
+    (normal_spec.has_normals()) ? enable_normal_arrays() : disable_normal_arrays();
 
     GLCheck(
         glVertexPointer,
-        (spec.position_attribute == VERTEX_ATTRIBUTE_2F) ? 2 : (spec.position_attribute == VERTEX_ATTRIBUTE_3F) ? 3 : 4,
-        GL_FLOAT,
-        spec.stride(),
-        ((const uint8_t*) vertex_data) + spec.position_offset(false)
+        gl_attribute_size(position_spec.position_attribute),
+        gl_attribute_type(renderer_, VERTEX_ATTRIBUTE_BIT_POSITION, position_spec.position_attribute),
+        position_spec.stride(),
+        base(position_spec) + position_spec.position_offset(false)
     );
 
-    const uint8_t* colour_pointer = (spec.has_diffuse()) ?
-        ((const uint8_t*) vertex_data) + spec.diffuse_offset(false) :
+    const uint8_t* colour_pointer = (diffuse_spec.has_diffuse()) ?
+        base(diffuse_spec) + diffuse_spec.diffuse_offset(false) :
         nullptr;
 
     GLCheck(
         glColorPointer,
-        (spec.diffuse_attribute == VERTEX_ATTRIBUTE_2F) ? 2 : (spec.diffuse_attribute == VERTEX_ATTRIBUTE_3F) ? 3 : 4,
-        GL_FLOAT,
-        spec.stride(),
+        gl_attribute_size(diffuse_spec.diffuse_attribute),
+        gl_attribute_type(renderer_, VERTEX_ATTRIBUTE_BIT_DIFFUSE, diffuse_spec.diffuse_attribute),
+        diffuse_spec.stride(),
         colour_pointer
     );
 
-    const uint8_t* normal_pointer = (spec.has_normals()) ?
-        ((const uint8_t*) vertex_data) + spec.normal_offset(false) :
+    const uint8_t* normal_pointer = (normal_spec.has_normals()) ?
+        base(normal_spec) + normal_spec.normal_offset(false) :
         nullptr;
 
     GLCheck(
         glNormalPointer,
-        GL_FLOAT,
-        spec.stride(),
+        gl_attribute_type(renderer_, VERTEX_ATTRIBUTE_BIT_NORMAL, normal_spec.normal_attribute),
+        normal_spec.stride(),
         normal_pointer
     );
 
     for(uint8_t i = 0; i < MAX_TEXTURE_UNITS; ++i) {
-        bool enabled = spec.has_texcoordX(i);
-        auto offset = spec.texcoordX_offset(i, false);
+        const VertexSpecification& texcoord_spec = pick(spec.has_texcoordX(i));
+
+        bool enabled = texcoord_spec.has_texcoordX(i);
+        auto offset = texcoord_spec.texcoordX_offset(i, false);
         const uint8_t* coord_pointer = (enabled) ?
-            ((const uint8_t*) vertex_data) + offset :
+            base(texcoord_spec) + offset :
             nullptr;
 
         (enabled) ? enable_texcoord_array(i) : disable_texcoord_array(i);
@@ -537,22 +598,28 @@ void GL1RenderQueueVisitor::do_visit(Renderable* renderable, MaterialPass* mater
             GLCheck(glClientActiveTexture, GL_TEXTURE0 + i);
             GLCheck(
                 glTexCoordPointer,
-                (spec.texcoordX_attribute(i) == VERTEX_ATTRIBUTE_2F) ? 2 : (spec.texcoordX_attribute(i) == VERTEX_ATTRIBUTE_3F) ? 3 : 4,
-                GL_FLOAT,
-                spec.stride(),
+                gl_attribute_size(texcoord_spec.texcoordX_attribute(i)),
+                gl_attribute_type(renderer_, VertexAttributeBit(VERTEX_ATTRIBUTE_BIT_TEXCOORD0 << i), texcoord_spec.texcoordX_attribute(i)),
+                texcoord_spec.stride(),
                 coord_pointer
             );
         }
     }
 
     auto arrangement = convert_arrangement(renderable->arrangement());
-    GLCheck(
-        glDrawElements,
-        arrangement,
-        element_count,
-        convert_index_type(renderable->index_type()),
-        (const void*) index_data
-    );
+    auto index_type = convert_index_type(renderable->index_type());
+    auto index_size = index_type_size(renderable->index_type());
+
+    // The client arrays are all set up, so each range is just an offset into the indices
+    each_index_range(renderable, [&](uint32_t start, uint32_t count) {
+        GLCheck(
+            glDrawElements,
+            arrangement,
+            count,
+            index_type,
+            (const void*) (((const uint8_t*) index_data) + (start * index_size))
+        );
+    });
 
     renderer_->window->stats->increment_polygons_rendered(renderable->arrangement(), element_count);
 }
@@ -41,6 +41,17 @@ public:
     std::string name() const override {
         return "gl1x";
     }
+
+    bool supports_vertex_attribute(VertexAttributeBit attribute, VertexAttribute format) const override {
+        switch(format) {
+        case VERTEX_ATTRIBUTE_4UN8:
+            return attribute == VERTEX_ATTRIBUTE_BIT_DIFFUSE || attribute == VERTEX_ATTRIBUTE_BIT_SPECULAR;
+        case VERTEX_ATTRIBUTE_3SN16:
+            return attribute == VERTEX_ATTRIBUTE_BIT_NORMAL;
+        default:
+            return vertex_attribute_is_float(format);
+        }
+    }
 private:
     std::unique_ptr<HardwareBufferManager> buffer_manager_;
 
@@ -18,6 +18,8 @@
 //
 
 #include <cassert>
+#include <algorithm>
+#include <memory>
 #include "buffer_manager.h"
 #include "../renderer.h"
 #include "../../utils/gl_error.h"
@@ -91,11 +93,129 @@ static GLenum convert_usage(HardwareBufferUsage usage) {
     }
 }
 
-GL2BufferManager::GL2BufferManager(const Renderer* renderer):
-    HardwareBufferManager(renderer) {
+/*
+ * Holds a streaming ring's data in a VBO of its own, created the first time something is
+ * streamed into it.
+ *
+ * GL 2.1 and GLES 2 have no sync objects, so there's no fence to wait on before a region
+ * is reused. With three regions the region being written was last drawn from two frames
+ * ago, and drivers don't queue up more frames than that.
+ */
+class GL2StreamingBackend : public StreamingRingBackend {
+public:
+    GL2StreamingBackend(GLenum target, std::size_t size, bool accounting_only):
+        target_(target),
+        size_(size),
+        accounting_only_(accounting_only) {}
+
+    ~GL2StreamingBackend() {
+        if(buffer_id_ && GLThreadCheck::is_current()) {
+            GLCheck(glDeleteBuffers, 1, &buffer_id_);
+        }
+    }
+
+    void upload(std::size_t offset, const uint8_t* data, std::size_t size) override {
+        if(accounting_only_) {
+            return;
+        }
+
+        if(!buffer_id_) {
+            GLCheck(glGenBuffers, 1, &buffer_id_);
+            GLCheck(glBindBuffer, target_, buffer_id_);
+            GLCheck(glBufferData, target_, size_, nullptr, GL_STREAM_DRAW);
+        } else {
+            GLCheck(glBindBuffer, target_, buffer_id_);
+        }
+
+        GLCheck(glBufferSubData, target_, offset, size, data);
+    }
+
+    void fence(uint64_t) override {}
+    void wait(uint64_t) override {}
+
+    GLuint buffer_id() const { return buffer_id_; }
+
+private:
+    GLenum target_;
+    std::size_t size_;
+    bool accounting_only_;
+
+    GLuint buffer_id_ = 0;
+};
+
+static BufferPoolKey pool_key(HardwareBufferPurpose purpose, HardwareBufferUsage usage) {
+    return (BufferPoolKey(purpose) << 16) | BufferPoolKey(usage);
+}
+
+GL2BufferManager::GL2BufferManager(const Renderer* renderer, bool accounting_only, std::size_t page_size, std::size_t streaming_region_size):
+    HardwareBufferManager(renderer),
+    accounting_only_(accounting_only),
+    pages_(page_size) {
+
+    const GLenum targets[] = {GL_ARRAY_BUFFER, GL_ELEMENT_ARRAY_BUFFER};
+    for(uint32_t i = 0; i < 2; ++i) {
+        streaming_backends_[i].reset(new GL2StreamingBackend(targets[i], streaming_region_size * 3, accounting_only));
+        streaming_rings_[i].reset(new StreamingRing(streaming_backends_[i].get(), streaming_region_size, 3));
+    }
+}
+
+GL2BufferManager::~GL2BufferManager() {
 
 }
 
+const StreamingRing& GL2BufferManager::streaming_ring(HardwareBufferPurpose purpose) const {
+    return *streaming_rings_[(purpose == HARDWARE_BUFFER_VERTEX_ARRAY_INDICES) ? 1 : 0];
+}
+
+BufferPageStats GL2BufferManager::page_stats() const {
+    std::lock_guard<std::mutex> lock(mutex_);
+    return pages_.stats();
+}
+
+BufferPageStats GL2BufferManager::page_stats(HardwareBufferPurpose purpose, HardwareBufferUsage usage) const {
+    std::lock_guard<std::mutex> lock(mutex_);
+    return pages_.stats(pool_key(purpose, usage));
+}
+
+void GL2BufferManager::run_on_gl_thread(const std::function<void ()>& func) {
+    if(accounting_only_ || GLThreadCheck::is_current()) {
+        func();
+    } else {
+        auto& idle_manager = renderer->window->idle;
+        idle_manager->run_sync(func);
+    }
+}
+
+void GL2BufferManager::assign_block(GL2HardwareBufferImpl* buffer, BufferPoolKey pool, std::size_t size) {
+    bool created_page = false;
+    auto block = pages_.allocate(pool, size, &created_page);
+
+    if(created_page) {
+        GLuint buffer_id = 0;
+        if(!accounting_only_) {
+            GLCheck(glGenBuffers, 1, &buffer_id);
+            GLCheck(glBindBuffer, buffer->purpose, buffer_id);
+            GLCheck(glBufferData, buffer->purpose, pages_.page_size(block.page), nullptr, buffer->usage);
+        }
+        page_buffers_[block.page] = buffer_id;
+    }
+
+    buffer->block = block;
+    buffer->buffer_id = page_buffers_.at(block.page);
+    buffer->offset = block.offset;
+    buffer->capacity = block.size;
+}
+
+void GL2BufferManager::release_block(const BufferBlock& block) {
+    if(pages_.release(block)) {
+        auto it = page_buffers_.find(block.page);
+        if(!accounting_only_) {
+            GLCheck(glDeleteBuffers, 1, &it->second);
+        }
+        page_buffers_.erase(it);
+    }
+}
+
 std::unique_ptr<HardwareBufferImpl> GL2BufferManager::do_allocation(
         std::size_t size,
         HardwareBufferPurpose purpose,
@@ -105,106 +225,373 @@ std::unique_ptr<HardwareBufferImpl> GL2BufferManager::do_allocation(
     std::unique_ptr<GL2HardwareBufferImpl> buffer_impl(new GL2HardwareBufferImpl(this));
 
     buffer_impl->size = size;
-    buffer_impl->capacity = size; // FIXME: Should probably round to some boundary
-    buffer_impl->offset = 0;
-    buffer_impl->usage = convert_usage(usage);
-    buffer_impl->purpose = convert_purpose(purpose);
+    buffer_impl->usage = (accounting_only_) ? 0 : convert_usage(usage);
+    buffer_impl->purpose = (accounting_only_) ? 0 : convert_purpose(purpose);
+
+    auto pool = pool_key(purpose, usage);
 
-    auto allocate_buffers = [&buffer_impl, shadow_buffer, size]() {
-        GLCheck(glGenBuffers, 1, &buffer_impl->buffer_id);
-        GLCheck(glBindBuffer, buffer_impl->purpose, buffer_impl->buffer_id);
-        GLCheck(glBufferData, buffer_impl->purpose, buffer_impl->capacity, nullptr, buffer_impl->usage);
+    // Anything rewritten every frame goes through the streaming ring
+    if(usage == HARDWARE_BUFFER_MODIFY_REPEATEDLY_USED_FOR_RENDERING && purpose != HARDWARE_BUFFER_TEXTURE_DATA) {
+        buffer_impl->ring_ = streaming_rings_[(purpose == HARDWARE_BUFFER_VERTEX_ARRAY_INDICES) ? 1 : 0].get();
+        buffer_impl->stream_data_.resize(size, 0);
+    }
 
-        if(shadow_buffer != SHADOW_BUFFER_DISABLED) {
+    run_on_gl_thread([this, &buffer_impl, pool, shadow_buffer, size]() {
+        std::lock_guard<std::mutex> lock(mutex_);
+        assign_block(buffer_impl.get(), pool, size);
+
+        // Streamed buffers already keep their data in RAM
+        if(shadow_buffer != SHADOW_BUFFER_DISABLED && !buffer_impl->is_streamed()) {
             buffer_impl->shadow_buffer_.resize(size, 0);
             buffer_impl->has_shadow_buffer_ = true;
         }
-    };
-
-    if(GLThreadCheck::is_current()) {
-        allocate_buffers();
-    } else {
-        auto& idle_manager = renderer->window->idle;
-        idle_manager->run_sync(allocate_buffers);
-    }
+    });
 
     return std::move(buffer_impl);
 }
 
 void GL2BufferManager::do_release(const HardwareBufferImpl *buffer) {
     auto gl2_buffer = static_cast<const GL2HardwareBufferImpl*>(buffer);
-    if(GLThreadCheck::is_current()) {
-        GLCheck(glDeleteBuffers, 1, &gl2_buffer->buffer_id);
-    } else {
-        auto& idle_manager = renderer->window->idle;
-        // Make sure we run the GL stuff on the main thread
-        idle_manager->run_sync([&]() {
-            GLCheck(glDeleteBuffers, 1, &gl2_buffer->buffer_id);
-        });
-    }
+
+    // Make sure we run the GL stuff on the main thread
+    run_on_gl_thread([this, gl2_buffer]() {
+        std::lock_guard<std::mutex> lock(mutex_);
+        dirty_buffers_.erase(const_cast<GL2HardwareBufferImpl*>(gl2_buffer));
+        release_block(gl2_buffer->block);
+    });
 }
 
 void GL2BufferManager::do_resize(HardwareBufferImpl* buffer, std::size_t new_size) {
     auto gl2_buffer = static_cast<GL2HardwareBufferImpl*>(buffer);
 
-    auto resize_buffer = [gl2_buffer, new_size]() {
-        if(new_size == gl2_buffer->capacity) {
+    auto resize_in_place = [this, gl2_buffer, new_size]() -> bool {
+        // Shrinking, or there's free space after the buffer in its page, so nothing needs to move
+        if(pages_.resize_in_place(gl2_buffer->block, new_size)) {
+            if(gl2_buffer->has_shadow_buffer_) {
+                // Anything past the old size is new, and zeroed, so it has to go up too
+                if(new_size > gl2_buffer->size) {
+                    mark_shadow_dirty(gl2_buffer, gl2_buffer->size, new_size);
+                }
+                gl2_buffer->dirty_ranges_.truncate(new_size);
+            }
+
+            gl2_buffer->size = new_size;
+            gl2_buffer->capacity = gl2_buffer->block.size;
+            return true;
+        }
+
+        return false;
+    };
+
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+
+        if(gl2_buffer->is_streamed()) {
+            // The stream data is what gets uploaded, so that's all that needs to keep the contents
+            gl2_buffer->stream_data_.resize(new_size, 0);
+            gl2_buffer->stream_dirty_ = true;
+        }
+
+        if(gl2_buffer->has_shadow_buffer_) {
+            gl2_buffer->shadow_buffer_.resize(new_size, 0);
+        }
+
+        // This doesn't need GL, so there's no need to wait for the render thread
+        if(resize_in_place()) {
             return;
         }
+    }
 
-        //FIXME: If supported this should use glCopyBufferSubData for performance
-        GLCheck(glBindBuffer, gl2_buffer->purpose, gl2_buffer->buffer_id);
+    run_on_gl_thread([this, gl2_buffer, new_size, resize_in_place]() {
+        std::lock_guard<std::mutex> lock(mutex_);
 
-        // Read the data from the existing buffer so we can retain it
-        std::vector<uint8_t> existing(gl2_buffer->size);
-        GLCheck(glGetBufferSubData, gl2_buffer->purpose, gl2_buffer->offset, gl2_buffer->size, &existing[0]);
+        // Something may have been freed up while waiting
+        if(resize_in_place()) {
+            return;
+        }
 
-        // Resize to the new size, either truncating the data, or extending it with zeroes
-        existing.resize(new_size, 0);
+        auto old_block = gl2_buffer->block;
+        auto old_buffer_id = gl2_buffer->buffer_id;
+        auto old_size = gl2_buffer->size;
 
-        // Update the size of the allocated buffer
+        assign_block(gl2_buffer, pages_.pool(old_block.page), new_size);
         gl2_buffer->size = new_size;
-        gl2_buffer->capacity = new_size; //FIXME: Should probably round up (like do_allocate)
 
-        // Upload the new data to the existing buffer
-        GLCheck(glBufferData, gl2_buffer->purpose, gl2_buffer->capacity, &existing[0], gl2_buffer->usage);
-    };
+        if(gl2_buffer->has_shadow_buffer_) {
+            // The shadow buffer has everything, so there's no need to read anything back
+            gl2_buffer->dirty_ranges_.clear();
+            mark_shadow_dirty(gl2_buffer, 0, new_size);
+        } else if(!accounting_only_ && !gl2_buffer->is_streamed() && old_size) {
+            //FIXME: If supported this should use glCopyBufferSubData for performance
+            std::vector<uint8_t> existing(old_size);
+
+            GLCheck(glBindBuffer, gl2_buffer->purpose, old_buffer_id);
+            GLCheck(glGetBufferSubData, gl2_buffer->purpose, old_block.offset, old_size, &existing[0]);
+
+            GLCheck(glBindBuffer, gl2_buffer->purpose, gl2_buffer->buffer_id);
+            GLCheck(glBufferSubData, gl2_buffer->purpose, gl2_buffer->offset, old_size, &existing[0]);
+        }
+
+        release_block(old_block);
+    });
+}
+
+void GL2BufferManager::place_streamed_buffer(GL2HardwareBufferImpl* buffer) {
+    auto ring = buffer->ring_;
+
+    if(!buffer->stream_dirty_) {
+        // Already in the ring for this frame, or in the block (which doesn't go stale)
+        if(!buffer->in_ring_ || (ring->in_frame() && buffer->streamed_frame_ == ring->frame())) {
+            return;
+        }
+    }
+
+    auto size = buffer->size;
+    auto data = buffer->stream_data_.data();
+
+    std::size_t ring_offset = 0;
+    if(size && ring->stream(data, size, &ring_offset)) {
+        auto backend = streaming_backends_[(ring == streaming_rings_[0].get()) ? 0 : 1].get();
 
-    if(GLThreadCheck::is_current()) {
-        resize_buffer();
+        buffer->in_ring_ = true;
+        buffer->streamed_frame_ = ring->frame();
+        buffer->buffer_id = backend->buffer_id();
+        buffer->offset = ring_offset;
     } else {
-        auto& idle_manager = renderer->window->idle;
-        idle_manager->run_sync(resize_buffer);
+        // The ring is full (or we're outside of a frame) so upload to the block like any other buffer
+        buffer->in_ring_ = false;
+        buffer->buffer_id = page_buffers_.at(buffer->block.page);
+        buffer->offset = buffer->block.offset;
+
+        if(size && !accounting_only_) {
+            GLCheck(glBindBuffer, buffer->purpose, buffer->buffer_id);
+            GLCheck(glBufferSubData, buffer->purpose, buffer->offset, size, data);
+        }
     }
+
+    buffer->stream_dirty_ = false;
+}
+
+void GL2BufferManager::mark_shadow_dirty(GL2HardwareBufferImpl* buffer, std::size_t begin, std::size_t end) {
+    buffer->dirty_ranges_.add(begin, end);
+    dirty_buffers_.insert(buffer);
+}
+
+void GL2BufferManager::flush_shadow_buffer(GL2HardwareBufferImpl* buffer) {
+    auto& ranges = buffer->dirty_ranges_.ranges();
+
+    if(!accounting_only_ && !ranges.empty()) {
+        GLCheck(glBindBuffer, buffer->purpose, buffer->buffer_id);
+    }
+
+    for(auto& range: ranges) {
+        if(!accounting_only_) {
+            GLCheck(
+                glBufferSubData, buffer->purpose, buffer->offset + range.first,
+                range.second - range.first, &buffer->shadow_buffer_[range.first]
+            );
+        }
+
+        ++shadow_uploads_;
+    }
+
+    buffer->dirty_ranges_.clear();
+}
+
+void GL2BufferManager::flush_shadow_buffers() {
+    std::lock_guard<std::mutex> lock(mutex_);
+
+    for(auto buffer: dirty_buffers_) {
+        flush_shadow_buffer(buffer);
+    }
+
+    dirty_buffers_.clear();
 }
 
 void GL2BufferManager::do_bind(const HardwareBufferImpl *buffer, HardwareBufferPurpose purpose) {
-    auto gl2_buffer = static_cast<const GL2HardwareBufferImpl*>(buffer);
-    if(GLThreadCheck::is_current()) {
-        GLCheck(glBindBuffer, convert_purpose(purpose), gl2_buffer->buffer_id);
-    } else {
-        auto& idle_manager = renderer->window->idle;
-        // If we're uploading in a background thread, make sure we run the GL stuff on the main thread
-        idle_manager->run_sync([&]() {
+    /* Binding is where a streamed buffer finds out where it lives this frame, so its
+     * buffer ID and offset can change here */
+    auto gl2_buffer = const_cast<GL2HardwareBufferImpl*>(
+        static_cast<const GL2HardwareBufferImpl*>(buffer)
+    );
+
+    // If we're uploading in a background thread, make sure we run the GL stuff on the main thread
+    run_on_gl_thread([gl2_buffer, purpose, this]() {
+        if(gl2_buffer->is_streamed()) {
+            std::lock_guard<std::mutex> lock(mutex_);
+            place_streamed_buffer(gl2_buffer);
+        } else if(gl2_buffer->has_shadow_buffer_) {
+            // Written to since the frame started
+            std::lock_guard<std::mutex> lock(mutex_);
+            if(dirty_buffers_.erase(gl2_buffer)) {
+                flush_shadow_buffer(gl2_buffer);
+            }
+        }
+
+        if(!accounting_only_) {
             GLCheck(glBindBuffer, convert_purpose(purpose), gl2_buffer->buffer_id);
-        });
+        }
+    });
+}
+
+void GL2BufferManager::do_begin_frame(uint64_t frame) {
+    flush_shadow_buffers();
+
+    std::lock_guard<std::mutex> lock(mutex_);
+    for(auto& ring: streaming_rings_) {
+        ring->begin_frame(frame);
     }
 }
 
+void GL2BufferManager::do_end_frame() {
+    std::size_t streamed = 0, overflowed = 0;
+
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        for(auto& ring: streaming_rings_) {
+            ring->end_frame();
+            streamed += ring->bytes_streamed();
+            overflowed += ring->bytes_overflowed();
+        }
+    }
+
+    if(renderer) {
+        renderer->window->stats->set_streamed_bytes(streamed, overflowed);
+    }
+}
+
+uint8_t* GL2HardwareBufferImpl::begin_write(const std::size_t size) {
+    if(has_shadow_buffer_) {
+        // Uploaded with the next flush
+        return shadow_buffer_.data();
+    }
+
+    if(!is_streamed()) {
+        return HardwareBufferImpl::begin_write(size);
+    }
+
+    // Streamed buffers are written in place, there's nothing to upload until they're bound
+    assert(size <= stream_data_.size());
+    return stream_data_.data();
+}
+
+void GL2HardwareBufferImpl::end_write(const std::size_t size) {
+    if(has_shadow_buffer_) {
+        auto gl2_manager = static_cast<GL2BufferManager*>(manager);
+        std::lock_guard<std::mutex> lock(gl2_manager->mutex_);
+        gl2_manager->mark_shadow_dirty(this, 0, size);
+        return;
+    }
+
+    if(!is_streamed()) {
+        HardwareBufferImpl::end_write(size);
+        return;
+    }
+
+    std::lock_guard<std::mutex> lock(static_cast<GL2BufferManager*>(manager)->mutex_);
+    stream_dirty_ = true;
+}
+
 void GL2HardwareBufferImpl::upload(const uint8_t *data, const std::size_t size) {
     assert(size <= capacity);
+    upload_range(0, data, size);
+}
 
-    if(GLThreadCheck::is_current()) {
+void GL2HardwareBufferImpl::upload_range(const std::size_t offset, const uint8_t* data, const std::size_t size) {
+    assert(offset + size <= capacity);
+
+    auto gl2_manager = static_cast<GL2BufferManager*>(manager);
+
+    if(is_streamed()) {
+        std::lock_guard<std::mutex> lock(gl2_manager->mutex_);
+        std::copy(data, data + size, stream_data_.begin() + offset);
+        stream_dirty_ = true;
+        return;
+    }
+
+    if(has_shadow_buffer_) {
+        // Only touches RAM, so this is fine from any thread
+        std::lock_guard<std::mutex> lock(gl2_manager->mutex_);
+        std::copy(data, data + size, shadow_buffer_.begin() + offset);
+        gl2_manager->mark_shadow_dirty(this, offset, offset + size);
+        return;
+    }
+
+    if(gl2_manager->is_accounting_only()) {
+        return;
+    }
+
+    // If we're uploading in a background thread, make sure we run the GL stuff on the main thread
+    gl2_manager->run_on_gl_thread([&]() {
         GLCheck(glBindBuffer, purpose, buffer_id);
-        GLCheck(glBufferSubData, purpose, offset, size, data);
-    } else {
-        auto& idle_manager = manager->renderer->window->idle;
-        // If we're uploading in a background thread, make sure we run the GL stuff on the main thread
-        idle_manager->run_sync([&]() {
+        GLCheck(glBufferSubData, purpose, this->offset + offset, size, data);
+    });
+}
+
+void GL2HardwareBufferImpl::update_target_from_shadow_buffer() {
+    auto gl2_manager = static_cast<GL2BufferManager*>(manager);
+
+    // Off the render thread there's nothing to do, the next flush will take care of it
+    if(!gl2_manager->is_accounting_only() && !GLThreadCheck::is_current()) {
+        return;
+    }
+
+    std::lock_guard<std::mutex> lock(gl2_manager->mutex_);
+    if(gl2_manager->dirty_buffers_.erase(this)) {
+        gl2_manager->flush_shadow_buffer(this);
+    }
+}
+
+void GL2HardwareBufferImpl::destroy_shadow_buffer() {
+    if(!has_shadow_buffer_) {
+        return;
+    }
+
+    auto gl2_manager = static_cast<GL2BufferManager*>(manager);
+
+    // Anything not uploaded yet would be lost with it
+    gl2_manager->run_on_gl_thread([this, gl2_manager]() {
+        std::lock_guard<std::mutex> lock(gl2_manager->mutex_);
+        if(gl2_manager->dirty_buffers_.erase(this)) {
+            gl2_manager->flush_shadow_buffer(this);
+        }
+
+        has_shadow_buffer_ = false;
+        shadow_buffer_.clear();
+        shadow_buffer_.shrink_to_fit();
+    });
+}
+
+MappedBuffer GL2HardwareBufferImpl::map_target_for_read() const {
+    if(has_shadow_buffer_) {
+        return MappedBuffer(
+            [this]() -> const uint8_t* { return shadow_buffer_.data(); },
+            []() {}
+        );
+    }
+
+    if(is_streamed()) {
+        return MappedBuffer(
+            [this]() -> const uint8_t* { return stream_data_.data(); },
+            []() {}
+        );
+    }
+
+    // No copy in RAM, so read the target back from the GPU
+    auto gl2_manager = static_cast<GL2BufferManager*>(manager);
+    auto data = std::make_shared<std::vector<uint8_t>>(size);
+
+    if(!gl2_manager->is_accounting_only() && size) {
+        gl2_manager->run_on_gl_thread([this, data]() {
             GLCheck(glBindBuffer, purpose, buffer_id);
-            GLCheck(glBufferSubData, purpose, offset, size, data);
+            GLCheck(glGetBufferSubData, purpose, offset, size, data->data());
         });
     }
+
+    return MappedBuffer(
+        [data]() -> const uint8_t* { return data->data(); },
+        [data]() { data->clear(); }
+    );
 }
 
 }
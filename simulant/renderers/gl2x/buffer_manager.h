@@ -18,59 +18,143 @@
 
 #pragma once
 
+#include <map>
+#include <set>
+#include <mutex>
+#include <functional>
+
 #include "../glad/glad/glad.h"
 #include "../../hardware_buffer.h"
+#include "buffer_pages.h"
+#include "streaming_ring.h"
+#include "dirty_ranges.h"
 
 namespace smlt {
 
+class GL2StreamingBackend;
+
 struct GL2HardwareBufferImpl : public HardwareBufferImpl {
-    GLuint buffer_id; // The ID of the VBO we are using
-    std::size_t offset; // The offset into the VBO that this hardware buffer begins
+    GLuint buffer_id = 0; // The ID of the VBO we are using, this is shared with the other buffers in the page
     GLenum usage; // The usage of this buffer
     GLenum purpose; // The purpose of this buffer
+    BufferBlock block; // Where in the page this buffer lives
 
     GL2HardwareBufferImpl(HardwareBufferManager* manager):
         HardwareBufferImpl(manager) {}
 
     void upload(const uint8_t *data, const std::size_t size) override;
+    void upload_range(const std::size_t offset, const uint8_t* data, const std::size_t size) override;
+    uint8_t* begin_write(const std::size_t size) override;
+    void end_write(const std::size_t size) override;
+
+    /* Streamed buffers are rewritten every frame, and are placed in the manager's
+     * streaming ring when they're bound rather than living in their block */
+    bool is_streamed() const { return ring_ != nullptr; }
+    bool is_in_ring() const { return in_ring_; }
 
     virtual bool has_shadow_buffer() const override { return has_shadow_buffer_; }
     virtual BufferLocation shadow_buffer_location() const override { return BUFFER_LOCATION_RAM; }
     virtual BufferLocation target_buffer_location() const override { return BUFFER_LOCATION_VRAM; }
-    virtual void update_target_from_shadow_buffer() override {
-        //fixme: IMPLEMENT!
-    }
-
-    virtual void destroy_shadow_buffer() override  {
-        has_shadow_buffer_ = false;
-        shadow_buffer_.clear();
-    }
-
-    virtual MappedBuffer map_target_for_read() const {
-        //FIXME: implement
-        return MappedBuffer(
-            []() -> uint8_t* { return nullptr; },
-            [](){}
-        );
-    }
+
+    /* Writes to a buffer with a shadow buffer only go to RAM, and the ranges written are
+     * uploaded by the manager once per frame (or when the buffer is bound). This uploads
+     * them now, if called on the render thread */
+    virtual void update_target_from_shadow_buffer() override;
+    virtual void destroy_shadow_buffer() override;
+
+    /* With a shadow buffer this is the shadow buffer, which is what the target will hold
+     * once it's been updated. Otherwise the target is read back from the GPU */
+    virtual MappedBuffer map_target_for_read() const override;
+
 private:
     bool has_shadow_buffer_ = false;
-    mutable std::vector<uint8_t> shadow_buffer_; // Rarely used
+    mutable std::vector<uint8_t> shadow_buffer_;
+    DirtyRanges dirty_ranges_ = DirtyRanges(256);
+
+    StreamingRing* ring_ = nullptr; // Only set for streamed buffers
+    bool in_ring_ = false; // Whether the ring (rather than the block) holds the data
+    bool stream_dirty_ = false;
+    uint64_t streamed_frame_ = 0;
+    std::vector<uint8_t> stream_data_; // The contents of a streamed buffer, copied to the ring each frame
 
     friend class GL2BufferManager;
 };
 
+/*
+ * Buffers are sub-allocated from large VBOs ("pages"), one set of pages for each purpose
+ * and usage, rather than each buffer having a VBO of its own. Each buffer's offset is
+ * where it starts in its page's VBO.
+ *
+ * If accounting_only is set, no GL calls are made at all and only the page accounting is
+ * done. That's so the allocation behaviour can be tested without a GL context.
+ */
 class GL2BufferManager:
     public smlt::HardwareBufferManager {
 
 public:
-    GL2BufferManager(const Renderer* renderer);
+    static const std::size_t DEFAULT_PAGE_SIZE = 1024 * 1024;
+    static const std::size_t DEFAULT_STREAMING_REGION_SIZE = 1024 * 1024;
+
+    GL2BufferManager(
+        const Renderer* renderer,
+        bool accounting_only=false,
+        std::size_t page_size=DEFAULT_PAGE_SIZE,
+        std::size_t streaming_region_size=DEFAULT_STREAMING_REGION_SIZE
+    );
+
+    ~GL2BufferManager();
+
+    bool is_accounting_only() const { return accounting_only_; }
+
+    BufferPageStats page_stats() const;
+    BufferPageStats page_stats(HardwareBufferPurpose purpose, HardwareBufferUsage usage) const;
+
+    const StreamingRing& streaming_ring(HardwareBufferPurpose purpose) const;
+
+    /* Uploads whatever has been written to shadow buffers since the last flush. Happens
+     * at the start of every frame, must be called on the render thread */
+    void flush_shadow_buffers();
+
+    /* The number of uploads made by flushes, after merging the ranges written */
+    uint32_t shadow_upload_count() const { return shadow_uploads_; }
 
 private:
     std::unique_ptr<HardwareBufferImpl> do_allocation(std::size_t size, HardwareBufferPurpose purpose, ShadowBufferEnableOption shadow_buffer, HardwareBufferUsage usage);
     void do_release(const HardwareBufferImpl *buffer);
     void do_resize(HardwareBufferImpl* buffer, std::size_t new_size);
     void do_bind(const HardwareBufferImpl *buffer, HardwareBufferPurpose purpose);
+    void do_begin_frame(uint64_t frame);
+    void do_end_frame();
+
+    void run_on_gl_thread(const std::function<void ()>& func);
+
+    /* Assigns a block (and a VBO) to the buffer, must be called with the mutex held */
+    void assign_block(GL2HardwareBufferImpl* buffer, BufferPoolKey pool, std::size_t size);
+    void release_block(const BufferBlock& block);
+
+    /* Puts a streamed buffer's data in the ring for this frame, or in its block if it
+     * doesn't fit. Must be called with the mutex held */
+    void place_streamed_buffer(GL2HardwareBufferImpl* buffer);
+
+    /* Must be called with the mutex held */
+    void mark_shadow_dirty(GL2HardwareBufferImpl* buffer, std::size_t begin, std::size_t end);
+    void flush_shadow_buffer(GL2HardwareBufferImpl* buffer);
+
+    bool accounting_only_;
+
+    mutable std::mutex mutex_;
+    BufferPageAllocator pages_;
+    std::map<BufferPageID, GLuint> page_buffers_;
+
+    /* Buffers whose shadow buffers have been written to since the last flush */
+    std::set<GL2HardwareBufferImpl*> dirty_buffers_;
+    uint32_t shadow_uploads_ = 0;
+
+    /* One ring for vertex attributes and one for indices */
+    std::unique_ptr<GL2StreamingBackend> streaming_backends_[2];
+    std::unique_ptr<StreamingRing> streaming_rings_[2];
+
+    friend struct GL2HardwareBufferImpl;
 };
 
 }
@@ -0,0 +1,266 @@
+#include <cassert>
+#include <algorithm>
+#include <stdexcept>
+
+#include "buffer_pages.h"
+
+namespace smlt {
+
+BufferPage::BufferPage(std::size_t size, bool dedicated):
+    size_(size),
+    free_bytes_(0),
+    dedicated_(dedicated) {
+
+    insert_free(0, size);
+}
+
+void BufferPage::insert_free(std::size_t offset, std::size_t size) {
+    free_by_offset_.insert(std::make_pair(offset, size));
+    free_by_size_.insert(std::make_pair(size, offset));
+    free_bytes_ += size;
+}
+
+void BufferPage::erase_free(std::map<std::size_t, std::size_t>::iterator it) {
+    auto range = free_by_size_.equal_range(it->second);
+    for(auto s = range.first; s != range.second; ++s) {
+        if(s->second == it->first) {
+            free_by_size_.erase(s);
+            break;
+        }
+    }
+
+    free_bytes_ -= it->second;
+    free_by_offset_.erase(it);
+}
+
+bool BufferPage::allocate(std::size_t size, std::size_t* offset) {
+    auto best = free_by_size_.lower_bound(size);
+    if(best == free_by_size_.end()) {
+        return false;
+    }
+
+    auto start = best->second;
+    auto available = best->first;
+
+    erase_free(free_by_offset_.find(start));
+
+    if(available > size) {
+        insert_free(start + size, available - size);
+    }
+
+    *offset = start;
+    return true;
+}
+
+void BufferPage::release(std::size_t offset, std::size_t size) {
+    assert(offset + size <= size_);
+
+    // Merge with the free range after this one
+    auto next = free_by_offset_.find(offset + size);
+    if(next != free_by_offset_.end()) {
+        size += next->second;
+        erase_free(next);
+    }
+
+    // ...and the one before
+    auto prev = free_by_offset_.lower_bound(offset);
+    if(prev != free_by_offset_.begin()) {
+        --prev;
+        if(prev->first + prev->second == offset) {
+            offset = prev->first;
+            size += prev->second;
+            erase_free(prev);
+        }
+    }
+
+    insert_free(offset, size);
+}
+
+bool BufferPage::grow(std::size_t offset, std::size_t size, std::size_t new_size) {
+    assert(new_size > size);
+
+    auto next = free_by_offset_.find(offset + size);
+    if(next == free_by_offset_.end()) {
+        return false;
+    }
+
+    auto needed = new_size - size;
+    auto available = next->second;
+    if(available < needed) {
+        return false;
+    }
+
+    erase_free(next);
+
+    if(available > needed) {
+        insert_free(offset + new_size, available - needed);
+    }
+
+    return true;
+}
+
+std::size_t BufferPage::largest_free_block() const {
+    return (free_by_size_.empty()) ? 0 : free_by_size_.rbegin()->first;
+}
+
+BufferPageAllocator::BufferPageAllocator(std::size_t page_size, std::size_t alignment):
+    page_size_(page_size),
+    alignment_(alignment) {
+
+    assert(alignment_ && (alignment_ & (alignment_ - 1)) == 0);
+    page_size_ = round_up(page_size_);
+}
+
+std::size_t BufferPageAllocator::round_up(std::size_t size) const {
+    // Zero sized buffers still need somewhere to live
+    size = std::max(size, alignment_);
+    return (size + alignment_ - 1) & ~(alignment_ - 1);
+}
+
+BufferPageID BufferPageAllocator::new_page(BufferPoolKey pool, std::size_t size, bool dedicated) {
+    auto id = next_page_id_++;
+
+    pages_.insert(std::make_pair(id, BufferPage(size, dedicated)));
+    page_pools_[id] = pool;
+    pools_[pool].push_back(id);
+
+    return id;
+}
+
+BufferBlock BufferPageAllocator::allocate(BufferPoolKey pool, std::size_t size, bool* created_page) {
+    BufferBlock block;
+    block.size = round_up(size);
+
+    if(created_page) {
+        *created_page = false;
+    }
+
+    if(block.size > page_size_) {
+        block.page = new_page(pool, block.size, true);
+        block.offset = 0;
+        pages_.at(block.page).allocate(block.size, &block.offset);
+
+        if(created_page) {
+            *created_page = true;
+        }
+        return block;
+    }
+
+    auto it = pools_.find(pool);
+    if(it != pools_.end()) {
+        for(auto id: it->second) {
+            auto& page = pages_.at(id);
+            if(!page.is_dedicated() && page.allocate(block.size, &block.offset)) {
+                block.page = id;
+                return block;
+            }
+        }
+    }
+
+    block.page = new_page(pool, page_size_, false);
+    pages_.at(block.page).allocate(block.size, &block.offset);
+
+    if(created_page) {
+        *created_page = true;
+    }
+
+    return block;
+}
+
+bool BufferPageAllocator::release(const BufferBlock& block) {
+    auto it = pages_.find(block.page);
+    if(it == pages_.end()) {
+        throw std::logic_error("Tried to release a block from a page which doesn't exist");
+    }
+
+    auto& page = it->second;
+    page.release(block.offset, block.size);
+
+    if(!page.empty()) {
+        return false;
+    }
+
+    auto pool = page_pools_.at(block.page);
+    auto& pool_pages = pools_.at(pool);
+
+    // Keep one empty shared page around, otherwise a buffer which is repeatedly
+    // created and destroyed would create and destroy a page each time
+    if(!page.is_dedicated()) {
+        auto shared = std::count_if(pool_pages.begin(), pool_pages.end(), [this](BufferPageID id) {
+            return !pages_.at(id).is_dedicated();
+        });
+
+        if(shared == 1) {
+            return false;
+        }
+    }
+
+    pool_pages.erase(std::find(pool_pages.begin(), pool_pages.end(), block.page));
+    if(pool_pages.empty()) {
+        pools_.erase(pool);
+    }
+
+    page_pools_.erase(block.page);
+    pages_.erase(it);
+
+    return true;
+}
+
+bool BufferPageAllocator::resize_in_place(BufferBlock& block, std::size_t new_size) {
+    new_size = round_up(new_size);
+
+    auto& page = pages_.at(block.page);
+
+    if(new_size == block.size) {
+        return true;
+    } else if(new_size < block.size) {
+        page.release(block.offset + new_size, block.size - new_size);
+        block.size = new_size;
+        return true;
+    } else if(page.grow(block.offset, block.size, new_size)) {
+        block.size = new_size;
+        return true;
+    }
+
+    return false;
+}
+
+std::size_t BufferPageAllocator::page_size(BufferPageID page) const {
+    return pages_.at(page).size();
+}
+
+BufferPoolKey BufferPageAllocator::pool(BufferPageID page) const {
+    return page_pools_.at(page);
+}
+
+void BufferPageAllocator::add_stats(BufferPageStats& stats, const BufferPage& page) const {
+    stats.page_count++;
+    stats.allocated_bytes += page.size();
+    stats.used_bytes += page.size() - page.free_bytes();
+    stats.free_bytes += page.free_bytes();
+    stats.largest_free_block = std::max(stats.largest_free_block, page.largest_free_block());
+    stats.free_block_count += page.free_block_count();
+}
+
+BufferPageStats BufferPageAllocator::stats() const {
+    BufferPageStats stats;
+    for(auto& pair: pages_) {
+        add_stats(stats, pair.second);
+    }
+    return stats;
+}
+
+BufferPageStats BufferPageAllocator::stats(BufferPoolKey pool) const {
+    BufferPageStats stats;
+    for(auto id: pages(pool)) {
+        add_stats(stats, pages_.at(id));
+    }
+    return stats;
+}
+
+std::vector<BufferPageID> BufferPageAllocator::pages(BufferPoolKey pool) const {
+    auto it = pools_.find(pool);
+    return (it == pools_.end()) ? std::vector<BufferPageID>() : it->second;
+}
+
+}
@@ -0,0 +1,114 @@
+#pragma once
+
+#include <cstdint>
+#include <cstddef>
+#include <map>
+#include <vector>
+
+namespace smlt {
+
+typedef uint32_t BufferPageID;
+typedef uint32_t BufferPoolKey;
+
+/* A range of bytes handed out from a page */
+struct BufferBlock {
+    BufferPageID page = 0;
+    std::size_t offset = 0;
+    std::size_t size = 0;
+};
+
+/*
+ * The free space within a single page. Free ranges are kept both by offset (so that
+ * released blocks can be merged with their neighbours) and by size (so allocations
+ * take the smallest range that fits, which keeps large ranges free for large buffers)
+ */
+class BufferPage {
+public:
+    BufferPage(std::size_t size, bool dedicated);
+
+    bool allocate(std::size_t size, std::size_t* offset);
+    void release(std::size_t offset, std::size_t size);
+
+    /* Extends an allocation into the free space directly after it, if there is enough */
+    bool grow(std::size_t offset, std::size_t size, std::size_t new_size);
+
+    std::size_t size() const { return size_; }
+    std::size_t free_bytes() const { return free_bytes_; }
+    std::size_t largest_free_block() const;
+    std::size_t free_block_count() const { return free_by_offset_.size(); }
+
+    bool empty() const { return free_bytes_ == size_; }
+
+    /* Dedicated pages hold a single buffer which was too big for a shared page */
+    bool is_dedicated() const { return dedicated_; }
+
+private:
+    void insert_free(std::size_t offset, std::size_t size);
+    void erase_free(std::map<std::size_t, std::size_t>::iterator it);
+
+    std::size_t size_;
+    std::size_t free_bytes_;
+    bool dedicated_;
+
+    std::map<std::size_t, std::size_t> free_by_offset_;
+    std::multimap<std::size_t, std::size_t> free_by_size_;
+};
+
+struct BufferPageStats {
+    uint32_t page_count = 0;
+    std::size_t allocated_bytes = 0; // The total size of every page
+    std::size_t used_bytes = 0;
+    std::size_t free_bytes = 0;
+    std::size_t largest_free_block = 0;
+    std::size_t free_block_count = 0;
+};
+
+/*
+ * Hands out blocks from large pages, so that many buffers can share one VBO. Pages are
+ * grouped into pools (the GL renderer uses one per buffer target and usage) and a block
+ * never spans pages. Requests bigger than the page size get a page of their own.
+ *
+ * This only does the accounting, it doesn't touch GL, so the caller creates and destroys
+ * the storage for each page as allocate() and release() report them.
+ */
+class BufferPageAllocator {
+public:
+    BufferPageAllocator(std::size_t page_size=1024 * 1024, std::size_t alignment=16);
+
+    /* If created_page is set, the block is at the start of a page which was created for it */
+    BufferBlock allocate(BufferPoolKey pool, std::size_t size, bool* created_page=nullptr);
+
+    /* Returns true if the block's page was destroyed because nothing else was using it */
+    bool release(const BufferBlock& block);
+
+    /* Resizes the block without moving it, returns false if it would have to move */
+    bool resize_in_place(BufferBlock& block, std::size_t new_size);
+
+    std::size_t page_size(BufferPageID page) const;
+    BufferPoolKey pool(BufferPageID page) const;
+    std::size_t page_size() const { return page_size_; }
+    std::size_t alignment() const { return alignment_; }
+
+    /* The size a request of the given size actually takes up */
+    std::size_t round_up(std::size_t size) const;
+
+    BufferPageStats stats() const;
+    BufferPageStats stats(BufferPoolKey pool) const;
+
+    std::vector<BufferPageID> pages(BufferPoolKey pool) const;
+
+private:
+    BufferPageID new_page(BufferPoolKey pool, std::size_t size, bool dedicated);
+    void add_stats(BufferPageStats& stats, const BufferPage& page) const;
+
+    std::size_t page_size_;
+    std::size_t alignment_;
+
+    BufferPageID next_page_id_ = 1;
+
+    std::map<BufferPageID, BufferPage> pages_;
+    std::map<BufferPageID, BufferPoolKey> page_pools_;
+    std::map<BufferPoolKey, std::vector<BufferPageID>> pools_;
+};
+
+}
@@ -0,0 +1,51 @@
+#include <algorithm>
+
+#include "dirty_ranges.h"
+
+namespace smlt {
+
+void DirtyRanges::add(std::size_t begin, std::size_t end) {
+    if(begin >= end) {
+        return;
+    }
+
+    // The first range which could merge with this one, i.e. doesn't end too far before it
+    auto first = std::lower_bound(ranges_.begin(), ranges_.end(), begin, [this](const Range& range, std::size_t value) {
+        return range.second + merge_gap_ < value;
+    });
+
+    // ...and the first one past that which starts too far after it
+    auto last = first;
+    while(last != ranges_.end() && last->first <= end + merge_gap_) {
+        begin = std::min(begin, last->first);
+        end = std::max(end, last->second);
+        ++last;
+    }
+
+    if(first == last) {
+        ranges_.insert(first, Range(begin, end));
+    } else {
+        *first = Range(begin, end);
+        ranges_.erase(first + 1, last);
+    }
+}
+
+void DirtyRanges::truncate(std::size_t size) {
+    while(!ranges_.empty() && ranges_.back().first >= size) {
+        ranges_.pop_back();
+    }
+
+    if(!ranges_.empty()) {
+        ranges_.back().second = std::min(ranges_.back().second, size);
+    }
+}
+
+std::size_t DirtyRanges::dirty_bytes() const {
+    std::size_t total = 0;
+    for(auto& range: ranges_) {
+        total += range.second - range.first;
+    }
+    return total;
+}
+
+}
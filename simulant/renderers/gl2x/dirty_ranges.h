@@ -0,0 +1,40 @@
+#pragma once
+
+#include <cstddef>
+#include <utility>
+#include <vector>
+
+namespace smlt {
+
+/*
+ * The byte ranges of a buffer which have been written to but not yet uploaded. Ranges
+ * which overlap or touch are merged as they're added, and so are ranges separated by no
+ * more than merge_gap bytes, as uploading a few unchanged bytes is cheaper than making
+ * another upload call.
+ */
+class DirtyRanges {
+public:
+    typedef std::pair<std::size_t, std::size_t> Range; // [first, second)
+
+    DirtyRanges(std::size_t merge_gap=0):
+        merge_gap_(merge_gap) {}
+
+    void add(std::size_t begin, std::size_t end);
+
+    /* Drops anything at or beyond size, for when the buffer shrinks */
+    void truncate(std::size_t size);
+
+    void clear() { ranges_.clear(); }
+    bool empty() const { return ranges_.empty(); }
+
+    /* Sorted, and none of them overlap */
+    const std::vector<Range>& ranges() const { return ranges_; }
+
+    std::size_t dirty_bytes() const;
+
+private:
+    std::size_t merge_gap_;
+    std::vector<Range> ranges_;
+};
+
+}
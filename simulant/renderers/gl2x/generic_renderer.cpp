@@ -17,6 +17,9 @@
 //     along with Simulant.  If not, see <http://www.gnu.org/licenses/>.
 //
 
+#include <cstdio>
+#include <cstring>
+
 #include "generic_renderer.h"
 
 #include "../../nodes/actor.h"
@@ -209,6 +212,48 @@ void GenericRenderer::set_stage_uniforms(const MaterialPass *pass, GPUProgram *p
 }
 
 
+/* GL 2.1 headers don't have these, they're used when the driver supports them */
+#ifndef GL_HALF_FLOAT
+#define GL_HALF_FLOAT 0x140B
+#endif
+
+#ifndef GL_INT_2_10_10_10_REV
+#define GL_INT_2_10_10_10_REV 0x8D9F
+#endif
+
+/* What glVertexAttribPointer needs to know about an attribute format */
+static void gl_attribute_format(VertexAttribute attr, GLint* size, GLenum* type, GLboolean* normalized) {
+    *size = vertex_attribute_components(attr);
+    *normalized = GL_TRUE;
+
+    switch(attr) {
+    case VERTEX_ATTRIBUTE_2H:
+    case VERTEX_ATTRIBUTE_3H:
+    case VERTEX_ATTRIBUTE_4H:
+        *type = GL_HALF_FLOAT;
+        *normalized = GL_FALSE;
+    break;
+    case VERTEX_ATTRIBUTE_2SN16:
+    case VERTEX_ATTRIBUTE_3SN16:
+    case VERTEX_ATTRIBUTE_4SN16:
+        *type = GL_SHORT;
+    break;
+    case VERTEX_ATTRIBUTE_2UN16:
+        *type = GL_UNSIGNED_SHORT;
+    break;
+    case VERTEX_ATTRIBUTE_4UN8:
+        *type = GL_UNSIGNED_BYTE;
+    break;
+    case VERTEX_ATTRIBUTE_PACKED_10_10_10_2:
+        *type = GL_INT_2_10_10_10_REV;
+        *size = 4; // Packed formats are always 4 components, the w is 0
+    break;
+    default:
+        *type = GL_FLOAT;
+        *normalized = GL_FALSE;
+    }
+}
+
 /* Shadows GL state to avoid unnecessary GL calls */
 static uint8_t enabled_vertex_attributes_ = 0;
 
@@ -235,11 +280,16 @@ void disable_vertex_attribute(uint8_t i) {
     enabled_vertex_attributes_ ^= v;
 }
 
+/* other_stream is the specification of the renderable's other vertex buffer (if it has one). Attributes
+ * missing from vertex_spec are only disabled if the other stream doesn't provide them either. buffer_offset
+ * is where the vertex buffer starts in the bound VBO */
 template<typename EnabledMethod, typename OffsetMethod>
 void send_attribute(ShaderAvailableAttributes attr,
                     const VertexSpecification& vertex_spec,
                     EnabledMethod exists_on_data_predicate,
-                    OffsetMethod offset_func) {
+                    OffsetMethod offset_func,
+                    const VertexSpecification* other_stream,
+                    std::size_t buffer_offset) {
 
     int32_t loc = (int32_t) attr;
 
@@ -250,23 +300,37 @@ void send_attribute(ShaderAvailableAttributes attr,
 
         auto converted = convert(attr);
         auto attr_for_type = attribute_for_type(converted, vertex_spec);
-        auto attr_size = vertex_attribute_size(attr_for_type);
         auto stride = vertex_spec.stride();
 
+        GLint size;
+        GLenum type;
+        GLboolean normalized;
+        gl_attribute_format(attr_for_type, &size, &type, &normalized);
+
         GLCheck(glVertexAttribPointer,
             loc,
-            attr_size / sizeof(float),
-            GL_FLOAT,
-            GL_FALSE,
+            size,
+            type,
+            normalized,
             stride,
-            BUFFER_OFFSET(offset)
+            BUFFER_OFFSET(buffer_offset + offset)
         );
-    } else {
+    } else if(!other_stream || !(other_stream->*exists_on_data_predicate)()) {
         disable_vertex_attribute(loc);
         //L_WARN_ONCE(_u("Couldn't locate attribute on the mesh: {0}").format(attr));
     }
 }
 
+static void send_attributes(const VertexSpecification& vertex_spec, const VertexSpecification* other_stream, std::size_t buffer_offset) {
+    send_attribute(SP_ATTR_VERTEX_POSITION, vertex_spec, &VertexSpecification::has_positions, &VertexSpecification::position_offset, other_stream, buffer_offset);
+    send_attribute(SP_ATTR_VERTEX_DIFFUSE, vertex_spec, &VertexSpecification::has_diffuse, &VertexSpecification::diffuse_offset, other_stream, buffer_offset);
+    send_attribute(SP_ATTR_VERTEX_TEXCOORD0, vertex_spec, &VertexSpecification::has_texcoord0, &VertexSpecification::texcoord0_offset, other_stream, buffer_offset);
+    send_attribute(SP_ATTR_VERTEX_TEXCOORD1, vertex_spec, &VertexSpecification::has_texcoord1, &VertexSpecification::texcoord1_offset, other_stream, buffer_offset);
+    send_attribute(SP_ATTR_VERTEX_TEXCOORD2, vertex_spec, &VertexSpecification::has_texcoord2, &VertexSpecification::texcoord2_offset, other_stream, buffer_offset);
+    send_attribute(SP_ATTR_VERTEX_TEXCOORD3, vertex_spec, &VertexSpecification::has_texcoord3, &VertexSpecification::texcoord3_offset, other_stream, buffer_offset);
+    send_attribute(SP_ATTR_VERTEX_NORMAL, vertex_spec, &VertexSpecification::has_normals, &VertexSpecification::normal_offset, other_stream, buffer_offset);
+}
+
 void GenericRenderer::set_auto_attributes_on_shader(Renderable &buffer) {
     /*
      *  Binding attributes generically is hard. So we have some template magic in the send_attribute
@@ -276,13 +340,22 @@ void GenericRenderer::set_auto_attributes_on_shader(Renderable &buffer) {
      */        
     const VertexSpecification& vertex_spec = buffer.vertex_attribute_specification();
 
-    send_attribute(SP_ATTR_VERTEX_POSITION, vertex_spec, &VertexSpecification::has_positions, &VertexSpecification::position_offset);
-    send_attribute(SP_ATTR_VERTEX_DIFFUSE, vertex_spec, &VertexSpecification::has_diffuse, &VertexSpecification::diffuse_offset);
-    send_attribute(SP_ATTR_VERTEX_TEXCOORD0, vertex_spec, &VertexSpecification::has_texcoord0, &VertexSpecification::texcoord0_offset);
-    send_attribute(SP_ATTR_VERTEX_TEXCOORD1, vertex_spec, &VertexSpecification::has_texcoord1, &VertexSpecification::texcoord1_offset);
-    send_attribute(SP_ATTR_VERTEX_TEXCOORD2, vertex_spec, &VertexSpecification::has_texcoord2, &VertexSpecification::texcoord2_offset);
-    send_attribute(SP_ATTR_VERTEX_TEXCOORD3, vertex_spec, &VertexSpecification::has_texcoord3, &VertexSpecification::texcoord3_offset);
-    send_attribute(SP_ATTR_VERTEX_NORMAL, vertex_spec, &VertexSpecification::has_normals, &VertexSpecification::normal_offset);
+    auto vertex_offset = buffer.vertex_attribute_buffer()->offset();
+
+    auto static_buffer = buffer.static_vertex_attribute_buffer();
+    if(!static_buffer) {
+        send_attributes(vertex_spec, nullptr, vertex_offset);
+        return;
+    }
+
+    /* The vertex buffer is already bound, glVertexAttribPointer takes whichever buffer is
+     * bound at the time, so the static attributes are sent after binding theirs */
+    const VertexSpecification static_spec = buffer.static_vertex_attribute_specification();
+
+    send_attributes(vertex_spec, &static_spec, vertex_offset);
+
+    static_buffer->bind(HARDWARE_BUFFER_VERTEX_ATTRIBUTES);
+    send_attributes(static_spec, &vertex_spec, static_buffer->offset());
 }
 
 void GenericRenderer::set_blending_mode(BlendType type) {
@@ -630,6 +703,15 @@ static GLenum convert_index_type(IndexType type) {
     }
 }
 
+static uint32_t index_type_size(IndexType type) {
+    switch(type) {
+    case INDEX_TYPE_8_BIT: return sizeof(GLubyte);
+    case INDEX_TYPE_32_BIT: return sizeof(GLuint);
+    default:
+        return sizeof(GLushort);
+    }
+}
+
 static GLenum convert_arrangement(MeshArrangement arrangement) {
     switch(arrangement) {
     case MESH_ARRANGEMENT_LINES:
@@ -656,9 +738,34 @@ void GenericRenderer::send_geometry(Renderable *renderable) {
     }
 
     auto index_type = convert_index_type(renderable->index_type());
+    auto index_size = index_type_size(renderable->index_type());
     auto arrangement = renderable->arrangement();
+    auto mode = convert_arrangement(arrangement);
+
+    // The index buffer may not start at the beginning of the bound VBO
+    auto index_offset = renderable->index_buffer()->offset();
+
+    auto ranges = renderable->index_ranges();
+    if(ranges && ranges->size() > 1 && glMultiDrawElements) {
+        // Everything is already bound, so hand all of the ranges over in one call
+        multi_draw_counts_.clear();
+        multi_draw_offsets_.clear();
+
+        each_index_range(renderable, [&](uint32_t start, uint32_t count) {
+            multi_draw_counts_.push_back(count);
+            multi_draw_offsets_.push_back(BUFFER_OFFSET(index_offset + start * index_size));
+        });
+
+        GLCheck(
+            glMultiDrawElements, mode, &multi_draw_counts_[0], index_type,
+            &multi_draw_offsets_[0], (GLsizei) multi_draw_counts_.size()
+        );
+    } else {
+        each_index_range(renderable, [&](uint32_t start, uint32_t count) {
+            GLCheck(glDrawElements, mode, count, index_type, BUFFER_OFFSET(index_offset + start * index_size));
+        });
+    }
 
-    GLCheck(glDrawElements, convert_arrangement(arrangement), element_count, index_type, BUFFER_OFFSET(0));
     window->stats->increment_polygons_rendered(arrangement, element_count);
 }
 
@@ -670,6 +777,34 @@ void GenericRenderer::init_context() {
     GLCheck(glEnable, GL_DEPTH_TEST);
     GLCheck(glDepthFunc, GL_LEQUAL);
     GLCheck(glEnable, GL_CULL_FACE);
+
+    int major = 0, minor = 0;
+    auto version = (const char*) glGetString(GL_VERSION);
+    if(version) {
+        sscanf(version, "%d.%d", &major, &minor);
+    }
+
+    auto extensions = (const char*) glGetString(GL_EXTENSIONS);
+    auto has_extension = [extensions](const char* name) -> bool {
+        return extensions && strstr(extensions, name);
+    };
+
+    half_float_vertices_ = major >= 3 || has_extension("GL_ARB_half_float_vertex");
+    packed_vertices_ = (major > 3 || (major == 3 && minor >= 3)) || has_extension("GL_ARB_vertex_type_2_10_10_10_rev");
+}
+
+bool GenericRenderer::supports_vertex_attribute(VertexAttributeBit, VertexAttribute format) const {
+    switch(format) {
+    case VERTEX_ATTRIBUTE_2H:
+    case VERTEX_ATTRIBUTE_3H:
+    case VERTEX_ATTRIBUTE_4H:
+        return half_float_vertices_;
+    case VERTEX_ATTRIBUTE_PACKED_10_10_10_2:
+        return packed_vertices_;
+    default:
+        // Everything else is a normalized short or byte, which GL 2 can always take
+        return format != VERTEX_ATTRIBUTE_NONE;
+    }
 }
 
 
@@ -100,6 +100,7 @@ public:
     GPUProgramPtr gpu_program(const GPUProgramID& program_id);
 
     bool supports_gpu_programs() const override { return true; }
+    bool supports_vertex_attribute(VertexAttributeBit attribute, VertexAttribute format) const override;
 
     std::string name() const override {
         return "gl2x";
@@ -108,6 +109,10 @@ public:
 private:
     GPUProgramManager program_manager_;
 
+    /* Half float and 10:10:10:2 attributes need GL 3.x or an extension, checked in init_context() */
+    bool half_float_vertices_ = false;
+    bool packed_vertices_ = false;
+
     std::unique_ptr<HardwareBufferManager> buffer_manager_;
 
     HardwareBufferManager* _get_buffer_manager() const {
@@ -123,6 +128,10 @@ private:
     void set_blending_mode(BlendType type);
     void send_geometry(Renderable* renderable);
 
+    /* Scratch space for glMultiDrawElements, kept around to avoid allocating per draw */
+    std::vector<GLsizei> multi_draw_counts_;
+    std::vector<const GLvoid*> multi_draw_offsets_;
+
     friend class GL2RenderQueueVisitor;
 
     void on_texture_prepare(TexturePtr texture) override {
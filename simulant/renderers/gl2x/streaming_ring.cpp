@@ -0,0 +1,73 @@
+#include <cassert>
+#include <stdexcept>
+
+#include "streaming_ring.h"
+
+namespace smlt {
+
+StreamingRing::StreamingRing(StreamingRingBackend* backend, std::size_t region_size, uint32_t region_count, std::size_t alignment):
+    backend_(backend),
+    region_size_(region_size),
+    region_count_(region_count),
+    alignment_(alignment),
+    region_frames_(region_count, 0),
+    region_used_(region_count, false) {
+
+    assert(region_count_);
+    assert(alignment_ && (alignment_ & (alignment_ - 1)) == 0);
+}
+
+void StreamingRing::begin_frame(uint64_t frame) {
+    if(in_frame_) {
+        throw std::logic_error("Tried to begin a streaming frame without ending the last one");
+    }
+
+    frame_ = frame;
+    region_ = uint32_t(frame % region_count_);
+
+    if(region_used_[region_]) {
+        backend_->wait(region_frames_[region_]);
+    }
+
+    region_frames_[region_] = frame;
+    region_used_[region_] = false;
+
+    head_ = 0;
+    overflowed_ = 0;
+    in_frame_ = true;
+}
+
+void StreamingRing::end_frame() {
+    if(!in_frame_) {
+        return;
+    }
+
+    // Nothing to wait for next time round if nothing was written
+    if(region_used_[region_]) {
+        backend_->fence(frame_);
+    }
+
+    in_frame_ = false;
+}
+
+bool StreamingRing::stream(const uint8_t* data, std::size_t size, std::size_t* offset) {
+    if(!in_frame_) {
+        return false;
+    }
+
+    auto start = (head_ + alignment_ - 1) & ~(alignment_ - 1);
+    if(start + size > region_size_) {
+        overflowed_ += size;
+        return false;
+    }
+
+    *offset = (region_ * region_size_) + start;
+    backend_->upload(*offset, data, size);
+
+    head_ = start + size;
+    region_used_[region_] = true;
+
+    return true;
+}
+
+}
@@ -0,0 +1,74 @@
+#pragma once
+
+#include <cstdint>
+#include <cstddef>
+#include <vector>
+
+namespace smlt {
+
+/* Whatever actually stores the ring's data, so that the ring itself can be tested without GL */
+class StreamingRingBackend {
+public:
+    virtual ~StreamingRingBackend() {}
+
+    /* Copies size bytes of data into the ring's storage at offset */
+    virtual void upload(std::size_t offset, const uint8_t* data, std::size_t size) = 0;
+
+    /* Called once everything which uses the frame's region has been submitted */
+    virtual void fence(uint64_t frame) = 0;
+
+    /* Called before a region is reused, must not return until the GPU is done with the frame */
+    virtual void wait(uint64_t frame) = 0;
+};
+
+/*
+ * Storage for data which is rewritten every frame. The ring is split into regions (three
+ * by default) and each frame writes into the next region along, so the data being written
+ * is never data that the GPU could still be reading for an earlier frame. Before a region
+ * is reused the backend waits for the frame which last used it.
+ *
+ * Data can only be streamed between begin_frame() and end_frame(), and only as much as fits
+ * in a region. If stream() returns false the caller needs to put the data somewhere else.
+ */
+class StreamingRing {
+public:
+    StreamingRing(StreamingRingBackend* backend, std::size_t region_size, uint32_t region_count=3, std::size_t alignment=16);
+
+    void begin_frame(uint64_t frame);
+    void end_frame();
+
+    /* Copies the data into this frame's region and returns where it went in offset */
+    bool stream(const uint8_t* data, std::size_t size, std::size_t* offset);
+
+    bool in_frame() const { return in_frame_; }
+    uint64_t frame() const { return frame_; }
+    uint32_t region() const { return region_; }
+
+    std::size_t region_size() const { return region_size_; }
+    uint32_t region_count() const { return region_count_; }
+    std::size_t size() const { return region_size_ * region_count_; }
+
+    /* What was streamed during the current (or last) frame, and what didn't fit */
+    std::size_t bytes_streamed() const { return head_; }
+    std::size_t bytes_overflowed() const { return overflowed_; }
+
+private:
+    StreamingRingBackend* backend_;
+
+    std::size_t region_size_;
+    uint32_t region_count_;
+    std::size_t alignment_;
+
+    bool in_frame_ = false;
+    uint64_t frame_ = 0;
+    uint32_t region_ = 0;
+
+    std::size_t head_ = 0;
+    std::size_t overflowed_ = 0;
+
+    /* The frame which last wrote to each region, so it can be waited for */
+    std::vector<uint64_t> region_frames_;
+    std::vector<bool> region_used_;
+};
+
+}
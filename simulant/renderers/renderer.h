@@ -67,6 +67,12 @@ public:
     // Render support flags
     virtual bool supports_gpu_programs() const { return false; }
 
+    /* Whether the renderer can draw the attribute when it's stored in format. Every
+     * renderer can draw the float formats */
+    virtual bool supports_vertex_attribute(VertexAttributeBit attribute, VertexAttribute format) const {
+        return vertex_attribute_is_float(format);
+    }
+
     virtual HardwareBufferManager* _get_buffer_manager() const = 0;
 
     void register_texture(TextureID tex_id, TexturePtr texture);
@@ -167,7 +167,7 @@ MeshID ResourceManager::new_mesh_from_submesh(SubMesh* submesh, GarbageCollectMe
     return result;
 }
 
-MeshID ResourceManager::new_mesh_from_file(const unicode& path, GarbageCollectMethod garbage_collect) {
+MeshID ResourceManager::new_mesh_from_file(const unicode& path, GarbageCollectMethod garbage_collect, bool quantize) {
     //Load the material
     smlt::MeshID mesh_id = new_mesh(VertexSpecification::POSITION_ONLY, garbage_collect);
     auto loader = window->loader_for(path.encode());
@@ -175,6 +175,10 @@ MeshID ResourceManager::new_mesh_from_file(const unicode& path, GarbageCollectMe
 
     loader->into(mesh(mesh_id));
 
+    if(quantize) {
+        mesh(mesh_id)->quantize();
+    }
+
     MeshManager::mark_as_uncollected(mesh_id);
     return mesh_id;
 }
@@ -45,6 +45,7 @@
 #include "render_sequence.h"
 #include "nodes/light.h"
 #include "meshes/mesh.h"
+#include "vertex_view.h"
 #include "procedural/mesh.h"
 #include "procedural/texture.h"
 #include "loader.h"
@@ -36,6 +36,7 @@
 #include "partitioners/null_partitioner.h"
 #include "partitioners/spatial_hash.h"
 #include "partitioners/frustum_partitioner.h"
+#include "partitioners/aabb_tree_partitioner.h"
 
 namespace smlt {
 
@@ -218,6 +219,15 @@ GeomPtr Stage::new_geom_with_mesh_at_position(MeshID mid, const Vec3& position,
     return gid;
 }
 
+GeomPtr Stage::new_geom_with_mesh_and_cache(MeshID mid, const unicode& compiled_path, const Vec3& position, const Quaternion& rotation) {
+    auto gid = geom_manager_->make(this, window->_sound_driver(), mid, position, rotation, compiled_path.encode()).fetch();
+    gid->set_parent(this);
+
+    signal_geom_created_(gid->id());
+
+    return gid;
+}
+
 bool Stage::has_geom(GeomID geom_id) const {
     return geom_manager_->contains(geom_id);
 }
@@ -233,6 +243,22 @@ std::size_t Stage::geom_count() const {
     return geom_manager_->count();
 }
 
+void Stage::add_occluder(MeshID mesh_id, const Mat4& transformation) {
+    auto mesh = assets->mesh(mesh_id);
+
+    mesh->each([&](const std::string&, SubMesh* submesh) {
+        submesh->each_triangle([&](uint32_t a, uint32_t b, uint32_t c) {
+            occluder_triangles_.push_back(submesh->vertex_data->position_at<Vec3>(a).transformed_by(transformation));
+            occluder_triangles_.push_back(submesh->vertex_data->position_at<Vec3>(b).transformed_by(transformation));
+            occluder_triangles_.push_back(submesh->vertex_data->position_at<Vec3>(c).transformed_by(transformation));
+        });
+    });
+}
+
+void Stage::clear_occluders() {
+    occluder_triangles_.clear();
+}
+
 //=============== PARTICLES =================
 
 ParticleSystemPtr Stage::new_particle_system() {
@@ -284,6 +310,47 @@ ParticleSystemPtr Stage::delete_particle_system(ParticleSystemID pid) {
     return nullptr;
 }
 
+void Stage::update_particle_systems(float dt) {
+    particle_system_batch_.clear();
+
+    for(auto& pair: ParticleSystemManager::__objects()) {
+        ParticleSystem* system = pair.second.get();
+
+        // Only systems which are in the stage's tree are updated, the same as any other node
+        TreeNode* root = system;
+        while(root->parent()) {
+            root = root->parent();
+        }
+
+        if(root == this) {
+            particle_system_batch_.push_back(system);
+        }
+    }
+
+    window->workers->parallel_for(particle_system_batch_.size(), 1, [&](uint32_t, uint32_t begin, uint32_t end) {
+        for(auto i = begin; i < end; ++i) {
+            particle_system_batch_[i]->update_particles(dt);
+        }
+    });
+
+    // Destroying a system can destroy others (its children) so nothing is
+    // destroyed until every system has been merged
+    std::vector<ParticleSystemID> finished;
+    for(auto system: particle_system_batch_) {
+        if(system->merge_update()) {
+            finished.push_back(system->id());
+        }
+    }
+
+    particle_system_batch_.clear();
+
+    for(auto& id: finished) {
+        if(has_particle_system(id)) {
+            delete_particle_system(id);
+        }
+    }
+}
+
 LightPtr Stage::new_light_as_directional(const Vec3& direction, const smlt::Colour& colour) {
     auto light = LightManager::make(this).fetch();
     auto light_id = light->id();
@@ -346,6 +413,12 @@ void Stage::set_partitioner(AvailablePartitioner partitioner) {
         case PARTITIONER_HASH:
             partitioner_ = std::make_shared<SpatialHashPartitioner>(this);
         break;
+        case PARTITIONER_FLAT_HASH:
+            partitioner_ = std::make_shared<SpatialHashPartitioner>(this, PARTITIONER_FLAT_HASH);
+        break;
+        case PARTITIONER_AABB_TREE:
+            partitioner_ = std::make_shared<AABBTreePartitioner>(this);
+        break;
         default: {
             throw std::logic_error("Invalid partitioner type specified");
         }
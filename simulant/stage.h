@@ -125,11 +125,28 @@ public:
 
     GeomPtr new_geom_with_mesh(MeshID mid);
     GeomPtr new_geom_with_mesh_at_position(MeshID mid, const Vec3& position, const Quaternion& rotation=Quaternion());
+
+    /* Like new_geom_with_mesh_at_position, but the compiled geom is cached in a file. If the file exists
+     * and was compiled from the mesh as it is now (its vertices, indices and layout are hashed) it's used
+     * as-is, otherwise the mesh is compiled as usual and the result written to the file for next time. */
+    GeomPtr new_geom_with_mesh_and_cache(MeshID mid, const unicode& compiled_path, const Vec3& position=Vec3(), const Quaternion& rotation=Quaternion());
     GeomPtr geom(const GeomID gid) const;
     bool has_geom(GeomID geom_id) const;
     GeomPtr delete_geom(GeomID geom_id);
     std::size_t geom_count() const;
 
+    /* Occluders are simple, low-poly meshes (walls, buildings, terrain) which hide
+     * whatever is behind them. When a stage has occluders, anything they completely
+     * hide from the camera is skipped before it reaches the render queue. The mesh's
+     * triangles are copied, so the mesh can be released afterwards. */
+    void add_occluder(MeshID mesh_id, const Mat4& transformation=Mat4());
+    void clear_occluders();
+
+    bool has_occluders() const { return !occluder_triangles_.empty(); }
+
+    /* Every three vertices is a world-space triangle */
+    const std::vector<Vec3>& occluder_triangles() const { return occluder_triangles_; }
+
     ParticleSystemPtr new_particle_system();
     ParticleSystemPtr new_particle_system_from_file(const unicode& filename, bool destroy_on_completion=false);
     ParticleSystemPtr new_particle_system_with_parent_from_file(ActorID parent, const unicode& filename, bool destroy_on_completion=false);
@@ -138,6 +155,12 @@ public:
     ParticleSystemPtr delete_particle_system(ParticleSystemID pid);
     std::size_t particle_system_count() const { return ParticleSystemManager::count(); }
 
+    /* Steps every particle system attached to the stage, in parallel on the window's
+     * worker pool. Called by the StageManager after the stage nodes have been updated,
+     * so particles are emitted from where their parents moved to this frame. Systems
+     * which finish (and were set to destroy on completion) are destroyed afterwards. */
+    void update_particle_systems(float dt);
+
     LightPtr new_light_as_directional(const Vec3& direction=Vec3(1, -0.5, 0), const smlt::Colour& colour=DEFAULT_LIGHT_COLOUR);
     LightPtr new_light_as_point(const Vec3& position=Vec3(), const smlt::Colour& colour=DEFAULT_LIGHT_COLOUR);
 
@@ -219,6 +242,9 @@ private:
 
     std::unique_ptr<FogSettings> fog_;
     std::unique_ptr<GeomManager> geom_manager_;
+
+    std::vector<Vec3> occluder_triangles_;
+    std::vector<ParticleSystem*> particle_system_batch_;
     std::unique_ptr<SkyManager> sky_manager_;
     std::unique_ptr<SpriteManager> sprite_manager_;
 
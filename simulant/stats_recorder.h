@@ -45,6 +45,52 @@ public:
         return polygons_rendered_;
     }
 
+    /* Heap allocations made while working out which lights affect each renderable,
+     * once the renderer has warmed up this should be zero every frame */
+    void reset_light_list_allocations() {
+        light_list_allocations_ = 0;
+    }
+
+    void increment_light_list_allocations(uint32_t count) {
+        light_list_allocations_ += count;
+    }
+
+    uint32_t light_list_allocations() const {
+        return light_list_allocations_;
+    }
+
+    /* What was allocated from the Window's FrameArena during the last frame, and
+     * how many times the arena itself had to go to the heap */
+    void set_frame_arena_usage(std::size_t bytes, uint32_t allocations, uint32_t heap_allocations) {
+        frame_arena_bytes_ = bytes;
+        frame_arena_allocations_ = allocations;
+        frame_arena_heap_allocations_ = heap_allocations;
+    }
+
+    std::size_t frame_arena_bytes() const { return frame_arena_bytes_; }
+    uint32_t frame_arena_allocations() const { return frame_arena_allocations_; }
+    uint32_t frame_arena_heap_allocations() const { return frame_arena_heap_allocations_; }
+
+    /* What the occluders hid during the last pipeline run: whole stage nodes, and the
+     * parts of geoms (octree nodes) which weren't hidden entirely */
+    void set_occlusion_culled(uint32_t nodes, uint32_t geom_nodes) {
+        nodes_occluded_ = nodes;
+        geom_nodes_occluded_ = geom_nodes;
+    }
+
+    uint32_t nodes_occluded() const { return nodes_occluded_; }
+    uint32_t geom_nodes_occluded() const { return geom_nodes_occluded_; }
+
+    /* Bytes of per-frame buffer data the renderer streamed during the last frame, and
+     * how much didn't fit in its streaming buffers and was uploaded the slow way */
+    void set_streamed_bytes(std::size_t bytes, std::size_t overflow_bytes) {
+        streamed_bytes_ = bytes;
+        streamed_overflow_bytes_ = overflow_bytes;
+    }
+
+    std::size_t streamed_bytes() const { return streamed_bytes_; }
+    std::size_t streamed_overflow_bytes() const { return streamed_overflow_bytes_; }
+
 private:
     float frame_time_ = 0;
     uint32_t subactors_renderered_ = 0;
@@ -55,6 +101,17 @@ private:
     uint64_t frames_run_ = 0;
 
     uint32_t polygons_rendered_ = 0;
+    uint32_t light_list_allocations_ = 0;
+
+    std::size_t frame_arena_bytes_ = 0;
+    uint32_t frame_arena_allocations_ = 0;
+    uint32_t frame_arena_heap_allocations_ = 0;
+
+    uint32_t nodes_occluded_ = 0;
+    uint32_t geom_nodes_occluded_ = 0;
+
+    std::size_t streamed_bytes_ = 0;
+    std::size_t streamed_overflow_bytes_ = 0;
 };
 
 
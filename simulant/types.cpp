@@ -72,6 +72,27 @@ const VertexAttribute VertexSpecification::texcoordX_attribute(uint8_t which) co
     }
 }
 
+VertexSpecification VertexSpecification::subset(uint32_t mask) const {
+    auto pick = [mask](VertexAttribute attr, VertexAttributeBit bit) -> VertexAttribute {
+        return (mask & bit) ? attr : VERTEX_ATTRIBUTE_NONE;
+    };
+
+    return VertexSpecification(
+        pick(position_attribute_, VERTEX_ATTRIBUTE_BIT_POSITION),
+        pick(normal_attribute_, VERTEX_ATTRIBUTE_BIT_NORMAL),
+        pick(texcoord0_attribute_, VERTEX_ATTRIBUTE_BIT_TEXCOORD0),
+        pick(texcoord1_attribute_, VERTEX_ATTRIBUTE_BIT_TEXCOORD1),
+        pick(texcoord2_attribute_, VERTEX_ATTRIBUTE_BIT_TEXCOORD2),
+        pick(texcoord3_attribute_, VERTEX_ATTRIBUTE_BIT_TEXCOORD3),
+        pick(texcoord4_attribute_, VERTEX_ATTRIBUTE_BIT_TEXCOORD4),
+        pick(texcoord5_attribute_, VERTEX_ATTRIBUTE_BIT_TEXCOORD5),
+        pick(texcoord6_attribute_, VERTEX_ATTRIBUTE_BIT_TEXCOORD6),
+        pick(texcoord7_attribute_, VERTEX_ATTRIBUTE_BIT_TEXCOORD7),
+        pick(diffuse_attribute_, VERTEX_ATTRIBUTE_BIT_DIFFUSE),
+        pick(specular_attribute_, VERTEX_ATTRIBUTE_BIT_SPECULAR)
+    );
+}
+
 void VertexSpecification::recalc_stride_and_offsets() {
     normal_offset_ = vertex_attribute_size(position_attribute_);
     texcoord0_offset_ = normal_offset_ + vertex_attribute_size(normal_attribute_);
@@ -152,6 +173,45 @@ uint16_t VertexSpecification::texcoord7_offset(bool check) const {
     return texcoord7_offset_;
 }
 
+VertexAttribute VertexSpecification::attribute(VertexAttributeBit bit) const {
+    switch(bit) {
+    case VERTEX_ATTRIBUTE_BIT_POSITION: return position_attribute_;
+    case VERTEX_ATTRIBUTE_BIT_NORMAL: return normal_attribute_;
+    case VERTEX_ATTRIBUTE_BIT_TEXCOORD0: return texcoord0_attribute_;
+    case VERTEX_ATTRIBUTE_BIT_TEXCOORD1: return texcoord1_attribute_;
+    case VERTEX_ATTRIBUTE_BIT_TEXCOORD2: return texcoord2_attribute_;
+    case VERTEX_ATTRIBUTE_BIT_TEXCOORD3: return texcoord3_attribute_;
+    case VERTEX_ATTRIBUTE_BIT_TEXCOORD4: return texcoord4_attribute_;
+    case VERTEX_ATTRIBUTE_BIT_TEXCOORD5: return texcoord5_attribute_;
+    case VERTEX_ATTRIBUTE_BIT_TEXCOORD6: return texcoord6_attribute_;
+    case VERTEX_ATTRIBUTE_BIT_TEXCOORD7: return texcoord7_attribute_;
+    case VERTEX_ATTRIBUTE_BIT_DIFFUSE: return diffuse_attribute_;
+    case VERTEX_ATTRIBUTE_BIT_SPECULAR: return specular_attribute_;
+    default:
+        return VERTEX_ATTRIBUTE_NONE;
+    }
+}
+
+uint16_t VertexSpecification::offset(VertexAttributeBit bit, bool check) const {
+    switch(bit) {
+    case VERTEX_ATTRIBUTE_BIT_POSITION: return position_offset(check);
+    case VERTEX_ATTRIBUTE_BIT_NORMAL: return normal_offset(check);
+    case VERTEX_ATTRIBUTE_BIT_TEXCOORD0: return texcoord0_offset(check);
+    case VERTEX_ATTRIBUTE_BIT_TEXCOORD1: return texcoord1_offset(check);
+    case VERTEX_ATTRIBUTE_BIT_TEXCOORD2: return texcoord2_offset(check);
+    case VERTEX_ATTRIBUTE_BIT_TEXCOORD3: return texcoord3_offset(check);
+    case VERTEX_ATTRIBUTE_BIT_TEXCOORD4: return texcoord4_offset(check);
+    case VERTEX_ATTRIBUTE_BIT_TEXCOORD5: return texcoord5_offset(check);
+    case VERTEX_ATTRIBUTE_BIT_TEXCOORD6: return texcoord6_offset(check);
+    case VERTEX_ATTRIBUTE_BIT_TEXCOORD7: return texcoord7_offset(check);
+    case VERTEX_ATTRIBUTE_BIT_DIFFUSE: return diffuse_offset(check);
+    case VERTEX_ATTRIBUTE_BIT_SPECULAR: return specular_offset(check);
+    default:
+        if(check) { throw std::logic_error("No such attribute"); }
+        return 0;
+    }
+}
+
 uint16_t VertexSpecification::texcoordX_offset(uint8_t which, bool check) const {
     assert(which < MAX_TEXTURE_UNITS);
 
@@ -62,7 +62,37 @@ enum VertexAttribute {
     VERTEX_ATTRIBUTE_NONE,
     VERTEX_ATTRIBUTE_2F,
     VERTEX_ATTRIBUTE_3F,
-    VERTEX_ATTRIBUTE_4F
+    VERTEX_ATTRIBUTE_4F,
+
+    /* Compact formats, which VertexData converts to and from floats as they're written and
+     * read. Not every renderer can draw every one of them, see
+     * Renderer::supports_vertex_attribute() */
+    VERTEX_ATTRIBUTE_2H, // Half floats
+    VERTEX_ATTRIBUTE_3H,
+    VERTEX_ATTRIBUTE_4H,
+    VERTEX_ATTRIBUTE_2SN16, // Signed 16 bit integers, normalized to [-1, 1]
+    VERTEX_ATTRIBUTE_3SN16,
+    VERTEX_ATTRIBUTE_4SN16,
+    VERTEX_ATTRIBUTE_2UN16, // Unsigned 16 bit integers, normalized to [0, 1]
+    VERTEX_ATTRIBUTE_4UN8, // Unsigned bytes, normalized to [0, 1]
+    VERTEX_ATTRIBUTE_PACKED_10_10_10_2 // xyz as signed 10 bit integers normalized to [-1, 1], in 32 bits
+};
+
+/* Used to pick out a set of attributes from a VertexSpecification, see VertexSpecification::subset() */
+enum VertexAttributeBit {
+    VERTEX_ATTRIBUTE_BIT_POSITION = (1 << 0),
+    VERTEX_ATTRIBUTE_BIT_NORMAL = (1 << 1),
+    VERTEX_ATTRIBUTE_BIT_TEXCOORD0 = (1 << 2),
+    VERTEX_ATTRIBUTE_BIT_TEXCOORD1 = (1 << 3),
+    VERTEX_ATTRIBUTE_BIT_TEXCOORD2 = (1 << 4),
+    VERTEX_ATTRIBUTE_BIT_TEXCOORD3 = (1 << 5),
+    VERTEX_ATTRIBUTE_BIT_TEXCOORD4 = (1 << 6),
+    VERTEX_ATTRIBUTE_BIT_TEXCOORD5 = (1 << 7),
+    VERTEX_ATTRIBUTE_BIT_TEXCOORD6 = (1 << 8),
+    VERTEX_ATTRIBUTE_BIT_TEXCOORD7 = (1 << 9),
+    VERTEX_ATTRIBUTE_BIT_DIFFUSE = (1 << 10),
+    VERTEX_ATTRIBUTE_BIT_SPECULAR = (1 << 11),
+    VERTEX_ATTRIBUTE_BIT_ALL = (1 << 12) - 1
 };
 
 class VertexSpecification;
@@ -246,6 +276,15 @@ public:
         return !(*this == rhs);
     }
 
+    /*
+     * Returns a specification with only the attributes in mask (VertexAttributeBits OR'd
+     * together). This is how vertices are split across more than one buffer, for example
+     * animated meshes keep the attributes which change every frame apart from the ones that
+     * don't: spec.subset(VERTEX_ATTRIBUTE_BIT_POSITION | VERTEX_ATTRIBUTE_BIT_NORMAL) and
+     * spec.subset(~(VERTEX_ATTRIBUTE_BIT_POSITION | VERTEX_ATTRIBUTE_BIT_NORMAL))
+     */
+    VertexSpecification subset(uint32_t mask) const;
+
     inline uint32_t stride() const { return stride_; }
 
     bool has_positions() const { return bool(position_attribute_); }
@@ -283,6 +322,10 @@ public:
     uint16_t diffuse_offset(bool check=true) const;
     uint16_t specular_offset(bool check=true) const;
 
+    /* The same as the accessors above, but picking the attribute by its bit */
+    VertexAttribute attribute(VertexAttributeBit bit) const;
+    uint16_t offset(VertexAttributeBit bit, bool check=true) const;
+
 private:
     friend class VertexAttributeProperty;
 
@@ -317,7 +360,9 @@ enum MeshArrangement {
 enum AvailablePartitioner {
     PARTITIONER_NULL,
     PARTITIONER_FRUSTUM,
-    PARTITIONER_HASH
+    PARTITIONER_HASH,
+    PARTITIONER_FLAT_HASH,
+    PARTITIONER_AABB_TREE
 };
 
 enum LightType {
@@ -539,11 +584,26 @@ constexpr uint16_t vertex_attribute_size(VertexAttribute attr) {
     return round_to_bytes(
        (attr == VERTEX_ATTRIBUTE_2F) ? sizeof(float) * 2 :
        (attr == VERTEX_ATTRIBUTE_3F) ? sizeof(float) * 3 :
-       (attr == VERTEX_ATTRIBUTE_4F) ? sizeof(float) * 4 : 0,
+       (attr == VERTEX_ATTRIBUTE_4F) ? sizeof(float) * 4 :
+       (attr == VERTEX_ATTRIBUTE_2H || attr == VERTEX_ATTRIBUTE_2SN16 || attr == VERTEX_ATTRIBUTE_2UN16) ? sizeof(uint16_t) * 2 :
+       (attr == VERTEX_ATTRIBUTE_3H || attr == VERTEX_ATTRIBUTE_3SN16) ? sizeof(uint16_t) * 3 :
+       (attr == VERTEX_ATTRIBUTE_4H || attr == VERTEX_ATTRIBUTE_4SN16) ? sizeof(uint16_t) * 4 :
+       (attr == VERTEX_ATTRIBUTE_4UN8 || attr == VERTEX_ATTRIBUTE_PACKED_10_10_10_2) ? sizeof(uint32_t) : 0,
         BUFFER_ATTRIBUTE_ALIGNMENT
     );
 }
 
+/* How many values each vertex has for the attribute, the w of a 10:10:10:2 attribute isn't counted */
+constexpr uint8_t vertex_attribute_components(VertexAttribute attr) {
+    return (attr == VERTEX_ATTRIBUTE_2F || attr == VERTEX_ATTRIBUTE_2H || attr == VERTEX_ATTRIBUTE_2SN16 || attr == VERTEX_ATTRIBUTE_2UN16) ? 2 :
+           (attr == VERTEX_ATTRIBUTE_3F || attr == VERTEX_ATTRIBUTE_3H || attr == VERTEX_ATTRIBUTE_3SN16 || attr == VERTEX_ATTRIBUTE_PACKED_10_10_10_2) ? 3 :
+           (attr == VERTEX_ATTRIBUTE_4F || attr == VERTEX_ATTRIBUTE_4H || attr == VERTEX_ATTRIBUTE_4SN16 || attr == VERTEX_ATTRIBUTE_4UN8) ? 4 : 0;
+}
+
+constexpr bool vertex_attribute_is_float(VertexAttribute attr) {
+    return attr == VERTEX_ATTRIBUTE_2F || attr == VERTEX_ATTRIBUTE_3F || attr == VERTEX_ATTRIBUTE_4F;
+}
+
 }
 
 /* Hash functions for smlt types */
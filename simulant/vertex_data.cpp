@@ -19,6 +19,7 @@
 
 #include <stdexcept>
 #include "vertex_data.h"
+#include "vertex_formats.h"
 #include "window.h"
 #include "utils/gl_thread_check.h"
 
@@ -108,25 +109,40 @@ void VertexData::position_checks() {
 void VertexData::position(float x, float y, float z, float w) {
     position_checks();
 
-    assert(vertex_specification_.position_attribute == VERTEX_ATTRIBUTE_4F);
-    Vec4* out = (Vec4*) &data_[cursor_offset()];
-    *out = Vec4(x, y, z, w);
+    VertexAttribute attr = vertex_specification_.position_attribute;
+    if(attr == VERTEX_ATTRIBUTE_4F) {
+        Vec4* out = (Vec4*) &data_[cursor_offset()];
+        *out = Vec4(x, y, z, w);
+    } else {
+        assert(vertex_attribute_components(attr) == 4);
+        pack_vertex_attribute(attr, Vec4(x, y, z, w), &data_[cursor_offset()]);
+    }
 }
 
 void VertexData::position(float x, float y, float z) {
     position_checks();
 
-    assert(vertex_specification_.position_attribute == VERTEX_ATTRIBUTE_3F);
-    Vec3* out = (Vec3*) &data_[cursor_offset()];
-    *out = Vec3(x, y, z);
+    VertexAttribute attr = vertex_specification_.position_attribute;
+    if(attr == VERTEX_ATTRIBUTE_3F) {
+        Vec3* out = (Vec3*) &data_[cursor_offset()];
+        *out = Vec3(x, y, z);
+    } else {
+        assert(vertex_attribute_components(attr) == 3);
+        pack_vertex_attribute(attr, Vec4(x, y, z, 0), &data_[cursor_offset()]);
+    }
 }
 
 void VertexData::position(float x, float y) {
     position_checks();
 
-    assert(vertex_specification_.position_attribute == VERTEX_ATTRIBUTE_2F);
-    Vec2* out = (Vec2*) &data_[cursor_offset()];
-    *out = Vec2(x, y);
+    VertexAttribute attr = vertex_specification_.position_attribute;
+    if(attr == VERTEX_ATTRIBUTE_2F) {
+        Vec2* out = (Vec2*) &data_[cursor_offset()];
+        *out = Vec2(x, y);
+    } else {
+        assert(vertex_attribute_components(attr) == 2);
+        pack_vertex_attribute(attr, Vec4(x, y, 0, 0), &data_[cursor_offset()]);
+    }
 }
 
 void VertexData::position(const Vec2 &pos) {
@@ -143,31 +159,49 @@ void VertexData::position(const Vec4 &pos) {
 
 template<>
 Vec2 VertexData::position_at<Vec2>(uint32_t idx) const {
-    assert(vertex_specification_.position_attribute == VERTEX_ATTRIBUTE_2F);
+    VertexAttribute attr = vertex_specification_.position_attribute;
+    if(attr != VERTEX_ATTRIBUTE_2F) {
+        assert(vertex_attribute_components(attr) == 2);
+        auto v = unpack_vertex_attribute(attr, &data_[idx * stride()]);
+        return Vec2(v.x, v.y);
+    }
+
     Vec2 out = *((Vec2*) &data_[idx * stride()]);
     return out;
 }
 
 template<>
 Vec3 VertexData::position_at<Vec3>(uint32_t idx) const {
-    assert(vertex_specification_.position_attribute == VERTEX_ATTRIBUTE_3F);
+    VertexAttribute attr = vertex_specification_.position_attribute;
+    if(attr != VERTEX_ATTRIBUTE_3F) {
+        assert(vertex_attribute_components(attr) == 3);
+        auto v = unpack_vertex_attribute(attr, &data_[idx * stride()]);
+        return Vec3(v.x, v.y, v.z);
+    }
+
     Vec3 out = *((Vec3*) &data_[idx * stride()]);
     return out;
 }
 
 template<>
 Vec4 VertexData::position_at<Vec4>(uint32_t idx) const {
-    assert(vertex_specification_.position_attribute == VERTEX_ATTRIBUTE_4F);
+    VertexAttribute attr = vertex_specification_.position_attribute;
+    if(attr != VERTEX_ATTRIBUTE_4F) {
+        assert(vertex_attribute_components(attr) == 4);
+        auto v = unpack_vertex_attribute(attr, &data_[idx * stride()]);
+        return v;
+    }
+
     Vec4 out = *((Vec4*) &data_[idx * stride()]);
     return out;
 }
 
 Vec4 VertexData::position_nd_at(uint32_t idx, float def) const {
-    const auto& attr = vertex_specification_.position_attribute;
-    if(attr == VERTEX_ATTRIBUTE_2F) {
+    auto components = vertex_attribute_components(vertex_specification_.position_attribute);
+    if(components == 2) {
         auto v = position_at<Vec2>(idx);
         return Vec4(v.x, v.y, def, def);
-    } else if(attr == VERTEX_ATTRIBUTE_3F) {
+    } else if(components == 3) {
         auto v = position_at<Vec3>(idx);
         return Vec4(v.x, v.y, v.z, def);
     } else {
@@ -176,9 +210,14 @@ Vec4 VertexData::position_nd_at(uint32_t idx, float def) const {
 }
 
 void VertexData::normal(float x, float y, float z) {
-    assert(vertex_specification_.normal_attribute == VERTEX_ATTRIBUTE_3F);
-    Vec3* out = (Vec3*) &data_[cursor_offset() + specification().normal_offset()];
-    *out = Vec3(x, y, z);
+    VertexAttribute attr = vertex_specification_.normal_attribute;
+    if(attr == VERTEX_ATTRIBUTE_3F) {
+        Vec3* out = (Vec3*) &data_[cursor_offset() + specification().normal_offset()];
+        *out = Vec3(x, y, z);
+    } else {
+        assert(vertex_attribute_components(attr) == 3);
+        pack_vertex_attribute(attr, Vec4(x, y, z, 0), &data_[cursor_offset() + specification().normal_offset()]);
+    }
 }
 
 void VertexData::normal(const Vec3 &n) {
@@ -187,20 +226,35 @@ void VertexData::normal(const Vec3 &n) {
 
 void VertexData::tex_coordX(uint8_t which, float u, float v) {
     uint32_t offset = specification().texcoordX_offset(which);
-    Vec2* out = (Vec2*) &data_[cursor_offset() + offset];
-    *out = Vec2(u, v);
+    VertexAttribute attr = specification().texcoordX_attribute(which);
+    if(attr == VERTEX_ATTRIBUTE_2F) {
+        Vec2* out = (Vec2*) &data_[cursor_offset() + offset];
+        *out = Vec2(u, v);
+    } else {
+        pack_vertex_attribute(attr, Vec4(u, v, 0, 0), &data_[cursor_offset() + offset]);
+    }
 }
 
 void VertexData::tex_coordX(uint8_t which, float u, float v, float w) {
     uint32_t offset = specification().texcoordX_offset(which);
-    Vec3* out = (Vec3*) &data_[cursor_offset() + offset];
-    *out = Vec3(u, v, w);
+    VertexAttribute attr = specification().texcoordX_attribute(which);
+    if(attr == VERTEX_ATTRIBUTE_3F) {
+        Vec3* out = (Vec3*) &data_[cursor_offset() + offset];
+        *out = Vec3(u, v, w);
+    } else {
+        pack_vertex_attribute(attr, Vec4(u, v, w, 0), &data_[cursor_offset() + offset]);
+    }
 }
 
 void VertexData::tex_coordX(uint8_t which, float u, float v, float w, float x) {
     uint32_t offset = specification().texcoordX_offset(which);
-    Vec4* out = (Vec4*) &data_[cursor_offset() + offset];
-    *out = Vec4(u, v, w, x);
+    VertexAttribute attr = specification().texcoordX_attribute(which);
+    if(attr == VERTEX_ATTRIBUTE_4F) {
+        Vec4* out = (Vec4*) &data_[cursor_offset() + offset];
+        *out = Vec4(u, v, w, x);
+    } else {
+        pack_vertex_attribute(attr, Vec4(u, v, w, x), &data_[cursor_offset() + offset]);
+    }
 }
 
 void VertexData::push_back() {
@@ -222,42 +276,78 @@ void VertexData::tex_coord0(float u, float v, float w, float x) {
 
 template<>
 Vec2 VertexData::texcoord0_at<Vec2>(uint32_t idx) {
-    assert(vertex_specification_.texcoord0_attribute == VERTEX_ATTRIBUTE_2F);
+    VertexAttribute attr = vertex_specification_.texcoord0_attribute;
+    if(attr != VERTEX_ATTRIBUTE_2F) {
+        assert(vertex_attribute_components(attr) == 2);
+        auto v = unpack_vertex_attribute(attr, &data_[(idx * stride()) + specification().texcoord0_offset()]);
+        return Vec2(v.x, v.y);
+    }
+
     Vec2 out = *((Vec2*) &data_[(idx * stride()) + specification().texcoord0_offset()]);
     return out;
 }
 
 template<>
 Vec3 VertexData::texcoord0_at<Vec3>(uint32_t idx) {
-    assert(vertex_specification_.texcoord0_attribute == VERTEX_ATTRIBUTE_3F);
+    VertexAttribute attr = vertex_specification_.texcoord0_attribute;
+    if(attr != VERTEX_ATTRIBUTE_3F) {
+        assert(vertex_attribute_components(attr) == 3);
+        auto v = unpack_vertex_attribute(attr, &data_[(idx * stride()) + specification().texcoord0_offset()]);
+        return Vec3(v.x, v.y, v.z);
+    }
+
     Vec3 out = *((Vec3*) &data_[(idx * stride()) + specification().texcoord0_offset()]);
     return out;
 }
 
 template<>
 Vec4 VertexData::texcoord0_at<Vec4>(uint32_t idx) {
-    assert(vertex_specification_.texcoord0_attribute == VERTEX_ATTRIBUTE_4F);
+    VertexAttribute attr = vertex_specification_.texcoord0_attribute;
+    if(attr != VERTEX_ATTRIBUTE_4F) {
+        assert(vertex_attribute_components(attr) == 4);
+        auto v = unpack_vertex_attribute(attr, &data_[(idx * stride()) + specification().texcoord0_offset()]);
+        return v;
+    }
+
     Vec4 out = *((Vec4*) &data_[(idx * stride()) + specification().texcoord0_offset()]);
     return out;
 }
 
 template<>
 Vec2 VertexData::texcoord1_at<Vec2>(uint32_t idx) const {
-    assert(vertex_specification_.texcoord1_attribute == VERTEX_ATTRIBUTE_2F);
+    VertexAttribute attr = vertex_specification_.texcoord1_attribute;
+    if(attr != VERTEX_ATTRIBUTE_2F) {
+        assert(vertex_attribute_components(attr) == 2);
+        auto v = unpack_vertex_attribute(attr, &data_[(idx * stride()) + specification().texcoord1_offset()]);
+        return Vec2(v.x, v.y);
+    }
+
     Vec2 out = *((Vec2*) &data_[(idx * stride()) + specification().texcoord1_offset()]);
     return out;
 }
 
 template<>
 Vec3 VertexData::texcoord1_at<Vec3>(uint32_t idx) const {
-    assert(vertex_specification_.texcoord1_attribute == VERTEX_ATTRIBUTE_3F);
+    VertexAttribute attr = vertex_specification_.texcoord1_attribute;
+    if(attr != VERTEX_ATTRIBUTE_3F) {
+        assert(vertex_attribute_components(attr) == 3);
+        auto v = unpack_vertex_attribute(attr, &data_[(idx * stride()) + specification().texcoord1_offset()]);
+        return Vec3(v.x, v.y, v.z);
+    }
+
     Vec3 out = *((Vec3*) &data_[(idx * stride()) + specification().texcoord1_offset()]);
     return out;
 }
 
 template<>
 Vec4 VertexData::texcoord1_at<Vec4>(uint32_t idx) const {
-    assert(vertex_specification_.texcoord1_attribute == VERTEX_ATTRIBUTE_4F);
+    VertexAttribute attr = vertex_specification_.texcoord1_attribute;
+    if(attr != VERTEX_ATTRIBUTE_4F) {
+        assert(vertex_attribute_components(attr) == 4);
+        auto v = unpack_vertex_attribute(attr, &data_[(idx * stride()) + specification().texcoord1_offset()]);
+        return v;
+    }
+
     Vec4 out = *((Vec4*) &data_[(idx * stride()) + specification().texcoord1_offset()]);
     return out;
 }
@@ -299,9 +389,14 @@ void VertexData::tex_coord3(float u, float v, float w, float x) {
 }
 
 void VertexData::diffuse(float r, float g, float b, float a) {
-    assert(vertex_specification_.diffuse_attribute == VERTEX_ATTRIBUTE_4F);
-    Vec4* out = (Vec4*) &data_[cursor_offset() + specification().diffuse_offset()];
-    *out = Vec4(r, g, b, a);
+    VertexAttribute attr = vertex_specification_.diffuse_attribute;
+    if(attr == VERTEX_ATTRIBUTE_4F) {
+        Vec4* out = (Vec4*) &data_[cursor_offset() + specification().diffuse_offset()];
+        *out = Vec4(r, g, b, a);
+    } else {
+        assert(vertex_attribute_components(attr) == 4);
+        pack_vertex_attribute(attr, Vec4(r, g, b, a), &data_[cursor_offset() + specification().diffuse_offset()]);
+    }
 }
 
 void VertexData::diffuse(const Colour& colour) {
@@ -384,8 +479,16 @@ void VertexData::interp_vertex(uint32_t source_idx, const VertexData &dest_state
             out.position(final);
         }
         break;
-        default:
+        case VERTEX_ATTRIBUTE_NONE:
             L_WARN("Ignoring unsupported vertex position type");
+        break;
+        default: {
+            // Compact formats, interpolated as floats
+            Vec4 source = this->position_nd_at(source_idx);
+            Vec4 dest = dest_state.position_nd_at(dest_idx);
+            Vec4 final = source + ((dest - source) * interp);
+            pack_vertex_attribute(vertex_specification_.position_attribute, final, &out.data_[out_idx * stride()]);
+        }
     }
 
     //FIXME: Interpolate normals here
@@ -408,6 +511,38 @@ bool VertexData::clone_into(VertexData& other) {
     return true;
 }
 
+void VertexData::convert_to(const VertexSpecification& vertex_specification) {
+    if(vertex_specification == vertex_specification_) {
+        return;
+    }
+
+    const VertexSpecification& from = vertex_specification_;
+    const VertexSpecification& to = vertex_specification;
+
+    std::vector<uint8_t> converted(vertex_count_ * to.stride(), 0);
+
+    for(uint32_t i = 0; i < 12; ++i) {
+        auto bit = VertexAttributeBit(1 << i);
+        auto from_attr = from.attribute(bit);
+        auto to_attr = to.attribute(bit);
+
+        if(!from_attr || !to_attr) {
+            continue;
+        }
+
+        const uint8_t* in = data_.data() + from.offset(bit);
+        uint8_t* out = converted.data() + to.offset(bit);
+
+        for(uint32_t v = 0; v < vertex_count_; ++v, in += from.stride(), out += to.stride()) {
+            pack_vertex_attribute(to_attr, unpack_vertex_attribute(from_attr, in), out);
+        }
+    }
+
+    data_.swap(converted);
+    vertex_specification_ = vertex_specification;
+    stride_ = vertex_specification_.stride();
+}
+
 static constexpr uint32_t calc_index_stride(IndexType type) {
     return (type == INDEX_TYPE_16_BIT) ? sizeof(uint16_t) : (type == INDEX_TYPE_8_BIT) ? sizeof(uint8_t) : sizeof(uint32_t);
 }
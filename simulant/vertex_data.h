@@ -23,8 +23,10 @@
 #include "deps/kazsignal/kazsignal.h"
 
 #include "generic/managed.h"
+#include "generic/strided_span.h"
 #include "colour.h"
 #include "types.h"
+#include "vertex_formats.h"
 
 namespace smlt {
 
@@ -91,12 +93,25 @@ public:
     void normal(const Vec3& n);
 
     void normal_at(int32_t idx, Vec3& out) {
-        assert(vertex_specification_.normal_attribute == VERTEX_ATTRIBUTE_3F);
+        VertexAttribute attr = vertex_specification_.normal_attribute;
+        if(attr != VERTEX_ATTRIBUTE_3F) {
+            assert(vertex_attribute_components(attr) == 3);
+            auto v = unpack_vertex_attribute(attr, &data_[(idx * stride()) + vertex_specification_.normal_offset()]);
+            out = Vec3(v.x, v.y, v.z);
+            return;
+        }
+
         out = *((Vec3*) &data_[(idx * stride()) + vertex_specification_.normal_offset()]);
     }
 
     void normal_at(int32_t idx, Vec4& out) {
-        assert(vertex_specification_.normal_attribute == VERTEX_ATTRIBUTE_4F);
+        VertexAttribute attr = vertex_specification_.normal_attribute;
+        if(attr != VERTEX_ATTRIBUTE_4F) {
+            assert(vertex_attribute_components(attr) == 4);
+            out = unpack_vertex_attribute(attr, &data_[(idx * stride()) + vertex_specification_.normal_offset()]);
+            return;
+        }
+
         out = *((Vec4*) &data_[(idx * stride()) + vertex_specification_.normal_offset()]);
     }
 
@@ -162,6 +177,7 @@ public:
 
     void interp_vertex(uint32_t source_idx, const VertexData& dest_state, uint32_t dest_idx, VertexData& out, uint32_t out_idx, float interp);
     uint8_t* data() { if(empty()) { return nullptr; } return &data_[0]; }
+    const uint8_t* data() const { if(empty()) { return nullptr; } return &data_[0]; }
     uint32_t data_size() const { return data_.size(); }
 
     VertexAttribute attribute_for_type(VertexAttributeType type) const;
@@ -173,6 +189,25 @@ public:
 
     const VertexSpecification& specification() const { return vertex_specification_; }
 
+    /*
+     * One attribute of every vertex, for filling or reading vertices in bulk rather than one
+     * at a time through the cursor. The attribute must be a float one of T's size (e.g. Vec3
+     * for a 3F attribute). Anything which resizes the data invalidates the span.
+     */
+    template<typename T>
+    StridedSpan<T> attribute_span(VertexAttributeBit attr) {
+        VertexAttribute type = vertex_specification_.attribute(attr);
+        if(!vertex_attribute_is_float(type) || vertex_attribute_size(type) != sizeof(T)) {
+            throw std::logic_error("Vertex attribute is missing or isn't the size of the span type");
+        }
+
+        if(empty()) {
+            return StridedSpan<T>();
+        }
+
+        return StridedSpan<T>(data() + vertex_specification_.offset(attr), stride_, vertex_count_);
+    }
+
     /* Clones this VertexData into another. The other data must have the same
      * specification and will be wiped if it contains vertices already.
      *
@@ -183,6 +218,11 @@ public:
     */
     bool clone_into(VertexData& other);
 
+    /* Changes the specification, converting every vertex's attributes to their new formats.
+     * Attributes which aren't in the new specification are dropped and new ones are zeroed.
+     * Like the cursor methods, call done() afterwards */
+    void convert_to(const VertexSpecification& vertex_specification);
+
 private:
     VertexSpecification vertex_specification_;
     std::vector<uint8_t> data_;
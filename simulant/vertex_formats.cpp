@@ -0,0 +1,348 @@
+#include <algorithm>
+#include <cmath>
+#include <cstring>
+#include <vector>
+
+#include "vertex_formats.h"
+#include "vertex_data.h"
+#include "math/utils.h"
+
+namespace smlt {
+
+uint16_t float_to_half(float value) {
+    uint32_t bits;
+    std::memcpy(&bits, &value, sizeof(float));
+
+    const uint32_t sign = (bits >> 16) & 0x8000;
+    const uint32_t float_exponent = (bits >> 23) & 0xFF;
+    uint32_t mantissa = bits & 0x7FFFFF;
+
+    if(float_exponent == 0xFF) {
+        // Infinity stays infinity, NaN stays NaN
+        return uint16_t(sign | 0x7C00 | (mantissa ? 0x200 : 0));
+    }
+
+    const int32_t exponent = int32_t(float_exponent) - 127 + 15;
+
+    if(exponent >= 31) {
+        return uint16_t(sign | 0x7C00);
+    }
+
+    if(exponent <= 0) {
+        // Too small to be a normal half, so it's denormal or zero
+        if(exponent < -10) {
+            return uint16_t(sign);
+        }
+
+        mantissa |= 0x800000;
+
+        const uint32_t shift = uint32_t(14 - exponent);
+        uint32_t half = mantissa >> shift;
+        const uint32_t remainder = mantissa & ((1u << shift) - 1);
+        const uint32_t halfway = 1u << (shift - 1);
+
+        if(remainder > halfway || (remainder == halfway && (half & 1))) {
+            ++half;
+        }
+
+        return uint16_t(sign | half);
+    }
+
+    uint32_t half = sign | (uint32_t(exponent) << 10) | (mantissa >> 13);
+    const uint32_t remainder = mantissa & 0x1FFF;
+
+    // Rounding up can carry into the exponent, which is the right answer
+    if(remainder > 0x1000 || (remainder == 0x1000 && (half & 1))) {
+        ++half;
+    }
+
+    return uint16_t(half);
+}
+
+float half_to_float(uint16_t value) {
+    const uint32_t sign = uint32_t(value & 0x8000) << 16;
+    int32_t exponent = (value >> 10) & 0x1F;
+    uint32_t mantissa = value & 0x3FF;
+
+    uint32_t bits;
+    if(exponent == 0) {
+        if(!mantissa) {
+            bits = sign;
+        } else {
+            // Denormal, which is a normal float once the mantissa is shifted up
+            exponent = 1;
+            while(!(mantissa & 0x400)) {
+                mantissa <<= 1;
+                --exponent;
+            }
+
+            mantissa &= 0x3FF;
+            bits = sign | (uint32_t(exponent + 127 - 15) << 23) | (mantissa << 13);
+        }
+    } else if(exponent == 31) {
+        bits = sign | 0x7F800000 | (mantissa << 13);
+    } else {
+        bits = sign | (uint32_t(exponent + 127 - 15) << 23) | (mantissa << 13);
+    }
+
+    float out;
+    std::memcpy(&out, &bits, sizeof(float));
+    return out;
+}
+
+static int16_t to_snorm16(float value) {
+    return int16_t(std::round(clamp(value, -1.0f, 1.0f) * 32767.0f));
+}
+
+static float from_snorm16(int16_t value) {
+    return std::max(float(value) / 32767.0f, -1.0f);
+}
+
+void pack_vertex_attribute(VertexAttribute attr, const Vec4& value, uint8_t* out) {
+    const float in[4] = {value.x, value.y, value.z, value.w};
+    const uint8_t components = vertex_attribute_components(attr);
+
+    switch(attr) {
+    case VERTEX_ATTRIBUTE_2F:
+    case VERTEX_ATTRIBUTE_3F:
+    case VERTEX_ATTRIBUTE_4F:
+        std::memcpy(out, in, sizeof(float) * components);
+    break;
+    case VERTEX_ATTRIBUTE_2H:
+    case VERTEX_ATTRIBUTE_3H:
+    case VERTEX_ATTRIBUTE_4H:
+        for(uint8_t i = 0; i < components; ++i) {
+            uint16_t half = float_to_half(in[i]);
+            std::memcpy(out + (i * sizeof(uint16_t)), &half, sizeof(uint16_t));
+        }
+    break;
+    case VERTEX_ATTRIBUTE_2SN16:
+    case VERTEX_ATTRIBUTE_3SN16:
+    case VERTEX_ATTRIBUTE_4SN16:
+        for(uint8_t i = 0; i < components; ++i) {
+            int16_t snorm = to_snorm16(in[i]);
+            std::memcpy(out + (i * sizeof(int16_t)), &snorm, sizeof(int16_t));
+        }
+    break;
+    case VERTEX_ATTRIBUTE_2UN16:
+        for(uint8_t i = 0; i < components; ++i) {
+            uint16_t unorm = uint16_t(std::round(clamp(in[i], 0.0f, 1.0f) * 65535.0f));
+            std::memcpy(out + (i * sizeof(uint16_t)), &unorm, sizeof(uint16_t));
+        }
+    break;
+    case VERTEX_ATTRIBUTE_4UN8:
+        for(uint8_t i = 0; i < components; ++i) {
+            out[i] = uint8_t(std::round(clamp(in[i], 0.0f, 1.0f) * 255.0f));
+        }
+    break;
+    case VERTEX_ATTRIBUTE_PACKED_10_10_10_2: {
+        // x in the lowest bits, as GL_INT_2_10_10_10_REV expects. w is always 0
+        uint32_t packed = 0;
+        for(uint8_t i = 0; i < 3; ++i) {
+            int32_t snorm = int32_t(std::round(clamp(in[i], -1.0f, 1.0f) * 511.0f));
+            packed |= (uint32_t(snorm) & 0x3FF) << (i * 10);
+        }
+        std::memcpy(out, &packed, sizeof(uint32_t));
+    }
+    break;
+    default:
+        break;
+    }
+}
+
+Vec4 unpack_vertex_attribute(VertexAttribute attr, const uint8_t* in) {
+    float out[4] = {0, 0, 0, 0};
+    const uint8_t components = vertex_attribute_components(attr);
+
+    switch(attr) {
+    case VERTEX_ATTRIBUTE_2F:
+    case VERTEX_ATTRIBUTE_3F:
+    case VERTEX_ATTRIBUTE_4F:
+        std::memcpy(out, in, sizeof(float) * components);
+    break;
+    case VERTEX_ATTRIBUTE_2H:
+    case VERTEX_ATTRIBUTE_3H:
+    case VERTEX_ATTRIBUTE_4H:
+        for(uint8_t i = 0; i < components; ++i) {
+            uint16_t half;
+            std::memcpy(&half, in + (i * sizeof(uint16_t)), sizeof(uint16_t));
+            out[i] = half_to_float(half);
+        }
+    break;
+    case VERTEX_ATTRIBUTE_2SN16:
+    case VERTEX_ATTRIBUTE_3SN16:
+    case VERTEX_ATTRIBUTE_4SN16:
+        for(uint8_t i = 0; i < components; ++i) {
+            int16_t snorm;
+            std::memcpy(&snorm, in + (i * sizeof(int16_t)), sizeof(int16_t));
+            out[i] = from_snorm16(snorm);
+        }
+    break;
+    case VERTEX_ATTRIBUTE_2UN16:
+        for(uint8_t i = 0; i < components; ++i) {
+            uint16_t unorm;
+            std::memcpy(&unorm, in + (i * sizeof(uint16_t)), sizeof(uint16_t));
+            out[i] = float(unorm) / 65535.0f;
+        }
+    break;
+    case VERTEX_ATTRIBUTE_4UN8:
+        for(uint8_t i = 0; i < components; ++i) {
+            out[i] = float(in[i]) / 255.0f;
+        }
+    break;
+    case VERTEX_ATTRIBUTE_PACKED_10_10_10_2: {
+        uint32_t packed;
+        std::memcpy(&packed, in, sizeof(uint32_t));
+
+        for(uint8_t i = 0; i < 3; ++i) {
+            int32_t snorm = (packed >> (i * 10)) & 0x3FF;
+            if(snorm & 0x200) {
+                snorm -= 0x400; // Sign extend
+            }
+            out[i] = std::max(float(snorm) / 511.0f, -1.0f);
+        }
+    }
+    break;
+    default:
+        break;
+    }
+
+    return Vec4(out[0], out[1], out[2], out[3]);
+}
+
+/* True if every value of the attribute survives conversion to candidate within tolerance */
+static bool converts_within(const VertexData& data, VertexAttributeBit bit, VertexAttribute candidate, float tolerance) {
+    const auto& spec = data.specification();
+    const VertexAttribute current = spec.attribute(bit);
+    const uint8_t components = vertex_attribute_components(current);
+
+    if(vertex_attribute_components(candidate) != components) {
+        return false;
+    }
+
+    const uint8_t* in = data.data() + spec.offset(bit);
+    uint8_t packed[16];
+
+    for(uint32_t i = 0; i < data.count(); ++i, in += data.stride()) {
+        Vec4 value = unpack_vertex_attribute(current, in);
+        pack_vertex_attribute(candidate, value, packed);
+        Vec4 result = unpack_vertex_attribute(candidate, packed);
+
+        const float before[4] = {value.x, value.y, value.z, value.w};
+        const float after[4] = {result.x, result.y, result.z, result.w};
+
+        for(uint8_t c = 0; c < components; ++c) {
+            // Written this way round so that NaNs fail
+            if(!(std::fabs(before[c] - after[c]) <= tolerance)) {
+                return false;
+            }
+        }
+    }
+
+    return true;
+}
+
+/* The largest extent of the bounds of the data's positions */
+static float position_extent(const VertexData& data) {
+    const auto& spec = data.specification();
+    const VertexAttribute attr = spec.position_attribute;
+    const uint8_t components = vertex_attribute_components(attr);
+
+    const uint8_t* in = data.data() + spec.position_offset();
+
+    Vec4 value = unpack_vertex_attribute(attr, in);
+    float min[4] = {value.x, value.y, value.z, value.w};
+    float max[4] = {value.x, value.y, value.z, value.w};
+
+    for(uint32_t i = 1; i < data.count(); ++i) {
+        in += data.stride();
+        value = unpack_vertex_attribute(attr, in);
+
+        const float v[4] = {value.x, value.y, value.z, value.w};
+        for(uint8_t c = 0; c < components; ++c) {
+            min[c] = std::min(min[c], v[c]);
+            max[c] = std::max(max[c], v[c]);
+        }
+    }
+
+    float extent = 0.0f;
+    for(uint8_t c = 0; c < components; ++c) {
+        extent = std::max(extent, max[c] - min[c]);
+    }
+
+    return extent;
+}
+
+VertexSpecification quantized_specification(const VertexData& data, const VertexQuantizeOptions& options) {
+    const auto& spec = data.specification();
+
+    if(!data.count()) {
+        return spec;
+    }
+
+    // Twice the rounding error of the formats, so values in range always fit and clamped ones don't
+    const float NORMAL_TOLERANCE = 1.0f / 511.0f;
+    const float COLOUR_TOLERANCE = 1.0f / 255.0f;
+
+    VertexAttribute attributes[12];
+
+    for(uint32_t i = 0; i < 12; ++i) {
+        auto bit = VertexAttributeBit(1 << i);
+        auto current = spec.attribute(bit);
+        attributes[i] = current;
+
+        if(!vertex_attribute_is_float(current)) {
+            continue;
+        }
+
+        const uint8_t components = vertex_attribute_components(current);
+
+        std::vector<VertexAttribute> candidates;
+        float tolerance = 0.0f;
+
+        if(bit == VERTEX_ATTRIBUTE_BIT_POSITION) {
+            tolerance = options.position_tolerance * position_extent(data);
+            candidates = (components == 2) ? std::vector<VertexAttribute>{VERTEX_ATTRIBUTE_2SN16, VERTEX_ATTRIBUTE_2H} :
+                         (components == 3) ? std::vector<VertexAttribute>{VERTEX_ATTRIBUTE_3SN16, VERTEX_ATTRIBUTE_3H} :
+                                             std::vector<VertexAttribute>{VERTEX_ATTRIBUTE_4SN16, VERTEX_ATTRIBUTE_4H};
+        } else if(bit == VERTEX_ATTRIBUTE_BIT_NORMAL) {
+            if(!options.normals || components != 3) {
+                continue;
+            }
+
+            tolerance = NORMAL_TOLERANCE;
+            candidates = {VERTEX_ATTRIBUTE_PACKED_10_10_10_2, VERTEX_ATTRIBUTE_3SN16};
+        } else if(bit == VERTEX_ATTRIBUTE_BIT_DIFFUSE || bit == VERTEX_ATTRIBUTE_BIT_SPECULAR) {
+            if(!options.colours || components != 4) {
+                continue;
+            }
+
+            tolerance = COLOUR_TOLERANCE;
+            candidates = {VERTEX_ATTRIBUTE_4UN8};
+        } else {
+            tolerance = options.texcoord_tolerance;
+            candidates = (components == 2) ? std::vector<VertexAttribute>{VERTEX_ATTRIBUTE_2UN16, VERTEX_ATTRIBUTE_2H} :
+                         (components == 3) ? std::vector<VertexAttribute>{VERTEX_ATTRIBUTE_3H} :
+                                             std::vector<VertexAttribute>{VERTEX_ATTRIBUTE_4H};
+        }
+
+        for(auto candidate: candidates) {
+            if(options.supported && !options.supported(bit, candidate)) {
+                continue;
+            }
+
+            if(converts_within(data, bit, candidate, tolerance)) {
+                attributes[i] = candidate;
+                break;
+            }
+        }
+    }
+
+    return VertexSpecification(
+        attributes[0], attributes[1], attributes[2], attributes[3],
+        attributes[4], attributes[5], attributes[6], attributes[7],
+        attributes[8], attributes[9], attributes[10], attributes[11]
+    );
+}
+
+}
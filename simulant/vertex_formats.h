@@ -0,0 +1,44 @@
+#pragma once
+
+#include <cstdint>
+#include <functional>
+
+#include "types.h"
+
+namespace smlt {
+
+class VertexData;
+
+/* IEEE 754 half precision floats, rounded to the nearest value */
+uint16_t float_to_half(float value);
+float half_to_float(uint16_t value);
+
+/* Writes the first vertex_attribute_components(attr) values of value to out in the
+ * attribute's format. Values outside a normalized format's range are clamped to it */
+void pack_vertex_attribute(VertexAttribute attr, const Vec4& value, uint8_t* out);
+
+/* The reverse of pack_vertex_attribute(), any components the attribute doesn't have are 0 */
+Vec4 unpack_vertex_attribute(VertexAttribute attr, const uint8_t* in);
+
+struct VertexQuantizeOptions {
+    /* The furthest a position can move when it's converted, as a fraction of the largest extent
+     * of the positions' bounds. Positions which are all within [-1, 1] become snorm16, otherwise
+     * half floats if that loses no more than this */
+    float position_tolerance = 1.0f / 4096.0f;
+
+    /* The same for texture coordinates, which become unorm16 if they're all within [0, 1] */
+    float texcoord_tolerance = 1.0f / 4096.0f;
+
+    bool normals = true; // 10:10:10:2, or snorm16 if that isn't supported
+    bool colours = true; // unorm8, unless any are outside [0, 1]
+
+    /* Whether a format can be used for an attribute, usually Renderer::supports_vertex_attribute.
+     * If it isn't set, any format can be */
+    std::function<bool (VertexAttributeBit, VertexAttribute)> supported;
+};
+
+/* Picks the most compact format for each float attribute of data which holds its values
+ * within the options' tolerances. Attributes which don't fit anything smaller are left alone */
+VertexSpecification quantized_specification(const VertexData& data, const VertexQuantizeOptions& options);
+
+}
@@ -0,0 +1,209 @@
+#pragma once
+
+#include <cstdint>
+#include <cstring>
+#include <stdexcept>
+#include <type_traits>
+
+#include "generic/strided_span.h"
+#include "vertex_data.h"
+
+namespace smlt {
+
+/*
+ * One attribute of a vertex, for building a VertexLayout. T is the type it's read and
+ * written as, which decides whether it's a 2F, 3F or 4F attribute.
+ */
+template<VertexAttributeBit Bit, typename T>
+struct VertexField {
+    static_assert(sizeof(T) == 8 || sizeof(T) == 12 || sizeof(T) == 16, "Vertex attributes are 2, 3 or 4 floats");
+
+    typedef T type;
+
+    static const VertexAttributeBit bit = Bit;
+    static const VertexAttribute attribute = (sizeof(T) == 8) ? VERTEX_ATTRIBUTE_2F : (sizeof(T) == 12) ? VERTEX_ATTRIBUTE_3F : VERTEX_ATTRIBUTE_4F;
+    static const uint32_t size = vertex_attribute_size(attribute);
+};
+
+typedef VertexField<VERTEX_ATTRIBUTE_BIT_POSITION, Vec2> VertexPosition2F;
+typedef VertexField<VERTEX_ATTRIBUTE_BIT_POSITION, Vec3> VertexPosition3F;
+typedef VertexField<VERTEX_ATTRIBUTE_BIT_POSITION, Vec4> VertexPosition4F;
+typedef VertexField<VERTEX_ATTRIBUTE_BIT_NORMAL, Vec3> VertexNormal3F;
+typedef VertexField<VERTEX_ATTRIBUTE_BIT_TEXCOORD0, Vec2> VertexTexCoord0_2F;
+typedef VertexField<VERTEX_ATTRIBUTE_BIT_TEXCOORD1, Vec2> VertexTexCoord1_2F;
+typedef VertexField<VERTEX_ATTRIBUTE_BIT_DIFFUSE, Colour> VertexDiffuse4F;
+typedef VertexField<VERTEX_ATTRIBUTE_BIT_SPECULAR, Colour> VertexSpecular4F;
+
+namespace _vertex_view {
+
+/* The total size of the fields which VertexSpecification lays out before Bit */
+template<uint32_t Bit, typename... Fields>
+struct SizeBefore {
+    static const uint32_t value = 0;
+};
+
+template<uint32_t Bit, typename F, typename... Rest>
+struct SizeBefore<Bit, F, Rest...> {
+    static const uint32_t value = ((uint32_t(F::bit) < Bit) ? F::size : 0) + SizeBefore<Bit, Rest...>::value;
+};
+
+template<uint32_t Bit, typename... Fields>
+struct AttributeOf {
+    static const VertexAttribute value = VERTEX_ATTRIBUTE_NONE;
+};
+
+template<uint32_t Bit, typename F, typename... Rest>
+struct AttributeOf<Bit, F, Rest...> {
+    static const VertexAttribute value = (uint32_t(F::bit) == Bit) ? F::attribute : AttributeOf<Bit, Rest...>::value;
+};
+
+template<typename... Fields>
+struct Bits {
+    static const uint32_t mask = 0;
+    static const uint32_t sum = 0;
+};
+
+template<typename F, typename... Rest>
+struct Bits<F, Rest...> {
+    static const uint32_t mask = uint32_t(F::bit) | Bits<Rest...>::mask;
+    static const uint32_t sum = uint32_t(F::bit) + Bits<Rest...>::sum;
+};
+
+template<typename Field, typename... Fields>
+struct Contains {
+    static const bool value = false;
+};
+
+template<typename Field, typename F, typename... Rest>
+struct Contains<Field, F, Rest...> {
+    static const bool value = std::is_same<Field, F>::value || Contains<Field, Rest...>::value;
+};
+
+}
+
+/*
+ * The layout of a vertex with the given fields, worked out at compile time the same way
+ * VertexSpecification works it out at runtime. The fields can be listed in any order, they're
+ * laid out in VertexSpecification's order (position, normal, texcoords, diffuse, specular).
+ */
+template<typename... Fields>
+struct VertexLayout {
+    static_assert(sizeof...(Fields) > 0, "A vertex layout needs at least one field");
+    static_assert(_vertex_view::Bits<Fields...>::mask == _vertex_view::Bits<Fields...>::sum, "Each attribute can only appear once");
+
+    static const uint32_t stride = round_to_bytes(
+        _vertex_view::SizeBefore<VERTEX_ATTRIBUTE_BIT_ALL + 1, Fields...>::value,
+        BUFFER_STRIDE_ALIGNMENT
+    );
+
+    template<typename Field>
+    static constexpr uint32_t offset() {
+        static_assert(_vertex_view::Contains<Field, Fields...>::value, "The field isn't part of this layout");
+        return _vertex_view::SizeBefore<Field::bit, Fields...>::value;
+    }
+
+    static VertexSpecification specification() {
+        using _vertex_view::AttributeOf;
+
+        return VertexSpecification(
+            AttributeOf<VERTEX_ATTRIBUTE_BIT_POSITION, Fields...>::value,
+            AttributeOf<VERTEX_ATTRIBUTE_BIT_NORMAL, Fields...>::value,
+            AttributeOf<VERTEX_ATTRIBUTE_BIT_TEXCOORD0, Fields...>::value,
+            AttributeOf<VERTEX_ATTRIBUTE_BIT_TEXCOORD1, Fields...>::value,
+            AttributeOf<VERTEX_ATTRIBUTE_BIT_TEXCOORD2, Fields...>::value,
+            AttributeOf<VERTEX_ATTRIBUTE_BIT_TEXCOORD3, Fields...>::value,
+            AttributeOf<VERTEX_ATTRIBUTE_BIT_TEXCOORD4, Fields...>::value,
+            AttributeOf<VERTEX_ATTRIBUTE_BIT_TEXCOORD5, Fields...>::value,
+            AttributeOf<VERTEX_ATTRIBUTE_BIT_TEXCOORD6, Fields...>::value,
+            AttributeOf<VERTEX_ATTRIBUTE_BIT_TEXCOORD7, Fields...>::value,
+            AttributeOf<VERTEX_ATTRIBUTE_BIT_DIFFUSE, Fields...>::value,
+            AttributeOf<VERTEX_ATTRIBUTE_BIT_SPECULAR, Fields...>::value
+        );
+    }
+};
+
+template<typename... Fields>
+const uint32_t VertexLayout<Fields...>::stride;
+
+/*
+ * Typed access to vertices whose layout is known at compile time, as an alternative to
+ * VertexData's cursor. Each attribute is a StridedSpan with a constant stride and offset, so
+ * filling or reading a span compiles down to a simple loop (or a memcpy), rather than a
+ * function call and a specification lookup for every attribute of every vertex.
+ *
+ *     typedef VertexView<VertexPosition3F, VertexTexCoord0_2F> View;
+ *
+ *     VertexData data(View::layout::specification());
+ *     data.resize(count);
+ *
+ *     View view(data);
+ *     view.span<VertexPosition3F>().assign(&positions[0], count);
+ *     view.span<VertexTexCoord0_2F>().fill(Vec2());
+ *     data.done();
+ *
+ * The view can also wrap raw memory, such as the pointer HardwareBuffer::write() hands out.
+ * Like a StridedSpan, it doesn't own the vertices and resizing the VertexData invalidates it.
+ */
+template<typename... Fields>
+class VertexView {
+public:
+    typedef VertexLayout<Fields...> layout;
+
+    VertexView(uint8_t* data, uint32_t count):
+        data_(data),
+        count_(count) {}
+
+    /* Throws std::logic_error if the data's specification doesn't match the layout */
+    explicit VertexView(VertexData& data):
+        VertexView(data.data(), data.count()) {
+
+        if(data.specification() != layout::specification()) {
+            throw std::logic_error("The vertex data's specification doesn't match the view's layout");
+        }
+    }
+
+    uint32_t count() const { return count_; }
+    uint8_t* data() const { return data_; }
+
+    template<typename Field>
+    StridedSpan<typename Field::type> span() const {
+        if(!data_) {
+            return StridedSpan<typename Field::type>();
+        }
+
+        return StridedSpan<typename Field::type>(
+            data_ + layout::template offset<Field>(), layout::stride, count_
+        );
+    }
+
+    template<typename Field>
+    typename Field::type& get(uint32_t i) const {
+        return *reinterpret_cast<typename Field::type*>(
+            data_ + (i * layout::stride) + layout::template offset<Field>()
+        );
+    }
+
+    /* The count vertices starting at first */
+    VertexView subview(uint32_t first, uint32_t count) const {
+        return VertexView(data_ + (first * layout::stride), count);
+    }
+
+    /* Copies count whole vertices from src, starting at src_first, to dest onwards */
+    void copy(uint32_t dest, const VertexView& src, uint32_t src_first, uint32_t count) const {
+        if(!count) {
+            return;
+        }
+
+        std::memmove(
+            data_ + (dest * layout::stride),
+            src.data_ + (src_first * layout::stride),
+            count * layout::stride
+        );
+    }
+
+private:
+    uint8_t* data_;
+    uint32_t count_;
+};
+
+}
@@ -49,6 +49,7 @@
 #include "nodes/camera.h"
 
 #include "renderers/renderer_config.h"
+#include "hardware_buffer.h"
 #include "sound.h"
 #include "render_sequence.h"
 #include "stage.h"
@@ -77,7 +78,9 @@ Window::Window(int width, int height, int bpp, bool fullscreen, bool enable_vsyn
     frame_counter_time_(0),
     frame_counter_frames_(0),
     frame_time_in_milliseconds_(0),
-    time_keeper_(TimeKeeper::create(1.0 / Window::STEPS_PER_SECOND)) {
+    time_keeper_(TimeKeeper::create(1.0 / Window::STEPS_PER_SECOND)),
+    worker_pool_(std::make_shared<WorkerPool>()),
+    frame_arena_(std::make_shared<FrameArena>()) {
 
     set_width(width);
     set_height(height);
@@ -347,6 +350,9 @@ bool Window::run_frame() {
 
     Profiler profiler(__func__);
 
+    // Nothing from last frame should be holding on to arena memory by now
+    frame_arena_->reset();
+
     signal_frame_started_();
 
     float dt = 0.0f;
@@ -391,11 +397,15 @@ bool Window::run_frame() {
         if(has_context()) {
 
             stats->reset_polygons_rendered();
+            stats->reset_light_list_allocations();
+
+            renderer_->hardware_buffers->begin_frame(stats_.frames_run());
             render_sequence_->run();
 
             signal_pre_swap_();
 
             swap_buffers();
+            renderer_->hardware_buffers->end_frame();
             GLChecker::end_of_frame_check();
 
             //std::this_thread::sleep_for(std::chrono::milliseconds(10));
@@ -404,6 +414,12 @@ bool Window::run_frame() {
 
     profiler.checkpoint("rendering");
 
+    stats_.set_frame_arena_usage(
+        frame_arena_->bytes_allocated(),
+        frame_arena_->allocation_count(),
+        frame_arena_->heap_allocation_count()
+    );
+
     signal_frame_finished_();
 
     /* We totally ignore the first frame as it can take a while and messes up
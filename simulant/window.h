@@ -26,6 +26,8 @@
 #include "generic/property.h"
 #include "generic/manager.h"
 #include "generic/data_carrier.h"
+#include "generic/threading/worker_pool.h"
+#include "generic/frame_arena.h"
 
 #include "resource_locator.h"
 #include "idle_task_manager.h"
@@ -313,6 +315,12 @@ private:
 
     StatsRecorder stats_;
 
+    /* Shared by anything that wants to spread per-frame work across cores */
+    std::shared_ptr<WorkerPool> worker_pool_;
+
+    /* Scratch memory for things which are thrown away at the end of the frame */
+    std::shared_ptr<FrameArena> frame_arena_;
+
     std::shared_ptr<SoundDriver> sound_driver_;
 
     virtual std::shared_ptr<SoundDriver> create_sound_driver() = 0;
@@ -342,6 +350,8 @@ public:
     Property<Window, InputManager> input = {this, &Window::input_manager_};
     Property<Window, InputState> input_state = {this, &Window::input_state_};
     Property<Window, StatsRecorder> stats = { this, &Window::stats_ };
+    Property<Window, WorkerPool> workers = { this, &Window::worker_pool_ };
+    Property<Window, FrameArena> frame_arena = { this, &Window::frame_arena_ };
     Property<Window, Platform> platform = {this, &Window::platform_};
 
     SoundDriver* _sound_driver() const { return sound_driver_.get(); }
@@ -0,0 +1,197 @@
+#pragma once
+
+#include <set>
+#include <vector>
+
+#include <kaztest/kaztest.h>
+
+#include "../simulant/frustum.h"
+#include "../simulant/partitioners/impl/aabb_tree.h"
+
+namespace {
+
+using namespace smlt;
+
+class AABBTreeTests : public TestCase {
+public:
+    void test_empty_tree() {
+        AABBTree tree;
+
+        uint32_t found = 0;
+        tree.query_box(AABB(Vec3(), 1000.0f), [&](AABBTree::ProxyID) { ++found; });
+
+        assert_equal(0u, found);
+        assert_equal(0u, tree.height());
+        assert_true(tree.validate());
+    }
+
+    void test_small_moves_stay_in_the_fat_box() {
+        AABBTree tree(0.5f);
+
+        auto proxy = tree.create_proxy(AABB(Vec3(), 1.0f), nullptr);
+        tree.create_proxy(AABB(Vec3(10, 0, 0), 1.0f), nullptr);
+
+        assert_false(tree.move_proxy(proxy, AABB(Vec3(0.25f, 0, 0), 1.0f)));
+        assert_true(tree.move_proxy(proxy, AABB(Vec3(1.0f, 0, 0), 1.0f)));
+        tree.refit();
+
+        assert_true(tree.validate());
+
+        // The tight box is what's queried, not the fat one
+        std::set<AABBTree::ProxyID> found;
+        tree.query_box(AABB(Vec3(-0.4f, 0, 0), 0.2f), [&](AABBTree::ProxyID p) { found.insert(p); });
+        assert_equal(0u, found.size());
+
+        tree.query_box(AABB(Vec3(1.4f, 0, 0), 0.2f), [&](AABBTree::ProxyID p) { found.insert(p); });
+        assert_equal(1u, found.size());
+        assert_true(found.count(proxy));
+    }
+
+    void test_tree_stays_balanced() {
+        AABBTree tree;
+
+        // Inserting in a line is the worst case for an unbalanced tree
+        for(uint32_t i = 0; i < 1024; ++i) {
+            tree.create_proxy(AABB(Vec3(float(i) * 2.0f, 0, 0), 1.0f), nullptr);
+        }
+
+        assert_true(tree.validate());
+        assert_equal(1024u, tree.proxy_count());
+        assert_true(tree.height() <= 20);
+    }
+
+    void test_queries_match_brute_force() {
+        AABBTree tree;
+
+        const uint32_t count = 1000;
+        std::vector<AABB> boxes(count);
+        std::vector<AABBTree::ProxyID> proxies(count, AABBTree::NULL_PROXY);
+
+        for(uint32_t step = 0; step < 10000; ++step) {
+            uint32_t i = next() % count;
+            AABB box(random_position(), 0.1f + float(next() % 1000) / 100.0f);
+
+            if(proxies[i] == AABBTree::NULL_PROXY) {
+                proxies[i] = tree.create_proxy(box, &boxes[i]);
+                boxes[i] = box;
+            } else if(next() % 4 == 0) {
+                tree.destroy_proxy(proxies[i]);
+                proxies[i] = AABBTree::NULL_PROXY;
+            } else {
+                // Mostly small moves, with the odd jump across the world
+                if(next() % 10) {
+                    Vec3 offset(float(next() % 100) / 50.0f, 0, 0);
+                    box = AABB(boxes[i].min() + offset, boxes[i].max() + offset);
+                }
+
+                tree.move_proxy(proxies[i], box);
+                boxes[i] = box;
+            }
+
+            if(step % 100 != 0) {
+                continue;
+            }
+
+            tree.refit();
+            assert_true(tree.validate());
+
+            AABB query(random_position(), float(next() % 100));
+            std::set<AABBTree::ProxyID> found;
+            tree.query_box(query, [&](AABBTree::ProxyID p) {
+                assert_true(found.insert(p).second);
+            });
+
+            uint32_t expected = 0;
+            for(uint32_t j = 0; j < count; ++j) {
+                if(proxies[j] != AABBTree::NULL_PROXY && boxes[j].intersects_aabb(query)) {
+                    assert_true(found.count(proxies[j]));
+                    assert_true(tree.user_data(proxies[j]) == &boxes[j]);
+                    ++expected;
+                }
+            }
+
+            assert_equal(expected, found.size());
+        }
+
+        tree.refit();
+
+        Mat4 projection = Mat4::as_projection(Degrees(60.0), 16.0 / 9.0, 0.1, 150.0);
+        Mat4 modelview = Mat4::as_look_at(Vec3(-100, 0, 0), Vec3(0, 10, 20), Vec3(0, 1, 0));
+        Mat4 modelview_projection = projection * modelview;
+
+        Frustum frustum;
+        frustum.build(&modelview_projection);
+
+        std::set<AABBTree::ProxyID> visible;
+        tree.query_frustum(frustum, [&](AABBTree::ProxyID p) { visible.insert(p); });
+
+        // Aim at one of the boxes, so there's at least one hit
+        uint32_t target = 0;
+        while(proxies[target] == AABBTree::NULL_PROXY) {
+            ++target;
+        }
+
+        Vec3 start(-100, 1, 1);
+        Ray ray(start, (boxes[target].centre() - start).normalized());
+        std::set<AABBTree::ProxyID> hit;
+        tree.query_ray(ray, 400.0f, [&](AABBTree::ProxyID p) { hit.insert(p); });
+
+        uint32_t expected_visible = 0;
+        uint32_t expected_hit = 0;
+        for(uint32_t j = 0; j < count; ++j) {
+            if(proxies[j] == AABBTree::NULL_PROXY) {
+                continue;
+            }
+
+            if(frustum.intersects_aabb(boxes[j])) {
+                assert_true(visible.count(proxies[j]));
+                ++expected_visible;
+            }
+
+            if(ray_hits(ray, 400.0f, boxes[j])) {
+                assert_true(hit.count(proxies[j]));
+                ++expected_hit;
+            }
+        }
+
+        assert_true(expected_visible > 0);
+        assert_true(expected_hit > 0);
+        assert_equal(expected_visible, visible.size());
+
+        // Sampling can miss glancing hits, so only check the tree's hits are close
+        for(auto p: hit) {
+            auto& box = *static_cast<AABB*>(tree.user_data(p));
+            Vec3 tolerance(0.05f, 0.05f, 0.05f);
+            assert_true(ray_hits(ray, 400.0f, AABB(box.min() - tolerance, box.max() + tolerance)));
+        }
+    }
+
+private:
+    uint32_t seed_ = 11;
+
+    uint32_t next() {
+        seed_ = seed_ * 1103515245u + 12345u;
+        return (seed_ >> 8) & 0xFFFFFF;
+    }
+
+    Vec3 random_position() {
+        return Vec3(
+            float(next() % 2000) / 10.0f - 100.0f,
+            float(next() % 2000) / 10.0f - 100.0f,
+            float(next() % 2000) / 10.0f - 100.0f
+        );
+    }
+
+    /* Brute force segment test, by sampling along the ray */
+    bool ray_hits(const Ray& ray, float max_distance, const AABB& box) {
+        for(float t = 0; t <= max_distance; t += 0.02f) {
+            if(box.contains_point(ray.start + ray.dir * t)) {
+                return true;
+            }
+        }
+
+        return false;
+    }
+};
+
+}
@@ -0,0 +1,173 @@
+#pragma once
+
+#include <set>
+
+#include <kaztest/kaztest.h>
+
+#include "global.h"
+#include "../simulant/meshes/animated_frame_cache.h"
+
+namespace {
+
+using namespace smlt;
+
+/* Every vertex's x is the interpolated frame number, so frames are easy to check */
+class CountingFrameData : public MeshFrameData {
+public:
+    VertexSpecification frame_specification() const override {
+        return VertexSpecification(VERTEX_ATTRIBUTE_3F);
+    }
+
+    VertexSpecification static_specification() const override {
+        return VertexSpecification(VERTEX_ATTRIBUTE_NONE, VERTEX_ATTRIBUTE_NONE, VERTEX_ATTRIBUTE_2F);
+    }
+
+    void unpack_frame(uint32_t current_frame, uint32_t next_frame, float t, VertexData* out) override {
+        ++frames_unpacked;
+
+        float x = float(current_frame) + (float(next_frame) - float(current_frame)) * t;
+
+        out->move_to_start();
+        for(uint32_t i = 0; i < 3; ++i) {
+            out->position(x, 0, 0);
+            out->move_next();
+        }
+        out->done();
+    }
+
+    void unpack_static(VertexData* out) override {
+        ++statics_unpacked;
+
+        out->resize(3);
+        out->move_to_start();
+        for(uint32_t i = 0; i < 3; ++i) {
+            out->tex_coord0(1, 1);
+            out->move_next();
+        }
+        out->done();
+    }
+
+    uint32_t frames_unpacked = 0;
+    uint32_t statics_unpacked = 0;
+};
+
+class AnimatedFrameCacheTests : public TestCase {
+public:
+    void set_up() {
+        TestCase::set_up();
+        data_ = std::make_shared<CountingFrameData>();
+    }
+
+    void test_identical_states_share_a_frame() {
+        AnimatedFrameCache cache(data_);
+
+        auto a = cache.frame(2, 3, 0.5f);
+        auto b = cache.frame(2, 3, 0.5f);
+        auto c = cache.frame(2, 3, 0.75f);
+
+        assert_true(a == b);
+        assert_true(a != c);
+        assert_equal(2u, data_->frames_unpacked);
+        assert_equal(2u, cache.frame_count());
+
+        assert_close(2.5f, a->vertices.position_at<Vec3>(0).x, 0.0001f);
+        assert_close(2.75f, c->vertices.position_at<Vec3>(2).x, 0.0001f);
+    }
+
+    void test_interpolation_steps_round_to_the_nearest() {
+        AnimatedFrameCache cache(data_);
+        cache.set_interpolation_steps(4);
+
+        auto a = cache.frame(0, 1, 0.24f);
+        auto b = cache.frame(0, 1, 0.26f);
+        auto c = cache.frame(0, 1, 0.4f);
+
+        assert_true(a == b);
+        assert_true(a != c);
+        assert_equal(2u, data_->frames_unpacked);
+
+        // The frame is unpacked at the step, not at whatever asked first
+        assert_close(0.25f, a->vertices.position_at<Vec3>(0).x, 0.0001f);
+        assert_close(0.5f, c->vertices.position_at<Vec3>(0).x, 0.0001f);
+    }
+
+    void test_unused_frames_are_reused() {
+        AnimatedFrameCache cache(data_);
+
+        auto a = cache.frame(0, 1, 0.5f);
+        auto unused = cache.frame(4, 5, 0.5f).get(); // Nobody holds on to this one
+
+        assert_equal(1u, cache.frame_count());
+
+        // Still cached, so asking again doesn't unpack it
+        cache.frame(4, 5, 0.5f);
+        assert_equal(2u, data_->frames_unpacked);
+
+        // A new state takes over the unused frame rather than allocating one
+        auto b = cache.frame(6, 7, 0.5f);
+        assert_true(b.get() == unused);
+        assert_true(b->needs_upload);
+        assert_equal(3u, data_->frames_unpacked);
+        assert_close(6.5f, b->vertices.position_at<Vec3>(0).x, 0.0001f);
+
+        a.reset();
+        b.reset();
+        assert_equal(0u, cache.frame_count());
+    }
+
+    void test_one_actor_swaps_between_two_frames() {
+        AnimatedFrameCache cache(data_);
+
+        // What an out of sync actor does every tick
+        std::set<AnimatedFrame*> frames;
+        AnimatedFramePtr current = cache.frame(0, 1, 0.0f);
+        for(uint32_t i = 1; i < 100; ++i) {
+            current = cache.frame(0, 1, float(i) / 100.0f);
+            frames.insert(current.get());
+        }
+
+        assert_equal(2u, frames.size());
+        assert_equal(100u, data_->frames_unpacked);
+    }
+
+    void test_static_frame_is_unpacked_once() {
+        AnimatedFrameCache cache(data_);
+
+        auto a = cache.static_frame();
+        auto b = cache.static_frame();
+
+        assert_true(a == b);
+        assert_equal(1u, data_->statics_unpacked);
+        assert_equal(3u, a->vertices.count());
+    }
+
+private:
+    std::shared_ptr<CountingFrameData> data_;
+};
+
+class AnimatedActorTests : public SimulantTestCase {
+public:
+    void test_stepping_an_actor_reuses_its_buffers() {
+        auto stage = window->new_stage();
+        auto mesh_id = stage->assets->new_mesh_from_file("ogro.md2");
+        auto actor = stage->new_actor_with_mesh(mesh_id);
+
+        // Let the first few ticks allocate whatever the actor keeps hold of
+        for(uint32_t i = 0; i < 5; ++i) {
+            actor->_update_thunk(1.0f / 60.0f);
+        }
+
+        auto allocated = window->renderer->hardware_buffers->allocation_count();
+
+        for(uint32_t i = 0; i < 120; ++i) {
+            actor->_update_thunk(1.0f / 60.0f);
+        }
+
+        assert_equal(allocated, window->renderer->hardware_buffers->allocation_count());
+
+        stage->delete_actor(actor->id());
+        window->delete_stage(stage->id());
+    }
+};
+
+}
@@ -0,0 +1,187 @@
+#pragma once
+
+#include <vector>
+
+#include <kaztest/kaztest.h>
+
+#include "global.h"
+#include "../simulant/renderers/gl2x/buffer_pages.h"
+#include "../simulant/renderers/gl2x/buffer_manager.h"
+
+namespace {
+
+using namespace smlt;
+
+class BufferPageAllocatorTests : public TestCase {
+public:
+    void test_blocks_share_a_page() {
+        BufferPageAllocator allocator(1024, 16);
+
+        bool created = false;
+        auto a = allocator.allocate(0, 100, &created);
+        assert_true(created);
+
+        auto b = allocator.allocate(0, 10, &created);
+        assert_false(created);
+
+        assert_equal(a.page, b.page);
+        assert_equal(0u, a.offset);
+        assert_equal(112u, a.size); // Rounded to the alignment
+        assert_equal(112u, b.offset);
+
+        // Different pools never share
+        auto c = allocator.allocate(1, 10, &created);
+        assert_true(created);
+        assert_true(c.page != a.page);
+
+        auto stats = allocator.stats(0);
+        assert_equal(1u, stats.page_count);
+        assert_equal(128u, stats.used_bytes);
+        assert_equal(896u, stats.free_bytes);
+    }
+
+    void test_released_space_is_reused() {
+        BufferPageAllocator allocator(1024, 16);
+
+        auto a = allocator.allocate(0, 256);
+        auto b = allocator.allocate(0, 256);
+        auto c = allocator.allocate(0, 384);
+
+        // The only gap big enough is where b was
+        allocator.release(b);
+
+        bool created = true;
+        auto d = allocator.allocate(0, 200, &created);
+        assert_false(created);
+        assert_equal(b.offset, d.offset);
+
+        allocator.release(a);
+        allocator.release(c);
+        allocator.release(d);
+
+        // Everything merged back into one range
+        auto stats = allocator.stats();
+        assert_equal(1u, stats.page_count);
+        assert_equal(1u, stats.free_block_count);
+        assert_equal(1024u, stats.largest_free_block);
+    }
+
+    void test_smallest_fitting_range_is_used() {
+        BufferPageAllocator allocator(1024, 16);
+
+        std::vector<BufferBlock> blocks;
+        for(uint32_t i = 0; i < 8; ++i) {
+            blocks.push_back(allocator.allocate(0, 128));
+        }
+
+        // Leaves a 128 byte hole and a 256 byte hole
+        allocator.release(blocks[1]);
+        allocator.release(blocks[4]);
+        allocator.release(blocks[5]);
+
+        auto small = allocator.allocate(0, 120);
+        assert_equal(blocks[1].offset, small.offset);
+
+        auto stats = allocator.stats();
+        assert_equal(1u, stats.free_block_count);
+        assert_equal(256u, stats.largest_free_block);
+    }
+
+    void test_full_pages_spill_into_new_ones() {
+        BufferPageAllocator allocator(1024, 16);
+
+        auto a = allocator.allocate(0, 1000);
+        auto b = allocator.allocate(0, 1000);
+        assert_true(a.page != b.page);
+        assert_equal(2u, allocator.pages(0).size());
+
+        // The first empty page goes, the last one is kept for next time
+        assert_true(allocator.release(a));
+        assert_false(allocator.release(b));
+        assert_equal(1u, allocator.pages(0).size());
+    }
+
+    void test_oversized_blocks_get_their_own_page() {
+        BufferPageAllocator allocator(1024, 16);
+
+        auto small = allocator.allocate(0, 16);
+        auto big = allocator.allocate(0, 5000);
+
+        assert_true(big.page != small.page);
+        assert_equal(5008u, allocator.page_size(big.page));
+
+        // Nothing else goes in a dedicated page, and it goes as soon as it's empty
+        auto other = allocator.allocate(0, 16);
+        assert_equal(small.page, other.page);
+
+        assert_true(allocator.release(big));
+    }
+
+    void test_resize_in_place() {
+        BufferPageAllocator allocator(1024, 16);
+
+        auto a = allocator.allocate(0, 64);
+        auto b = allocator.allocate(0, 64);
+
+        // Blocked by b
+        assert_false(allocator.resize_in_place(a, 128));
+
+        assert_true(allocator.resize_in_place(b, 512));
+        assert_equal(512u, b.size);
+
+        assert_true(allocator.resize_in_place(b, 32));
+        assert_equal(32u, b.size);
+
+        auto stats = allocator.stats();
+        assert_equal(96u, stats.used_bytes);
+        assert_equal(1u, stats.free_block_count);
+    }
+};
+
+
+class GL2BufferManagerAccountingTests : public TestCase {
+public:
+    void test_buffers_are_sub_allocated() {
+        GL2BufferManager manager(nullptr, true, 4096);
+
+        auto a = manager.allocate(1000, HARDWARE_BUFFER_VERTEX_ATTRIBUTES, SHADOW_BUFFER_DISABLED);
+        auto b = manager.allocate(1000, HARDWARE_BUFFER_VERTEX_ATTRIBUTES, SHADOW_BUFFER_DISABLED);
+        auto c = manager.allocate(1000, HARDWARE_BUFFER_VERTEX_ARRAY_INDICES, SHADOW_BUFFER_DISABLED);
+
+        assert_equal(0u, a->offset());
+        assert_equal(1008u, b->offset());
+        assert_equal(0u, c->offset());
+
+        auto stats = manager.page_stats(HARDWARE_BUFFER_VERTEX_ATTRIBUTES, HARDWARE_BUFFER_MODIFY_ONCE_USED_FOR_RENDERING);
+        assert_equal(1u, stats.page_count);
+        assert_equal(2016u, stats.used_bytes);
+
+        a.reset();
+
+        // Reuses a's space
+        auto d = manager.allocate(500, HARDWARE_BUFFER_VERTEX_ATTRIBUTES, SHADOW_BUFFER_DISABLED);
+        assert_equal(0u, d->offset());
+        assert_equal(2u, manager.page_stats().page_count);
+    }
+
+    void test_resize_moves_when_it_has_to() {
+        GL2BufferManager manager(nullptr, true, 4096);
+
+        auto a = manager.allocate(256, HARDWARE_BUFFER_VERTEX_ATTRIBUTES, SHADOW_BUFFER_DISABLED);
+        auto b = manager.allocate(256, HARDWARE_BUFFER_VERTEX_ATTRIBUTES, SHADOW_BUFFER_DISABLED);
+
+        b->resize(1024);
+        assert_equal(256u, b->offset());
+        assert_equal(1024u, b->size());
+
+        a->resize(512);
+        assert_equal(1280u, a->offset());
+        assert_equal(512u, a->size());
+
+        auto stats = manager.page_stats();
+        assert_equal(1536u, stats.used_bytes);
+        assert_equal(256u, stats.free_bytes - stats.largest_free_block);
+    }
+};
+
+}
@@ -0,0 +1,175 @@
+#pragma once
+
+#include <vector>
+
+#include <kaztest/kaztest.h>
+
+#include "../simulant/frustum.h"
+#include "../simulant/partitioners/impl/flat_spatial_hash.h"
+
+namespace {
+
+using namespace smlt;
+
+class FlatSpatialHashTests : public TestCase {
+public:
+    void set_up() {
+        hash_ = new smlt::FlatSpatialHash();
+    }
+
+    void tear_down() {
+        delete hash_;
+    }
+
+    void test_morton_code_interleaves_bits() {
+        const uint64_t x_bits = 0x1249249249249249ull;
+        const uint64_t y_bits = x_bits << 1;
+        const uint64_t z_bits = x_bits << 2;
+
+        auto origin = FlatSpatialHash::morton_code(0, 0, 0);
+
+        // Moving along an axis only changes that axis' bits
+        assert_equal(0u, (FlatSpatialHash::morton_code(5, 0, 0) ^ origin) & (y_bits | z_bits));
+        assert_equal(0u, (FlatSpatialHash::morton_code(0, -5, 0) ^ origin) & (x_bits | z_bits));
+        assert_equal(0u, (FlatSpatialHash::morton_code(0, 0, 5) ^ origin) & (x_bits | y_bits));
+
+        assert_true(FlatSpatialHash::morton_code(-1, -1, -1) < origin);
+        assert_true(FlatSpatialHash::morton_code(1, 1, 1) > origin);
+    }
+
+    void test_retrieving_objects_within_a_box() {
+        SpatialHashEntry entry1, entry2, entry3;
+
+        AABB box1(Vec3(0.5, 0.5, 0.5), 0.5);
+        AABB box2(Vec3(0, 0, 0), 5.0);
+        AABB box3(Vec3(10, 10, 10), 1.0);
+
+        hash_->insert_object_for_box(box1, &entry1);
+        hash_->insert_object_for_box(box2, &entry2);
+        hash_->insert_object_for_box(box3, &entry3);
+
+        assert_equal(3u, hash_->entry_count());
+
+        auto results = hash_->find_objects_within_box(AABB(Vec3(), 5.0));
+        assert_equal(results.size(), 2u);
+
+        results = hash_->find_objects_within_box(AABB(Vec3(150.0, 150.0, 150.0), 1.0));
+        assert_equal(results.size(), 0u);
+
+        results = hash_->find_objects_within_box(AABB(Vec3(), 400));
+        assert_equal(results.size(), 3u);
+
+        results = hash_->find_objects_within_box(AABB(Vec3(1000, 1000, 1000), 400));
+        assert_equal(results.size(), 0u);
+    }
+
+    void test_retrieving_objects_within_frustum() {
+        SpatialHashEntry entry1, entry2, entry3, entry4;
+
+        hash_->insert_object_for_box(AABB(Vec3(0.5, 0.5, -0.5), 0.5), &entry1);
+        hash_->insert_object_for_box(AABB(Vec3(0, 0, -1), 5.0), &entry2);
+        hash_->insert_object_for_box(AABB(Vec3(10, 10, -200), 1.0), &entry3);
+        hash_->insert_object_for_box(AABB(Vec3(0, 0, 1), 1.0), &entry4);
+
+        Frustum frustum;
+        Mat4 projection = Mat4::as_projection(Degrees(45.0), 16.0 / 9.0, 0.1, 100.0);
+        Mat4 modelview;
+        Mat4 modelview_projection = projection * modelview;
+        frustum.build(&modelview_projection);
+
+        auto results = hash_->find_objects_within_frustum(frustum);
+        assert_equal(results.size(), 2u);
+
+        // Entries are stamped by each query, a second query must still find them
+        results = hash_->find_objects_within_frustum(frustum);
+        assert_equal(results.size(), 2u);
+    }
+
+    void test_updating_and_removing_objects() {
+        SpatialHashEntry entry;
+
+        hash_->insert_object_for_box(AABB(Vec3(), 1.0), &entry);
+        hash_->update_object_for_box(AABB(Vec3(100, 0, 0), 1.0), &entry);
+
+        assert_equal(0u, hash_->find_objects_within_box(AABB(Vec3(), 2.0)).size());
+        assert_equal(1u, hash_->find_objects_within_box(AABB(Vec3(100, 0, 0), 2.0)).size());
+
+        // Growing moves the object up a level
+        hash_->update_object_for_box(AABB(Vec3(100, 0, 0), 50.0), &entry);
+        assert_equal(1u, hash_->find_objects_within_box(AABB(Vec3(80, 0, 0), 2.0)).size());
+
+        hash_->remove_object(&entry);
+        assert_equal(0u, hash_->entry_count());
+        assert_equal(0u, hash_->find_objects_within_box(AABB(Vec3(), 1000.0)).size());
+    }
+
+    void test_matches_brute_force() {
+        const uint32_t count = 500;
+
+        std::vector<SpatialHashEntry> entries(count);
+        std::vector<AABB> boxes(count);
+        std::vector<bool> inserted(count, false);
+
+        for(uint32_t step = 0; step < 5000; ++step) {
+            uint32_t i = next() % count;
+            AABB box(random_position(), 0.1f + float(next() % 4000) / 100.0f);
+
+            switch(next() % 3) {
+                case 0:
+                    hash_->insert_object_for_box(box, &entries[i]);
+                    boxes[i] = box;
+                    inserted[i] = true;
+                break;
+                case 1:
+                    if(inserted[i]) {
+                        hash_->update_object_for_box(box, &entries[i]);
+                        boxes[i] = box;
+                    }
+                break;
+                default:
+                    hash_->remove_object(&entries[i]);
+                    inserted[i] = false;
+            }
+
+            if(step % 10 == 0) {
+                AABB query(random_position(), float(next() % 200));
+                auto results = hash_->find_objects_within_box(query);
+
+                uint32_t expected = 0;
+                for(uint32_t j = 0; j < count; ++j) {
+                    if(inserted[j] && boxes[j].intersects_aabb(query)) {
+                        assert_true(results.count(&entries[j]));
+                        ++expected;
+                    }
+                }
+
+                assert_equal(expected, results.size());
+            }
+        }
+
+        for(auto& entry: entries) {
+            hash_->remove_object(&entry);
+        }
+
+        assert_equal(0u, hash_->entry_count());
+    }
+
+private:
+    smlt::FlatSpatialHash* hash_ = nullptr;
+    uint32_t seed_ = 7;
+
+    uint32_t next() {
+        seed_ = seed_ * 1103515245u + 12345u;
+        return (seed_ >> 8) & 0xFFFFFF;
+    }
+
+    Vec3 random_position() {
+        return Vec3(
+            float(next() % 2000) / 10.0f - 100.0f,
+            float(next() % 2000) / 10.0f - 100.0f,
+            float(next() % 2000) / 10.0f - 100.0f
+        );
+    }
+};
+
+}
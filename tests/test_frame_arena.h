@@ -0,0 +1,96 @@
+#pragma once
+
+#include <vector>
+#include <cstdint>
+
+#include "kaztest/kaztest.h"
+
+#include "simulant/generic/frame_arena.h"
+#include "simulant/generic/threading/worker_pool.h"
+
+namespace {
+
+using namespace smlt;
+
+class FrameArenaTests : public TestCase {
+public:
+    void test_allocations_are_aligned() {
+        FrameArena arena(256);
+
+        arena.allocate(3, 1);
+        void* ptr = arena.allocate(8, 16);
+
+        assert_equal(0u, (uint32_t) (uintptr_t(ptr) % 16));
+        assert_equal(2u, arena.allocation_count());
+        assert_equal(11u, (uint32_t) arena.bytes_allocated());
+    }
+
+    void test_overflow_merges_blocks_on_reset() {
+        FrameArena arena(128);
+
+        for(uint32_t i = 0; i < 10; ++i) {
+            arena.allocate(64);
+        }
+
+        assert_true(arena.heap_allocation_count() > 0);
+
+        auto capacity = arena.capacity();
+        arena.reset();
+
+        // The merge itself is the only allocation
+        assert_equal(1u, arena.heap_allocation_count());
+        assert_equal(0u, arena.allocation_count());
+        assert_equal(capacity, arena.capacity());
+
+        // The same frame now fits without going to the heap
+        for(uint32_t i = 0; i < 3; ++i) {
+            arena.reset();
+
+            for(uint32_t j = 0; j < 10; ++j) {
+                arena.allocate(64);
+            }
+
+            assert_equal(0u, arena.heap_allocation_count());
+        }
+    }
+
+    void test_frame_vector() {
+        FrameArena arena;
+
+        FrameAllocator<uint32_t> allocator(&arena);
+        FrameVector<uint32_t> values(allocator);
+        for(uint32_t i = 0; i < 100; ++i) {
+            values.push_back(i);
+        }
+
+        assert_equal(99u, values.back());
+        assert_true(arena.allocation_count() > 0);
+
+        // Without an arena it's just a normal vector
+        FrameVector<uint32_t> heap_values;
+        heap_values.push_back(1);
+        assert_equal(1u, heap_values[0]);
+    }
+
+    void test_concurrent_allocation() {
+        FrameArena arena(1024);
+        WorkerPool pool(3);
+
+        std::vector<uint32_t*> pointers(1000, nullptr);
+
+        pool.parallel_for(pointers.size(), 10, [&](uint32_t, uint32_t begin, uint32_t end) {
+            for(uint32_t i = begin; i < end; ++i) {
+                pointers[i] = static_cast<uint32_t*>(arena.allocate(sizeof(uint32_t), alignof(uint32_t)));
+                *pointers[i] = i;
+            }
+        });
+
+        assert_equal(1000u, arena.allocation_count());
+
+        for(uint32_t i = 0; i < pointers.size(); ++i) {
+            assert_equal(i, *pointers[i]);
+        }
+    }
+};
+
+}
@@ -0,0 +1,91 @@
+#pragma once
+
+#include <algorithm>
+#include <vector>
+
+#include <kaztest/kaztest.h>
+
+#include "../simulant/partitioners/impl/light_grid.h"
+#include "../simulant/random.h"
+
+namespace {
+
+using namespace smlt;
+
+class LightGridTests : public TestCase {
+public:
+    void test_cell_size_for_dimension() {
+        assert_equal(1, LightGrid::cell_size_for_dimension(0.5f));
+        assert_equal(8, LightGrid::cell_size_for_dimension(5.0f));
+        assert_equal(16, LightGrid::cell_size_for_dimension(16.0f));
+    }
+
+    void test_empty_grid_has_no_candidates() {
+        LightGrid grid;
+        grid.reset(4);
+        grid.finalize();
+
+        std::vector<uint32_t> candidates;
+        grid.candidates_for_box(AABB(Vec3(), 1.0f), candidates);
+
+        assert_true(candidates.empty());
+    }
+
+    void test_candidates_include_every_intersecting_light() {
+        std::vector<AABB> lights;
+        for(uint32_t i = 0; i < 100; ++i) {
+            lights.push_back(AABB(Vec3(next_float(), next_float(), next_float()), 4.0f));
+        }
+
+        LightGrid grid;
+        grid.reset(LightGrid::cell_size_for_dimension(4.0f));
+        for(uint32_t i = 0; i < lights.size(); ++i) {
+            grid.insert(i, lights[i]);
+        }
+        grid.finalize();
+
+        std::vector<uint32_t> candidates;
+        for(uint32_t j = 0; j < 100; ++j) {
+            AABB box(Vec3(next_float(), next_float(), next_float()), 2.0f);
+
+            candidates.clear();
+            grid.candidates_for_box(box, candidates);
+
+            assert_true(std::is_sorted(candidates.begin(), candidates.end()));
+            assert_true(std::unique(candidates.begin(), candidates.end()) == candidates.end());
+
+            for(uint32_t i = 0; i < lights.size(); ++i) {
+                if(lights[i].intersects_aabb(box)) {
+                    assert_true(std::binary_search(candidates.begin(), candidates.end(), i));
+                }
+            }
+
+            // The whole point is to not return everything
+            assert_true(candidates.size() < lights.size());
+        }
+    }
+
+    void test_oversized_lights_are_always_candidates() {
+        LightGrid grid;
+        grid.reset(1);
+        grid.insert(0, AABB(Vec3(), 100.0f));
+        grid.insert(1, AABB(Vec3(10, 10, 10), 0.5f));
+        grid.finalize();
+
+        std::vector<uint32_t> candidates;
+        grid.candidates_for_box(AABB(Vec3(-20, -20, -20), 0.5f), candidates);
+
+        assert_equal(1u, candidates.size());
+        assert_equal(0u, candidates[0]);
+    }
+
+private:
+    RandomGenerator random_ = RandomGenerator(1);
+
+    /* Deterministic values in [-32, 32) */
+    float next_float() {
+        return random_.float_in_range(-32.0f, 32.0f);
+    }
+};
+
+}
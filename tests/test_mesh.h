@@ -4,6 +4,7 @@
 #include "kaztest/kaztest.h"
 
 #include "simulant/simulant.h"
+#include "simulant/vertex_formats.h"
 #include "global.h"
 
 namespace {
@@ -252,6 +253,32 @@ public:
         assert_equal(smlt::Vec2(1.0 / 3.0, 4.0 / 4.0), vd.texcoord0_at<smlt::Vec2>(23));
     }
 
+    void test_sphere_fills_compact_attributes() {
+        smlt::VertexSpecification spec = smlt::VertexSpecification::DEFAULT;
+        spec.normal_attribute = smlt::VERTEX_ATTRIBUTE_3SN16;
+        spec.texcoord0_attribute = smlt::VERTEX_ATTRIBUTE_4H;
+        spec.texcoord1_attribute = smlt::VERTEX_ATTRIBUTE_NONE;
+        spec.diffuse_attribute = smlt::VERTEX_ATTRIBUTE_4UN8;
+
+        auto mesh = stage_->assets->new_mesh(spec).fetch();
+        smlt::procedural::mesh::sphere(mesh, 2.0);
+
+        auto& vd = *mesh->vertex_data;
+        assert_true(vd.count() > 0);
+
+        // The last vertex is the bottom pole
+        const uint8_t* last = vd.data() + (vd.count() - 1) * vd.stride();
+
+        auto normal = smlt::unpack_vertex_attribute(spec.normal_attribute, last + spec.offset(smlt::VERTEX_ATTRIBUTE_BIT_NORMAL));
+        assert_close(-1.0f, normal.y, 0.001f);
+
+        auto uv = smlt::unpack_vertex_attribute(spec.texcoord0_attribute, last + spec.offset(smlt::VERTEX_ATTRIBUTE_BIT_TEXCOORD0));
+        assert_close(0.5f, uv.y, 0.001f);
+
+        auto diffuse = smlt::unpack_vertex_attribute(spec.diffuse_attribute, last + spec.offset(smlt::VERTEX_ATTRIBUTE_BIT_DIFFUSE));
+        assert_equal(smlt::Vec4(1, 1, 1, 1), diffuse);
+    }
+
 private:
     smlt::CameraPtr camera_;
     smlt::StagePtr stage_;
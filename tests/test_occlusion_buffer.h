@@ -0,0 +1,256 @@
+#pragma once
+
+#include <cmath>
+#include <vector>
+
+#include <kaztest/kaztest.h>
+
+#include "global.h"
+#include "../simulant/occlusion_buffer.h"
+#include "../simulant/random.h"
+
+namespace {
+
+using namespace smlt;
+
+class OcclusionBufferTests : public TestCase {
+public:
+    void set_up() {
+        TestCase::set_up();
+
+        // Looking down -Z from the origin
+        Mat4 projection = Mat4::as_projection(Degrees(60.0), 2.0, 0.1, 100.0);
+        Mat4 view = Mat4::as_look_at(Vec3(), Vec3(0, 0, -1), Vec3(0, 1, 0));
+        view_projection_ = projection * view;
+    }
+
+    void test_empty_buffer_hides_nothing() {
+        OcclusionBuffer buffer(64, 32);
+        buffer.set_view_projection(view_projection_);
+
+        assert_false(buffer.is_occluded(AABB(Vec3(0, 0, -10), 1.0f)));
+        assert_false(buffer.is_occluded(AABB(Vec3(0, 0, -90), 1.0f)));
+    }
+
+    void test_size_is_rounded_up_to_tiles() {
+        OcclusionBuffer buffer(60, 30);
+
+        assert_equal(64u, buffer.width());
+        assert_equal(32u, buffer.height());
+    }
+
+    void test_wall_hides_boxes_behind_it() {
+        OcclusionBuffer buffer(64, 32);
+        buffer.set_view_projection(view_projection_);
+
+        add_wall(buffer, -20.0f, 10.0f);
+        assert_equal(2u, buffer.triangles_rasterized());
+
+        // Behind the wall
+        assert_true(buffer.is_occluded(AABB(Vec3(0, 0, -40), 1.0f)));
+        assert_true(buffer.is_occluded(AABB(Vec3(3, -2, -30), 2.0f)));
+
+        // In front of it, straddling it, and poking out from behind it
+        assert_false(buffer.is_occluded(AABB(Vec3(0, 0, -10), 1.0f)));
+        assert_false(buffer.is_occluded(AABB(Vec3(0, 0, -20), 1.0f)));
+        assert_false(buffer.is_occluded(AABB(Vec3(20, 0, -40), 2.0f)));
+
+        // Reaching behind the camera
+        assert_false(buffer.is_occluded(AABB(Vec3(0, 0, -5), 10.0f)));
+    }
+
+    void test_boxes_poking_past_an_edge_are_visible() {
+        OcclusionBuffer buffer(64, 32);
+        buffer.set_view_projection(view_projection_);
+
+        // The wall's right edge lands past the centre of a column of pixels
+        add_wall(buffer, -20.0f, 10.0f);
+        float edge = screen_x(buffer, Vec3(10, 0, -20));
+        assert_true(edge - std::floor(edge) > 0.5f);
+
+        // A flat box twice as far away, reaching halfway from the edge to the end of that column
+        float centre = buffer.width() * 0.5f;
+        float reach = 20.0f * ((edge + std::ceil(edge)) * 0.5f - centre) / (edge - centre);
+        assert_false(buffer.is_occluded(AABB(Vec3(0, -1, -40), Vec3(reach, 1, -40))));
+
+        // Stopping well short of the edge it's hidden
+        assert_true(buffer.is_occluded(AABB(Vec3(0, -1, -40), Vec3(10, 1, -40))));
+    }
+
+    void test_single_triangles_only_write_covered_pixels() {
+        OcclusionBuffer buffer(64, 32);
+        buffer.set_view_projection(view_projection_);
+
+        // A triangle leaves a gap along its long edge, which a quad fills
+        Vec3 a(-10, -10, -20), b(10, -10, -20), c(10, 10, -20), d(-10, 10, -20);
+        buffer.rasterize_triangle(a, b, c);
+        buffer.rasterize_triangle(a, c, d);
+        assert_false(buffer.is_occluded(AABB(Vec3(0, 0, -40), 1.0f)));
+
+        buffer.clear();
+        add_wall(buffer, -20.0f, 10.0f);
+        assert_true(buffer.is_occluded(AABB(Vec3(0, 0, -40), 1.0f)));
+    }
+
+    void test_triangles_crossing_the_near_plane_are_skipped() {
+        OcclusionBuffer buffer(64, 32);
+        buffer.set_view_projection(view_projection_);
+
+        buffer.rasterize_triangle(Vec3(-50, -50, 10), Vec3(50, -50, 10), Vec3(0, 50, -30));
+
+        assert_equal(0u, buffer.triangles_rasterized());
+        assert_false(buffer.is_occluded(AABB(Vec3(0, 0, -40), 1.0f)));
+    }
+
+    void test_winding_does_not_matter() {
+        OcclusionBuffer front(64, 32), back(64, 32);
+        front.set_view_projection(view_projection_);
+        back.set_view_projection(view_projection_);
+
+        Vec3 a(-10, -10, -20), b(10, -10, -20), c(0, 10, -20);
+        front.rasterize_triangle(a, b, c);
+        back.rasterize_triangle(a, c, b);
+
+        for(uint32_t y = 0; y < front.height(); ++y) {
+            for(uint32_t x = 0; x < front.width(); ++x) {
+                assert_close(front.depth_at(x, y), back.depth_at(x, y), 0.0001f);
+            }
+        }
+    }
+
+    void test_clear_resets_the_buffer() {
+        OcclusionBuffer buffer(64, 32);
+        buffer.set_view_projection(view_projection_);
+
+        add_wall(buffer, -20.0f, 10.0f);
+        assert_true(buffer.is_occluded(AABB(Vec3(0, 0, -40), 1.0f)));
+
+        buffer.clear();
+        assert_false(buffer.is_occluded(AABB(Vec3(0, 0, -40), 1.0f)));
+        assert_equal(0u, buffer.triangles_rasterized());
+    }
+
+    void test_occluded_boxes_are_really_hidden() {
+        OcclusionBuffer buffer(128, 64);
+        buffer.set_view_projection(view_projection_);
+
+        // A field of randomly placed, randomly sized walls
+        std::vector<Vec3> triangles;
+        for(uint32_t i = 0; i < 50; ++i) {
+            Vec3 centre(random_.float_in_range(-40, 40), random_.float_in_range(-20, 20), random_.float_in_range(-80, -10));
+            float size = random_.float_in_range(1, 10);
+
+            triangles.push_back(centre + Vec3(-size, -size, 0));
+            triangles.push_back(centre + Vec3(size, -size, 0));
+            triangles.push_back(centre + Vec3(size, size, 0));
+            triangles.push_back(centre + Vec3(-size, -size, 0));
+            triangles.push_back(centre + Vec3(size, size, 0));
+            triangles.push_back(centre + Vec3(-size, size, 0));
+        }
+
+        buffer.rasterize_triangles(&triangles[0], triangles.size());
+
+        uint32_t occluded = 0;
+        for(uint32_t i = 0; i < 500; ++i) {
+            Vec3 centre(random_.float_in_range(-40, 40), random_.float_in_range(-20, 20), random_.float_in_range(-95, -5));
+            AABB box(centre, random_.float_in_range(0.1f, 3.0f));
+
+            if(!buffer.is_occluded(box)) {
+                continue;
+            }
+
+            ++occluded;
+
+            // Every point of the box must be behind what's in the buffer where it lands
+            for(float x = 0; x <= 1.0f; x += 0.25f) {
+                for(float y = 0; y <= 1.0f; y += 0.25f) {
+                    for(float z = 0; z <= 1.0f; z += 0.25f) {
+                        Vec3 p(
+                            box.min().x + box.width() * x,
+                            box.min().y + box.height() * y,
+                            box.min().z + box.depth() * z
+                        );
+
+                        assert_true(behind_buffer(buffer, p));
+                    }
+                }
+            }
+        }
+
+        assert_true(occluded > 0);
+    }
+
+private:
+    Mat4 view_projection_;
+    RandomGenerator random_ = RandomGenerator(5);
+
+    /* A square facing the camera, centred on the Z axis */
+    void add_wall(OcclusionBuffer& buffer, float z, float half_size) {
+        Vec3 a(-half_size, -half_size, z), b(half_size, -half_size, z);
+        Vec3 c(half_size, half_size, z), d(-half_size, half_size, z);
+
+        Vec3 triangles[] = {a, b, c, a, c, d};
+        buffer.rasterize_triangles(triangles, 6);
+    }
+
+    float screen_x(const OcclusionBuffer& buffer, const Vec3& p) {
+        Vec4 clip = view_projection_ * Vec4(p.x, p.y, p.z, 1.0f);
+        return (clip.x / clip.w * 0.5f + 0.5f) * buffer.width();
+    }
+
+    bool behind_buffer(const OcclusionBuffer& buffer, const Vec3& p) {
+        Vec4 clip = view_projection_ * Vec4(p.x, p.y, p.z, 1.0f);
+
+        float x = (clip.x / clip.w * 0.5f + 0.5f) * buffer.width();
+        float y = (clip.y / clip.w * 0.5f + 0.5f) * buffer.height();
+        float z = clip.z / clip.w * 0.5f + 0.5f;
+
+        if(x < 0 || y < 0 || x >= buffer.width() || y >= buffer.height()) {
+            // Off screen points don't matter
+            return true;
+        }
+
+        return buffer.depth_at(uint32_t(x), uint32_t(y)) <= z;
+    }
+};
+
+
+class OcclusionCullingTests : public SimulantTestCase {
+public:
+    void test_occluded_actors_are_not_rendered() {
+        auto stage = window->new_stage();
+        auto camera = stage->new_camera();
+        camera->set_perspective_projection(Degrees(60.0), 16.0 / 9.0, 0.1, 100.0);
+
+        PipelinePtr pipeline = window->render(stage, camera);
+
+        auto cube = stage->assets->new_mesh_as_cube(1.0);
+
+        auto hidden = stage->new_actor_with_mesh(cube);
+        hidden->move_to(0, 0, -50);
+
+        auto visible = stage->new_actor_with_mesh(cube);
+        visible->move_to(0, 0, -5);
+
+        // A big wall between the two
+        auto wall = stage->assets->new_mesh_as_rectangle(40.0f, 40.0f);
+        stage->add_occluder(wall, Mat4::as_translation(Vec3(0, 0, -20)));
+
+        window->run_frame();
+
+        assert_true(stage->has_occluders());
+        assert_equal(1u, window->stats->nodes_occluded());
+        auto rendered_with_occluder = window->stats->geometry_visible();
+
+        stage->clear_occluders();
+        window->run_frame();
+
+        assert_equal(0u, window->stats->nodes_occluded());
+        assert_true(window->stats->geometry_visible() > rendered_with_occluder);
+
+        window->delete_pipeline(pipeline->id());
+        window->delete_stage(stage->id());
+    }
+};
+
+}
@@ -1,9 +1,18 @@
 #pragma once
 
+#include <cstdio>
+#include <cstring>
+#include <fstream>
+#include <atomic>
+#include <thread>
+
 #include "global.h"
 
 #include "../simulant/nodes/geoms/octree_culler.h"
+#include "../simulant/nodes/geoms/compiled_geom.h"
+#include "../simulant/nodes/geoms/geom_culler_renderable.h"
 #include "../simulant/nodes/geom.h"
+#include "../simulant/generic/threading/worker_pool.h"
 
 namespace {
 
@@ -66,6 +75,322 @@ public:
         // Should be different renderables that came back
         assert_not_equal(ret1.get(), ret2.get());
     }
+
+    void test_visibility_does_not_touch_indices() {
+        auto stage = window->new_stage();
+        auto camera = stage->new_camera();
+
+        auto mat1 = stage->assets->new_material_from_file(Material::BuiltIns::DIFFUSE_ONLY);
+
+        auto mesh = stage->assets->new_mesh(VertexSpecification::DEFAULT).fetch();
+        mesh->new_submesh_as_box("near", mat1, 1.0, 1.0, 1.0, Vec3(0, 0, -20.0));
+        mesh->new_submesh_as_box("far", mat1, 1.0, 1.0, 1.0, Vec3(0, 0, 20.0));
+
+        camera->look_at(0, 0, -1);
+
+        auto geom = stage->new_geom_with_mesh(mesh->id());
+        auto result = geom->culler->renderables_visible(camera->frustum());
+        assert_equal(1u, result.size());
+
+        auto renderable = std::static_pointer_cast<GeomCullerRenderable>(result[0]);
+        auto count = renderable->index_element_count();
+
+        // Only one of the boxes is visible
+        assert_true(count > 0);
+        assert_equal(count * 2, renderable->_indices().count());
+        assert_equal(1u, renderable->index_ranges()->size());
+
+        uint32_t updates = 0;
+        auto connection = renderable->_indices().signal_update_complete().connect([&]() {
+            ++updates;
+        });
+
+        auto first = renderable->index_ranges()->at(0);
+
+        geom->culler->renderables_visible(camera->frustum());
+        assert_equal(count, renderable->index_element_count());
+        assert_true(first == renderable->index_ranges()->at(0));
+
+        // Only the range changes, the indices (and the index buffer) are left alone
+        camera->look_at(0, 0, 1);
+        geom->culler->renderables_visible(camera->frustum());
+        assert_equal(0u, updates);
+        assert_equal(count, renderable->index_element_count());
+        assert_false(first == renderable->index_ranges()->at(0));
+
+        connection.disconnect();
+    }
+
+    void test_parallel_compile_matches_serial() {
+        auto stage = window->new_stage();
+        auto camera = stage->new_camera();
+
+        auto mat1 = stage->assets->new_material_from_file(Material::BuiltIns::DIFFUSE_ONLY);
+        auto mat2 = stage->assets->new_material_from_file(Material::BuiltIns::DIFFUSE_ONLY);
+
+        // Enough triangles for several compile chunks, spread over both materials
+        auto mesh = stage->assets->new_mesh(VertexSpecification::DEFAULT).fetch();
+        mesh->new_submesh_as_icosphere("sphere1", mat1, 10.0, 5);
+        mesh->new_submesh_as_icosphere("sphere2", mat2, 4.0, 5);
+
+        for(uint32_t i = 0; i < 50; ++i) {
+            float offset = float(i) - 25.0f;
+            mesh->new_submesh_as_box("box", (i % 2) ? mat1 : mat2, 1.0, 1.0, 1.0, Vec3(offset, offset * 0.5f, -offset));
+        }
+
+        WorkerPool serial_workers(0);
+        WorkerPool parallel_workers(3);
+
+        OctreeCuller serial(nullptr, mesh);
+        serial.set_compile_workers(&serial_workers);
+        serial.compile();
+
+        OctreeCuller parallel(nullptr, mesh);
+        parallel.set_compile_workers(&parallel_workers);
+        parallel.compile();
+
+        std::vector<GeomCullerRenderable*> serial_renderables, parallel_renderables;
+        serial.each_renderable([&](Renderable* r) {
+            serial_renderables.push_back(static_cast<GeomCullerRenderable*>(r));
+        });
+
+        parallel.each_renderable([&](Renderable* r) {
+            parallel_renderables.push_back(static_cast<GeomCullerRenderable*>(r));
+        });
+
+        assert_equal(2u, serial_renderables.size());
+        assert_equal(serial_renderables.size(), parallel_renderables.size());
+
+        for(uint32_t i = 0; i < serial_renderables.size(); ++i) {
+            auto& lhs = serial_renderables[i]->_indices();
+            auto& rhs = parallel_renderables[i]->_indices();
+
+            assert_true(lhs.count() > 0);
+            assert_true(lhs == rhs);
+        }
+
+        // The nodes must point at the same ranges too
+        camera->look_at(0, 0, -1);
+        serial.renderables_visible(camera->frustum());
+        parallel.renderables_visible(camera->frustum());
+
+        for(uint32_t i = 0; i < serial_renderables.size(); ++i) {
+            auto& lhs = *serial_renderables[i]->index_ranges();
+            auto& rhs = *parallel_renderables[i]->index_ranges();
+
+            assert_equal(lhs.size(), rhs.size());
+            for(uint32_t j = 0; j < lhs.size(); ++j) {
+                assert_true(lhs[j] == rhs[j]);
+            }
+        }
+    }
+
+    void test_compile_on_another_thread_while_the_pool_is_busy() {
+        auto stage = window->new_stage();
+
+        auto mat1 = stage->assets->new_material_from_file(Material::BuiltIns::DIFFUSE_ONLY);
+        auto mesh = stage->assets->new_mesh(VertexSpecification::DEFAULT).fetch();
+        mesh->new_submesh_as_icosphere("sphere", mat1, 10.0, 5);
+
+        WorkerPool serial_workers(0);
+        OctreeCuller serial(nullptr, mesh);
+        serial.set_compile_workers(&serial_workers);
+        serial.compile();
+
+        // Like a geom built by load_in_background while the main thread uses the same pool
+        WorkerPool shared_workers(3);
+        OctreeCuller background(nullptr, mesh);
+        background.set_compile_workers(&shared_workers);
+
+        std::atomic<bool> compiled(false);
+        std::thread loader([&]() {
+            background.compile();
+            compiled = true;
+        });
+
+        std::vector<uint32_t> visits(1000, 0);
+        uint32_t runs = 0;
+        while(!compiled) {
+            shared_workers.parallel_for(visits.size(), 7, [&](uint32_t, uint32_t begin, uint32_t end) {
+                for(uint32_t i = begin; i < end; ++i) {
+                    visits[i]++;
+                }
+            });
+            ++runs;
+        }
+
+        loader.join();
+
+        for(auto count: visits) {
+            assert_equal(runs, count);
+        }
+
+        std::vector<GeomCullerRenderable*> lhs, rhs;
+        serial.each_renderable([&](Renderable* r) { lhs.push_back(static_cast<GeomCullerRenderable*>(r)); });
+        background.each_renderable([&](Renderable* r) { rhs.push_back(static_cast<GeomCullerRenderable*>(r)); });
+
+        assert_equal(lhs.size(), rhs.size());
+        for(uint32_t i = 0; i < lhs.size(); ++i) {
+            assert_true(lhs[i]->_indices() == rhs[i]->_indices());
+        }
+    }
+
+    void test_compiled_file_round_trip() {
+        const std::string path = "test_octree_culler.sgeo";
+
+        auto stage = window->new_stage();
+        auto camera = stage->new_camera();
+
+        auto mat1 = stage->assets->new_material_from_file(Material::BuiltIns::DIFFUSE_ONLY);
+        auto mat2 = stage->assets->new_material_from_file(Material::BuiltIns::DIFFUSE_ONLY);
+
+        auto mesh = stage->assets->new_mesh(VertexSpecification::DEFAULT).fetch();
+        mesh->new_submesh_as_icosphere("sphere", mat1, 10.0, 3);
+        mesh->new_submesh_as_box("near", mat2, 1.0, 1.0, 1.0, Vec3(0, 0, -20.0));
+        mesh->new_submesh_as_box("far", mat1, 1.0, 1.0, 1.0, Vec3(0, 0, 20.0));
+
+        OctreeCuller original(nullptr, mesh);
+        original.compile();
+        assert_true(original.save_compiled(path));
+
+        auto file = CompiledGeomFile::open(path);
+        assert_true(bool(file));
+        assert_true(file->is_compatible_with(*mesh));
+
+        OctreeCuller loaded(nullptr, mesh, file);
+        loaded.compile();
+
+        assert_equal(original.octree_bounds().min(), loaded.octree_bounds().min());
+        assert_equal(original.octree_bounds().max(), loaded.octree_bounds().max());
+
+        std::vector<GeomCullerRenderable*> original_renderables, loaded_renderables;
+        original.each_renderable([&](Renderable* r) {
+            original_renderables.push_back(static_cast<GeomCullerRenderable*>(r));
+        });
+
+        loaded.each_renderable([&](Renderable* r) {
+            loaded_renderables.push_back(static_cast<GeomCullerRenderable*>(r));
+        });
+
+        assert_equal(2u, loaded_renderables.size());
+
+        for(uint32_t i = 0; i < original_renderables.size(); ++i) {
+            auto lhs = original_renderables[i];
+            auto rhs = loaded_renderables[i];
+
+            assert_equal(lhs->material_id(), rhs->material_id());
+            assert_equal(lhs->_index_count(), rhs->_index_count());
+            assert_equal(0, memcmp(lhs->_index_data(), rhs->_index_data(), lhs->_index_data_size()));
+
+            // The loaded indices come straight from the file
+            assert_equal(0u, rhs->_indices().count());
+        }
+
+        for(auto direction: {-1.0f, 1.0f}) {
+            camera->look_at(0, 0, direction);
+            auto lhs = original.renderables_visible(camera->frustum());
+            auto rhs = loaded.renderables_visible(camera->frustum());
+
+            assert_equal(lhs.size(), rhs.size());
+
+            for(uint32_t i = 0; i < original_renderables.size(); ++i) {
+                assert_true(*original_renderables[i]->index_ranges() == *loaded_renderables[i]->index_ranges());
+            }
+        }
+
+        // A mesh with a different layout can't use the file
+        auto other = stage->assets->new_mesh_as_cube(1.0);
+        assert_false(file->is_compatible_with(*stage->assets->mesh(other)));
+
+        file.reset();
+        std::remove(path.c_str());
+    }
+
+    void test_invalid_compiled_files_are_ignored() {
+        const std::string path = "test_octree_culler_invalid.sgeo";
+
+        assert_false(bool(CompiledGeomFile::open(path)));
+
+        std::ofstream stream(path, std::ios::binary);
+        std::string garbage(512, 'x');
+        stream.write(garbage.c_str(), garbage.size());
+        stream.close();
+
+        assert_false(bool(CompiledGeomFile::open(path)));
+
+        std::remove(path.c_str());
+    }
+
+    void test_geom_uses_compiled_cache() {
+        const std::string path = "test_octree_culler_cache.sgeo";
+        std::remove(path.c_str());
+
+        auto stage = window->new_stage();
+        auto camera = stage->new_camera();
+
+        auto mat1 = stage->assets->new_material_from_file(Material::BuiltIns::DIFFUSE_ONLY);
+        auto mesh = stage->assets->new_mesh(VertexSpecification::DEFAULT).fetch();
+        mesh->new_submesh_as_box("near", mat1, 1.0, 1.0, 1.0, Vec3(0, 0, -20.0));
+        mesh->new_submesh_as_box("far", mat1, 1.0, 1.0, 1.0, Vec3(0, 0, 20.0));
+
+        camera->look_at(0, 0, -1);
+
+        // The first geom compiles and writes the file, the second uses it
+        auto first = stage->new_geom_with_mesh_and_cache(mesh->id(), path);
+        assert_true(bool(CompiledGeomFile::open(path)));
+
+        auto second = stage->new_geom_with_mesh_and_cache(mesh->id(), path);
+
+        auto lhs = first->culler->renderables_visible(camera->frustum());
+        auto rhs = second->culler->renderables_visible(camera->frustum());
+
+        assert_equal(1u, lhs.size());
+        assert_equal(1u, rhs.size());
+        assert_equal(lhs[0]->index_element_count(), rhs[0]->index_element_count());
+
+        stage->delete_geom(first->id());
+        stage->delete_geom(second->id());
+        std::remove(path.c_str());
+    }
+
+    void test_edited_mesh_recompiles_cache() {
+        const std::string path = "test_octree_culler_edited.sgeo";
+        std::remove(path.c_str());
+
+        auto stage = window->new_stage();
+
+        auto mat1 = stage->assets->new_material_from_file(Material::BuiltIns::DIFFUSE_ONLY);
+        auto mesh = stage->assets->new_mesh(VertexSpecification::DEFAULT).fetch();
+        mesh->new_submesh_as_box("box", mat1, 1.0, 1.0, 1.0);
+
+        auto first = stage->new_geom_with_mesh_and_cache(mesh->id(), path);
+
+        uint64_t old_hash = 0;
+        {
+            auto file = CompiledGeomFile::open(path);
+            assert_true(file->is_compatible_with(*mesh));
+            old_hash = file->header().source_hash;
+
+            // Same layout and counts, only one vertex moves
+            auto position = mesh->vertex_data->position_at<Vec3>(0);
+            mesh->vertex_data->move_to(0);
+            mesh->vertex_data->position(position + Vec3(0, 5.0f, 0));
+            mesh->vertex_data->done();
+
+            assert_false(file->is_compatible_with(*mesh));
+        }
+
+        auto second = stage->new_geom_with_mesh_and_cache(mesh->id(), path);
+
+        auto file = CompiledGeomFile::open(path);
+        assert_true(file->is_compatible_with(*mesh));
+        assert_not_equal(old_hash, file->header().source_hash);
+        assert_true(file->bounds().max().y >= 5.0f);
+
+        stage->delete_geom(first->id());
+        stage->delete_geom(second->id());
+        std::remove(path.c_str());
+    }
 };
 
 }
@@ -0,0 +1,278 @@
+#pragma once
+
+#include <vector>
+
+#include <kaztest/kaztest.h>
+
+#include "global.h"
+#include "../simulant/nodes/particles/particle_pool.h"
+#include "../simulant/nodes/particles/kernels.h"
+#include "../simulant/nodes/particles/billboard_writer.h"
+#include "../simulant/vertex_data.h"
+#include "../simulant/nodes/particles/manipulators/size_manipulator.h"
+
+namespace {
+
+using namespace smlt;
+using namespace smlt::particles;
+
+/* Only implements the per-particle form, so goes through the pool's copy */
+class FadeManipulator : public Manipulator {
+public:
+    FadeManipulator():
+        Manipulator("fade") {}
+
+private:
+    void do_manipulate(std::vector<Particle>& particles, float dt) {
+        for(auto& particle: particles) {
+            particle.colour.a -= dt;
+        }
+    }
+};
+
+class ParticlePoolTests : public TestCase {
+public:
+    void test_push_and_read_back() {
+        ParticlePool pool;
+        pool.set_capacity(2);
+
+        assert_true(pool.push_back(make_particle(1.0f)));
+        assert_true(pool.push_back(make_particle(2.0f)));
+        assert_false(pool.push_back(make_particle(3.0f)));
+
+        assert_equal(2u, pool.size());
+
+        auto particle = pool.at(1);
+        assert_equal(Vec3(2, 4, 6), particle.position);
+        assert_equal(Vec3(2, 0, -2), particle.velocity);
+        assert_close(2.0f, particle.dimensions.x, 0.0001f);
+        assert_close(4.0f, particle.dimensions.y, 0.0001f);
+        assert_close(2.0f, particle.ttl, 0.0001f);
+        assert_close(0.5f, particle.colour.a, 0.0001f);
+    }
+
+    void test_swap_remove_moves_the_last_particle() {
+        ParticlePool pool;
+        pool.set_capacity(3);
+
+        pool.push_back(make_particle(1.0f));
+        pool.push_back(make_particle(2.0f));
+        pool.push_back(make_particle(3.0f));
+
+        pool.swap_remove(0);
+
+        assert_equal(2u, pool.size());
+        assert_close(3.0f, pool.at(0).ttl, 0.0001f);
+        assert_close(2.0f, pool.at(1).ttl, 0.0001f);
+    }
+
+    void test_shrinking_drops_particles() {
+        ParticlePool pool;
+        pool.set_capacity(3);
+
+        pool.push_back(make_particle(1.0f));
+        pool.push_back(make_particle(2.0f));
+        pool.push_back(make_particle(3.0f));
+
+        pool.set_capacity(1);
+        assert_equal(1u, pool.size());
+        assert_close(1.0f, pool.at(0).ttl, 0.0001f);
+    }
+
+    void test_integrate_matches_scalar() {
+        ParticlePool pool;
+        pool.set_capacity(37); // Not a multiple of the vector width
+
+        std::vector<Particle> expected;
+        for(uint32_t i = 0; i < 37; ++i) {
+            auto particle = make_particle(float(i) * 0.25f + 0.1f);
+            pool.push_back(particle);
+
+            particle.position += particle.velocity * 0.1f;
+            particle.ttl -= 0.1f;
+            expected.push_back(particle);
+        }
+
+        pool.integrate(0.1f);
+
+        for(uint32_t i = 0; i < 37; ++i) {
+            auto particle = pool.at(i);
+            assert_close(expected[i].position.x, particle.position.x, 0.0001f);
+            assert_close(expected[i].position.y, particle.position.y, 0.0001f);
+            assert_close(expected[i].position.z, particle.position.z, 0.0001f);
+            assert_close(expected[i].ttl, particle.ttl, 0.0001f);
+        }
+    }
+
+    void test_remove_expired() {
+        ParticlePool pool;
+        pool.set_capacity(50);
+
+        uint32_t alive = 0;
+        for(uint32_t i = 0; i < 50; ++i) {
+            // Runs of dead particles, including at the end
+            float ttl = (i % 7 < 3 || i > 45) ? 0.0f : float(i);
+            pool.push_back(make_particle(ttl));
+            alive += (ttl > 0.0f);
+        }
+
+        pool.remove_expired();
+
+        assert_equal(alive, pool.size());
+        for(uint32_t i = 0; i < pool.size(); ++i) {
+            auto particle = pool.at(i);
+            assert_true(particle.ttl > 0.0f);
+
+            // Every attribute moved with the particle
+            assert_close(particle.ttl * 2.0f, particle.position.y, 0.0001f);
+            assert_close(particle.ttl * 2.0f, particle.dimensions.y, 0.0001f);
+        }
+    }
+
+    void test_kernels_handle_the_remainder() {
+        std::vector<float> values = {1, 2, 3, 4, 5, 6, 7};
+        kernels::scale_clamped(&values[0], 2.0f, 5.0f, values.size());
+
+        assert_close(5.0f, values[0], 0.0001f);
+        assert_close(6.0f, values[2], 0.0001f);
+        assert_close(14.0f, values[6], 0.0001f);
+
+        // 5, 5, 6, 8, 10, 12, 14 -> -1, -1, 0, 2, 4, 6, 8
+        kernels::add(&values[0], -6.0f, values.size());
+        assert_equal(0u, kernels::find_non_positive(&values[0], 0, values.size()));
+        assert_equal(2u, kernels::find_non_positive(&values[0], 2, values.size()));
+        assert_equal(7u, kernels::find_non_positive(&values[0], 3, values.size()));
+    }
+
+    void test_size_manipulator_batch() {
+        ParticlePool pool;
+        pool.set_capacity(5);
+        for(uint32_t i = 0; i < 5; ++i) {
+            pool.push_back(make_particle(float(i + 1)));
+        }
+
+        SizeManipulator manipulator;
+        manipulator.set_property("rate", -0.5f);
+        manipulator.manipulate(pool, 1.0f);
+
+        for(uint32_t i = 0; i < 5; ++i) {
+            auto particle = pool.at(i);
+            assert_close(float(i + 1) * 0.5f, particle.dimensions.x, 0.0001f);
+            assert_close(float(i + 1), particle.dimensions.y, 0.0001f);
+        }
+
+        // Can't shrink past nothing
+        manipulator.set_property("rate", -5.0f);
+        manipulator.manipulate(pool, 1.0f);
+        assert_close(0.0f, pool.at(4).dimensions.x, 0.0001f);
+    }
+
+    void test_per_particle_manipulators_still_work() {
+        ParticlePool pool;
+        pool.set_capacity(3);
+        for(uint32_t i = 0; i < 3; ++i) {
+            pool.push_back(make_particle(float(i + 1)));
+        }
+
+        FadeManipulator manipulator;
+        manipulator.manipulate(pool, 0.25f);
+
+        assert_equal(3u, pool.size());
+        for(uint32_t i = 0; i < 3; ++i) {
+            assert_close(0.25f, pool.at(i).colour.a, 0.0001f);
+            assert_close(float(i + 1), pool.at(i).ttl, 0.0001f);
+        }
+    }
+
+private:
+    Particle make_particle(float ttl) {
+        Particle particle;
+        particle.position = Vec3(ttl, ttl * 2, ttl * 3);
+        particle.velocity = Vec3(ttl, 0, -ttl);
+        particle.dimensions = Vec2(ttl, ttl * 2);
+        particle.ttl = ttl;
+        particle.colour = Colour(1, 1, 1, 0.5f);
+        return particle;
+    }
+};
+
+
+class BillboardWriterTests : public TestCase {
+public:
+    void set_up() {
+        TestCase::set_up();
+
+        spec_ = VertexSpecification(
+            VERTEX_ATTRIBUTE_3F,
+            VERTEX_ATTRIBUTE_NONE,
+            VERTEX_ATTRIBUTE_2F,
+            VERTEX_ATTRIBUTE_NONE,
+            VERTEX_ATTRIBUTE_NONE,
+            VERTEX_ATTRIBUTE_NONE,
+            VERTEX_ATTRIBUTE_NONE,
+            VERTEX_ATTRIBUTE_NONE,
+            VERTEX_ATTRIBUTE_NONE,
+            VERTEX_ATTRIBUTE_NONE,
+            VERTEX_ATTRIBUTE_4F
+        );
+    }
+
+    void test_quads_face_the_camera() {
+        ParticlePool pool;
+        pool.set_capacity(2);
+
+        Particle particle;
+        particle.position = Vec3(10, 0, 0);
+        particle.velocity = Vec3();
+        particle.dimensions = Vec2(2, 4);
+        particle.ttl = 1.0f;
+        particle.colour = Colour(0.25f, 0.5f, 0.75f, 1.0f);
+        pool.push_back(particle);
+
+        particle.position = Vec3(0, 0, -5);
+        pool.push_back(particle);
+
+        // A camera looking down -X, so right is -Z
+        BillboardWriter writer(spec_);
+        writer.set_camera_axes(Vec3(0, 0, -1), Vec3(0, 1, 0));
+
+        VertexData vertices(spec_);
+        vertices.resize(8);
+        writer.write(pool, vertices.data());
+
+        assert_equal(Vec3(10, -2, 1), vertices.position_at<Vec3>(0));
+        assert_equal(Vec3(10, -2, -1), vertices.position_at<Vec3>(1));
+        assert_equal(Vec3(10, 2, -1), vertices.position_at<Vec3>(2));
+        assert_equal(Vec3(10, 2, 1), vertices.position_at<Vec3>(3));
+
+        assert_equal(Vec3(0, -2, -4), vertices.position_at<Vec3>(4));
+        assert_equal(Vec3(0, 2, -4), vertices.position_at<Vec3>(7));
+
+        auto texcoord = vertices.texcoord0_at<Vec2>(2);
+        assert_close(1.0f, texcoord.x, 0.0001f);
+        assert_close(1.0f, texcoord.y, 0.0001f);
+
+        auto diffuse = (const float*) (vertices.data() + 5 * spec_.stride() + spec_.diffuse_offset());
+        assert_close(0.5f, diffuse[1], 0.0001f);
+        assert_close(1.0f, diffuse[3], 0.0001f);
+    }
+
+    void test_quad_indices() {
+        IndexData indices(INDEX_TYPE_16_BIT);
+        indices.index(100);
+
+        write_quad_indices(indices, 2);
+
+        assert_equal(12u, indices.count());
+
+        uint32_t expected[] = {0, 1, 2, 0, 2, 3, 4, 5, 6, 4, 6, 7};
+        for(uint32_t i = 0; i < 12; ++i) {
+            assert_equal(expected[i], indices.at(i));
+        }
+    }
+
+private:
+    VertexSpecification spec_;
+};
+
+}
@@ -0,0 +1,69 @@
+#pragma once
+
+#include <vector>
+
+#include "kaztest/kaztest.h"
+
+#include "simulant/simulant.h"
+#include "global.h"
+
+namespace {
+
+using namespace smlt;
+
+class ParticleSystemUpdateTests : public SimulantTestCase {
+public:
+    void set_up() {
+        SimulantTestCase::set_up();
+        stage_ = window->new_stage();
+    }
+
+    void tear_down() {
+        SimulantTestCase::tear_down();
+        window->delete_stage(stage_->id());
+    }
+
+    void test_every_attached_system_is_updated() {
+        std::vector<ParticleSystemPtr> systems;
+        for(uint32_t i = 0; i < 32; ++i) {
+            auto system = stage_->new_particle_system();
+            system->set_parent(stage_);
+            system->push_emitter();
+            systems.push_back(system);
+        }
+
+        // Never added to the stage's tree, so left alone
+        auto detached = stage_->new_particle_system();
+        detached->push_emitter();
+
+        stage_->update_particle_systems(1.0f);
+
+        for(auto system: systems) {
+            assert_true(system->particle_count() > 0);
+        }
+
+        assert_equal(0u, detached->particle_count());
+    }
+
+    void test_finished_systems_are_destroyed_after_the_update() {
+        auto finished = stage_->new_particle_system();
+        finished->set_parent(stage_);
+        finished->set_destroy_on_completion();
+
+        auto kept = stage_->new_particle_system();
+        kept->set_parent(stage_);
+
+        auto finished_id = finished->id();
+        auto kept_id = kept->id();
+
+        stage_->update_particle_systems(0.1f);
+
+        assert_false(stage_->has_particle_system(finished_id));
+        assert_true(stage_->has_particle_system(kept_id));
+    }
+
+private:
+    StagePtr stage_;
+};
+
+}
@@ -1,6 +1,7 @@
 #pragma once
 
 #include <functional>
+#include <vector>
 #include "kaztest/kaztest.h"
 #include "global.h"
 #include "../../simulant/partitioner.h"
@@ -152,6 +153,118 @@ public:
         partitioner._apply_writes();
         window->delete_stage(stage->id());
     }
+
+    void test_updates_are_coalesced() {
+        std::vector<StagedWrite> writes;
+        auto record = [&](const StagedWrite& write) { writes.push_back(write); };
+
+        StagePtr stage = window->new_stage();
+        ActorPtr actor = stage->new_actor();
+
+        MockPartitioner partitioner(stage, record);
+        partitioner.add_actor(actor->id());
+        partitioner.update_actor(actor->id(), AABB(Vec3(), 1.0f));
+        partitioner.update_actor(actor->id(), AABB(Vec3(), 2.0f));
+        partitioner.update_actor(actor->id(), AABB(Vec3(), 3.0f));
+        partitioner._apply_writes();
+
+        assert_equal(2u, writes.size());
+        assert_equal(WRITE_OPERATION_ADD, writes[0].operation);
+        assert_equal(WRITE_OPERATION_UPDATE, writes[1].operation);
+        assert_close(3.0f, writes[1].new_bounds.width(), 0.0001f);
+
+        window->delete_stage(stage->id());
+    }
+
+    void test_add_then_remove_cancels_out() {
+        std::vector<StagedWrite> writes;
+        auto record = [&](const StagedWrite& write) { writes.push_back(write); };
+
+        StagePtr stage = window->new_stage();
+        ActorPtr actor = stage->new_actor();
+
+        MockPartitioner partitioner(stage, record);
+        partitioner.add_actor(actor->id());
+        partitioner.update_actor(actor->id(), AABB(Vec3(), 1.0f));
+        partitioner.remove_actor(actor->id());
+        partitioner._apply_writes();
+
+        assert_true(writes.empty());
+
+        // A remove followed by an add must keep both, in order
+        partitioner.remove_actor(actor->id());
+        partitioner.add_actor(actor->id());
+        partitioner._apply_writes();
+
+        assert_equal(2u, writes.size());
+        assert_equal(WRITE_OPERATION_REMOVE, writes[0].operation);
+        assert_equal(WRITE_OPERATION_ADD, writes[1].operation);
+
+        window->delete_stage(stage->id());
+    }
+
+    void test_writes_apply_in_order() {
+        std::vector<StagedWrite> writes;
+        auto record = [&](const StagedWrite& write) { writes.push_back(write); };
+
+        StagePtr stage = window->new_stage();
+        ActorPtr actor1 = stage->new_actor();
+        ActorPtr actor2 = stage->new_actor();
+        auto light = stage->new_light_as_point();
+
+        MockPartitioner partitioner(stage, record);
+        partitioner.add_light(light->id());
+        partitioner.add_actor(actor2->id());
+        partitioner.add_actor(actor1->id());
+        partitioner.update_actor(actor2->id(), AABB(Vec3(), 1.0f));
+        partitioner._apply_writes();
+
+        assert_equal(4u, writes.size());
+        assert_equal(light->id(), writes[0].light_id);
+        assert_equal(actor2->id(), writes[1].actor_id);
+        assert_equal(WRITE_OPERATION_ADD, writes[1].operation);
+        assert_equal(actor2->id(), writes[2].actor_id);
+        assert_equal(WRITE_OPERATION_UPDATE, writes[2].operation);
+        assert_equal(actor1->id(), writes[3].actor_id);
+
+        window->delete_stage(stage->id());
+    }
+
+    void test_aabb_tree_partitioner_visibility() {
+        StagePtr stage = window->new_stage(PARTITIONER_AABB_TREE);
+
+        auto camera = stage->new_camera();
+        camera->set_perspective_projection(Degrees(45.0), 1.0, 1.0, 100.0);
+
+        auto mesh = stage->assets->new_mesh_as_cube(1.0);
+        ActorPtr in_front = stage->new_actor_with_mesh(mesh);
+        in_front->move_to(0, 0, -10);
+
+        ActorPtr behind = stage->new_actor_with_mesh(mesh);
+        behind->move_to(0, 0, 10);
+
+        stage->partitioner->_apply_writes();
+
+        std::vector<LightID> lights;
+        std::vector<StageNode*> nodes;
+        stage->partitioner->lights_and_geometry_visible_from(camera->id(), lights, nodes);
+
+        assert_equal(1u, nodes.size());
+        assert_true(nodes[0] == (Actor*) in_front);
+
+        // Swap them over, so both leave their fat boxes
+        in_front->move_to(0, 0, 10);
+        behind->move_to(0, 0, -10);
+        stage->partitioner->_apply_writes();
+
+        nodes.clear();
+        stage->partitioner->lights_and_geometry_visible_from(camera->id(), lights, nodes);
+
+        assert_equal(1u, nodes.size());
+        assert_true(nodes[0] == (Actor*) behind);
+
+        window->delete_stage(stage->id());
+    }
 };
 
 }
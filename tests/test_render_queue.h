@@ -1,13 +1,48 @@
 #pragma once
 
+#include <algorithm>
+
 #include "kaztest/kaztest.h"
 
 #include "simulant/simulant.h"
+#include "simulant/renderers/batching/render_command_buffer.h"
+#include "simulant/nodes/geoms/geom_culler.h"
+#include "simulant/nodes/geoms/geom_culler_renderable.h"
 
 namespace {
 
 using namespace smlt;
 
+class RecordingVisitor : public batcher::RenderQueueVisitor {
+public:
+    void start_traversal(const batcher::RenderQueue&, uint64_t, Stage*) override {}
+    void end_traversal(const batcher::RenderQueue&, Stage*) override {}
+
+    void change_render_group(const batcher::RenderGroup*, const batcher::RenderGroup* next) override {
+        groups.push_back(next);
+    }
+
+    void change_material_pass(const MaterialPass*, const MaterialPass*) override {}
+    void apply_lights(const LightPtr*, const uint8_t) override {}
+    void change_light(const Light*, const Light*) override {}
+
+    void visit(Renderable* renderable, MaterialPass*, batcher::Iteration) override {
+        visited.push_back(renderable);
+
+        // Record the draws the same way the GL visitors issue them
+        each_index_range(renderable, [&](uint32_t start, uint32_t count) {
+            IndexRange range;
+            range.start = start;
+            range.count = count;
+            draws.push_back(range);
+        });
+    }
+
+    std::vector<const batcher::RenderGroup*> groups;
+    std::vector<Renderable*> visited;
+    std::vector<IndexRange> draws;
+};
+
 class RenderQueueTests : public SimulantTestCase {
 public:
     void set_up() {
@@ -19,6 +54,223 @@ public:
         window->delete_stage(stage_->id());
     }
 
+    uint32_t batched_renderable_count(batcher::RenderQueue& queue) {
+        uint32_t count = 0;
+        for(uint32_t pass = 0; pass < queue.pass_count(); ++pass) {
+            queue.each_group(pass, [&](uint32_t, const batcher::RenderGroup&, const batcher::Batch& batch) {
+                count += batch.renderable_count();
+            });
+        }
+        return count;
+    }
+
+    void test_update_renderable_only_batches_once() {
+        auto mesh = stage_->assets->new_mesh_as_cube(1.0);
+        auto actor = stage_->new_actor_with_mesh(mesh);
+
+        batcher::RenderQueue queue(stage_, window->renderer.get());
+
+        auto renderable = &actor->subactor(0);
+        queue.update_renderable(renderable);
+        queue.update_renderable(renderable);
+
+        assert_equal(1u, queue.renderable_count());
+        assert_equal(1u, batched_renderable_count(queue));
+    }
+
+    void test_priority_change_moves_renderable() {
+        auto mesh = stage_->assets->new_mesh_as_cube(1.0);
+        auto actor = stage_->new_actor_with_mesh(mesh);
+
+        batcher::RenderQueue queue(stage_, window->renderer.get());
+
+        auto renderable = &actor->subactor(0);
+        queue.update_renderable(renderable);
+
+        actor->set_render_priority(RENDER_PRIORITY_FOREGROUND);
+        queue.update_renderable(renderable);
+        queue.clean_empty_batches();
+
+        assert_equal(1u, queue.renderable_count());
+        assert_equal(1u, queue.group_count(0));
+        assert_equal(1u, batched_renderable_count(queue));
+    }
+
+    void test_destroyed_renderables_leave_the_queue() {
+        auto mesh = stage_->assets->new_mesh_as_cube(1.0);
+        auto actor = stage_->new_actor_with_mesh(mesh);
+
+        batcher::RenderQueue queue(stage_, window->renderer.get());
+        queue.update_renderable(&actor->subactor(0));
+
+        assert_equal(1u, queue.renderable_count());
+
+        stage_->delete_actor(actor->id());
+
+        assert_equal(0u, queue.renderable_count());
+        assert_equal(0u, batched_renderable_count(queue));
+    }
+
+    void test_material_change_rebatches_renderable() {
+        auto material_id = stage_->assets->new_material_from_file(Material::BuiltIns::DIFFUSE_ONLY);
+        auto mesh = stage_->assets->new_mesh_as_cube(1.0);
+        mesh.fetch()->set_material_id(material_id);
+
+        auto actor = stage_->new_actor_with_mesh(mesh);
+
+        batcher::RenderQueue queue(stage_, window->renderer.get());
+        queue.update_renderable(&actor->subactor(0));
+
+        auto material = stage_->assets->material(material_id);
+        material->new_pass();
+
+        queue.apply_material_changes();
+
+        assert_equal(1u, queue.renderable_count());
+        assert_equal(material->pass_count(), queue.pass_count());
+    }
+
+    void test_sort_key_backend_matches_batched_order() {
+        auto material_id = stage_->assets->new_material_from_file(Material::BuiltIns::DIFFUSE_ONLY);
+        auto mesh = stage_->assets->new_mesh_as_cube(1.0);
+        mesh.fetch()->set_material_id(material_id);
+
+        RenderPriority priorities[] = {
+            RENDER_PRIORITY_MAIN, RENDER_PRIORITY_BACKGROUND, RENDER_PRIORITY_MAIN,
+            RENDER_PRIORITY_FOREGROUND, RENDER_PRIORITY_BACKGROUND, RENDER_PRIORITY_MAIN
+        };
+
+        batcher::RenderQueue batched(stage_, window->renderer.get(), batcher::RENDER_QUEUE_BACKEND_BATCHED);
+        batcher::RenderQueue sorted(stage_, window->renderer.get(), batcher::RENDER_QUEUE_BACKEND_SORT_KEYS);
+
+        const uint64_t frame_id = 1;
+
+        for(auto priority: priorities) {
+            auto actor = stage_->new_actor_with_mesh(mesh);
+            actor->set_render_priority(priority);
+
+            auto renderable = &actor->subactor(0);
+            renderable->update_last_visible_frame_id(frame_id);
+
+            batched.update_renderable(renderable);
+            sorted.update_renderable(renderable);
+        }
+
+        // One invisible renderable, which neither backend should visit
+        auto hidden = stage_->new_actor_with_mesh(mesh);
+        batched.update_renderable(&hidden->subactor(0));
+        sorted.update_renderable(&hidden->subactor(0));
+
+        assert_equal(7u * stage_->assets->material(material_id)->pass_count(), sorted.command_count());
+
+        RecordingVisitor expected, actual;
+        batched.traverse(&expected, frame_id);
+        sorted.traverse(&actual, frame_id);
+
+        auto pass_count = stage_->assets->material(material_id)->pass_count();
+
+        assert_equal(3u * pass_count, expected.groups.size());
+        assert_equal(expected.groups.size(), actual.groups.size());
+        for(uint32_t i = 0; i < expected.groups.size(); ++i) {
+            auto& lhs = *expected.groups[i];
+            auto& rhs = *actual.groups[i];
+            assert_true(!(lhs < rhs) && !(rhs < lhs));
+        }
+
+        assert_false(expected.visited.empty());
+        assert_equal(expected.visited.size(), actual.visited.size());
+        for(uint32_t i = 0; i < expected.visited.size(); ++i) {
+            assert_equal(expected.visited[i]->render_priority(), actual.visited[i]->render_priority());
+        }
+
+        stage_->delete_actor(hidden->id());
+        assert_equal(6u * pass_count, sorted.command_count());
+    }
+
+    void test_visitors_draw_whole_buffer_without_ranges() {
+        auto mesh = stage_->assets->new_mesh_as_cube(1.0);
+        auto actor = stage_->new_actor_with_mesh(mesh);
+
+        auto renderable = &actor->subactor(0);
+        renderable->update_last_visible_frame_id(1);
+
+        batcher::RenderQueue queue(stage_, window->renderer.get());
+        queue.update_renderable(renderable);
+
+        RecordingVisitor visitor;
+        queue.traverse(&visitor, 1);
+
+        assert_false(visitor.draws.empty());
+        for(auto& range: visitor.draws) {
+            assert_equal(0u, range.start);
+            assert_equal(renderable->index_element_count(), range.count);
+        }
+    }
+
+    void test_visitors_draw_index_ranges() {
+        auto camera = stage_->new_camera();
+        auto material_id = stage_->assets->new_material_from_file(Material::BuiltIns::DIFFUSE_ONLY);
+
+        // Three boxes, the middle one is behind the camera
+        auto mesh = stage_->assets->new_mesh(VertexSpecification::DEFAULT).fetch();
+        mesh->new_submesh_as_box("a", material_id, 1.0, 1.0, 1.0, Vec3(-5, 0, -20.0));
+        mesh->new_submesh_as_box("b", material_id, 1.0, 1.0, 1.0, Vec3(0, 0, 20.0));
+        mesh->new_submesh_as_box("c", material_id, 1.0, 1.0, 1.0, Vec3(5, 0, -20.0));
+
+        camera->look_at(0, 0, -1);
+
+        auto geom = stage_->new_geom_with_mesh(mesh->id());
+        auto visible = geom->culler->renderables_visible(camera->frustum());
+        assert_equal(1u, visible.size());
+
+        auto renderable = std::static_pointer_cast<GeomCullerRenderable>(visible[0]);
+        renderable->update_last_visible_frame_id(1);
+
+        batcher::RenderQueue queue(stage_, window->renderer.get());
+        queue.update_renderable(renderable.get());
+
+        RecordingVisitor visitor;
+        queue.traverse(&visitor, 1);
+
+        auto pass_count = stage_->assets->material(material_id)->pass_count();
+        auto& ranges = *renderable->index_ranges();
+
+        assert_false(ranges.empty());
+        assert_equal(ranges.size() * pass_count, visitor.draws.size());
+
+        // Every pass draws exactly the visible ranges, in order, and nothing else
+        uint32_t drawn = 0;
+        for(uint32_t i = 0; i < visitor.draws.size(); ++i) {
+            auto& range = visitor.draws[i];
+            assert_true(range == ranges[i % ranges.size()]);
+            assert_true(range.start + range.count <= renderable->_indices().count());
+            drawn += range.count;
+        }
+
+        assert_equal(renderable->index_element_count() * pass_count, drawn);
+        assert_true(renderable->index_element_count() < renderable->_indices().count());
+    }
+
+    void test_steady_state_frame_does_not_allocate_light_lists() {
+        auto camera = stage_->new_camera();
+        PipelinePtr pipeline = window->render(stage_, camera);
+
+        auto mesh = stage_->assets->new_mesh_as_cube(1.0);
+        for(uint32_t i = 0; i < 20; ++i) {
+            auto actor = stage_->new_actor_with_mesh(mesh);
+            actor->move_to(float(i) - 10.0f, 0, -10);
+
+            stage_->new_light_as_point(Vec3(float(i) - 10.0f, 1, -10));
+        }
+
+        window->run_frame();
+        window->run_frame();
+
+        assert_equal(0u, window->stats->light_list_allocations());
+
+        window->delete_pipeline(pipeline->id());
+    }
+
 #ifdef SIMULANT_GL_VERSION_2X
     void test_shader_grouping() {
 
@@ -32,4 +284,65 @@ private:
 
 };
 
+
+class LightListTests : public TestCase {
+public:
+    void test_assign_is_capped() {
+        std::vector<LightPtr> lights(MAX_LIGHTS_PER_RENDERABLE + 2);
+
+        LightList list;
+        list.assign(lights.data(), lights.size());
+
+        assert_equal(MAX_LIGHTS_PER_RENDERABLE, (uint32_t) list.size());
+        assert_equal(list.data() + list.size(), list.end());
+    }
+
+    void test_push_back_fails_when_full() {
+        LightList list;
+        assert_true(list.empty());
+
+        for(uint32_t i = 0; i < MAX_LIGHTS_PER_RENDERABLE; ++i) {
+            assert_true(list.push_back(LightPtr()));
+        }
+
+        assert_false(list.push_back(LightPtr()));
+        assert_equal(MAX_LIGHTS_PER_RENDERABLE, (uint32_t) list.size());
+
+        list.clear();
+        assert_true(list.empty());
+    }
+};
+
+
+class RadixSortTests : public TestCase {
+public:
+    void test_matches_stable_sort() {
+        std::vector<batcher::RenderCommand> commands(1000);
+
+        uint64_t seed = 12345;
+        for(uint32_t i = 0; i < commands.size(); ++i) {
+            seed = seed * 6364136223846793005ull + 1442695040888963407ull;
+
+            // Lots of duplicate keys so that stability matters
+            commands[i].key = (seed ^ (seed >> 29)) & 0xF00FF0000000FFull;
+            commands[i].renderable = nullptr;
+            commands[i].group = i;
+            commands[i].pass = 0;
+        }
+
+        auto expected = commands;
+        std::stable_sort(expected.begin(), expected.end(), [](const batcher::RenderCommand& lhs, const batcher::RenderCommand& rhs) {
+            return lhs.key < rhs.key;
+        });
+
+        std::vector<batcher::RenderCommand> scratch(commands.size());
+        batcher::radix_sort(commands.data(), scratch.data(), commands.size());
+
+        for(uint32_t i = 0; i < commands.size(); ++i) {
+            assert_equal(expected[i].key, commands[i].key);
+            assert_equal(expected[i].group, commands[i].group);
+        }
+    }
+};
+
 }
@@ -0,0 +1,164 @@
+#pragma once
+
+#include <thread>
+#include <vector>
+
+#include <kaztest/kaztest.h>
+
+#include "global.h"
+#include "../simulant/renderers/gl2x/dirty_ranges.h"
+#include "../simulant/renderers/gl2x/buffer_manager.h"
+
+namespace {
+
+using namespace smlt;
+
+class DirtyRangesTests : public TestCase {
+public:
+    void test_touching_ranges_merge() {
+        DirtyRanges ranges;
+
+        ranges.add(10, 20);
+        ranges.add(30, 40);
+        ranges.add(0, 5);
+        assert_equal(3u, ranges.ranges().size());
+
+        ranges.add(20, 30);
+        assert_equal(2u, ranges.ranges().size());
+        assert_equal(10u, ranges.ranges()[1].first);
+        assert_equal(40u, ranges.ranges()[1].second);
+
+        // Swallows everything
+        ranges.add(2, 50);
+        assert_equal(1u, ranges.ranges().size());
+        assert_equal(0u, ranges.ranges()[0].first);
+        assert_equal(50u, ranges.ranges()[0].second);
+        assert_equal(50u, ranges.dirty_bytes());
+    }
+
+    void test_small_gaps_are_merged() {
+        DirtyRanges ranges(8);
+
+        ranges.add(0, 10);
+        ranges.add(18, 20);
+        ranges.add(40, 50);
+        ranges.add(32, 33);
+
+        assert_equal(2u, ranges.ranges().size());
+        assert_equal(20u, ranges.ranges()[0].second);
+        assert_equal(32u, ranges.ranges()[1].first);
+    }
+
+    void test_truncate() {
+        DirtyRanges ranges;
+
+        ranges.add(0, 10);
+        ranges.add(20, 30);
+        ranges.add(40, 50);
+
+        ranges.truncate(25);
+        assert_equal(2u, ranges.ranges().size());
+        assert_equal(25u, ranges.ranges()[1].second);
+    }
+};
+
+
+class GL2ShadowBufferTests : public TestCase {
+public:
+    void test_writes_are_merged_into_one_flush() {
+        GL2BufferManager manager(nullptr, true);
+
+        auto buffer = manager.allocate(1024, HARDWARE_BUFFER_VERTEX_ATTRIBUTES, SHADOW_BUFFER_ENABLE_IF_OPTIMAL);
+        assert_true(buffer->has_shadow_buffer());
+
+        std::vector<uint8_t> bytes(100, 7);
+
+        // Near enough to go up together
+        buffer->upload_range(0, &bytes[0], 16);
+        buffer->upload_range(20, &bytes[0], 16);
+        buffer->upload_range(8, &bytes[0], 4);
+
+        // Too far away
+        buffer->upload_range(900, &bytes[0], 100);
+
+        assert_equal(0u, manager.shadow_upload_count());
+
+        manager.flush_shadow_buffers();
+        assert_equal(2u, manager.shadow_upload_count());
+
+        // Nothing new to upload
+        manager.flush_shadow_buffers();
+        assert_equal(2u, manager.shadow_upload_count());
+
+        auto mapped = buffer->map_target_for_read();
+        const uint8_t* data = mapped;
+        assert_equal(7, data[20]);
+        assert_equal(0, data[40]);
+        assert_equal(7, data[999]);
+    }
+
+    void test_writes_from_other_threads_only_touch_ram() {
+        GL2BufferManager manager(nullptr, true);
+
+        auto buffer = manager.allocate(4096, HARDWARE_BUFFER_VERTEX_ATTRIBUTES, SHADOW_BUFFER_ENABLE_IF_OPTIMAL);
+
+        std::vector<std::thread> threads;
+        for(uint32_t i = 0; i < 4; ++i) {
+            threads.push_back(std::thread([&buffer, i]() {
+                std::vector<uint8_t> bytes(1024, uint8_t(i + 1));
+                buffer->upload_range(i * 1024, &bytes[0], bytes.size());
+            }));
+        }
+
+        for(auto& thread: threads) {
+            thread.join();
+        }
+
+        // The four writes touch, so they're one upload
+        manager.flush_shadow_buffers();
+        assert_equal(1u, manager.shadow_upload_count());
+
+        auto mapped = buffer->map_target_for_read();
+        const uint8_t* data = mapped;
+        assert_equal(1, data[0]);
+        assert_equal(4, data[4095]);
+    }
+
+    void test_binding_flushes_the_buffer() {
+        GL2BufferManager manager(nullptr, true);
+
+        auto buffer = manager.allocate(64, HARDWARE_BUFFER_VERTEX_ATTRIBUTES, SHADOW_BUFFER_ENABLE_IF_OPTIMAL);
+        buffer->write(64, [](uint8_t* out) { std::fill(out, out + 64, 1); });
+
+        buffer->bind(HARDWARE_BUFFER_VERTEX_ATTRIBUTES);
+        assert_equal(1u, manager.shadow_upload_count());
+
+        manager.flush_shadow_buffers();
+        assert_equal(1u, manager.shadow_upload_count());
+    }
+
+    void test_resize_keeps_the_contents() {
+        GL2BufferManager manager(nullptr, true, 4096);
+
+        auto a = manager.allocate(64, HARDWARE_BUFFER_VERTEX_ATTRIBUTES, SHADOW_BUFFER_ENABLE_IF_OPTIMAL);
+        auto b = manager.allocate(64, HARDWARE_BUFFER_VERTEX_ATTRIBUTES, SHADOW_BUFFER_ENABLE_IF_OPTIMAL);
+
+        std::vector<uint8_t> bytes(64, 9);
+        a->upload(&bytes[0], bytes.size());
+        manager.flush_shadow_buffers();
+
+        // Has to move past b, the whole buffer is uploaded again from RAM
+        a->resize(256);
+        assert_equal(128u, a->offset());
+
+        manager.flush_shadow_buffers();
+        assert_equal(2u, manager.shadow_upload_count());
+
+        auto mapped = a->map_target_for_read();
+        const uint8_t* data = mapped;
+        assert_equal(9, data[63]);
+        assert_equal(0, data[64]);
+    }
+};
+
+}
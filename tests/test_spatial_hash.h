@@ -1,7 +1,10 @@
 #pragma once
 
+#include <vector>
+
 #include <kaztest/kaztest.h>
 
+#include "../simulant/frustum.h"
 #include "../simulant/partitioners/impl/spatial_hash.h"
 
 namespace {
@@ -166,6 +169,68 @@ public:
         assert_equal(results.size(), 2u);
     }
 
+    void test_frustum_traversal_matches_brute_force() {
+        const uint32_t count = 2000;
+
+        std::vector<SpatialHashEntry> entries(count);
+        std::vector<AABB> boxes;
+
+        uint32_t seed = 3;
+        auto next = [&seed]() -> float {
+            seed = seed * 1103515245u + 12345u;
+            return float((seed >> 8) & 0xFFFF) / 65536.0f;
+        };
+
+        for(uint32_t i = 0; i < count; ++i) {
+            Vec3 centre(next() * 4000.0f - 2000.0f, next() * 400.0f - 200.0f, next() * 4000.0f - 2000.0f);
+            boxes.push_back(AABB(centre, 0.25f + next() * 60.0f));
+            hash_->insert_object_for_box(boxes.back(), &entries[i]);
+        }
+
+        // A long far plane, looking across the scene at an angle
+        Mat4 projection = Mat4::as_projection(Degrees(60.0), 16.0 / 9.0, 0.1, 3000.0);
+        Mat4 modelview = Mat4::as_look_at(Vec3(-100, 20, 50), Vec3(300, 0, -700), Vec3(0, 1, 0));
+        Mat4 modelview_projection = projection * modelview;
+
+        Frustum frustum;
+        frustum.build(&modelview_projection);
+
+        // Run twice, so the second query has stale stamps from the first
+        for(uint32_t run = 0; run < 2; ++run) {
+            auto results = hash_->find_objects_within_frustum(frustum);
+
+            uint32_t expected = 0;
+            for(uint32_t i = 0; i < count; ++i) {
+                if(frustum.intersects_aabb(boxes[i])) {
+                    assert_true(results.count(&entries[i]));
+                    ++expected;
+                }
+            }
+
+            assert_true(expected > 0);
+            assert_equal(expected, results.size());
+        }
+
+        for(auto& entry: entries) {
+            hash_->remove_object(&entry);
+        }
+    }
+
+    void test_classifying_boxes_against_a_frustum() {
+        Mat4 projection = Mat4::as_projection(Degrees(45.0), 16.0 / 9.0, 0.1, 100.0);
+        Mat4 modelview;
+        Mat4 modelview_projection = projection * modelview;
+
+        Frustum frustum;
+        frustum.build(&modelview_projection);
+
+        assert_equal(FRUSTUM_CONTAINS_ALL, frustum.classify_aabb(AABB(Vec3(0, 0, -50), 1.0)));
+        assert_equal(FRUSTUM_CONTAINS_PARTIAL, frustum.classify_aabb(AABB(Vec3(0, 0, -100), 2.0)));
+        assert_equal(FRUSTUM_CONTAINS_PARTIAL, frustum.classify_aabb(AABB(Vec3(0, 0, 0), 1000.0)));
+        assert_equal(FRUSTUM_CONTAINS_NONE, frustum.classify_aabb(AABB(Vec3(0, 0, 10), 1.0)));
+        assert_equal(FRUSTUM_CONTAINS_NONE, frustum.classify_aabb(AABB(Vec3(0, 0, -200), 1.0)));
+    }
+
     void test_removing_objects_from_the_hash() {
         test_adding_objects_to_the_hash();
 
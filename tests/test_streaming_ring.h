@@ -0,0 +1,167 @@
+#pragma once
+
+#include <vector>
+
+#include <kaztest/kaztest.h>
+
+#include "global.h"
+#include "../simulant/renderers/gl2x/streaming_ring.h"
+#include "../simulant/renderers/gl2x/buffer_manager.h"
+
+namespace {
+
+using namespace smlt;
+
+class RecordingBackend : public StreamingRingBackend {
+public:
+    RecordingBackend(std::size_t size):
+        data(size, 0) {}
+
+    void upload(std::size_t offset, const uint8_t* bytes, std::size_t size) override {
+        std::copy(bytes, bytes + size, data.begin() + offset);
+    }
+
+    void fence(uint64_t frame) override {
+        fenced.push_back(frame);
+    }
+
+    void wait(uint64_t frame) override {
+        waited.push_back(frame);
+    }
+
+    std::vector<uint8_t> data;
+    std::vector<uint64_t> fenced;
+    std::vector<uint64_t> waited;
+};
+
+class StreamingRingTests : public TestCase {
+public:
+    void test_each_frame_writes_the_next_region() {
+        RecordingBackend backend(3 * 256);
+        StreamingRing ring(&backend, 256, 3, 16);
+
+        uint8_t bytes[10] = {1, 2, 3, 4, 5, 6, 7, 8, 9, 10};
+        std::size_t offset = 0;
+
+        ring.begin_frame(0);
+        assert_true(ring.stream(bytes, 10, &offset));
+        assert_equal(0u, offset);
+        assert_true(ring.stream(bytes, 10, &offset));
+        assert_equal(16u, offset); // Aligned
+        ring.end_frame();
+
+        ring.begin_frame(1);
+        assert_true(ring.stream(bytes, 10, &offset));
+        assert_equal(256u, offset);
+        assert_equal(10u, ring.bytes_streamed());
+        ring.end_frame();
+
+        assert_equal(5, backend.data[256 + 4]);
+    }
+
+    void test_regions_wait_for_the_frame_which_used_them() {
+        RecordingBackend backend(3 * 64);
+        StreamingRing ring(&backend, 64, 3, 16);
+
+        uint8_t bytes[4] = {};
+        std::size_t offset = 0;
+
+        for(uint64_t frame = 0; frame < 5; ++frame) {
+            ring.begin_frame(frame);
+
+            // Nothing streamed in frame 2, so there's nothing to wait for when frame 5 comes round
+            if(frame != 2) {
+                ring.stream(bytes, 4, &offset);
+            }
+
+            ring.end_frame();
+        }
+
+        assert_equal(4u, backend.fenced.size());
+        assert_equal(3u, backend.fenced[2]);
+
+        assert_equal(2u, backend.waited.size());
+        assert_equal(0u, backend.waited[0]);
+        assert_equal(1u, backend.waited[1]);
+
+        ring.begin_frame(5);
+        assert_equal(2u, backend.waited.size());
+    }
+
+    void test_data_which_does_not_fit_is_refused() {
+        RecordingBackend backend(3 * 64);
+        StreamingRing ring(&backend, 64, 3, 16);
+
+        uint8_t bytes[48] = {};
+        std::size_t offset = 0;
+
+        // Outside a frame
+        assert_false(ring.stream(bytes, 4, &offset));
+
+        ring.begin_frame(0);
+        assert_true(ring.stream(bytes, 48, &offset));
+        assert_false(ring.stream(bytes, 32, &offset));
+        assert_true(ring.stream(bytes, 16, &offset));
+
+        assert_equal(64u, ring.bytes_streamed());
+        assert_equal(32u, ring.bytes_overflowed());
+    }
+};
+
+
+class GL2StreamedBufferTests : public TestCase {
+public:
+    void test_streamed_buffers_move_through_the_ring() {
+        GL2BufferManager manager(nullptr, true, 4096, 1024);
+
+        auto buffer = manager.allocate(
+            100,
+            HARDWARE_BUFFER_VERTEX_ATTRIBUTES,
+            SHADOW_BUFFER_DISABLED,
+            HARDWARE_BUFFER_MODIFY_REPEATEDLY_USED_FOR_RENDERING
+        );
+
+        std::vector<uint8_t> data(100, 1);
+
+        manager.begin_frame(0);
+        buffer->upload(&data[0], data.size());
+        buffer->bind(HARDWARE_BUFFER_VERTEX_ATTRIBUTES);
+        assert_equal(0u, buffer->offset());
+        manager.end_frame();
+
+        // Not rewritten, but the last frame's region can't be relied on so it's streamed again
+        manager.begin_frame(1);
+        buffer->bind(HARDWARE_BUFFER_VERTEX_ATTRIBUTES);
+        assert_equal(1024u, buffer->offset());
+
+        // Only streamed once per frame
+        buffer->bind(HARDWARE_BUFFER_VERTEX_ATTRIBUTES);
+        assert_equal(1024u, buffer->offset());
+        assert_equal(100u, manager.streaming_ring(HARDWARE_BUFFER_VERTEX_ATTRIBUTES).bytes_streamed());
+        manager.end_frame();
+    }
+
+    void test_full_ring_falls_back_to_the_block() {
+        GL2BufferManager manager(nullptr, true, 4096, 128);
+
+        auto a = manager.allocate(100, HARDWARE_BUFFER_VERTEX_ATTRIBUTES, SHADOW_BUFFER_DISABLED, HARDWARE_BUFFER_MODIFY_REPEATEDLY_USED_FOR_RENDERING);
+        auto b = manager.allocate(100, HARDWARE_BUFFER_VERTEX_ATTRIBUTES, SHADOW_BUFFER_DISABLED, HARDWARE_BUFFER_MODIFY_REPEATEDLY_USED_FOR_RENDERING);
+
+        manager.begin_frame(0);
+
+        a->write(100, [](uint8_t* out) { std::fill(out, out + 100, 2); });
+        b->write(100, [](uint8_t* out) { std::fill(out, out + 100, 3); });
+
+        a->bind(HARDWARE_BUFFER_VERTEX_ATTRIBUTES);
+        b->bind(HARDWARE_BUFFER_VERTEX_ATTRIBUTES);
+
+        assert_equal(0u, a->offset());
+        assert_equal(112u, b->offset()); // Its block in the page, after a's
+
+        auto& ring = manager.streaming_ring(HARDWARE_BUFFER_VERTEX_ATTRIBUTES);
+        assert_equal(100u, ring.bytes_overflowed());
+        manager.end_frame();
+    }
+};
+
+}
@@ -5,6 +5,7 @@
 #include "kaztest/kaztest.h"
 
 #include "global.h"
+#include "../simulant/meshes/keyframe_lerp.h"
 
 class IndexDataTest : public SimulantTestCase {
 public:
@@ -116,6 +117,55 @@ public:
         // sizeof(float) * 18, but rounded to the nearest 16 byte boundary == 96
         assert_equal(96u, data.data_size());
     }
+
+    void test_subset() {
+        smlt::VertexSpecification spec = {
+            smlt::VERTEX_ATTRIBUTE_3F,
+            smlt::VERTEX_ATTRIBUTE_3F,
+            smlt::VERTEX_ATTRIBUTE_2F
+        };
+        spec.diffuse_attribute = smlt::VERTEX_ATTRIBUTE_4F;
+
+        uint32_t animated = smlt::VERTEX_ATTRIBUTE_BIT_POSITION | smlt::VERTEX_ATTRIBUTE_BIT_NORMAL;
+
+        auto frame = spec.subset(animated);
+        assert_true(frame.has_positions());
+        assert_true(frame.has_normals());
+        assert_false(frame.has_texcoord0());
+        assert_false(frame.has_diffuse());
+        assert_equal(sizeof(float) * 3, frame.normal_offset());
+        assert_equal(32u, frame.stride());
+
+        auto fixed = spec.subset(~animated);
+        assert_false(fixed.has_positions());
+        assert_false(fixed.has_normals());
+        assert_true(fixed.has_texcoord0());
+        assert_true(fixed.has_diffuse());
+        assert_equal(0u, fixed.texcoord0_offset());
+        assert_equal(sizeof(float) * 2, fixed.diffuse_offset());
+
+        assert_true(spec.subset(smlt::VERTEX_ATTRIBUTE_BIT_ALL) == spec);
+    }
+
+    void test_lerp_keyframes() {
+        // Not a multiple of four, so the remainder is done one at a time
+        const uint32_t count = 11;
+
+        float a[count], b[count], out[count];
+        for(uint32_t i = 0; i < count; ++i) {
+            a[i] = float(i);
+            b[i] = float(i) * 3.0f - 2.0f;
+        }
+
+        smlt::lerp_keyframes(out, a, b, 0.25f, count);
+
+        for(uint32_t i = 0; i < count; ++i) {
+            assert_close(a[i] + (b[i] - a[i]) * 0.25f, out[i], 0.0001f);
+        }
+
+        smlt::lerp_keyframes(out, a, b, 1.0f, count);
+        assert_close(b[10], out[10], 0.0001f);
+    }
 };
 
 #endif // TEST_VERTEX_DATA_H
@@ -0,0 +1,182 @@
+#pragma once
+
+#include <cmath>
+
+#include <kaztest/kaztest.h>
+
+#include "global.h"
+#include "../simulant/vertex_data.h"
+#include "../simulant/vertex_formats.h"
+
+namespace {
+
+using namespace smlt;
+
+class VertexFormatTests : public TestCase {
+public:
+    void test_half_floats() {
+        assert_equal(0x3C00, float_to_half(1.0f));
+        assert_equal(0xC000, float_to_half(-2.0f));
+        assert_equal(0x7C00, float_to_half(100000.0f));
+
+        const float values[] = {0.0f, 0.5f, -3.25f, 1024.0f, 0.0001f};
+        for(auto value: values) {
+            assert_close(value, half_to_float(float_to_half(value)), std::fabs(value) / 1024.0f);
+        }
+    }
+
+    void test_normalized_formats_round_trip() {
+        uint8_t buffer[16];
+        const Vec4 value(0.25f, -0.5f, 1.0f, 0.75f);
+
+        pack_vertex_attribute(VERTEX_ATTRIBUTE_3SN16, value, buffer);
+        Vec4 result = unpack_vertex_attribute(VERTEX_ATTRIBUTE_3SN16, buffer);
+        assert_close(-0.5f, result.y, 0.0001f);
+        assert_equal(0.0f, result.w);
+
+        pack_vertex_attribute(VERTEX_ATTRIBUTE_4UN8, value, buffer);
+        result = unpack_vertex_attribute(VERTEX_ATTRIBUTE_4UN8, buffer);
+        assert_equal(0.0f, result.y); // Clamped
+        assert_close(0.75f, result.w, 1.0f / 255.0f);
+
+        pack_vertex_attribute(VERTEX_ATTRIBUTE_PACKED_10_10_10_2, value, buffer);
+        result = unpack_vertex_attribute(VERTEX_ATTRIBUTE_PACKED_10_10_10_2, buffer);
+        assert_close(0.25f, result.x, 1.0f / 511.0f);
+        assert_close(-0.5f, result.y, 1.0f / 511.0f);
+        assert_close(1.0f, result.z, 1.0f / 511.0f);
+    }
+
+    void test_cursor_reads_and_writes_compact_formats() {
+        VertexSpecification spec = VertexSpecification::DEFAULT;
+        spec.position_attribute = VERTEX_ATTRIBUTE_3H;
+        spec.texcoord1_attribute = VERTEX_ATTRIBUTE_NONE;
+        spec.normal_attribute = VERTEX_ATTRIBUTE_PACKED_10_10_10_2;
+        spec.texcoord0_attribute = VERTEX_ATTRIBUTE_2UN16;
+        spec.diffuse_attribute = VERTEX_ATTRIBUTE_4UN8;
+
+        // 20 bytes of attributes, padded to BUFFER_STRIDE_ALIGNMENT. The float version is 48
+        assert_equal(32u, spec.stride());
+
+        VertexData data(spec);
+        data.position(2.5f, -1.0f, 8.0f);
+        data.normal(0, 1, 0);
+        data.tex_coord0(0.5f, 0.25f);
+        data.diffuse(Colour::RED);
+        data.move_next();
+        data.done();
+
+        assert_equal(Vec3(2.5f, -1.0f, 8.0f), data.position_at<Vec3>(0));
+        assert_close(0.25f, data.texcoord0_at<Vec2>(0).y, 0.0001f);
+
+        Vec3 normal;
+        data.normal_at(0, normal);
+        assert_close(1.0f, normal.y, 0.0001f);
+    }
+
+    void test_convert_to() {
+        VertexData data(VertexSpecification::DEFAULT);
+        for(uint32_t i = 0; i < 4; ++i) {
+            data.position(i, 0, 0);
+            data.normal(0, 0, 1);
+            data.tex_coord0(0.25f * i, 0);
+            data.diffuse(Colour::WHITE);
+            data.move_next();
+        }
+        data.done();
+
+        VertexSpecification spec = data.specification();
+        spec.normal_attribute = VERTEX_ATTRIBUTE_3SN16;
+        spec.diffuse_attribute = VERTEX_ATTRIBUTE_NONE;
+        data.convert_to(spec);
+
+        assert_true(data.specification() == spec);
+        assert_equal(4u, data.count());
+        assert_equal(Vec3(3, 0, 0), data.position_at<Vec3>(3));
+        assert_equal(Vec2(0.5f, 0), data.texcoord0_at<Vec2>(2));
+
+        Vec3 normal;
+        data.normal_at(1, normal);
+        assert_close(1.0f, normal.z, 0.0001f);
+    }
+
+    void test_attribute_spans_need_float_formats() {
+        VertexSpecification spec = VertexSpecification::POSITION_ONLY;
+        spec.position_attribute = VERTEX_ATTRIBUTE_3H;
+
+        VertexData data(spec);
+        data.resize(2);
+
+        assert_raises(std::logic_error, [&]() { data.attribute_span<Vec3>(VERTEX_ATTRIBUTE_BIT_POSITION); });
+    }
+};
+
+class QuantizeTests : public TestCase {
+public:
+    void test_unit_mesh_is_fully_quantized() {
+        VertexData data(VertexSpecification::DEFAULT);
+        data.position(-1, 0.5f, 1);
+        data.normal(0, 1, 0);
+        data.tex_coord0(1, 0);
+        data.diffuse(Colour::GREEN);
+        data.move_next();
+        data.position(1, -0.5f, -1);
+        data.normal(0, 0, 1);
+        data.tex_coord0(0, 1);
+        data.diffuse(Colour::GREEN);
+        data.move_next();
+        data.done();
+
+        auto spec = quantized_specification(data, VertexQuantizeOptions());
+
+        assert_equal(VERTEX_ATTRIBUTE_3SN16, spec.position_attribute);
+        assert_equal(VERTEX_ATTRIBUTE_PACKED_10_10_10_2, spec.normal_attribute);
+        assert_equal(VERTEX_ATTRIBUTE_2UN16, spec.texcoord0_attribute);
+        assert_equal(VERTEX_ATTRIBUTE_4UN8, spec.diffuse_attribute);
+    }
+
+    void test_values_out_of_range_stay_precise() {
+        VertexData data(VertexSpecification::DEFAULT);
+        data.position(1000.123f, 0, 0);
+        data.normal(0, 1, 0);
+        data.tex_coord0(2.5f, 0);
+        data.diffuse(Colour(2.0f, 0, 0, 1));
+        data.move_next();
+        data.position(1000.0f, 0, 0);
+        data.normal(0, 1, 0);
+        data.tex_coord0(2.5f, 0);
+        data.diffuse(Colour(2.0f, 0, 0, 1));
+        data.move_next();
+        data.done();
+
+        VertexQuantizeOptions options;
+        options.supported = [](VertexAttributeBit, VertexAttribute format) {
+            return format != VERTEX_ATTRIBUTE_PACKED_10_10_10_2;
+        };
+
+        auto spec = quantized_specification(data, options);
+
+        // Too big for snorm16, and a half would be out by most of the mesh's size
+        assert_equal(VERTEX_ATTRIBUTE_3F, spec.position_attribute);
+        assert_equal(VERTEX_ATTRIBUTE_3SN16, spec.normal_attribute);
+        assert_equal(VERTEX_ATTRIBUTE_2H, spec.texcoord0_attribute);
+        assert_equal(VERTEX_ATTRIBUTE_4F, spec.diffuse_attribute);
+    }
+
+    void test_position_tolerance_scales_with_the_mesh() {
+        VertexData data(VertexSpecification::POSITION_ONLY);
+        data.position(-1000.3f, 0, 0);
+        data.move_next();
+        data.position(1000.3f, 0, 0);
+        data.move_next();
+        data.done();
+
+        // A half is out by 0.2 here, which is tiny next to a mesh 2000 units across
+        assert_equal(VERTEX_ATTRIBUTE_3H, quantized_specification(data, VertexQuantizeOptions()).position_attribute);
+
+        VertexQuantizeOptions options;
+        options.position_tolerance = 0.00001f;
+        assert_equal(VERTEX_ATTRIBUTE_3F, quantized_specification(data, options).position_attribute);
+    }
+};
+
+}
@@ -0,0 +1,148 @@
+#pragma once
+
+#include <vector>
+
+#include <kaztest/kaztest.h>
+
+#include "global.h"
+#include "../simulant/vertex_view.h"
+
+namespace {
+
+using namespace smlt;
+
+typedef VertexView<VertexPosition3F, VertexNormal3F, VertexTexCoord0_2F, VertexDiffuse4F> MeshView;
+
+class VertexLayoutTests : public TestCase {
+public:
+    void test_layout_matches_specification() {
+        auto spec = MeshView::layout::specification();
+
+        assert_equal(spec.stride(), MeshView::layout::stride);
+        assert_equal(spec.position_offset(), MeshView::layout::offset<VertexPosition3F>());
+        assert_equal(spec.normal_offset(), MeshView::layout::offset<VertexNormal3F>());
+        assert_equal(spec.texcoord0_offset(), MeshView::layout::offset<VertexTexCoord0_2F>());
+        assert_equal(spec.diffuse_offset(), MeshView::layout::offset<VertexDiffuse4F>());
+    }
+
+    void test_field_order_does_not_matter() {
+        typedef VertexLayout<VertexDiffuse4F, VertexPosition3F> Layout;
+
+        assert_equal(0u, Layout::offset<VertexPosition3F>());
+        assert_equal(12u, Layout::offset<VertexDiffuse4F>());
+        assert_equal(32u, Layout::stride);
+
+        assert_true(Layout::specification() == VertexSpecification(
+            VERTEX_ATTRIBUTE_3F, VERTEX_ATTRIBUTE_NONE, VERTEX_ATTRIBUTE_NONE, VERTEX_ATTRIBUTE_NONE,
+            VERTEX_ATTRIBUTE_NONE, VERTEX_ATTRIBUTE_NONE, VERTEX_ATTRIBUTE_NONE, VERTEX_ATTRIBUTE_NONE,
+            VERTEX_ATTRIBUTE_NONE, VERTEX_ATTRIBUTE_NONE, VERTEX_ATTRIBUTE_4F
+        ));
+    }
+};
+
+class VertexViewTests : public TestCase {
+public:
+    void test_view_rejects_other_layouts() {
+        VertexData data(VertexSpecification::POSITION_ONLY);
+        assert_raises(std::logic_error, [&]() { MeshView view(data); });
+    }
+
+    void test_spans_write_what_the_cursor_reads() {
+        VertexData data(MeshView::layout::specification());
+        data.resize(100);
+
+        std::vector<Vec3> positions;
+        for(uint32_t i = 0; i < 100; ++i) {
+            positions.push_back(Vec3(i, i * 2, i * 3));
+        }
+
+        MeshView view(data);
+        view.span<VertexPosition3F>().assign(&positions[0], positions.size());
+        view.span<VertexNormal3F>().fill(Vec3(0, 0, 1));
+        view.span<VertexTexCoord0_2F>().generate([](uint32_t i) { return Vec2(i, 0); });
+        view.span<VertexDiffuse4F>().fill(Colour::RED);
+
+        assert_equal(Vec3(7, 14, 21), data.position_at<Vec3>(7));
+        assert_equal(Vec2(99, 0), data.texcoord0_at<Vec2>(99));
+
+        Vec3 normal;
+        data.normal_at(50, normal);
+        assert_equal(Vec3(0, 0, 1), normal);
+
+        assert_true(view.get<VertexDiffuse4F>(3) == Colour::RED);
+    }
+
+    void test_transform_and_copy_to() {
+        VertexData data(MeshView::layout::specification());
+        data.resize(10);
+
+        MeshView view(data);
+        auto positions = view.span<VertexPosition3F>();
+        positions.fill(Vec3(1, 1, 1));
+        positions.subspan(5, 5).transform([](const Vec3& p) { return p * 2.0f; });
+
+        std::vector<Vec3> out(10);
+        positions.copy_to(&out[0]);
+
+        assert_equal(Vec3(1, 1, 1), out[4]);
+        assert_equal(Vec3(2, 2, 2), out[5]);
+
+        uint32_t visited = 0;
+        for(auto& p: positions) {
+            assert_true(p.x > 0);
+            ++visited;
+        }
+        assert_equal(10u, visited);
+    }
+
+    void test_copying_whole_vertices() {
+        VertexData data(MeshView::layout::specification());
+        data.resize(4);
+
+        MeshView view(data);
+        view.span<VertexPosition3F>().generate([](uint32_t i) { return Vec3(i, 0, 0); });
+        view.span<VertexDiffuse4F>().generate([](uint32_t i) { return (i == 0) ? Colour::GREEN : Colour::WHITE; });
+
+        view.copy(2, view, 0, 2);
+
+        assert_equal(Vec3(0, 0, 0), view.get<VertexPosition3F>(2));
+        assert_equal(Vec3(1, 0, 0), view.get<VertexPosition3F>(3));
+        assert_true(view.get<VertexDiffuse4F>(2) == Colour::GREEN);
+    }
+};
+
+class AttributeSpanTests : public TestCase {
+public:
+    void test_spans_follow_the_specification() {
+        VertexData data(VertexSpecification::DEFAULT);
+        data.resize(3);
+
+        auto uvs = data.attribute_span<Vec2>(VERTEX_ATTRIBUTE_BIT_TEXCOORD0);
+        assert_equal(data.stride(), uvs.stride());
+        assert_equal(3u, uvs.size());
+
+        uvs[1] = Vec2(0.5, 0.25);
+        assert_equal(Vec2(0.5, 0.25), data.texcoord0_at<Vec2>(1));
+    }
+
+    void test_missing_or_mismatched_attributes_throw() {
+        VertexData data(VertexSpecification::POSITION_ONLY);
+        data.resize(3);
+
+        assert_raises(std::logic_error, [&]() { data.attribute_span<Vec3>(VERTEX_ATTRIBUTE_BIT_NORMAL); });
+        assert_raises(std::logic_error, [&]() { data.attribute_span<Vec2>(VERTEX_ATTRIBUTE_BIT_POSITION); });
+    }
+
+    void test_packed_spans() {
+        std::vector<Vec3> in = {Vec3(1, 2, 3), Vec3(4, 5, 6)};
+        std::vector<Vec3> storage(2);
+
+        StridedSpan<Vec3> span((uint8_t*) &storage[0], sizeof(Vec3), 2);
+        assert_true(span.packed());
+
+        span.assign(&in[0], 2);
+        assert_equal(Vec3(4, 5, 6), storage[1]);
+    }
+};
+
+}
@@ -0,0 +1,98 @@
+#pragma once
+
+#include <vector>
+#include <atomic>
+#include <functional>
+#include <thread>
+
+#include "kaztest/kaztest.h"
+
+#include "simulant/generic/threading/worker_pool.h"
+
+namespace {
+
+using namespace smlt;
+
+class WorkerPoolTests : public TestCase {
+public:
+    void test_no_workers_runs_inline() {
+        WorkerPool pool(0);
+
+        assert_equal(0u, pool.worker_count());
+        assert_equal(1u, pool.thread_count());
+
+        uint32_t calls = 0;
+        pool.parallel_for(100, 10, [&](uint32_t worker, uint32_t begin, uint32_t end) {
+            assert_equal(0u, worker);
+            assert_equal(0u, begin);
+            assert_equal(100u, end);
+            ++calls;
+        });
+
+        assert_equal(1u, calls);
+    }
+
+    void test_every_index_visited_once() {
+        WorkerPool pool(3);
+
+        std::vector<uint32_t> visits(1000, 0);
+        std::atomic<bool> bad_worker(false);
+
+        for(uint32_t run = 0; run < 10; ++run) {
+            pool.parallel_for(visits.size(), 7, [&](uint32_t worker, uint32_t begin, uint32_t end) {
+                if(worker >= pool.thread_count()) {
+                    bad_worker = true;
+                }
+
+                for(uint32_t i = begin; i < end; ++i) {
+                    visits[i]++;
+                }
+            });
+        }
+
+        assert_false(bad_worker.load());
+
+        for(auto count: visits) {
+            assert_equal(10u, count);
+        }
+    }
+
+    void test_callers_on_other_threads_take_turns() {
+        WorkerPool pool(3);
+
+        std::vector<uint32_t> main_visits(1000, 0);
+        std::vector<uint32_t> other_visits(1000, 0);
+
+        auto visit = [&pool](std::vector<uint32_t>& visits) {
+            for(uint32_t run = 0; run < 200; ++run) {
+                pool.parallel_for(visits.size(), 7, [&](uint32_t, uint32_t begin, uint32_t end) {
+                    for(uint32_t i = begin; i < end; ++i) {
+                        visits[i]++;
+                    }
+                });
+            }
+        };
+
+        std::thread other(visit, std::ref(other_visits));
+        visit(main_visits);
+        other.join();
+
+        for(uint32_t i = 0; i < main_visits.size(); ++i) {
+            assert_equal(200u, main_visits[i]);
+            assert_equal(200u, other_visits[i]);
+        }
+    }
+
+    void test_empty_range_does_nothing() {
+        WorkerPool pool(2);
+
+        bool called = false;
+        pool.parallel_for(0, 16, [&](uint32_t, uint32_t, uint32_t) {
+            called = true;
+        });
+
+        assert_false(called);
+    }
+};
+
+}